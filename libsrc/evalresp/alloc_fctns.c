@@ -135,6 +135,8 @@ alloc_response (int npts, evalresp_logger *log)
     strncpy (rptr->locid, "", LOCIDLEN);
     strncpy (rptr->channel, "", NETLEN);
     strncpy (rptr->network, "", CHALEN);
+    strncpy (rptr->beg_t, "", DATIMLEN);
+    strncpy (rptr->end_t, "", DATIMLEN);
     rptr->rvec = alloc_complex (npts, log);
     cvec = rptr->rvec;
     for (k = 0; k < npts; k++)
@@ -425,6 +427,7 @@ alloc_list (evalresp_logger *log)
   blkt_ptr->blkt_info.list.amp = (double *)NULL;
   blkt_ptr->blkt_info.list.phase = (double *)NULL;
   blkt_ptr->blkt_info.list.nresp = 0;
+  blkt_ptr->blkt_info.list.spline = NULL;
 
   return (blkt_ptr);
 }
@@ -622,6 +625,7 @@ free_list (evalresp_blkt *blkt_ptr)
       free (blkt_ptr->blkt_info.list.amp);
     if (blkt_ptr->blkt_info.list.phase)
       free (blkt_ptr->blkt_info.list.phase);
+    free_list_spline (&blkt_ptr->blkt_info.list.spline);
     free (blkt_ptr);
   }
 }
@@ -708,6 +712,7 @@ free_stages (evalresp_stage *stage_ptr)
         free_fir (this_blkt);
         break;
       case FIR_COEFFS:
+      case IIR_COEFFS:
         free_coeff (this_blkt);
         break;
       case LIST:
@@ -806,6 +811,34 @@ evalresp_free_responses (evalresp_responses **responses)
   *responses = NULL;
 }
 
+void
+evalresp_free_sensitivity (evalresp_sensitivity **sensitivity)
+{
+  if (*sensitivity)
+  {
+    free ((*sensitivity)->stages);
+    free ((*sensitivity)->gains);
+    free (*sensitivity);
+  }
+  *sensitivity = NULL;
+}
+
+void
+evalresp_free_sensitivities (evalresp_sensitivities **sensitivities)
+{
+  int i;
+  if (*sensitivities)
+  {
+    for (i = 0; i < (*sensitivities)->nsensitivities; ++i)
+    {
+      evalresp_free_sensitivity (&(*sensitivities)->sensitivities[i]);
+    }
+    free ((*sensitivities)->sensitivities);
+    free (*sensitivities);
+  }
+  *sensitivities = NULL;
+}
+
 int
 evalresp_alloc_channels (evalresp_logger *log, evalresp_channels **channels)
 {
@@ -846,3 +879,164 @@ calloc_doubles (evalresp_logger *log, const char *name, int n, double **array)
   }
   return status;
 }
+
+/* a copy of n values (NULL for none) */
+static int
+copy_values (evalresp_logger *log, const void *in, int n, size_t size, void **out)
+{
+  *out = NULL;
+  if (in && n > 0)
+  {
+    if (!(*out = malloc (n * size)))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate copy of channel");
+      return EVALRESP_MEM;
+    }
+    memcpy (*out, in, n * size);
+  }
+  return EVALRESP_OK;
+}
+
+static int
+copy_blkt (evalresp_logger *log, const evalresp_blkt *in, evalresp_blkt **out)
+{
+  int status = EVALRESP_OK;
+
+  if (!(*out = malloc (sizeof (**out))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate copy of channel");
+    return EVALRESP_MEM;
+  }
+  /* the arrays are cleared first, so that the blockette can be freed if a
+     copy fails */
+  memcpy (*out, in, sizeof (**out));
+  (*out)->next_blkt = NULL;
+  switch (in->type)
+  {
+  case LAPLACE_PZ:
+  case ANALOG_PZ:
+  case IIR_PZ:
+    (*out)->blkt_info.pole_zero.zeros = (*out)->blkt_info.pole_zero.poles = NULL;
+    if (!(status = copy_values (log, in->blkt_info.pole_zero.zeros, in->blkt_info.pole_zero.nzeros,
+                                sizeof (evalresp_complex), (void **)&(*out)->blkt_info.pole_zero.zeros)))
+    {
+      status = copy_values (log, in->blkt_info.pole_zero.poles, in->blkt_info.pole_zero.npoles,
+                            sizeof (evalresp_complex), (void **)&(*out)->blkt_info.pole_zero.poles);
+    }
+    break;
+  case FIR_SYM_1:
+  case FIR_SYM_2:
+  case FIR_ASYM:
+    status = copy_values (log, in->blkt_info.fir.coeffs, in->blkt_info.fir.ncoeffs,
+                          sizeof (double), (void **)&(*out)->blkt_info.fir.coeffs);
+    break;
+  case FIR_COEFFS:
+  case IIR_COEFFS:
+    (*out)->blkt_info.coeff.numer = (*out)->blkt_info.coeff.denom = NULL;
+    if (!(status = copy_values (log, in->blkt_info.coeff.numer, in->blkt_info.coeff.nnumer,
+                                sizeof (double), (void **)&(*out)->blkt_info.coeff.numer)))
+    {
+      status = copy_values (log, in->blkt_info.coeff.denom, in->blkt_info.coeff.ndenom,
+                            sizeof (double), (void **)&(*out)->blkt_info.coeff.denom);
+    }
+    break;
+  case LIST:
+    (*out)->blkt_info.list.freq = (*out)->blkt_info.list.amp = (*out)->blkt_info.list.phase = NULL;
+    (*out)->blkt_info.list.spline = NULL;
+    if (!(status = copy_values (log, in->blkt_info.list.freq, in->blkt_info.list.nresp,
+                                sizeof (double), (void **)&(*out)->blkt_info.list.freq))
+        && !(status = copy_values (log, in->blkt_info.list.amp, in->blkt_info.list.nresp,
+                                   sizeof (double), (void **)&(*out)->blkt_info.list.amp))
+        && !(status = copy_values (log, in->blkt_info.list.phase, in->blkt_info.list.nresp,
+                                   sizeof (double), (void **)&(*out)->blkt_info.list.phase))
+        && in->blkt_info.list.spline)
+    {
+      /* the splines refer to the arrays they were made from */
+      status = list_blkt_spline (log, *out);
+    }
+    break;
+  case GENERIC:
+    (*out)->blkt_info.generic.corner_freq = (*out)->blkt_info.generic.corner_slope = NULL;
+    if (!(status = copy_values (log, in->blkt_info.generic.corner_freq, in->blkt_info.generic.ncorners,
+                                sizeof (double), (void **)&(*out)->blkt_info.generic.corner_freq)))
+    {
+      status = copy_values (log, in->blkt_info.generic.corner_slope, in->blkt_info.generic.ncorners,
+                            sizeof (double), (void **)&(*out)->blkt_info.generic.corner_slope);
+    }
+    break;
+  case POLYNOMIAL:
+    (*out)->blkt_info.polynomial.coeffs = (*out)->blkt_info.polynomial.coeffs_err = NULL;
+    if (!(status = copy_values (log, in->blkt_info.polynomial.coeffs, in->blkt_info.polynomial.ncoeffs,
+                                sizeof (double), (void **)&(*out)->blkt_info.polynomial.coeffs)))
+    {
+      status = copy_values (log, in->blkt_info.polynomial.coeffs_err, in->blkt_info.polynomial.ncoeffs,
+                            sizeof (double), (void **)&(*out)->blkt_info.polynomial.coeffs_err);
+    }
+    break;
+  default: /* DECIMATION, GAIN and REFERENCE hold no arrays */
+    break;
+  }
+  return status;
+}
+
+static int
+copy_string (evalresp_logger *log, const char *in, char **out)
+{
+  *out = NULL;
+  if (in && !(*out = strdup (in)))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate copy of channel");
+    return EVALRESP_MEM;
+  }
+  return EVALRESP_OK;
+}
+
+int
+copy_channel (evalresp_logger *log, const evalresp_channel *in, evalresp_channel **out)
+{
+  int status = EVALRESP_OK;
+  const evalresp_stage *stage;
+  const evalresp_blkt *blkt;
+  evalresp_stage **next_stage;
+  evalresp_blkt **next_blkt;
+
+  if (!(*out = malloc (sizeof (**out))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate copy of channel");
+    return EVALRESP_MEM;
+  }
+  memcpy (*out, in, sizeof (**out));
+  (*out)->first_stage = NULL;
+  next_stage = &(*out)->first_stage;
+  for (stage = in->first_stage; !status && stage; stage = stage->next_stage)
+  {
+    if (!(*next_stage = calloc (1, sizeof (**next_stage))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate copy of channel");
+      status = EVALRESP_MEM;
+      break;
+    }
+    (*next_stage)->sequence_no = stage->sequence_no;
+    (*next_stage)->input_units = stage->input_units;
+    (*next_stage)->output_units = stage->output_units;
+    if (!(status = copy_string (log, stage->input_units_str, &(*next_stage)->input_units_str)))
+    {
+      status = copy_string (log, stage->output_units_str, &(*next_stage)->output_units_str);
+    }
+    next_blkt = &(*next_stage)->first_blkt;
+    for (blkt = stage->first_blkt; !status && blkt; blkt = blkt->next_blkt)
+    {
+      status = copy_blkt (log, blkt, next_blkt);
+      if (*next_blkt)
+      {
+        next_blkt = &(*next_blkt)->next_blkt;
+      }
+    }
+    next_stage = &(*next_stage)->next_stage;
+  }
+  if (status)
+  {
+    evalresp_free_channel (out);
+  }
+  return status;
+}
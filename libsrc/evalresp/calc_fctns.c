@@ -43,6 +43,7 @@
 /* NEEDED for M_PI on windows */
 #define _USE_MATH_DEFINES
 
+#include <float.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -62,6 +63,94 @@ zmul (evalresp_complex *val1, evalresp_complex *val2)
   val1->imag = i;
 }
 
+/*==================================================================
+ *    Error-free transformations used by the compensated Horner
+ *    evaluation below: a + b = s + e and a * b = p + e exactly.
+ *=================================================================*/
+static void
+two_sum (double a, double b, double *s, double *e)
+{
+  double bb;
+  *s = a + b;
+  bb = *s - a;
+  *e = (a - (*s - bb)) + (b - bb);
+}
+
+static void
+two_prod (double a, double b, double *p, double *e)
+{
+  *p = a * b;
+  *e = fma (a, b, -*p);
+}
+
+/*==================================================================
+ *    Evaluate a real-coefficient polynomial in the unit phasor
+ *    z = e^{-i theta} by Horner's rule, so that a filter of any length
+ *    costs one cos/sin pair per frequency rather than one per
+ *    coefficient.  If leading_first is set then c[0] multiplies the
+ *    highest power (z^(n-1)), otherwise c[0] is the constant term.
+ *
+ *    Filters with at least EVALRESP_HORNER_COMPENSATED_MIN coefficients
+ *    are accumulated in double-double (compensated Horner, Graillat et
+ *    al. 2005) with the phasor itself taken from long double trig, so
+ *    the rounding error no longer grows with the filter length.
+ *=================================================================*/
+static void
+horner_phasor (const double *c, int n, int leading_first, double theta,
+               const evalresp_complex *phasor, evalresp_complex *out)
+{
+  int i;
+  double coeff, zr, zi, re = 0.0, im = 0.0, t;
+  long double lzr, lzi;
+  double zr_lo, zi_lo, re_lo = 0.0, im_lo = 0.0;
+  double a, ea, b, eb, s, es, lo;
+
+  if (n < EVALRESP_HORNER_COMPENSATED_MIN)
+  {
+    zr = phasor ? phasor->real : cos (theta);
+    zi = phasor ? phasor->imag : -sin (theta);
+    for (i = 0; i < n; i++)
+    {
+      coeff = c[leading_first ? i : n - 1 - i];
+      t = re * zr - im * zi + coeff;
+      im = re * zi + im * zr;
+      re = t;
+    }
+  }
+  else
+  {
+    lzr = cosl ((long double)theta);
+    lzi = -sinl ((long double)theta);
+    zr = (double)lzr;
+    zi = (double)lzi;
+    zr_lo = (double)(lzr - zr);
+    zi_lo = (double)(lzi - zi);
+    for (i = 0; i < n; i++)
+    {
+      coeff = c[leading_first ? i : n - 1 - i];
+      /* real part: re * zr - im * zi + coeff */
+      two_prod (re, zr, &a, &ea);
+      two_prod (im, zi, &b, &eb);
+      two_sum (a, -b, &s, &es);
+      two_sum (s, coeff, &t, &lo);
+      lo += ea - eb + es + re * zr_lo + re_lo * zr - im * zi_lo - im_lo * zi;
+      /* imaginary part: re * zi + im * zr */
+      two_prod (re, zi, &a, &ea);
+      two_prod (im, zr, &b, &eb);
+      two_sum (a, b, &s, &es);
+      es += ea + eb + re * zi_lo + re_lo * zi + im * zr_lo + im_lo * zr;
+      im = s + es;
+      im_lo = es - (im - s);
+      re = t + lo;
+      re_lo = lo - (re - t);
+    }
+    re += re_lo;
+    im += im_lo;
+  }
+  out->real = re;
+  out->imag = im;
+}
+
 /*==================================================================
  * Convert response to velocity first, then to specified units
  *=================================================================*/
@@ -133,6 +222,19 @@ convert_to_units (int inp, const evalresp_unit units, evalresp_complex *data, do
   return EVALRESP_OK;
 }
 
+/* h0 * num / denom (same amplitude and phase as |num|/|denom| and
+   arg(num) - arg(denom)) */
+static void
+iir_ratio (double h0, const evalresp_complex *num, const evalresp_complex *denom,
+           evalresp_complex *out)
+{
+  double mod_squared;
+
+  mod_squared = denom->real * denom->real + denom->imag * denom->imag;
+  out->real = (num->real * denom->real + num->imag * denom->imag) / mod_squared * h0;
+  out->imag = (num->imag * denom->real - num->real * denom->imag) / mod_squared * h0;
+}
+
 /*==================================================================
  *                Response of a digital IIR filter
  * This code is modified fom the FORTRAN subroutine written and tested by
@@ -142,23 +244,14 @@ convert_to_units (int inp, const evalresp_unit units, evalresp_complex *data, do
  * Version 0.2 07/12/00
  *================================================================*/
 static void
-iir_trans (evalresp_blkt *blkt_ptr, double wint, evalresp_complex *out)
+iir_trans (const evalresp_blkt *blkt_ptr, double h0, double t, double wint,
+           const evalresp_complex *phasor, evalresp_complex *out)
 {
 
-  double h0;
-  double xre, xim, phase;
-  double amp;
-  double t, w;
+  double w;
   double *cn, *cd; /* numerators and denominators */
-  int nn, nd, in, id;
-
-  evalresp_blkt *next_ptr;
-
-  h0 = blkt_ptr->blkt_info.coeff.h0; /* set a sensitivity */
-  next_ptr = blkt_ptr->next_blkt;
-
-  /* Sample interaval = 1/sample rate */
-  t = next_ptr->blkt_info.decimation.sample_int;
+  int nn, nd;
+  evalresp_complex num, denom;
 
   /* Numerator coeffs number */
   nn = blkt_ptr->blkt_info.coeff.nnumer;
@@ -173,53 +266,62 @@ iir_trans (evalresp_blkt *blkt_ptr, double wint, evalresp_complex *out)
   /* Calculate radial freq. time sample interval */
   w = wint * t;
 
-  /* Handle numerator */
-  xre = cn[0];
-  xim = 0.0;
+  /* Numerator and denominator are polynomials in z^-1 = e^{-iw} */
+  horner_phasor (cn, nn, 0, w, phasor, &num);
+  horner_phasor (cd, nd, 0, w, phasor, &denom);
+  iir_ratio (h0, &num, &denom, out);
+}
+
+/*================================================================
+ *    Response of blockette 62 (Polynomial)
+ * Function introduced in version 3.3.4 of evalresp
+ * Ilya Dricker ISTI (.dricker@isti.com) 06/01/13
+ *===============================================================*/
+/* the value and first derivative of the polynomial at n inputs, by
+   Horner's rule; the coefficients are taken in the outer loop so that the
+   inner loops, over a chunk of inputs, can be vectorised */
+static void
+horner_polynomial (const evalresp_polynomial *poly, double const *x, int n,
+                   double *value, double *derivative)
+{
+  double p[EVALRESP_POLYNOMIAL_CHUNK], d[EVALRESP_POLYNOMIAL_CHUNK], c;
+  int i, j, k, m;
 
-  if (nn != 1)
+  for (i = 0; i < n; i += m)
   {
-    for (in = 1; in < nn; in++)
+    m = n - i < EVALRESP_POLYNOMIAL_CHUNK ? n - i : EVALRESP_POLYNOMIAL_CHUNK;
+    for (k = 0; k < m; k++)
     {
-      xre += cn[in] * cos (-(in * w));
-      xim += cn[in] * sin (-(in * w));
+      p[k] = 0.0;
+      d[k] = 0.0;
     }
-  }
-  amp = sqrt (xre * xre + xim * xim);
-  phase = atan2 (xim, xre);
-
-  /* handle denominator */
-
-  xre = cd[0];
-  xim = 0.0;
-
-  if (nd != 1)
-  {
-    for (id = 1; id < nd; id++)
+    for (j = poly->ncoeffs - 1; j >= 0; j--)
+    {
+      c = poly->coeffs[j];
+      for (k = 0; k < m; k++)
+      {
+        d[k] = d[k] * x[i + k] + p[k];
+        p[k] = p[k] * x[i + k] + c;
+      }
+    }
+    if (value)
+    {
+      for (k = 0; k < m; k++)
+        value[i + k] = p[k];
+    }
+    if (derivative)
     {
-      xre += cd[id] * cos (-(id * w));
-      xim += cd[id] * sin (-(id * w));
+      for (k = 0; k < m; k++)
+        derivative[i + k] = d[k];
     }
   }
-
-  amp /= (sqrt (xre * xre + xim * xim));
-  phase = (phase - atan2 (xim, xre));
-
-  out->real = amp * cos (phase) * h0;
-  out->imag = amp * sin (phase) * h0;
 }
 
-/*================================================================
- *    Response of blockette 62 (Polynomial)
- * Function introduced in version 3.3.4 of evalresp
- * Ilya Dricker ISTI (.dricker@isti.com) 06/01/13
- *===============================================================*/
 static int
-calc_polynomial (evalresp_blkt *blkt_ptr, evalresp_complex *out,
+calc_polynomial (const evalresp_blkt *blkt_ptr, evalresp_complex *out,
                  double x_for_b62, evalresp_logger *log)
 {
   double amp = 0, phase = 0;
-  int j;
 
   if (x_for_b62 <= 0)
   {
@@ -230,10 +332,7 @@ calc_polynomial (evalresp_blkt *blkt_ptr, evalresp_complex *out,
   }
 
   // Compute a first derivate of MacLaurin polynomial
-  for (j = 1; j < blkt_ptr->blkt_info.polynomial.ncoeffs; j++)
-  {
-    amp += blkt_ptr->blkt_info.polynomial.coeffs[j] * j * pow (x_for_b62, j - 1);
-  }
+  horner_polynomial (&blkt_ptr->blkt_info.polynomial, &x_for_b62, 1, NULL, &amp);
 
   if (amp >= 0)
   {
@@ -256,7 +355,7 @@ calc_polynomial (evalresp_blkt *blkt_ptr, evalresp_complex *out,
  * Ilya Dricker ISTI (.dricker@isti.com) 06/22/00
  *===============================================================*/
 static void
-calc_list (evalresp_blkt *blkt_ptr, int i, evalresp_complex *out)
+calc_list (const evalresp_blkt *blkt_ptr, int i, evalresp_complex *out)
 {
   double amp, phase;
   double halfcirc = 180;
@@ -272,11 +371,12 @@ calc_list (evalresp_blkt *blkt_ptr, int i, evalresp_complex *out)
  *                Response of analog filter
  *=================================================================*/
 static void
-analog_trans (evalresp_blkt *blkt_ptr, double freq, evalresp_complex *out)
+analog_trans (const evalresp_blkt *blkt_ptr, double h0, double freq,
+              evalresp_complex *out)
 {
   int nz, np, i;
   evalresp_complex *ze, *po, denom, num, omega, temp;
-  double h0, mod_squared;
+  double mod_squared;
 
   if (blkt_ptr->type == LAPLACE_PZ)
     freq = 2 * M_PI * freq;
@@ -288,7 +388,6 @@ analog_trans (evalresp_blkt *blkt_ptr, double freq, evalresp_complex *out)
   nz = blkt_ptr->blkt_info.pole_zero.nzeros;
   po = blkt_ptr->blkt_info.pole_zero.poles;
   np = blkt_ptr->blkt_info.pole_zero.npoles;
-  h0 = blkt_ptr->blkt_info.pole_zero.a0;
 
   for (i = 0; i < nz; i++)
   {
@@ -320,63 +419,76 @@ analog_trans (evalresp_blkt *blkt_ptr, double freq, evalresp_complex *out)
 /*==================================================================
  *                Response of symetrical FIR filters
  *=================================================================*/
+/* the response of the whole symmetric filter from the sum over its
+   stored half (see fir_sym_trans()) */
 static void
-fir_sym_trans (evalresp_blkt *blkt_ptr, double w, evalresp_complex *out)
+fir_sym_fold (const evalresp_blkt *blkt_ptr, double h0, double wsint,
+              const evalresp_complex *sum, evalresp_complex *out)
 {
-  double *a, h0, wsint;
-  evalresp_blkt *next_ptr;
-  int na;
-  int k, fact;
-  double R = 0.0, sint;
-
-  a = blkt_ptr->blkt_info.fir.coeffs;
-  na = blkt_ptr->blkt_info.fir.ncoeffs;
-  next_ptr = blkt_ptr->next_blkt;
-  h0 = blkt_ptr->blkt_info.fir.h0;
-  sint = next_ptr->blkt_info.decimation.sample_int;
-  wsint = w * sint;
+  double *a = blkt_ptr->blkt_info.fir.coeffs;
+  int na = blkt_ptr->blkt_info.fir.ncoeffs;
 
   if (blkt_ptr->type == FIR_SYM_1)
   {
-    for (k = 0; k < (na - 1); k++)
-    {
-      fact = na - (k + 1);
-      R += a[k] * cos (wsint * fact);
-    }
-    out->real = (a[k] + 2.0 * R) * h0;
+    out->real = (2.0 * sum->real - a[na - 1]) * h0;
     out->imag = 0.;
   }
   else if (blkt_ptr->type == FIR_SYM_2)
   {
-    for (k = 0; k < na; k++)
-    {
-      fact = na - (k + 1);
-      R += a[k] * cos (wsint * (fact + 0.5));
-    }
-    out->real = 2.0 * R * h0;
+    /* shift by half a sample: Re(e^{-i wsint / 2} * sum) */
+    out->real = 2.0 * (sum->real * cos (wsint / 2.) + sum->imag * sin (wsint / 2.)) * h0;
     out->imag = 0.;
   }
 }
 
+static void
+fir_sym_trans (const evalresp_blkt *blkt_ptr, double h0, double sint, double w,
+               const evalresp_complex *phasor, evalresp_complex *out)
+{
+  double *a, wsint;
+  int na;
+  evalresp_complex sum;
+
+  a = blkt_ptr->blkt_info.fir.coeffs;
+  na = blkt_ptr->blkt_info.fir.ncoeffs;
+  wsint = w * sint;
+
+  /* sum of a[k] e^{-i wsint (na - 1 - k)}; the real part gives the
+     cosine series of the folded (symmetric) filter */
+  horner_phasor (a, na, 1, wsint, phasor, &sum);
+  fir_sym_fold (blkt_ptr, h0, wsint, &sum, out);
+}
+
 /*==================================================================
  *                Response of asymetrical FIR filters
  *=================================================================*/
+/* IGD The last member is returned from evalresp-3.2.35 after Gabi Laske report) */
+/* (rotate by the phase of half the filter length rather than via atan2) */
+static void
+fir_asym_rotate (int na, double h0, double sint, double w,
+                 const evalresp_complex *sum, evalresp_complex *out)
+{
+  double pha, c, s;
+
+  pha = w * (double)((na - 1) / 2.0) * sint;
+  c = cos (pha);
+  s = sin (pha);
+  out->real = (sum->real * c - sum->imag * s) * h0;
+  out->imag = (sum->real * s + sum->imag * c) * h0;
+}
+
 static void
-fir_asym_trans (evalresp_blkt *blkt_ptr, double w, evalresp_complex *out)
+fir_asym_trans (const evalresp_blkt *blkt_ptr, double h0, double sint, double w,
+                const evalresp_complex *phasor, evalresp_complex *out)
 {
-  double *a, h0, sint;
-  evalresp_blkt *next_ptr;
+  double *a;
   int na;
   int k;
-  double R = 0.0, I = 0.0;
-  double wsint, y;
-  double mod, pha;
+  double wsint;
+  evalresp_complex sum;
 
   a = blkt_ptr->blkt_info.fir.coeffs;
   na = blkt_ptr->blkt_info.fir.ncoeffs;
-  next_ptr = blkt_ptr->next_blkt;
-  h0 = blkt_ptr->blkt_info.fir.h0;
-  sint = next_ptr->blkt_info.decimation.sample_int;
   wsint = w * sint;
 
   for (k = 1; k < na; k++)
@@ -394,31 +506,19 @@ fir_asym_trans (evalresp_blkt *blkt_ptr, double w, evalresp_complex *out)
     return;
   }
 
-  for (k = 0; k < na; k++)
-  {
-    y = wsint * k;
-    R += a[k] * cos (y);
-    I += a[k] * -sin (y);
-  }
-
-  mod = sqrt (R * R + I * I);
-  /* IGD The last member is returned from evalresp-3.2.35 after Gabi Laske report) */
-  pha = atan2 (I, R) + (w * (double)((na - 1) / 2.0) * sint);
-  R = mod * cos (pha);
-  I = mod * sin (pha);
-  out->real = R * h0;
-  out->imag = I * h0;
+  horner_phasor (a, na, 0, wsint, phasor, &sum);
+  fir_asym_rotate (na, h0, sint, w, &sum, out);
 }
 
 /*==================================================================
  *                Response of IIR filters
  *=================================================================*/
 static void
-iir_pz_trans (evalresp_blkt *blkt_ptr, double w, evalresp_complex *out)
+iir_pz_trans (const evalresp_blkt *blkt_ptr, double h0, double sint, double w,
+              const evalresp_complex *phasor, evalresp_complex *out)
 {
   evalresp_complex *ze, *po;
-  double h0, sint, wsint;
-  evalresp_blkt *next_ptr;
+  double wsint;
   int nz, np;
   int i;
   double mod = 1.0, pha = 0.0;
@@ -429,13 +529,10 @@ iir_pz_trans (evalresp_blkt *blkt_ptr, double w, evalresp_complex *out)
   nz = blkt_ptr->blkt_info.pole_zero.nzeros;
   po = blkt_ptr->blkt_info.pole_zero.poles;
   np = blkt_ptr->blkt_info.pole_zero.npoles;
-  h0 = blkt_ptr->blkt_info.pole_zero.a0;
-  next_ptr = blkt_ptr->next_blkt;
-  sint = next_ptr->blkt_info.decimation.sample_int;
   wsint = w * sint;
 
-  c = cos (wsint);
-  s = sin (wsint); /* IGD 10/21/02 instead of -: pointed by Sleeman */
+  c = phasor ? phasor->real : cos (wsint);
+  s = phasor ? -phasor->imag : sin (wsint); /* IGD 10/21/02 instead of -: pointed by Sleeman */
   for (i = 0; i < nz; i++)
   {
     R = c - ze[i].real; /* IGD 09/20/01 instead of + */
@@ -465,25 +562,51 @@ iir_pz_trans (evalresp_blkt *blkt_ptr, double w, evalresp_complex *out)
  *      delta at the frequence w (rads/sec)
  *=================================================================*/
 static void
-calc_time_shift (double delta, double w, evalresp_complex *out)
+calc_time_shift (double delta, double w, const evalresp_complex *phasor,
+                 evalresp_complex *out)
+{
+  out->real = phasor ? phasor->real : cos (w * delta);
+  out->imag = phasor ? -phasor->imag : sin (w * delta);
+}
+
+/*==================================================================
+ *      sample interval of a digital filter, taken from the
+ *      decimation blockette that follows it in its stage
+ *=================================================================*/
+static double
+filter_sint (const evalresp_blkt *blkt_ptr)
+{
+  return blkt_ptr->next_blkt->blkt_info.decimation.sample_int;
+}
+
+/*==================================================================
+ *      is the stage with the given sequence number selected by the
+ *      start_stage and stop_stage options?
+ *=================================================================*/
+static int
+stage_selected (evalresp_options const *const options, int sequence_no)
 {
-  out->real = cos (w * delta);
-  out->imag = sin (w * delta);
+  if (options->start_stage >= 0 && options->stop_stage && (sequence_no < options->start_stage || sequence_no > options->stop_stage))
+    return 0;
+  else if (options->start_stage >= 0 && !options->stop_stage && sequence_no != options->start_stage)
+    return 0;
+  return 1;
 }
 
 /*=================================================================
- *                   Normalize response
+ *    Checks made on the stage gains before a channel is normalized
+ *    (TEST 1 of the normalization) and choice of the sensitivity
+ *    frequency.  If a two stage channel has no stage gain then
+ *    *sensit_gain is set and the reported sensitivity is used as
+ *    the gain of its first stage.
  *=================================================================*/
-int
-normalize_response (evalresp_logger *log, evalresp_options const *const options, evalresp_channel *chan)
+static int
+check_gains (evalresp_logger *log, evalresp_channel const *chan,
+             int *sensit_gain, double *sensfreq)
 {
   evalresp_stage *stage_ptr;
-  evalresp_blkt *fil, *last_fil = NULL, *main_filt = NULL;
-  int i, main_type, reset_gain, skipped_stages = 0;
-  double w, f;
-  double percent_diff;
-  evalresp_complex of, df;
-  int curr_seq_no;
+  evalresp_blkt *fil, *last_fil = NULL;
+  int i;
 
   /* -------- TEST 1 -------- */
   /*
@@ -495,24 +618,9 @@ normalize_response (evalresp_logger *log, evalresp_options const *const options,
      not require gain or sensitivity
      */
 
-  if (chan->nstages == 1)
-  { /* has no stage 0, does it have a gain??? */
-    stage_ptr = chan->first_stage;
-    fil = stage_ptr->first_blkt;
-    while (fil != (evalresp_blkt *)NULL && fil->type != GAIN)
-    {
-      last_fil = fil;
-      fil = last_fil->next_blkt;
-    }
-    if (fil == (evalresp_blkt *)NULL && last_fil->type != POLYNOMIAL)
-    {
-      evalresp_log (log, EV_ERROR, 0,
-                    "norm_resp; no stage gain defined, zero sensitivity");
-      return EVALRESP_VAL; /* ILLEGAL_RESP_FORMAT */
-    }
-  }
-  else if (chan->nstages == 2)
-  { /* has a stage 0??? */
+  *sensit_gain = 0;
+  if (chan->nstages == 1 || chan->nstages == 2)
+  { /* has no stage 0, does it have a gain???  or has a stage 0??? */
     stage_ptr = chan->first_stage;
     fil = stage_ptr->first_blkt;
     while (fil != (evalresp_blkt *)NULL && fil->type != GAIN)
@@ -520,61 +628,30 @@ normalize_response (evalresp_logger *log, evalresp_options const *const options,
       last_fil = fil;
       fil = last_fil->next_blkt;
     }
-    if (fil == (evalresp_blkt *)NULL && last_fil->type != POLYNOMIAL)
+    if (fil == (evalresp_blkt *)NULL && last_fil && last_fil->type != POLYNOMIAL)
     {
-      if (chan->sensit == 0.0)
+      if (chan->nstages == 1 || chan->sensit == 0.0)
       {
         evalresp_log (log, EV_ERROR, 0,
                       "norm_resp; no stage gain defined, zero sensitivity");
         return EVALRESP_VAL; /* ILLEGAL_RESP_FORMAT */
       }
-      else
-      {
-        fil = alloc_gain (log);
-        fil->blkt_info.gain.gain = chan->sensit;
-        fil->blkt_info.gain.gain_freq = chan->sensfreq;
-        last_fil->next_blkt = fil;
-      }
+      *sensit_gain = 1;
     }
   }
 
-  /* -------- TEST 2 -------- */
-  /*
-
-     Compute the variable chan->calc_sensit.  This value would normally be the
-     same as chan->sensit (the stage zero sensitivity) if the sensitivity
-     has been given and all the channel gains are at the sensitivity frequency.
-
-     Note that we must verify that each filter gain and normalization is
-     at the sensitivity frequency, before we can compute the overall
-     channel sensitivity.  If the frequencies are different, calculate the
-     gain for the stage at the same frequency as the channel sensitivity
-     frequency.
-
-     Note on terminology:
-
-     chan->sensit      = stage zero sensitivity read from input file
-     (i.e. the total sensitivity for a given channel).
-     chan->sensfreq    = frequency at which chan-sensit is reported.
-     chan->calc_sensit = product of the individual stage gains. This is computed
-     below. The computation is done at the frequency
-     chan->sensfreq. */
-
   /* Loop thru stages, checking for stage gains of zero */
 
   stage_ptr = chan->first_stage;
   for (i = 0; i < chan->nstages; i++)
   {
-    fil = stage_ptr->first_blkt;
-    curr_seq_no = stage_ptr->sequence_no;
-    while (fil)
+    for (fil = stage_ptr->first_blkt; fil; fil = fil->next_blkt)
     {
       if (fil->type == GAIN && fil->blkt_info.gain.gain == 0.0)
       {
         evalresp_log (log, EV_ERROR, 0, "norm_resp; zero stage gain");
         return EVALRESP_VAL; /* ILLEGAL_RESP_FORMAT */
       }
-      fil = fil->next_blkt;
     }
     stage_ptr = stage_ptr->next_stage;
   }
@@ -588,183 +665,160 @@ normalize_response (evalresp_logger *log, evalresp_options const *const options,
      frequency is likely the best choice, as its pass band is the
      narrowest. If all the frequencies are zero, then use zero! */
 
+  *sensfreq = chan->sensfreq;
   if (chan->sensit == 0.0)
   {
     stage_ptr = chan->first_stage;
     for (i = 0; i < chan->nstages; i++)
     {
-      fil = stage_ptr->first_blkt;
-      while (fil)
+      for (fil = stage_ptr->first_blkt; fil; fil = fil->next_blkt)
       {
         if (fil->type == GAIN && fil->blkt_info.gain.gain_freq != 0.0)
-          chan->sensfreq = fil->blkt_info.gain.gain_freq;
-        fil = fil->next_blkt;
+          *sensfreq = fil->blkt_info.gain.gain_freq;
       }
       stage_ptr = stage_ptr->next_stage;
     }
   }
+  return EVALRESP_OK;
+}
 
-  /*
-     Loop thru filters, evaluate the filter gains and normalizations at
-     the single frequency,  chan->sensfreq. Use the stage gains to
-     calculate a total channel sensitivity. */
+/*=================================================================
+ *    Normalize a stage gain (and the normalization of the main filter
+ *    of the stage) to the sensitivity frequency f, if the gain is given
+ *    at another frequency.  The result is kept in the gain entry; the
+ *    blockettes are not modified.
+ *=================================================================*/
+static int
+normalize_stage (evalresp_logger *log, const evalresp_blkt *main_filt,
+                 int main_type, double f, evalresp_plan_gain *gain)
+{
+  double w = 2 * M_PI * f;
+  evalresp_complex of, df;
+  int reset_gain = 1;
 
-  chan->calc_sensit = 1.0;
-  f = chan->sensfreq;
-  w = 2 * M_PI * f;
+  if ((gain->gain_freq == f) && !((main_type == ANALOG_PZ || main_type == LAPLACE_PZ || main_type == IIR_PZ) && (main_filt->blkt_info.pole_zero.a0_freq != f)))
+  {
+    return EVALRESP_OK;
+  }
 
-  stage_ptr = chan->first_stage;
-  for (i = 0; i < chan->nstages; i++)
+  /* the filter response with unit normalization, at the gain
+     frequency (df) and at the sensitivity frequency (of) */
+  if (main_type == ANALOG_PZ || main_type == LAPLACE_PZ)
   {
-    if (options->start_stage >= 0 && options->stop_stage && (stage_ptr->sequence_no < options->start_stage || stage_ptr->sequence_no > options->stop_stage))
+    analog_trans (main_filt, 1.0, gain->gain_freq, &df);
+    if (df.real == 0.0 && df.imag == 0.0)
     {
-      if (stage_ptr->sequence_no)
-        skipped_stages = 1;
-      stage_ptr = stage_ptr->next_stage;
-      continue;
+      evalresp_log (log, EV_ERROR, 0,
+                    "norm_resp: Gain frequency of zero found in bandpass analog filter");
+      return EVALRESP_VAL; /* ILLEGAL_FILT_S{EC */
     }
-    else if (options->start_stage >= 0 && !options->stop_stage && stage_ptr->sequence_no != options->start_stage)
+    analog_trans (main_filt, 1.0, f, &of);
+    if (of.real == 0.0 && of.imag == 0.0)
     {
-      if (stage_ptr->sequence_no)
-        skipped_stages = 1;
-      stage_ptr = stage_ptr->next_stage;
-      continue;
+      evalresp_log (log, EV_ERROR, 0,
+                    "norm_resp: Chan. Sens. frequency found with bandpass analog filter");
+      return EVALRESP_VAL; /* ILLEGAL_FILT_S{EC */
     }
-    fil = stage_ptr->first_blkt;
-    curr_seq_no = stage_ptr->sequence_no;
-    main_type = 0;
-    while (fil)
-    {
-      switch (fil->type)
-      {
-      case DECIMATION:
-      case REFERENCE:
-        break;
-      case ANALOG_PZ:
-      case LAPLACE_PZ:
-      case IIR_PZ:
-      case FIR_SYM_1:
-      case FIR_SYM_2:
-      case FIR_ASYM:
-      case POLYNOMIAL: /*IGD 06/01/0213 */
-      case IIR_COEFFS: /* IGD New type from v 3.2.17 */
-        main_filt = fil;
-        main_type = fil->type;
-        break;
-      case GAIN:
-        if (curr_seq_no)
-        {
-          if ((fil->blkt_info.gain.gain_freq != chan->sensfreq) || ((main_type == ANALOG_PZ || main_type == LAPLACE_PZ || main_type == IIR_PZ) && (main_filt->blkt_info.pole_zero.a0_freq != chan->sensfreq)))
-          {
-
-            reset_gain = 1;
-            if (main_type == ANALOG_PZ || main_type == LAPLACE_PZ)
-            {
-              main_filt->blkt_info.pole_zero.a0 = 1.0;
-              analog_trans (main_filt,
-                            fil->blkt_info.gain.gain_freq, &df);
-              if (df.real == 0.0 && df.imag == 0.0)
-              {
-                evalresp_log (log, EV_ERROR, 0,
-                              "norm_resp: Gain frequency of zero found in bandpass analog filter");
-                return EVALRESP_VAL; /* ILLEGAL_FILT_S{EC */
-              }
-              analog_trans (main_filt, f, &of);
-              if (of.real == 0.0 && of.imag == 0.0)
-              {
-                evalresp_log (log, EV_ERROR, 0,
-                              "norm_resp: Chan. Sens. frequency found with bandpass analog filter");
-                return EVALRESP_VAL; /* ILLEGAL_FILT_S{EC */
-              }
-            }
-            else if (main_type == IIR_PZ)
-            {
-              main_filt->blkt_info.pole_zero.a0 = 1.0;
-              iir_pz_trans (main_filt,
-                            2 * M_PI * fil->blkt_info.gain.gain_freq, &df);
-              iir_pz_trans (main_filt, w, &of);
-            }
-            else if ((main_type == FIR_SYM_1 || main_type == FIR_SYM_2) && main_filt->blkt_info.fir.ncoeffs)
-            {
-              main_filt->blkt_info.fir.h0 = 1.0;
-              fir_sym_trans (main_filt,
-                             2 * M_PI * fil->blkt_info.gain.gain_freq, &df);
-              fir_sym_trans (main_filt, w, &of);
-            }
-            else if (main_type == FIR_ASYM && main_filt->blkt_info.fir.ncoeffs)
-            {
-              main_filt->blkt_info.fir.h0 = 1.0;
-              fir_asym_trans (main_filt,
-                              2 * M_PI * fil->blkt_info.gain.gain_freq, &df);
-              fir_asym_trans (main_filt, w, &of);
-            }
-            else if (main_type == IIR_COEFFS)
-            { /*IGD - new case for 3.2.17 */
-              main_filt->blkt_info.coeff.h0 = 1.0;
-              iir_trans (main_filt,
-                         2 * M_PI * fil->blkt_info.gain.gain_freq, &df);
-              iir_trans (main_filt, w, &of);
-            }
-
-            else
-              reset_gain = 0;
+  }
+  else if (main_type == IIR_PZ)
+  {
+    iir_pz_trans (main_filt, 1.0, filter_sint (main_filt),
+                  2 * M_PI * gain->gain_freq, NULL, &df);
+    iir_pz_trans (main_filt, 1.0, filter_sint (main_filt), w, NULL, &of);
+  }
+  else if ((main_type == FIR_SYM_1 || main_type == FIR_SYM_2) && main_filt->blkt_info.fir.ncoeffs)
+  {
+    fir_sym_trans (main_filt, 1.0, filter_sint (main_filt),
+                   2 * M_PI * gain->gain_freq, NULL, &df);
+    fir_sym_trans (main_filt, 1.0, filter_sint (main_filt), w, NULL, &of);
+  }
+  else if (main_type == FIR_ASYM && main_filt->blkt_info.fir.ncoeffs)
+  {
+    fir_asym_trans (main_filt, 1.0, filter_sint (main_filt),
+                    2 * M_PI * gain->gain_freq, NULL, &df);
+    fir_asym_trans (main_filt, 1.0, filter_sint (main_filt), w, NULL, &of);
+  }
+  else if (main_type == IIR_COEFFS)
+  { /*IGD - new case for 3.2.17 */
+    iir_trans (main_filt, 1.0, filter_sint (main_filt),
+               2 * M_PI * gain->gain_freq, NULL, &df);
+    iir_trans (main_filt, 1.0, filter_sint (main_filt), w, NULL, &of);
+  }
+  else
+    reset_gain = 0;
 
-            if (reset_gain)
-            {
-              fil->blkt_info.gain.gain /= sqrt (
-                  df.real * df.real + df.imag * df.imag);
-              fil->blkt_info.gain.gain *= sqrt (
-                  of.real * of.real + of.imag * of.imag);
-              fil->blkt_info.gain.gain_freq = f;
-              if (main_type == ANALOG_PZ || main_type == LAPLACE_PZ || main_type == IIR_PZ)
-              {
-                main_filt->blkt_info.pole_zero.a0 = 1.0 / sqrt (
-                                                              of.real * of.real + of.imag * of.imag);
-                main_filt->blkt_info.pole_zero.a0_freq = f;
-              }
-              else if (main_type == FIR_SYM_1 || main_type == FIR_SYM_2 || main_type == FIR_ASYM)
-              {
-                main_filt->blkt_info.fir.h0 = 1.0 / sqrt (
-                                                        of.real * of.real + of.imag * of.imag);
-              }
-              else if (main_type == IIR_COEFFS)
-              {
-                main_filt->blkt_info.coeff.h0 = 1.0 / sqrt (
-                                                          of.real * of.real + of.imag * of.imag);
-              }
-            }
-          }
-          /* compute new overall sensitivity. */
-          chan->calc_sensit *= fil->blkt_info.gain.gain;
-          if (chan->nstages == 1)
-          {
-            chan->sensit = chan->calc_sensit;
-          }
-        }
-        break;
-      default:
-        break;
-      }
-      fil = fil->next_blkt;
-    }
-    stage_ptr = stage_ptr->next_stage;
+  if (reset_gain)
+  {
+    gain->gain /= sqrt (df.real * df.real + df.imag * df.imag);
+    gain->gain *= sqrt (of.real * of.real + of.imag * of.imag);
+    gain->gain_freq = f;
+    gain->filt = main_filt;
+    gain->filt_gain = 1.0 / sqrt (of.real * of.real + of.imag * of.imag);
   }
+  return EVALRESP_OK;
+}
 
-  /* -------- TEST 3 -------- */
-  /* Finally, print a warning, if necessary */
+/*=================================================================
+ *                   Normalize response
+ *=================================================================*/
+int
+normalize_response (evalresp_logger *log, evalresp_options const *const options, evalresp_channel *chan)
+{
+  evalresp_plan *plan = NULL;
+  evalresp_plan_gain *gain;
+  evalresp_blkt *fil, *last_fil;
+  int i, status;
 
-  if (!skipped_stages && chan->sensit != 0.0)
+  if (!(status = compile_plan (log, options, chan, 1, &plan)))
   {
-    percent_diff = fabs ((chan->sensit - chan->calc_sensit) / chan->sensit);
-    if (percent_diff >= 0.05)
+    for (i = 0; i < plan->ngains; i++)
     {
-      evalresp_log (log, EV_WARN, 0,
-                    " (norm_resp): computed and reported sensitivities");
-      evalresp_log (log, EV_WARN, 0, " differ by more than 5 percent. \n");
-      evalresp_log (log, EV_WARN, 0, "\t Execution continuing.\n");
+      gain = &plan->gains[i];
+      if (gain->blkt)
+      {
+        fil = (evalresp_blkt *)gain->blkt;
+      }
+      else
+      {
+        /* add the reported sensitivity as a gain of the first stage */
+        if (!(fil = alloc_gain (log)))
+        {
+          status = EVALRESP_MEM;
+          break;
+        }
+        for (last_fil = chan->first_stage->first_blkt; last_fil->next_blkt;
+             last_fil = last_fil->next_blkt)
+          ;
+        last_fil->next_blkt = fil;
+      }
+      fil->blkt_info.gain.gain = gain->gain;
+      fil->blkt_info.gain.gain_freq = gain->gain_freq;
+      if (gain->filt)
+      {
+        fil = (evalresp_blkt *)gain->filt;
+        switch (fil->type)
+        {
+        case ANALOG_PZ:
+        case LAPLACE_PZ:
+        case IIR_PZ:
+          fil->blkt_info.pole_zero.a0 = gain->filt_gain;
+          fil->blkt_info.pole_zero.a0_freq = gain->gain_freq;
+          break;
+        case IIR_COEFFS:
+          fil->blkt_info.coeff.h0 = gain->filt_gain;
+          break;
+        default:
+          fil->blkt_info.fir.h0 = gain->filt_gain;
+          break;
+        }
+      }
     }
+    chan->sensit = plan->sensit;
+    chan->sensfreq = plan->sensfreq;
+    chan->calc_sensit = plan->calc_sensit;
   }
-  return EVALRESP_OK;
+  free_plan (&plan);
+  return status;
 }
 
 /* IGD 04/05/04 Phase unwrapping function
@@ -817,188 +871,1574 @@ wrap_phase (double phase, double range, double *added_value)
   return phase;
 }
 
-int
-calculate_response (evalresp_logger *log, evalresp_options *options,
-                    evalresp_channel *chan, double *freq, int nfreqs,
-                    evalresp_complex *output)
+/*=================================================================
+ *    Add a stage gain to a plan that is being normalized: normalize
+ *    it (and the main filter of its stage) to the sensitivity
+ *    frequency and compute new overall sensitivity.
+ *=================================================================*/
+static int
+add_stage_gain (evalresp_logger *log, evalresp_plan *plan, int sequence_no,
+                const evalresp_blkt *blkt, double stage_gain, double gain_freq,
+                const evalresp_blkt *main_filt, int main_type,
+                evalresp_plan_op *main_op)
 {
-  evalresp_blkt *blkt_ptr;
-  evalresp_stage *stage_ptr;
-  int i, j, units_code, eval_flag = 0, nc = 0, sym_fir = 0;
-  double w;
-  int matching_stages = 0, has_stage0 = 0;
-  evalresp_complex of, val;
-  double corr_applied, calc_delay, estim_delay, delay;
-  int status = EVALRESP_OK;
+  evalresp_plan_gain *gain = &plan->gains[plan->ngains++];
+  int status;
+
+  gain->sequence_no = sequence_no;
+  gain->blkt = blkt;
+  gain->gain = stage_gain;
+  gain->gain_freq = gain_freq;
+  if (!(status = normalize_stage (log, main_filt, main_type, plan->sensfreq, gain)))
+  {
+    if (gain->filt && main_op)
+    {
+      main_op->gain = gain->filt_gain;
+    }
+    plan->calc_sensit *= gain->gain;
+  }
+  return status;
+}
 
-  /*  if(options->start_stage && options->start_stage > chan->nstages) {
-     error_return(NO_STAGE_MATCHED, "calc_resp: %s options->start_stage=%d, highest stage found=%d)",
-     "No Matching Stages Found (requested",start_stage, chan->nstages);
-     } */
+/*==================================================================
+ *    Single precision evaluation.  Filters whose response is well
+ *    conditioned are evaluated in float, several frequencies at a time,
+ *    while the products of the stages and the final normalizations stay
+ *    in double.
+ *=================================================================*/
 
-  /* for each frequency */
+/* a bound on the relative error of a filter evaluated in single
+   precision, in units of FLT_EPSILON (HUGE_VAL if it has to stay in
+   double) */
+static double
+single_precision_cond (const evalresp_blkt *blkt)
+{
+  const evalresp_complex *roots;
+  double sum = 0.0, abs_sum = 0.0, dc, cond = 0.0, mod;
+  int i, n;
 
-  for (i = 0; i < nfreqs; i++)
+  switch (blkt->type)
   {
-    w = 2 * M_PI * freq[i];
-    val.real = 1.0;
-    val.imag = 0.0;
-
-    /* loop through the stages and filters for each stage, calculating
-         the response for each frequency for all stages */
-
-    stage_ptr = chan->first_stage;
-    units_code = stage_ptr->input_units;
-    for (j = 0; j < chan->nstages; j++)
-    {
-      nc = 0;
-      sym_fir = 0;
-      if (!stage_ptr->sequence_no)
-        has_stage0 = 1;
-      if (options->start_stage >= 0 && options->stop_stage && (stage_ptr->sequence_no < options->start_stage || stage_ptr->sequence_no > options->stop_stage))
+  case ANALOG_PZ:
+  case LAPLACE_PZ:
+    /* each factor (i w - r) loses about |r| / |Re r| digits near w = Im r */
+    n = blkt->blkt_info.pole_zero.nzeros + blkt->blkt_info.pole_zero.npoles;
+    for (i = 0; i < n; i++)
+    {
+      roots = i < blkt->blkt_info.pole_zero.nzeros ? &blkt->blkt_info.pole_zero.zeros[i]
+                                                   : &blkt->blkt_info.pole_zero.poles[i - blkt->blkt_info.pole_zero.nzeros];
+      mod = hypot (roots->real, roots->imag);
+      if (mod == 0.0)
+        cond += 1.0;
+      else if (roots->real == 0.0)
+        return HUGE_VAL;
+      else
+        cond += 2.0 * mod / fabs (roots->real);
+    }
+    return cond;
+  case FIR_SYM_1:
+  case FIR_SYM_2:
+  case FIR_ASYM:
+    n = blkt->blkt_info.fir.ncoeffs;
+    for (i = 0; i < n; i++)
+    {
+      sum += blkt->blkt_info.fir.coeffs[i];
+      abs_sum += fabs (blkt->blkt_info.fir.coeffs[i]);
+    }
+    if (blkt->type == FIR_ASYM)
+    {
+      /* boxcar filters have a closed form */
+      for (i = 1; i < n && blkt->blkt_info.fir.coeffs[i] == blkt->blkt_info.fir.coeffs[0]; i++)
+        ;
+      if (i == n)
+        return HUGE_VAL;
+      dc = sum;
+    }
+    else if (blkt->type == FIR_SYM_1)
+      dc = 2.0 * sum - blkt->blkt_info.fir.coeffs[n - 1];
+    else
+      dc = 2.0 * sum;
+    /* Horner's rule over n coefficients, relative to the pass band gain */
+    return dc != 0.0 ? 2.0 * n * abs_sum / fabs (dc) : HUGE_VAL;
+  case IIR_COEFFS:
+    /* only the (FIR) numerator of filters without poles */
+    if (blkt->blkt_info.coeff.ndenom > 1)
+      return HUGE_VAL;
+    n = blkt->blkt_info.coeff.nnumer;
+    for (i = 0; i < n; i++)
+    {
+      sum += blkt->blkt_info.coeff.numer[i];
+      abs_sum += fabs (blkt->blkt_info.coeff.numer[i]);
+    }
+    return sum != 0.0 ? 2.0 * n * abs_sum / fabs (sum) : HUGE_VAL;
+  default:
+    return HUGE_VAL;
+  }
+}
+
+/* choose the operations that can be evaluated in single precision and
+   give them float copies of their coefficients (or roots) */
+static int
+plan_single_precision (evalresp_logger *log, evalresp_plan *plan)
+{
+  evalresp_plan_op *op;
+  const evalresp_blkt *blkt;
+  const double *values;
+  int i, n;
+
+  for (op = plan->ops; op < plan->ops + plan->nops; op++)
+  {
+    blkt = op->blkt;
+    /* (constants made by simplify_plan() have no blockette) */
+    if (op->type == CONSTANT || single_precision_cond (blkt) * FLT_EPSILON > EVALRESP_SINGLE_TOL)
+    {
+      continue;
+    }
+    switch (blkt->type)
+    {
+    case ANALOG_PZ:
+    case LAPLACE_PZ:
+      /* zeros then poles, as real and imaginary parts */
+      n = 2 * (blkt->blkt_info.pole_zero.nzeros + blkt->blkt_info.pole_zero.npoles);
+      break;
+    case IIR_COEFFS:
+      n = blkt->blkt_info.coeff.nnumer;
+      break;
+    default:
+      n = blkt->blkt_info.fir.ncoeffs;
+      break;
+    }
+    if (!(op->single = malloc ((n ? n : 1) * sizeof (*op->single))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate single precision coefficients");
+      return EVALRESP_MEM;
+    }
+    for (i = 0; i < n; i++)
+    {
+      switch (blkt->type)
+      {
+      case ANALOG_PZ:
+      case LAPLACE_PZ:
+        values = i < 2 * blkt->blkt_info.pole_zero.nzeros
+                     ? &blkt->blkt_info.pole_zero.zeros[i / 2].real
+                     : &blkt->blkt_info.pole_zero.poles[i / 2 - blkt->blkt_info.pole_zero.nzeros].real;
+        op->single[i] = (float)(i % 2 ? values[1] : values[0]);
+        break;
+      case IIR_COEFFS:
+        op->single[i] = (float)blkt->blkt_info.coeff.numer[i];
+        break;
+      default:
+        op->single[i] = (float)blkt->blkt_info.fir.coeffs[i];
+        break;
+      }
+    }
+    plan->nsingle++;
+  }
+  return EVALRESP_OK;
+}
+
+/* horner_phasor() for m (at most EVALRESP_SINGLE_CHUNK) angles at once,
+   in single precision */
+static void
+horner_phasor_single (const float *c, int n, int leading_first,
+                      const double *theta, int m, evalresp_complex *out)
+{
+  float zr[EVALRESP_SINGLE_CHUNK], zi[EVALRESP_SINGLE_CHUNK];
+  float re[EVALRESP_SINGLE_CHUNK], im[EVALRESP_SINGLE_CHUNK];
+  float coeff, t;
+  int i, j;
+
+  for (j = 0; j < m; j++)
+  {
+    zr[j] = (float)cos (theta[j]);
+    zi[j] = (float)-sin (theta[j]);
+    re[j] = im[j] = 0.0f;
+  }
+  for (i = 0; i < n; i++)
+  {
+    coeff = c[leading_first ? i : n - 1 - i];
+    for (j = 0; j < m; j++)
+    {
+      t = re[j] * zr[j] - im[j] * zi[j] + coeff;
+      im[j] = re[j] * zi[j] + im[j] * zr[j];
+      re[j] = t;
+    }
+  }
+  for (j = 0; j < m; j++)
+  {
+    out[j].real = re[j];
+    out[j].imag = im[j];
+  }
+}
+
+/* response of an operation chosen by plan_single_precision() at m
+   frequencies */
+static void
+evaluate_op_single (const evalresp_plan_op *op, double const *freq, int m,
+                    evalresp_complex *out)
+{
+  const evalresp_blkt *blkt = op->blkt;
+  const float *root;
+  double theta[EVALRESP_SINGLE_CHUNK];
+  evalresp_complex num, denom, factor;
+  float omega;
+  int i, j, nz, np;
+
+  switch (op->type)
+  {
+  case ANALOG_PZ:
+  case LAPLACE_PZ:
+    nz = blkt->blkt_info.pole_zero.nzeros;
+    np = blkt->blkt_info.pole_zero.npoles;
+    for (j = 0; j < m; j++)
+    {
+      /* the factors in float, their products in double (to stay in
+         range for filters with many roots) */
+      omega = (float)(op->type == LAPLACE_PZ ? 2 * M_PI * freq[j] : freq[j]);
+      num.real = denom.real = 1.0;
+      num.imag = denom.imag = 0.0;
+      for (i = 0, root = op->single; i < nz + np; i++, root += 2)
+      {
+        factor.real = -root[0];
+        factor.imag = omega - root[1];
+        zmul (i < nz ? &num : &denom, &factor);
+      }
+      iir_ratio (op->gain, &num, &denom, &out[j]);
+    }
+    break;
+  case FIR_SYM_1:
+  case FIR_SYM_2:
+  case FIR_ASYM:
+    for (j = 0; j < m; j++)
+      theta[j] = 2 * M_PI * freq[j] * op->sint;
+    horner_phasor_single (op->single, blkt->blkt_info.fir.ncoeffs, op->type != FIR_ASYM,
+                          theta, m, out);
+    for (j = 0; j < m; j++)
+    {
+      num = out[j];
+      if (op->type == FIR_ASYM)
+        fir_asym_rotate (blkt->blkt_info.fir.ncoeffs, op->gain, op->sint,
+                         2 * M_PI * freq[j], &num, &out[j]);
+      else
+        fir_sym_fold (blkt, op->gain, theta[j], &num, &out[j]);
+    }
+    break;
+  case IIR_COEFFS:
+    for (j = 0; j < m; j++)
+      theta[j] = 2 * M_PI * freq[j] * op->sint;
+    horner_phasor_single (op->single, blkt->blkt_info.coeff.nnumer, 0, theta, m, out);
+    for (j = 0; j < m; j++)
+    {
+      num = out[j];
+      denom.real = blkt->blkt_info.coeff.ndenom ? blkt->blkt_info.coeff.denom[0] : 0.0;
+      denom.imag = 0.0;
+      iir_ratio (op->gain, &num, &denom, &out[j]);
+    }
+    break;
+  }
+}
+
+/* simplification of a compiled plan (see simplify_plan()) */
+
+/* a copy of the pole-zero blockette of op, owned by the plan, with room
+   for nzeros zeros and npoles poles (NULL if memory is short) */
+static evalresp_blkt *
+own_pole_zero (evalresp_plan *plan, evalresp_plan_op *op, int nzeros, int npoles)
+{
+  evalresp_blkt *blkt;
+  evalresp_pole_zero *pz;
+  evalresp_complex *zeros, *poles;
+
+  if (op->blkt >= plan->owned && op->blkt < plan->owned + plan->nowned)
+  {
+    blkt = &plan->owned[op->blkt - plan->owned];
+  }
+  else
+  {
+    blkt = &plan->owned[plan->nowned];
+    *blkt = *op->blkt;
+    blkt->next_blkt = NULL;
+    blkt->blkt_info.pole_zero.zeros = NULL;
+    blkt->blkt_info.pole_zero.poles = NULL;
+    plan->nowned++;
+  }
+  pz = &blkt->blkt_info.pole_zero;
+  if (!(zeros = realloc (pz->zeros, (nzeros ? nzeros : 1) * sizeof (*zeros))))
+    return NULL;
+  pz->zeros = zeros;
+  if (!(poles = realloc (pz->poles, (npoles ? npoles : 1) * sizeof (*poles))))
+    return NULL;
+  pz->poles = poles;
+  if (op->blkt != blkt)
+  {
+    memcpy (pz->zeros, op->blkt->blkt_info.pole_zero.zeros, pz->nzeros * sizeof (*zeros));
+    memcpy (pz->poles, op->blkt->blkt_info.pole_zero.poles, pz->npoles * sizeof (*poles));
+    op->blkt = blkt;
+  }
+  return blkt;
+}
+
+/* can op absorb the roots of other? */
+static int
+mergeable_pole_zero (const evalresp_plan_op *op, const evalresp_plan_op *other)
+{
+  return op->type == other->type && !(op->type == IIR_PZ && op->sint != other->sint);
+}
+
+/* remove the zero-pole pairs of a pole-zero operation that change its
+   response by no more than tol (relative) at any frequency: on the
+   imaginary axis (or the unit circle) the factor (s - z) / (s - p)
+   differs from 1 by |p - z| / |s - p|, and |s - p| is at least the
+   distance from p to the axis (or circle) */
+static int
+cancel_pole_zero (evalresp_plan *plan, evalresp_plan_op *op, double tol, int *npairs)
+{
+  const evalresp_pole_zero *pz = &op->blkt->blkt_info.pole_zero;
+  evalresp_pole_zero *owned;
+  evalresp_blkt *blkt;
+  double dist;
+  int i, j;
+
+  for (i = 0; i < pz->nzeros; i++)
+  {
+    for (j = 0; j < pz->npoles; j++)
+    {
+      if (op->type == IIR_PZ)
+        dist = fabs (1.0 - hypot (pz->poles[j].real, pz->poles[j].imag));
+      else
+        dist = fabs (pz->poles[j].real);
+      if (hypot (pz->zeros[i].real - pz->poles[j].real, pz->zeros[i].imag - pz->poles[j].imag) <= tol * dist
+          || (pz->zeros[i].real == pz->poles[j].real && pz->zeros[i].imag == pz->poles[j].imag))
+      {
+        if (!(blkt = own_pole_zero (plan, op, pz->nzeros, pz->npoles)))
+          return EVALRESP_MEM;
+        owned = &blkt->blkt_info.pole_zero;
+        pz = owned;
+        memmove (&owned->zeros[i], &owned->zeros[i + 1], (owned->nzeros - i - 1) * sizeof (*owned->zeros));
+        memmove (&owned->poles[j], &owned->poles[j + 1], (owned->npoles - j - 1) * sizeof (*owned->poles));
+        owned->nzeros--;
+        owned->npoles--;
+        (*npairs)++;
+        i--;
+        break;
+      }
+    }
+  }
+  return EVALRESP_OK;
+}
+
+/*==================================================================
+ * Simplify the operations of a plan: pole-zero filters of the same kind
+ * (and, for IIR filters, sample interval) are merged into one, zero-pole
+ * pairs that cancel to within tol are removed, pole-zero filters left
+ * without roots become a single constant (polynomial stages keep their
+ * blockette and are never combined), and time shifts of zero are
+ * dropped.  Merged and reduced pole-zero sets are held by the plan.
+ *=================================================================*/
+static int
+simplify_plan (evalresp_logger *log, evalresp_plan *plan, double tol)
+{
+  evalresp_plan_op *op, *target, *constant = NULL, *kept = plan->ops;
+  const evalresp_pole_zero *pz;
+  evalresp_blkt *blkt;
+  evalresp_complex factor;
+  int i, nops = plan->nops, ndelays = 0, nmerged = 0, npairs = 0, nconstants = 0;
+  int status = EVALRESP_OK;
+
+  if (!(plan->owned = calloc (nops ? nops : 1, sizeof (*plan->owned))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate simplified response");
+    return EVALRESP_MEM;
+  }
+
+  /* merge pole-zero filters into the first of their kind */
+  for (op = plan->ops; !status && op < plan->ops + nops; op++)
+  {
+    if (op->type == ANALOG_PZ || op->type == LAPLACE_PZ || op->type == IIR_PZ)
+    {
+      for (target = plan->ops; target < kept && !mergeable_pole_zero (target, op); target++)
+        ;
+      if (target < kept)
+      {
+        pz = &target->blkt->blkt_info.pole_zero;
+        if (!(blkt = own_pole_zero (plan, target, pz->nzeros + op->blkt->blkt_info.pole_zero.nzeros,
+                                    pz->npoles + op->blkt->blkt_info.pole_zero.npoles)))
+        {
+          status = EVALRESP_MEM;
+          break;
+        }
+        pz = &op->blkt->blkt_info.pole_zero;
+        memcpy (blkt->blkt_info.pole_zero.zeros + blkt->blkt_info.pole_zero.nzeros, pz->zeros,
+                pz->nzeros * sizeof (*pz->zeros));
+        memcpy (blkt->blkt_info.pole_zero.poles + blkt->blkt_info.pole_zero.npoles, pz->poles,
+                pz->npoles * sizeof (*pz->poles));
+        blkt->blkt_info.pole_zero.nzeros += pz->nzeros;
+        blkt->blkt_info.pole_zero.npoles += pz->npoles;
+        target->gain *= op->gain;
+        nmerged++;
+        continue;
+      }
+    }
+    *kept++ = *op;
+  }
+  nops = kept - plan->ops;
+
+  /* cancel roots, then gather the constant factors */
+  kept = plan->ops;
+  for (op = plan->ops; !status && op < plan->ops + nops; op++)
+  {
+    if (op->type == ANALOG_PZ || op->type == LAPLACE_PZ || op->type == IIR_PZ)
+    {
+      if ((status = cancel_pole_zero (plan, op, tol, &npairs)))
+        break;
+      pz = &op->blkt->blkt_info.pole_zero;
+      if (!pz->nzeros && !pz->npoles)
+      {
+        op->type = CONSTANT;
+        op->blkt = NULL;
+        op->value.real = op->gain;
+        op->value.imag = 0.0;
+      }
+    }
+    if (op->type == DECIMATION && op->delay == 0.0)
+    {
+      ndelays++;
+      continue;
+    }
+    if (op->type == CONSTANT)
+    {
+      if (constant)
+      {
+        factor = op->value;
+        zmul (&constant->value, &factor);
+        nconstants++;
+        continue;
+      }
+      constant = kept;
+    }
+    *kept++ = *op;
+  }
+  if (status)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate simplified response");
+    return status;
+  }
+  if (constant && constant->value.real == 1.0 && constant->value.imag == 0.0)
+  {
+    for (op = constant; op + 1 < kept; op++)
+      *op = op[1];
+    kept--;
+    nconstants++;
+  }
+
+  if (kept - plan->ops < plan->nops)
+  {
+    evalresp_log (log, EV_INFO, EV_INFO,
+                  "Simplified response from %d to %d operations (%d pole-zero filters merged, "
+                  "%d zero-pole pairs cancelled, %d constant factors combined, %d zero delays dropped)",
+                  plan->nops, (int)(kept - plan->ops), nmerged, npairs, nconstants, ndelays);
+  }
+  else if (npairs)
+  {
+    evalresp_log (log, EV_INFO, EV_INFO, "Simplified response (%d zero-pole pairs cancelled)", npairs);
+  }
+  for (i = kept - plan->ops; i < plan->nops; i++)
+  {
+    memset (&plan->ops[i], 0, sizeof (plan->ops[i]));
+  }
+  plan->nops = kept - plan->ops;
+  return EVALRESP_OK;
+}
+
+/*=================================================================
+ *    Compile a channel into a flat sequence of operations.  This
+ *    resolves, once for all frequencies, the stage selection, the
+ *    pairing of FIR filters with their decimation blockette (sample
+ *    interval and delay correction) and the filter normalizations.
+ *
+ *    When normalizing, the filter gains and normalizations are
+ *    evaluated at the single frequency sensfreq and the stage gains
+ *    are used to calculate a total channel sensitivity:
+ *
+ *    sensit      = stage zero sensitivity read from input file
+ *                  (i.e. the total sensitivity for a given channel).
+ *    sensfreq    = frequency at which sensit is reported.
+ *    calc_sensit = product of the individual stage gains, computed at
+ *                  the frequency sensfreq.
+ *
+ *    The normalized values are kept in the plan; the channel is not
+ *    modified.
+ *=================================================================*/
+int
+compile_plan (evalresp_logger *log, evalresp_options const *const options,
+              evalresp_channel const *chan, int normalize, evalresp_plan **plan)
+{
+  evalresp_blkt *blkt_ptr;
+  const evalresp_blkt *main_filt;
+  evalresp_stage *stage_ptr;
+  evalresp_plan_op *op, *main_op;
+  int j, nblkts = 0, ngains = 1, nc = 0, sym_fir = 0, main_type;
+  int matching_stages = 0, has_stage0 = 0, skipped_stages = 0, sensit_gain = 0;
+  int status = EVALRESP_OK;
+  double calc_delay, percent_diff;
+
+  /* there is at most one operation per blockette (and one gain per
+     gain blockette, plus one for the reported sensitivity) */
+  for (stage_ptr = chan->first_stage; stage_ptr; stage_ptr = stage_ptr->next_stage)
+  {
+    for (blkt_ptr = stage_ptr->first_blkt; blkt_ptr; blkt_ptr = blkt_ptr->next_blkt)
+    {
+      nblkts++;
+      if (blkt_ptr->type == GAIN)
+        ngains++;
+    }
+  }
+
+  if (!(*plan = calloc (1, sizeof (**plan))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate response plan");
+    return EVALRESP_MEM;
+  }
+  if (!((*plan)->ops = calloc (nblkts ? nblkts : 1, sizeof (*(*plan)->ops))) || !((*plan)->gains = calloc (ngains, sizeof (*(*plan)->gains))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate response plan operations");
+    free_plan (plan);
+    return EVALRESP_MEM;
+  }
+
+  (*plan)->units_code = chan->first_stage->input_units;
+  (*plan)->unit = options->unit;
+  (*plan)->nthreads = parallel_threads (options->freq_threads);
+  (*plan)->parallel_nfreq = options->parallel_nfreq;
+  (*plan)->stage_cache = options->stage_cache;
+  (*plan)->sensit = chan->sensit;
+  (*plan)->sensfreq = chan->sensfreq;
+  (*plan)->calc_sensit = chan->calc_sensit;
+  (*plan)->unit_scale_fact = chan->unit_scale_fact;
+
+  if (normalize)
+  {
+    status = check_gains (log, chan, &sensit_gain, &(*plan)->sensfreq);
+    (*plan)->calc_sensit = 1.0;
+  }
+
+  stage_ptr = chan->first_stage;
+  for (j = 0; !status && j < chan->nstages; j++, stage_ptr = stage_ptr->next_stage)
+  {
+    nc = 0;
+    sym_fir = 0;
+    main_filt = NULL;
+    main_type = 0;
+    main_op = NULL;
+    if (!stage_ptr->sequence_no)
+      has_stage0 = 1;
+    if (!stage_selected (options, stage_ptr->sequence_no))
+    {
+      if (stage_ptr->sequence_no)
+        skipped_stages = 1;
+      continue;
+    }
+    matching_stages++;
+    for (blkt_ptr = stage_ptr->first_blkt; !status && blkt_ptr; blkt_ptr = blkt_ptr->next_blkt)
+    {
+      op = &(*plan)->ops[(*plan)->nops];
+      op->type = blkt_ptr->type;
+      op->blkt = blkt_ptr;
+      op->stage = j;
+      switch (blkt_ptr->type)
+      {
+      case ANALOG_PZ:
+      case LAPLACE_PZ:
+      case IIR_PZ:
+      case FIR_SYM_1:
+      case FIR_SYM_2:
+      case FIR_ASYM:
+      case POLYNOMIAL: /*IGD 06/01/0213 */
+      case IIR_COEFFS: /* IGD New type from v 3.2.17 */
+        main_filt = blkt_ptr;
+        main_type = blkt_ptr->type;
+        main_op = NULL;
+        break;
+      default:
+        break;
+      }
+      switch (blkt_ptr->type)
+      {
+      case ANALOG_PZ:
+      case LAPLACE_PZ:
+        op->gain = blkt_ptr->blkt_info.pole_zero.a0;
+        main_op = op;
+        (*plan)->nops++;
+        break;
+      case IIR_PZ:
+        if (blkt_ptr->blkt_info.pole_zero.nzeros || blkt_ptr->blkt_info.pole_zero.npoles)
+        {
+          op->gain = blkt_ptr->blkt_info.pole_zero.a0;
+          op->sint = filter_sint (blkt_ptr);
+          main_op = op;
+          (*plan)->nops++;
+        }
+        break;
+      case FIR_SYM_1:
+      case FIR_SYM_2:
+        if (blkt_ptr->type == FIR_SYM_1)
+          nc = blkt_ptr->blkt_info.fir.ncoeffs * 2 - 1;
+        else
+          nc = blkt_ptr->blkt_info.fir.ncoeffs * 2;
+        if (blkt_ptr->blkt_info.fir.ncoeffs)
+        {
+          op->gain = blkt_ptr->blkt_info.fir.h0;
+          op->sint = filter_sint (blkt_ptr);
+          sym_fir = 1;
+          main_op = op;
+          (*plan)->nops++;
+        }
+        break;
+      case FIR_ASYM:
+        nc = blkt_ptr->blkt_info.fir.ncoeffs;
+        if (blkt_ptr->blkt_info.fir.ncoeffs)
+        {
+          op->gain = blkt_ptr->blkt_info.fir.h0;
+          op->sint = filter_sint (blkt_ptr);
+          sym_fir = -1;
+          main_op = op;
+          (*plan)->nops++;
+        }
+        break;
+      case DECIMATION: /* IGD 10/05/13 Logic updated to include calc_delay on demand */
+        /* Asymmetric FIR coefficients require a delay correction (the
+           delay of symmetric filters has already been handled in
+           fir_sym_trans()) */
+        if (nc != 0 && sym_fir == -1)
+        {
+          /* IGD 08/27/08 Use estimated delay instead of calculated */
+          if (options->use_estimated_delay)
+          {
+            op->delay = blkt_ptr->blkt_info.decimation.estim_delay;
+          }
+          else
+          {
+            calc_delay = ((nc - 1) / 2.0) * blkt_ptr->blkt_info.decimation.sample_int;
+            op->delay = blkt_ptr->blkt_info.decimation.applied_corr - calc_delay;
+          }
+          (*plan)->nops++;
+        }
+        break;
+      case LIST: /* This option is added in version 2.3.17 I.Dricker*/
+        (*plan)->nops++;
+        break;
+      case POLYNOMIAL: /* IGD 06/01/2013*/
+        /* the B62 response does not depend on frequency */
+        if (!(status = calc_polynomial (blkt_ptr, &op->value, options->b62_x, log)))
+        {
+          (*plan)->nops++;
+        }
+        break;
+      case IIR_COEFFS: /* This option is added in version 2.3.17 I.Dricker*/
+        op->gain = blkt_ptr->blkt_info.coeff.h0;
+        op->sint = filter_sint (blkt_ptr);
+        main_op = op;
+        (*plan)->nops++;
+        break;
+      case GAIN:
+        if (normalize && stage_ptr->sequence_no)
+        {
+          status = add_stage_gain (log, *plan, stage_ptr->sequence_no,
+                                   blkt_ptr, blkt_ptr->blkt_info.gain.gain,
+                                   blkt_ptr->blkt_info.gain.gain_freq,
+                                   main_filt, main_type, main_op);
+        }
+        break;
+      default:
+        break;
+      }
+    }
+
+    /* a two stage channel without stage gain uses the reported
+       sensitivity as the gain of its first stage */
+    if (!status && sensit_gain && stage_ptr == chan->first_stage && stage_ptr->sequence_no)
+    {
+      status = add_stage_gain (log, *plan, stage_ptr->sequence_no,
+                               NULL, chan->sensit, chan->sensfreq,
+                               main_filt, main_type, main_op);
+    }
+  }
+
+  /* if no matching stages were found, then report the error */
+
+  if (!status && !matching_stages && !has_stage0)
+  {
+    evalresp_log (log, EV_ERROR, 0,
+                  "calc_resp: %s start_stage=%d, highest stage found=%d)",
+                  "No Matching Stages Found (requested", options->start_stage,
+                  chan->nstages);
+    status = EVALRESP_PAR;
+  }
+  else if (!status && !matching_stages)
+  {
+    evalresp_log (log, EV_ERROR, 0,
+                  "calc_resp: %s start_stage=%d, highest stage found=%d)",
+                  "No Matching Stages Found (requested", options->start_stage,
+                  chan->nstages - 1);
+    status = EVALRESP_PAR;
+  }
+
+  if (!status && normalize)
+  {
+    if (chan->nstages == 1 && (*plan)->ngains)
+    {
+      (*plan)->sensit = (*plan)->calc_sensit;
+    }
+
+    /* -------- TEST 3 -------- */
+    /* Finally, print a warning, if necessary */
+
+    if (!skipped_stages && (*plan)->sensit != 0.0)
+    {
+      percent_diff = fabs (((*plan)->sensit - (*plan)->calc_sensit) / (*plan)->sensit);
+      if (percent_diff >= 0.05)
+      {
+        evalresp_log (log, EV_WARN, 0,
+                      " (norm_resp): computed and reported sensitivities");
+        evalresp_log (log, EV_WARN, 0, " differ by more than 5 percent. \n");
+        evalresp_log (log, EV_WARN, 0, "\t Execution continuing.\n");
+      }
+    }
+  }
+
+  if (!status && options->simplify)
+  {
+    status = simplify_plan (log, *plan, options->simplify_tol);
+  }
+
+  if (!status && options->single_precision)
+  {
+    status = plan_single_precision (log, *plan);
+  }
+
+  if (status)
+  {
+    free_plan (plan);
+  }
+  else
+  {
+    (*plan)->resp_sensit = options->use_total_sensitivity ? (*plan)->sensit : (*plan)->calc_sensit;
+  }
+  return status;
+}
+
+/* the frequencies a plan is evaluated at, with the tables of the grid they
+   come from (omega and phasors are NULL for plain frequencies) */
+typedef struct
+{
+  double const *freq;
+  double const *omega;                    /* 2 pi freq */
+  evalresp_complex const *const *phasors; /* per operation, e^{-i omega dt} */
+  evalresp_freq_grid const *grid;
+} plan_freqs;
+
+/* response of a single operation at frequency freq[i]; phasor is
+   e^{-i omega dt} at that frequency for the sample interval (or delay) of
+   the operation, if known */
+static void
+evaluate_op (const evalresp_plan_op *op, const plan_freqs *freqs, int i,
+             const evalresp_complex *phasor, evalresp_complex *of)
+{
+  double const *freq = freqs->freq;
+  double w = freqs->omega ? freqs->omega[i] : 2 * M_PI * freq[i];
+
+  switch (op->type)
+  {
+  case ANALOG_PZ:
+  case LAPLACE_PZ:
+    analog_trans (op->blkt, op->gain, freq[i], of);
+    break;
+  case IIR_PZ:
+    iir_pz_trans (op->blkt, op->gain, op->sint, w, phasor, of);
+    break;
+  case FIR_SYM_1:
+  case FIR_SYM_2:
+    fir_sym_trans (op->blkt, op->gain, op->sint, w, phasor, of);
+    break;
+  case FIR_ASYM:
+    fir_asym_trans (op->blkt, op->gain, op->sint, w, phasor, of);
+    break;
+  case DECIMATION:
+    calc_time_shift (op->delay, w, phasor, of);
+    break;
+  case LIST: /* the frequencies are those of the list */
+    calc_list (op->blkt, i, of); /*compute real and imag parts for the i-th ampl and phase */
+    break;
+  case POLYNOMIAL:
+  case CONSTANT:
+    *of = op->value;
+    break;
+  case IIR_COEFFS:
+    iir_trans (op->blkt, op->gain, op->sint, w, phasor, of);
+    break;
+  }
+}
+
+/* where evaluated values are written: either values, or real and imag */
+typedef struct
+{
+  evalresp_complex *values;
+  double *real;
+  double *imag;
+} plan_output;
+
+static void
+plan_output_set (const plan_output *output, int i, const evalresp_complex *val)
+{
+  if (output->values)
+  {
+    output->values[i] = *val;
+  }
+  else
+  {
+    output->real[i] = val->real;
+    output->imag[i] = val->imag;
+  }
+}
+
+static void
+plan_output_get (const plan_output *output, int i, evalresp_complex *val)
+{
+  if (output->values)
+  {
+    *val = output->values[i];
+  }
+  else
+  {
+    val->real = output->real[i];
+    val->imag = output->imag[i];
+  }
+}
+
+/*  Write output for freq[i] in output[i] (note: unit_scale_fact is set by the
+ * 'parse_units' function that is used to convert to 'MKS' units when the
+ * the response was given as a displacement, velocity, or acceleration in units other
+ * than meters) */
+static void
+evaluate_output (evalresp_plan const *plan, const plan_freqs *freqs, int i,
+                 const evalresp_complex *val, const plan_output *output)
+{
+  double w = freqs->omega ? freqs->omega[i] : 2 * M_PI * freqs->freq[i];
+  evalresp_complex out;
+
+  out.real = val->real * plan->resp_sensit * plan->unit_scale_fact;
+  out.imag = val->imag * plan->resp_sensit * plan->unit_scale_fact;
+  (void)convert_to_units (plan->units_code, plan->unit, &out, w, NULL);
+  plan_output_set (output, i, &out);
+}
+
+/* the phasor of operation k at frequency i, if tabulated */
+#define PLAN_PHASOR(freqs, k, i) \
+  ((freqs)->phasors && (freqs)->phasors[k] ? &(freqs)->phasors[k][i] : NULL)
+
+/* evaluate the plan at freq[begin..end-1].  the checks in evaluate_plan()
+   guarantee that nothing here can fail, so blocks can be evaluated on any
+   thread without logging */
+static void
+evaluate_plan_block (evalresp_plan const *plan, const plan_freqs *freqs,
+                     int begin, int end, const plan_output *output)
+{
+  const evalresp_plan_op *op;
+  double const *freq = freqs->freq;
+  evalresp_complex of, val, ofs[EVALRESP_SINGLE_CHUNK], vals[EVALRESP_SINGLE_CHUNK];
+  int i, j, k, m;
+
+  if (!plan->nsingle)
+  {
+    for (i = begin; i < end; i++)
+    {
+      val.real = 1.0;
+      val.imag = 0.0;
+      for (k = 0, op = plan->ops; k < plan->nops; k++, op++)
+      {
+        evaluate_op (op, freqs, i, PLAN_PHASOR (freqs, k, i), &of);
+        zmul (&val, &of);
+      }
+      evaluate_output (plan, freqs, i, &val, output);
+    }
+    return;
+  }
+
+  /* with single precision operations, evaluate a chunk of frequencies
+     one operation at a time */
+  for (i = begin; i < end; i += m)
+  {
+    m = end - i < EVALRESP_SINGLE_CHUNK ? end - i : EVALRESP_SINGLE_CHUNK;
+    for (j = 0; j < m; j++)
+    {
+      vals[j].real = 1.0;
+      vals[j].imag = 0.0;
+    }
+    for (k = 0, op = plan->ops; k < plan->nops; k++, op++)
+    {
+      if (op->single)
+      {
+        evaluate_op_single (op, freq + i, m, ofs);
+      }
+      else
+      {
+        for (j = 0; j < m; j++)
+          evaluate_op (op, freqs, i + j, PLAN_PHASOR (freqs, k, i + j), &ofs[j]);
+      }
+      for (j = 0; j < m; j++)
+        zmul (&vals[j], &ofs[j]);
+    }
+    for (j = 0; j < m; j++)
+      evaluate_output (plan, freqs, i + j, &vals[j], output);
+  }
+}
+
+typedef struct
+{
+  evalresp_plan const *plan;
+  const plan_freqs *freqs;
+  const plan_output *output;
+} plan_block_data;
+
+static int
+plan_block_task (void *arg, int thread, int begin, int end)
+{
+  plan_block_data *data = arg;
+  evaluate_plan_block (data->plan, data->freqs, begin, end, data->output);
+  return EVALRESP_OK;
+}
+
+/* evaluate the plan at all frequencies, on several threads if the grid
+   is large enough */
+static int
+evaluate_plan_blocks (evalresp_logger *log, evalresp_plan const *plan,
+                      const plan_freqs *freqs, int nfreqs, const plan_output *output)
+{
+  plan_block_data data;
+
+  if (plan->nthreads > 1 && plan->parallel_nfreq > 0 && nfreqs >= plan->parallel_nfreq)
+  {
+    data.plan = plan;
+    data.freqs = freqs;
+    data.output = output;
+    return run_parallel (log, plan->nthreads, nfreqs, EVALRESP_PARALLEL_BLOCK,
+                         plan_block_task, &data);
+  }
+  evaluate_plan_block (plan, freqs, 0, nfreqs, output);
+  return EVALRESP_OK;
+}
+
+typedef struct
+{
+  unsigned char *data;
+  size_t len;
+  size_t size;
+  int failed;
+} stage_key;
+
+static void
+stage_key_add (stage_key *key, const void *data, size_t len)
+{
+  unsigned char *grown;
+  size_t size;
+
+  if (key->failed)
+    return;
+  if (key->len + len > key->size)
+  {
+    for (size = key->size ? key->size : 256; size < key->len + len; size *= 2)
+      ;
+    if (!(grown = realloc (key->data, size)))
+    {
+      key->failed = 1;
+      return;
+    }
+    key->data = grown;
+    key->size = size;
+  }
+  memcpy (key->data + key->len, data, len);
+  key->len += len;
+}
+
+/* the canonical description of the operations [first, last): everything
+   their response depends on */
+static void
+stage_key_ops (stage_key *key, const evalresp_plan_op *first, const evalresp_plan_op *last)
+{
+  const evalresp_plan_op *op;
+  const evalresp_blkt *blkt;
+  int single;
+
+  for (op = first; op < last; op++)
+  {
+    blkt = op->blkt;
+    single = op->single != NULL;
+    stage_key_add (key, &op->type, sizeof (op->type));
+    stage_key_add (key, &single, sizeof (single));
+    stage_key_add (key, &op->gain, sizeof (op->gain));
+    stage_key_add (key, &op->sint, sizeof (op->sint));
+    stage_key_add (key, &op->delay, sizeof (op->delay));
+    stage_key_add (key, &op->value, sizeof (op->value));
+    switch (op->type)
+    {
+    case ANALOG_PZ:
+    case LAPLACE_PZ:
+    case IIR_PZ:
+      stage_key_add (key, &blkt->blkt_info.pole_zero.nzeros, sizeof (int));
+      stage_key_add (key, &blkt->blkt_info.pole_zero.npoles, sizeof (int));
+      stage_key_add (key, blkt->blkt_info.pole_zero.zeros,
+                     blkt->blkt_info.pole_zero.nzeros * sizeof (evalresp_complex));
+      stage_key_add (key, blkt->blkt_info.pole_zero.poles,
+                     blkt->blkt_info.pole_zero.npoles * sizeof (evalresp_complex));
+      break;
+    case FIR_SYM_1:
+    case FIR_SYM_2:
+    case FIR_ASYM:
+      stage_key_add (key, &blkt->blkt_info.fir.ncoeffs, sizeof (int));
+      stage_key_add (key, blkt->blkt_info.fir.coeffs,
+                     blkt->blkt_info.fir.ncoeffs * sizeof (double));
+      break;
+    case IIR_COEFFS:
+      stage_key_add (key, &blkt->blkt_info.coeff.nnumer, sizeof (int));
+      stage_key_add (key, &blkt->blkt_info.coeff.ndenom, sizeof (int));
+      stage_key_add (key, blkt->blkt_info.coeff.numer,
+                     blkt->blkt_info.coeff.nnumer * sizeof (double));
+      stage_key_add (key, blkt->blkt_info.coeff.denom,
+                     blkt->blkt_info.coeff.ndenom * sizeof (double));
+      break;
+    case LIST:
+      stage_key_add (key, &blkt->blkt_info.list.nresp, sizeof (int));
+      stage_key_add (key, blkt->blkt_info.list.amp,
+                     blkt->blkt_info.list.nresp * sizeof (double));
+      stage_key_add (key, blkt->blkt_info.list.phase,
+                     blkt->blkt_info.list.nresp * sizeof (double));
+      break;
+    default:
+      break;
+    }
+  }
+}
+
+/* evaluate the plan stage by stage, looking each stage up in the cache;
+   the frequencies are identified by their number and hash */
+static int
+evaluate_plan_cached (evalresp_logger *log, evalresp_plan const *plan,
+                      const plan_freqs *freqs, int nfreqs, const plan_output *output)
+{
+  const evalresp_plan_op *first, *last, *op, *end = plan->ops + plan->nops;
+  const evalresp_complex *values;
+  evalresp_complex *computed, val, acc;
+  evalresp_plan stage_plan;
+  plan_freqs stage_freqs;
+  plan_output stage_output = {NULL, NULL, NULL};
+  stage_cache_entry *entry;
+  stage_key key = {NULL, 0, 0, 0};
+  uint64_t grid_hash, hash;
+  int i, status = EVALRESP_OK;
+
+  if (freqs->grid)
+    grid_hash = freq_grid_hash (freqs->grid);
+  else
+    grid_hash = stage_cache_hash (freqs->freq, nfreqs * sizeof (*freqs->freq), EVALRESP_HASH_INIT);
+  acc.real = 1.0;
+  acc.imag = 0.0;
+  for (i = 0; i < nfreqs; i++)
+  {
+    plan_output_set (output, i, &acc);
+  }
+
+  for (first = plan->ops; !status && first < end; first = last)
+  {
+    for (last = first + 1; last < end && last->stage == first->stage; last++)
+      ;
+    key.len = 0;
+    stage_key_add (&key, &grid_hash, sizeof (grid_hash));
+    stage_key_ops (&key, first, last);
+    if (key.failed)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate stage cache key");
+      status = EVALRESP_MEM;
+      break;
+    }
+    hash = stage_cache_hash (key.data, key.len, EVALRESP_HASH_INIT);
+
+    computed = NULL;
+    if (!(values = stage_cache_acquire (plan->stage_cache, key.data, key.len, hash, nfreqs, &entry)))
+    {
+      if (!(computed = malloc ((nfreqs ? nfreqs : 1) * sizeof (*computed))))
       {
-        stage_ptr = stage_ptr->next_stage;
-        continue;
+        evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate stage response");
+        status = EVALRESP_MEM;
+        break;
+      }
+      /* the stage on its own, without sensitivity or unit conversion */
+      stage_plan = *plan;
+      stage_plan.ops = (evalresp_plan_op *)first;
+      stage_plan.nops = last - first;
+      stage_plan.nsingle = 0;
+      for (op = first; op < last; op++)
+        stage_plan.nsingle += op->single != NULL;
+      stage_plan.resp_sensit = 1.0;
+      stage_plan.unit_scale_fact = 1.0;
+      stage_plan.unit = evalresp_file_unit;
+      stage_plan.stage_cache = NULL;
+      stage_freqs = *freqs;
+      if (freqs->phasors)
+        stage_freqs.phasors = freqs->phasors + (first - plan->ops);
+      stage_output.values = computed;
+      if (!(status = evaluate_plan_blocks (log, &stage_plan, &stage_freqs, nfreqs, &stage_output)))
+      {
+        if ((values = stage_cache_insert (plan->stage_cache, key.data, key.len, hash,
+                                          nfreqs, computed, &entry)))
+        {
+          computed = NULL;
+        }
+        else
+        {
+          values = computed;
+        }
       }
-      else if (options->start_stage >= 0 && !options->stop_stage && stage_ptr->sequence_no != options->start_stage)
+    }
+    if (!status)
+    {
+      for (i = 0; i < nfreqs; i++)
       {
-        stage_ptr = stage_ptr->next_stage;
+        val = values[i];
+        plan_output_get (output, i, &acc);
+        zmul (&acc, &val);
+        plan_output_set (output, i, &acc);
+      }
+    }
+    stage_cache_release (plan->stage_cache, entry);
+    free (computed);
+  }
+  free (key.data);
+
+  for (i = 0; !status && i < nfreqs; i++)
+  {
+    plan_output_get (output, i, &val);
+    evaluate_output (plan, freqs, i, &val, output);
+  }
+  return status;
+}
+
+/* the checks that make evaluate_plan_block() safe */
+static int
+check_plan (evalresp_logger *log, evalresp_plan const *plan, int nfreqs)
+{
+  const evalresp_plan_op *op;
+
+  switch (plan->unit)
+  {
+  case evalresp_file_unit:
+  case evalresp_displacement_unit:
+  case evalresp_velocity_unit:
+  case evalresp_acceleration_unit:
+    break;
+  default:
+    evalresp_log (log, EV_ERROR, 0, "convert_to_units: bad output units");
+    return EVALRESP_ERR; /* BAD_OUT_UNITS */
+  }
+  for (op = plan->ops; op < plan->ops + plan->nops; op++)
+  {
+    if (op->type == LIST && nfreqs > op->blkt->blkt_info.list.nresp)
+    {
+      evalresp_log (log, EV_ERROR, 0,
+                    "calc_resp: more frequencies than in the response list (%d)",
+                    op->blkt->blkt_info.list.nresp);
+      return EVALRESP_PAR;
+    }
+  }
+  return EVALRESP_OK;
+}
+
+static int
+evaluate_plan_freqs (evalresp_logger *log, evalresp_plan const *plan,
+                     const plan_freqs *freqs, int nfreqs, const plan_output *output)
+{
+  int status;
+
+  if (!(status = check_plan (log, plan, nfreqs)))
+  {
+    if (plan->stage_cache)
+    {
+      status = evaluate_plan_cached (log, plan, freqs, nfreqs, output);
+    }
+    else
+    {
+      status = evaluate_plan_blocks (log, plan, freqs, nfreqs, output);
+    }
+  }
+  return status;
+}
+
+int
+evaluate_plan (evalresp_logger *log, evalresp_plan const *plan,
+               double const *freq, int nfreqs, evalresp_complex *output)
+{
+  plan_freqs freqs = {freq, NULL, NULL, NULL};
+  plan_output out = {output, NULL, NULL};
+
+  return evaluate_plan_freqs (log, plan, &freqs, nfreqs, &out);
+}
+
+int
+evaluate_plan_split (evalresp_logger *log, evalresp_plan const *plan,
+                     double const *freq, int nfreqs, double *real, double *imag)
+{
+  plan_freqs freqs = {freq, NULL, NULL, NULL};
+  plan_output out = {NULL, real, imag};
+
+  return evaluate_plan_freqs (log, plan, &freqs, nfreqs, &out);
+}
+
+int
+evaluate_plan_grid (evalresp_logger *log, evalresp_plan const *plan,
+                    evalresp_freq_grid *grid, evalresp_complex *output)
+{
+  evalresp_complex const **phasors;
+  plan_freqs freqs;
+  plan_output out = {output, NULL, NULL};
+  const evalresp_plan_op *op;
+  int k, status;
+
+  freqs.freq = evalresp_freq_grid_freqs (grid);
+  freqs.omega = freq_grid_omega (grid);
+  freqs.grid = grid;
+  /* look up the tables for each operation once; without them (if memory
+     is short) the values are calculated as for plain frequencies */
+  if ((phasors = calloc (plan->nops ? plan->nops : 1, sizeof (*phasors))))
+  {
+    for (k = 0, op = plan->ops; k < plan->nops; k++, op++)
+    {
+      if (op->single)
         continue;
+      switch (op->type)
+      {
+      case IIR_PZ:
+      case FIR_SYM_1:
+      case FIR_SYM_2:
+      case FIR_ASYM:
+      case IIR_COEFFS:
+        phasors[k] = freq_grid_phasors (grid, op->sint);
+        break;
+      case DECIMATION:
+        phasors[k] = freq_grid_phasors (grid, op->delay);
+        break;
+      }
+    }
+  }
+  freqs.phasors = phasors;
+  status = evaluate_plan_freqs (log, plan, &freqs, evalresp_freq_grid_nfreqs (grid), &out);
+  free (phasors);
+  return status;
+}
+
+/* the larger of the relative amplitude error and the phase error (in
+   radians) made interpolating the response m at the middle of an interval
+   from the responses l and r at its ends: the amplitude logarithmically
+   and the phase linearly.  a phase that turns by more than a quarter
+   circle over the interval is always refined, as its interpolation would
+   be ambiguous. */
+static double
+interpolation_error (evalresp_complex l, evalresp_complex m, evalresp_complex r)
+{
+  double al = hypot (l.real, l.imag), am = hypot (m.real, m.imag), ar = hypot (r.real, r.imag);
+  double amp, phase, turn, mean;
+
+  if (al > 0 && am > 0 && ar > 0)
+  {
+    amp = fabs (am / sqrt (al * ar) - 1);
+    turn = atan2 (r.imag * l.real - r.real * l.imag, r.real * l.real + r.imag * l.imag);
+    if (fabs (turn) > M_PI / 2)
+    {
+      return HUGE_VAL;
+    }
+    phase = atan2 (m.imag * l.real - m.real * l.imag, m.real * l.real + m.imag * l.imag) - turn / 2;
+    phase = fabs (atan2 (sin (phase), cos (phase)));
+    return amp > phase ? amp : phase;
+  }
+  /* no phase, or logarithm, at a zero */
+  mean = (al + ar) / 2;
+  return (am > mean ? am : mean) > 0 ? fabs (am - mean) / (am > mean ? am : mean) : 0;
+}
+
+static int
+alloc_adaptive (evalresp_logger *log, int n, double **freqs, evalresp_complex **values,
+                char **refine)
+{
+  int status;
+
+  if (!(status = calloc_doubles (log, "adaptive frequencies", n ? n : 1, freqs)))
+  {
+    if (!(*values = calloc (n ? n : 1, sizeof (**values)))
+        || (refine && !(*refine = calloc (n ? n : 1, sizeof (**refine)))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate adaptive response");
+      status = EVALRESP_MEM;
+    }
+  }
+  return status;
+}
+
+int
+evaluate_plan_adaptive (evalresp_logger *log, evalresp_plan const *plan,
+                        double const *freq, int nfreqs, int lin, double tol, int max_nfreqs,
+                        int *nout, double **freq_out, evalresp_complex **output)
+{
+  double *freqs = NULL, *mids = NULL, *next_freqs = NULL;
+  evalresp_complex *values = NULL, *mid_values = NULL, *next_values = NULL;
+  char *refine = NULL, *next_refine = NULL;
+  int status, n = nfreqs, m, i, j, k, depth;
+
+  *nout = 0;
+  *freq_out = NULL;
+  *output = NULL;
+  if (!(status = alloc_adaptive (log, n, &freqs, &values, &refine)))
+  {
+    memcpy (freqs, freq, n * sizeof (*freqs));
+    status = evaluate_plan (log, plan, freqs, n, values);
+    /* refine[i] marks the interval from freqs[i] to freqs[i + 1] */
+    for (i = 0; i < n - 1; i++)
+    {
+      refine[i] = 1;
+    }
+  }
+
+  /* each pass tests the middle of every interval still marked, keeping
+     (and marking both halves) only where interpolation is not good
+     enough */
+  for (depth = 0; !status && depth < ADAPTIVE_MAX_DEPTH; depth++)
+  {
+    for (m = 0, i = 0; i < n - 1; i++)
+    {
+      m += refine[i];
+    }
+    if (!m)
+    {
+      break;
+    }
+    if (n + m > max_nfreqs)
+    {
+      evalresp_log (log, EV_WARN, EV_WARN,
+                    "Adaptive sampling stopped at %d frequencies before reaching the tolerance", n);
+      break;
+    }
+    if (!(status = alloc_adaptive (log, m, &mids, &mid_values, NULL))
+        && !(status = alloc_adaptive (log, n + m, &next_freqs, &next_values, &next_refine)))
+    {
+      for (i = 0, k = 0; i < n - 1; i++)
+      {
+        if (refine[i])
+        {
+          mids[k++] = lin || freqs[i] <= 0 ? (freqs[i] + freqs[i + 1]) / 2
+                                           : sqrt (freqs[i] * freqs[i + 1]);
+        }
       }
-      matching_stages++;
-      blkt_ptr = stage_ptr->first_blkt;
-      while (blkt_ptr)
+      if (!(status = evaluate_plan (log, plan, mids, m, mid_values)))
       {
-        eval_flag = 0;
-        switch (blkt_ptr->type)
+        for (i = 0, j = 0, k = 0; i < n; i++)
         {
-        case ANALOG_PZ:
-        case LAPLACE_PZ:
-          analog_trans (blkt_ptr, freq[i], &of);
-          eval_flag = 1;
-          break;
-        case IIR_PZ:
-          if (blkt_ptr->blkt_info.pole_zero.nzeros || blkt_ptr->blkt_info.pole_zero.npoles)
-          {
-            iir_pz_trans (blkt_ptr, w, &of);
-            eval_flag = 1;
-          }
-          break;
-        case FIR_SYM_1:
-        case FIR_SYM_2:
-          if (blkt_ptr->type == FIR_SYM_1)
-            nc = (double)blkt_ptr->blkt_info.fir.ncoeffs * 2 - 1;
-          else if (blkt_ptr->type == FIR_SYM_2)
-            nc = (double)blkt_ptr->blkt_info.fir.ncoeffs * 2;
-          if (blkt_ptr->blkt_info.fir.ncoeffs)
-          {
-            fir_sym_trans (blkt_ptr, w, &of);
-            sym_fir = 1;
-            eval_flag = 1;
-          }
-          break;
-        case FIR_ASYM:
-          nc = (double)blkt_ptr->blkt_info.fir.ncoeffs;
-          if (blkt_ptr->blkt_info.fir.ncoeffs)
-          {
-            fir_asym_trans (blkt_ptr, w, &of);
-            sym_fir = -1;
-            eval_flag = 1;
-          }
-          break;
-        case DECIMATION: /* IGD 10/05/13 Logic updated to include calc_delay on demand */
-          if (blkt_ptr->type != IIR_PZ && nc != 0)
+          next_freqs[j] = freqs[i];
+          next_values[j++] = values[i];
+          if (i < n - 1 && refine[i])
           {
-            /* IGD 08/27/08 Use estimated delay instead of calculated */
-            estim_delay =
-                (double)blkt_ptr->blkt_info.decimation.estim_delay;
-            corr_applied =
-                blkt_ptr->blkt_info.decimation.applied_corr;
-            calc_delay = ((nc - 1) / 2.0) * blkt_ptr->blkt_info.decimation.sample_int;
-            /* Asymmetric FIR coefficients require a delay correction */
-            if (sym_fir == -1)
-            {
-              if (options->use_estimated_delay)
-              {
-                delay = estim_delay;
-              }
-              else
-              {
-                delay = corr_applied - calc_delay;
-              }
-            }
-            /* Otherwise delay has already been handled in fir_sym_trans() */
-            else
+            /* stop at the resolution of the frequencies */
+            if (mids[k] > freqs[i] && mids[k] < freqs[i + 1]
+                && interpolation_error (values[i], mid_values[k], values[i + 1]) > tol)
             {
-              delay = 0;
+              next_refine[j - 1] = 1;
+              next_freqs[j] = mids[k];
+              next_refine[j] = 1;
+              next_values[j++] = mid_values[k];
             }
-            calc_time_shift (delay, w, &of);
-            eval_flag = 1;
+            k++;
           }
-          break;
-        case LIST:                      /* This option is added in version 2.3.17 I.Dricker*/
-          calc_list (blkt_ptr, i, &of); /*compute real and imag parts for the i-th ampl and phase */
-          eval_flag = 1;
-          break;
-        case POLYNOMIAL: /* IGD 06/01/2013*/
-          if ((status = calc_polynomial (blkt_ptr, &of, options->b62_x, log)))
-          {
-            return status;
-          }
-          eval_flag = 1;
-          break;
-        case IIR_COEFFS: /* This option is added in version 2.3.17 I.Dricker*/
-          iir_trans (blkt_ptr, w, &of);
-          eval_flag = 1;
-          break;
-        default:
-          break;
         }
-        if (eval_flag)
-          zmul (&val, &of);
-        blkt_ptr = blkt_ptr->next_blkt;
+        free (freqs);
+        free (values);
+        free (refine);
+        freqs = next_freqs;
+        values = next_values;
+        refine = next_refine;
+        next_freqs = NULL;
+        next_values = NULL;
+        next_refine = NULL;
+        n = j;
       }
-      stage_ptr = stage_ptr->next_stage;
     }
+    free (mids);
+    free (mid_values);
+    free (next_freqs);
+    free (next_values);
+    free (next_refine);
+    mids = next_freqs = NULL;
+    mid_values = next_values = NULL;
+    next_refine = NULL;
+  }
+
+  free (refine);
+  if (status)
+  {
+    free (freqs);
+    free (values);
+  }
+  else
+  {
+    *nout = n;
+    *freq_out = freqs;
+    *output = values;
+  }
+  return status;
+}
+
+int
+evaluate_polynomial (evalresp_logger *log, const evalresp_blkt *blkt,
+                     double const *x, int n, double *value, double *derivative)
+{
+  if (!blkt || blkt->type != POLYNOMIAL)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Not a polynomial blockette");
+    return EVALRESP_INP;
+  }
+  horner_polynomial (&blkt->blkt_info.polynomial, x, n, value, derivative);
+  return EVALRESP_OK;
+}
 
-    /* if no matching stages were found, then report the error */
+int
+evaluate_plan_polynomial (evalresp_logger *log, evalresp_plan const *plan, double freq,
+                          double const *x, int n, double *value, double *derivative)
+{
+  evalresp_plan rest;
+  const evalresp_plan_op *poly = NULL;
+  evalresp_complex scale;
+  int i, npoly = 0, status = EVALRESP_OK;
 
-    if (!matching_stages && !has_stage0)
+  for (i = 0; i < plan->nops; i++)
+  {
+    if (plan->ops[i].type == POLYNOMIAL)
     {
-      evalresp_log (log, EV_ERROR, 0,
-                    "calc_resp: %s start_stage=%d, highest stage found=%d)",
-                    "No Matching Stages Found (requested", options->start_stage,
-                    chan->nstages);
-      return EVALRESP_PAR;
+      if (!plan->ops[i].blkt)
+      {
+        evalresp_log (log, EV_ERROR, EV_ERROR, "Polynomial stage without coefficients");
+        return EVALRESP_INP;
+      }
+      poly = &plan->ops[i];
+      npoly++;
     }
-    else if (!matching_stages)
+  }
+  if (npoly != 1)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR,
+                  "Cannot evaluate a polynomial response with %d polynomial stages", npoly);
+    return EVALRESP_INP;
+  }
+
+  /* the rest of the response, with the polynomial replaced by 1 */
+  rest = *plan;
+  if (!(rest.ops = malloc (plan->nops * sizeof (*rest.ops))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate polynomial response");
+    return EVALRESP_MEM;
+  }
+  memcpy (rest.ops, plan->ops, plan->nops * sizeof (*rest.ops));
+  rest.ops[poly - plan->ops].value.real = 1.0;
+  rest.ops[poly - plan->ops].value.imag = 0.0;
+  status = evaluate_plan (log, &rest, &freq, 1, &scale);
+  free (rest.ops);
+
+  if (!status)
+  {
+    horner_polynomial (&poly->blkt->blkt_info.polynomial, x, n, value, derivative);
+    for (i = 0; value && i < n; i++)
+      value[i] *= scale.real;
+    for (i = 0; derivative && i < n; i++)
+      derivative[i] *= scale.real;
+  }
+  return status;
+}
+
+int
+interpolate_plan_lists (evalresp_logger *log, evalresp_plan *plan,
+                        double *freqs, int nfreqs)
+{
+  evalresp_plan_op *op;
+  evalresp_blkt *blkt;
+  evalresp_list *list;
+  int status = EVALRESP_OK;
+
+  if (!plan->lists && !(plan->lists = calloc (plan->nops ? plan->nops : 1, sizeof (*plan->lists))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate interpolated response list");
+    return EVALRESP_MEM;
+  }
+  for (op = plan->ops; !status && op < plan->ops + plan->nops; op++)
+  {
+    if (op->type == LIST)
     {
-      evalresp_log (log, EV_ERROR, 0,
-                    "calc_resp: %s start_stage=%d, highest stage found=%d)",
-                    "No Matching Stages Found (requested", options->start_stage,
-                    chan->nstages - 1);
-      return EVALRESP_PAR;
+      /* the list of the channel is only read; the interpolated values
+         belong to the plan */
+      list = (evalresp_list *)&op->blkt->blkt_info.list;
+      blkt = &plan->lists[plan->nlists];
+      *blkt = *op->blkt;
+      blkt->next_blkt = NULL;
+      blkt->blkt_info.list.spline = NULL;
+      if (!(status = interpolate_list (list->freq, list->amp, list->phase, list->nresp,
+                                       list->spline, freqs, nfreqs, &blkt->blkt_info.list.freq,
+                                       &blkt->blkt_info.list.amp, &blkt->blkt_info.list.phase,
+                                       &blkt->blkt_info.list.nresp, log)))
+      {
+        plan->nlists++;
+        op->blkt = blkt;
+      }
     }
+  }
+  return status;
+}
+
+void
+free_plan (evalresp_plan **plan)
+{
+  int i;
 
-    /*  Write output for freq[i] in output[i] (note: unit_scale_fact is set by the
-     * 'parse_units' function that is used to convert to 'MKS' units when the
-     * the response was given as a displacement, velocity, or acceleration in units other
-     * than meters) */
-    if (0 == options->use_total_sensitivity)
+  if (*plan)
+  {
+    for (i = 0; i < (*plan)->nops; i++)
     {
-      output[i].real = val.real * chan->calc_sensit * chan->unit_scale_fact;
-      output[i].imag = val.imag * chan->calc_sensit * chan->unit_scale_fact;
+      free ((*plan)->ops[i].single);
     }
-    else
+    for (i = 0; i < (*plan)->nowned; i++)
     {
-      output[i].real = val.real * chan->sensit * chan->unit_scale_fact;
-      output[i].imag = val.imag * chan->sensit * chan->unit_scale_fact;
+      free ((*plan)->owned[i].blkt_info.pole_zero.zeros);
+      free ((*plan)->owned[i].blkt_info.pole_zero.poles);
     }
-
-    if ((status = convert_to_units (units_code, options->unit, &output[i], w, log)))
+    free ((*plan)->owned);
+    for (i = 0; i < (*plan)->nlists; i++)
     {
-      return status;
+      free ((*plan)->lists[i].blkt_info.list.freq);
+      free ((*plan)->lists[i].blkt_info.list.amp);
+      free ((*plan)->lists[i].blkt_info.list.phase);
     }
+    free ((*plan)->lists);
+    free ((*plan)->ops);
+    free ((*plan)->gains);
+    free (*plan);
+    *plan = NULL;
   }
-  return EVALRESP_OK;
+}
+
+int
+calculate_response (evalresp_logger *log, evalresp_options *options,
+                    evalresp_channel *chan, double *freq, int nfreqs,
+                    evalresp_complex *output)
+{
+  evalresp_plan *plan = NULL;
+  int status;
+
+  if (!(status = compile_plan (log, options, chan, 0, &plan)))
+  {
+    status = evaluate_plan (log, plan, freq, nfreqs, output);
+  }
+  free_plan (&plan);
+  return status;
 }
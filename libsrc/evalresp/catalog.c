@@ -0,0 +1,759 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+#include "evalresp/private.h"
+
+/* a catalog holds the RESP.* names in each directory that has been
+   searched, so that the files for many sncls are found with a single
+   read of the directory.  a name of the form RESP.NET.STA.CHA or
+   RESP.NET.STA.LOC.CHA is split into its fields and chained by each
+   field between two dots (station and, with four fields, location).  a
+   pattern with a literal station can only match a name with that text
+   between two dots (whatever wildcards come before it), so it is only
+   tried against those names.  matching is always of the whole name, as
+   glob() does. */
+
+#define CATALOG_PREFIX "RESP."
+#define CATALOG_MAGIC "EVALRESP CATALOG 1"
+#define CATALOG_MAX_FIELDS 4
+#define CATALOG_LINE_LEN 4096
+/* characters that make the directory of a pattern a pattern itself (on
+   windows the backslash separates directories, so is not an escape) */
+#ifdef _WIN32
+#define CATALOG_WILDCARDS "*?["
+#else
+#define CATALOG_WILDCARDS "*?[\\"
+#endif
+
+typedef struct
+{
+  int nfields; /* 3 or 4 (or 0 if the name is matched as a whole) */
+  char *field[CATALOG_MAX_FIELDS];
+} catalog_fields;
+
+typedef struct catalog_dir_s catalog_dir;
+
+struct catalog_dir_s
+{
+  char *path;             /* as given in the pattern, with the trailing separator */
+  time_t mtime;           /* of the directory when it was read */
+  time_t read_at;         /* when it was read */
+  int checked;            /* generation in which mtime was last checked */
+  int nnames;
+  char **names;           /* sorted, as glob() sorts them */
+  char **split;           /* copies of the names, cut into fields */
+  catalog_fields *fields;
+  int nbuckets;
+  int *buckets;           /* first link with a field of each hash, or -1 */
+  int *next;              /* next link in the same bucket, or -1; link 2i + k
+                             is name i by its field 1 + k */
+  int nothers;
+  int *others;            /* names not split into fields */
+  catalog_dir *next_dir;
+};
+
+struct evalresp_catalog_s
+{
+  evalresp_mutex *mutex;
+  char *filename; /* where the catalog is kept between runs, or NULL */
+  int generation;
+  catalog_dir *dirs;
+};
+
+static int
+is_wild (const char *text)
+{
+  return strpbrk (text, "*?[\\") != NULL;
+}
+
+/* match c against the set of a bracket expression that starts at p (after
+   the '['); returns the end of the expression, or NULL if it is not
+   terminated (and so the '[' is an ordinary character) */
+static const char *
+match_bracket (const char *p, char c, int *matched)
+{
+  const char *start;
+  int negate = 0, found = 0;
+  unsigned char lo, hi;
+
+  if (*p == '!' || *p == '^')
+  {
+    negate = 1;
+    p++;
+  }
+  for (start = p; *p && (*p != ']' || p == start);)
+  {
+    if (*p == '\\' && p[1])
+      p++;
+    lo = hi = *p++;
+    if (*p == '-' && p[1] && p[1] != ']')
+    {
+      p++;
+      if (*p == '\\' && p[1])
+        p++;
+      hi = *p++;
+    }
+    found |= lo <= (unsigned char)c && (unsigned char)c <= hi;
+  }
+  if (*p != ']')
+  {
+    return NULL;
+  }
+  *matched = found != negate;
+  return p + 1;
+}
+
+/* does the text match a glob() pattern (with *, ? and [...])? */
+static int
+glob_match (const char *p, const char *t)
+{
+  const char *star_p = NULL, *star_t = NULL, *next;
+  int matched;
+
+  while (*t)
+  {
+    if (*p == '*')
+    {
+      star_p = ++p;
+      star_t = t;
+      continue;
+    }
+    if (*p == '?')
+    {
+      p++;
+      t++;
+      continue;
+    }
+    if (*p == '[' && (next = match_bracket (p + 1, *t, &matched)))
+    {
+      if (matched)
+      {
+        p = next;
+        t++;
+        continue;
+      }
+    }
+    else
+    {
+      if (*p == '\\' && p[1])
+        p++;
+      if (*p && *p == *t)
+      {
+        p++;
+        t++;
+        continue;
+      }
+    }
+    /* retry from the last '*', which takes one more character */
+    if (!star_p)
+    {
+      return 0;
+    }
+    p = star_p;
+    t = ++star_t;
+  }
+  while (*p == '*')
+  {
+    p++;
+  }
+  return !*p;
+}
+
+/* split text (after RESP.) into fields at each '.', in place */
+static int
+split_fields (char *text, catalog_fields *fields)
+{
+  char *dot;
+
+  fields->nfields = 0;
+  for (;;)
+  {
+    if (fields->nfields == CATALOG_MAX_FIELDS)
+    {
+      fields->nfields = 0;
+      return 0;
+    }
+    fields->field[fields->nfields++] = text;
+    if (!(dot = strchr (text, '.')))
+    {
+      break;
+    }
+    *dot = '\0';
+    text = dot + 1;
+  }
+  if (fields->nfields < 3)
+  {
+    fields->nfields = 0;
+  }
+  return fields->nfields;
+}
+
+static unsigned
+field_bucket (const char *field, int nbuckets)
+{
+  return (unsigned)(stage_cache_hash (field, strlen (field), EVALRESP_HASH_INIT) & (nbuckets - 1));
+}
+
+static int
+compare_names (const void *a, const void *b)
+{
+  return strcmp (*(char *const *)a, *(char *const *)b);
+}
+
+static void
+free_dir_index (catalog_dir *dir)
+{
+  int i;
+
+  for (i = 0; dir->split && i < dir->nnames; i++)
+  {
+    free (dir->split[i]);
+  }
+  free (dir->split);
+  free (dir->fields);
+  free (dir->buckets);
+  free (dir->next);
+  free (dir->others);
+  dir->others = NULL;
+  dir->nothers = 0;
+  dir->split = NULL;
+  dir->fields = NULL;
+  dir->buckets = NULL;
+  dir->next = NULL;
+}
+
+static void
+free_dir_names (catalog_dir *dir)
+{
+  int i;
+
+  free_dir_index (dir);
+  for (i = 0; dir->names && i < dir->nnames; i++)
+  {
+    free (dir->names[i]);
+  }
+  free (dir->names);
+  dir->names = NULL;
+  dir->nnames = 0;
+}
+
+/* split the (sorted) names and chain them by their inner fields */
+static int
+index_dir (evalresp_logger *log, catalog_dir *dir)
+{
+  int i, k;
+  unsigned bucket;
+
+  for (dir->nbuckets = 1; dir->nbuckets < dir->nnames; dir->nbuckets *= 2)
+    ;
+  if (!(dir->split = calloc (dir->nnames + 1, sizeof (*dir->split)))
+      || !(dir->fields = calloc (dir->nnames + 1, sizeof (*dir->fields)))
+      || !(dir->buckets = malloc (dir->nbuckets * sizeof (*dir->buckets)))
+      || !(dir->next = malloc ((2 * dir->nnames + 1) * sizeof (*dir->next)))
+      || !(dir->others = malloc ((dir->nnames + 1) * sizeof (*dir->others))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate catalog of %s", dir->path);
+    free_dir_index (dir);
+    return EVALRESP_MEM;
+  }
+  for (i = 0; i < dir->nbuckets; i++)
+  {
+    dir->buckets[i] = -1;
+  }
+  /* last to first, so that each chain is in name order */
+  for (i = dir->nnames - 1; i >= 0; i--)
+  {
+    if (!(dir->split[i] = strdup (dir->names[i] + strlen (CATALOG_PREFIX))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate catalog of %s", dir->path);
+      free_dir_index (dir);
+      return EVALRESP_MEM;
+    }
+    if (!split_fields (dir->split[i], &dir->fields[i]))
+    {
+      dir->others[dir->nothers++] = i;
+      continue;
+    }
+    for (k = dir->fields[i].nfields - 3; k >= 0; k--)
+    {
+      dir->next[2 * i + k] = -1;
+      if (k && !strcmp (dir->fields[i].field[1], dir->fields[i].field[2]))
+      {
+        continue;
+      }
+      bucket = field_bucket (dir->fields[i].field[1 + k], dir->nbuckets);
+      dir->next[2 * i + k] = dir->buckets[bucket];
+      dir->buckets[bucket] = 2 * i + k;
+    }
+  }
+  return EVALRESP_OK;
+}
+
+static int
+add_name (evalresp_logger *log, catalog_dir *dir, const char *name, int *size)
+{
+  char **names;
+
+  if (dir->nnames == *size)
+  {
+    *size = *size ? 2 * *size : 1024;
+    if (!(names = realloc (dir->names, *size * sizeof (*names))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate catalog of %s", dir->path);
+      return EVALRESP_MEM;
+    }
+    dir->names = names;
+  }
+  if (!(dir->names[dir->nnames] = strdup (name)))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate catalog of %s", dir->path);
+    return EVALRESP_MEM;
+  }
+  dir->nnames++;
+  return EVALRESP_OK;
+}
+
+/* (re)read the RESP.* names in a directory */
+static int
+read_dir (evalresp_logger *log, catalog_dir *dir, time_t mtime)
+{
+  int status = EVALRESP_OK, size = 0;
+  const char *path = strlen (dir->path) ? dir->path : ".";
+#ifdef _WIN32
+  char pattern[CATALOG_LINE_LEN];
+  struct _finddata_t found;
+  intptr_t handle;
+#else
+  DIR *entries;
+  struct dirent *entry;
+#endif
+
+  free_dir_names (dir);
+  dir->read_at = time (NULL);
+  dir->mtime = mtime;
+#ifdef _WIN32
+  _evalresp_snprintf (pattern, sizeof (pattern), "%s%s*", dir->path, CATALOG_PREFIX);
+  if ((handle = _findfirst (pattern, &found)) != -1)
+  {
+    do
+    {
+      status = add_name (log, dir, found.name, &size);
+    } while (!status && _findnext (handle, &found) == 0);
+    _findclose (handle);
+  }
+#else
+  if (!(entries = opendir (path)))
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Cannot read directory %s: %s", path, strerror (errno));
+    return EVALRESP_OK;
+  }
+  while (!status && (entry = readdir (entries)))
+  {
+    if (!strncmp (entry->d_name, CATALOG_PREFIX, strlen (CATALOG_PREFIX)))
+    {
+      status = add_name (log, dir, entry->d_name, &size);
+    }
+  }
+  closedir (entries);
+#endif
+  if (!status)
+  {
+    qsort (dir->names, dir->nnames, sizeof (*dir->names), compare_names);
+    status = index_dir (log, dir);
+  }
+  if (status)
+  {
+    free_dir_names (dir);
+  }
+  return status;
+}
+
+static void
+free_dir (catalog_dir **dir)
+{
+  if (*dir)
+  {
+    free_dir_names (*dir);
+    free ((*dir)->path);
+    free (*dir);
+    *dir = NULL;
+  }
+}
+
+static int
+new_dir (evalresp_logger *log, const char *path, size_t len, catalog_dir **dir)
+{
+  if (!(*dir = calloc (1, sizeof (**dir))) || !((*dir)->path = calloc (len + 1, 1)))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate catalog");
+    free (*dir);
+    *dir = NULL;
+    return EVALRESP_MEM;
+  }
+  memcpy ((*dir)->path, path, len);
+  return EVALRESP_OK;
+}
+
+/* read a catalog saved by save_catalog(); anything unexpected discards
+   the rest of the file (which is only a cache) */
+static void
+load_catalog (evalresp_logger *log, evalresp_catalog *catalog)
+{
+  char line[CATALOG_LINE_LEN];
+  long long mtime, read_at;
+  int i, n, offset, size, ok = 1;
+  size_t len;
+  catalog_dir *dir = NULL, **last = &catalog->dirs;
+  FILE *file;
+
+  if (!(file = fopen (catalog->filename, "r")))
+  {
+    return;
+  }
+  if (!fgets (line, sizeof (line), file) || strncmp (line, CATALOG_MAGIC "\n", sizeof (line)))
+  {
+    ok = 0;
+  }
+  while (ok && fgets (line, sizeof (line), file))
+  {
+    offset = 0;
+    len = strlen (line);
+    if (sscanf (line, "%lld %lld %d %n", &mtime, &read_at, &n, &offset) != 3 || !offset
+        || n < 0 || len < 2 || line[len - 1] != '\n'
+        || new_dir (log, line + offset, len - 1 - offset, &dir))
+    {
+      ok = 0;
+      break;
+    }
+    dir->mtime = (time_t)mtime;
+    dir->read_at = (time_t)read_at;
+    for (i = 0, size = 0; ok && i < n; i++)
+    {
+      ok = fgets (line, sizeof (line), file) && (len = strlen (line)) > strlen (CATALOG_PREFIX)
+           && line[len - 1] == '\n';
+      if (ok)
+      {
+        line[len - 1] = '\0';
+        ok = !add_name (log, dir, line, &size);
+      }
+    }
+    if (!ok || index_dir (log, dir))
+    {
+      ok = 0;
+      free_dir (&dir);
+      break;
+    }
+    *last = dir;
+    last = &dir->next_dir;
+    dir = NULL;
+  }
+  if (!ok)
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Ignoring unusable catalog %s", catalog->filename);
+    while (catalog->dirs)
+    {
+      dir = catalog->dirs->next_dir;
+      free_dir (&catalog->dirs);
+      catalog->dirs = dir;
+    }
+  }
+  fclose (file);
+}
+
+/* write the catalog to a temporary file that then replaces the old one */
+static void
+save_catalog (evalresp_logger *log, evalresp_catalog *catalog)
+{
+  char temp[CATALOG_LINE_LEN];
+  catalog_dir *dir;
+  FILE *file;
+  int i, ok;
+
+  _evalresp_snprintf (temp, sizeof (temp), "%s.tmp", catalog->filename);
+  if (!(file = fopen (temp, "w")))
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Cannot write catalog %s", temp);
+    return;
+  }
+  ok = fprintf (file, "%s\n", CATALOG_MAGIC) > 0;
+  for (dir = catalog->dirs; ok && dir; dir = dir->next_dir)
+  {
+    /* a newline in a name cannot be saved, so the directory is read again */
+    for (i = 0; i < dir->nnames && !strchr (dir->names[i], '\n'); i++)
+      ;
+    if (i < dir->nnames || strchr (dir->path, '\n'))
+    {
+      continue;
+    }
+    ok = fprintf (file, "%lld %lld %d %s\n", (long long)dir->mtime, (long long)dir->read_at,
+                  dir->nnames, dir->path) > 0;
+    for (i = 0; ok && i < dir->nnames; i++)
+    {
+      ok = fprintf (file, "%s\n", dir->names[i]) > 0;
+    }
+  }
+  if (fclose (file) || !ok
+#ifdef _WIN32
+      || (remove (catalog->filename) && errno != ENOENT)
+#endif
+      || rename (temp, catalog->filename))
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Cannot write catalog %s", catalog->filename);
+    remove (temp);
+  }
+}
+
+int
+evalresp_new_catalog (evalresp_logger *log, const char *filename, evalresp_catalog **catalog)
+{
+  int status = EVALRESP_OK;
+
+  if (!(*catalog = calloc (1, sizeof (**catalog))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate catalog");
+    return EVALRESP_MEM;
+  }
+  if (filename && !((*catalog)->filename = strdup (filename)))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate catalog");
+    status = EVALRESP_MEM;
+  }
+  if (!status && !(status = mutex_new (log, &(*catalog)->mutex)) && filename)
+  {
+    load_catalog (log, *catalog);
+  }
+  if (status)
+  {
+    evalresp_free_catalog (catalog);
+  }
+  return status;
+}
+
+void
+evalresp_free_catalog (evalresp_catalog **catalog)
+{
+  catalog_dir *dir;
+
+  if (*catalog)
+  {
+    while ((*catalog)->dirs)
+    {
+      dir = (*catalog)->dirs->next_dir;
+      free_dir (&(*catalog)->dirs);
+      (*catalog)->dirs = dir;
+    }
+    mutex_free (&(*catalog)->mutex);
+    free ((*catalog)->filename);
+    free (*catalog);
+    *catalog = NULL;
+  }
+}
+
+void
+catalog_check (evalresp_catalog *catalog)
+{
+  if (catalog)
+  {
+    mutex_lock (catalog->mutex);
+    catalog->generation++;
+    mutex_unlock (catalog->mutex);
+  }
+}
+
+/* the directory, read if it is new or has changed since it was read.  a
+   directory modified in the second it was read (or later) may have
+   changed unseen, so is read again */
+static int
+find_dir (evalresp_logger *log, evalresp_catalog *catalog, const char *path, size_t len, catalog_dir **dir)
+{
+  int status = EVALRESP_OK;
+  struct stat buf;
+  time_t mtime = 0;
+
+  for (*dir = catalog->dirs; *dir; *dir = (*dir)->next_dir)
+  {
+    if (strlen ((*dir)->path) == len && !strncmp ((*dir)->path, path, len))
+    {
+      break;
+    }
+  }
+  if (*dir && (*dir)->checked == catalog->generation)
+  {
+    return EVALRESP_OK;
+  }
+  if (!*dir)
+  {
+    if ((status = new_dir (log, path, len, dir)))
+    {
+      return status;
+    }
+    (*dir)->next_dir = catalog->dirs;
+    catalog->dirs = *dir;
+    (*dir)->read_at = -1; /* force reading */
+  }
+  (*dir)->checked = catalog->generation;
+  if (!stat (strlen ((*dir)->path) ? (*dir)->path : ".", &buf))
+  {
+    mtime = buf.st_mtime;
+  }
+  if ((*dir)->read_at < 0 || mtime != (*dir)->mtime || (*dir)->mtime >= (*dir)->read_at)
+  {
+    if (!(status = read_dir (log, *dir, mtime)) && catalog->filename)
+    {
+      save_catalog (log, catalog);
+    }
+  }
+  return status;
+}
+
+static int
+compare_ints (const void *a, const void *b)
+{
+  return *(const int *)a - *(const int *)b;
+}
+
+/* the names in a directory that match a pattern, in name order */
+static int
+match_dir (evalresp_logger *log, catalog_dir *dir, const char *base, int **matches, int *n)
+{
+  char split[CATALOG_LINE_LEN];
+  catalog_fields pattern;
+  int i, link;
+
+  *n = 0;
+  if (!(*matches = calloc (dir->nnames + 1, sizeof (**matches))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate catalog matches");
+    return EVALRESP_MEM;
+  }
+  strncpy (split, base + strlen (CATALOG_PREFIX), sizeof (split) - 1);
+  split[sizeof (split) - 1] = '\0';
+  if (!strchr (split, '[') && split_fields (split, &pattern) && !is_wild (pattern.field[1]))
+  {
+    /* only the names with the station between two dots (and those not
+       split into fields) can match */
+    for (link = dir->buckets[field_bucket (pattern.field[1], dir->nbuckets)]; link >= 0; link = dir->next[link])
+    {
+      i = link / 2;
+      if (!strcmp (pattern.field[1], dir->fields[i].field[1 + link % 2]) && glob_match (base, dir->names[i]))
+      {
+        (*matches)[(*n)++] = i;
+      }
+    }
+    for (i = 0; i < dir->nothers; i++)
+    {
+      if (glob_match (base, dir->names[dir->others[i]]))
+      {
+        (*matches)[(*n)++] = dir->others[i];
+      }
+    }
+    qsort (*matches, *n, sizeof (**matches), compare_ints);
+  }
+  else
+  {
+    for (i = 0; i < dir->nnames; i++)
+    {
+      if (glob_match (base, dir->names[i]))
+      {
+        (*matches)[(*n)++] = i;
+      }
+    }
+  }
+  return EVALRESP_OK;
+}
+
+/* the files matching one pattern, or -1 if the catalog cannot be used */
+static int
+catalog_pattern (evalresp_logger *log, evalresp_catalog *catalog, char *pattern,
+                 struct matched_files *files)
+{
+  const char *base, *wild;
+#ifdef _WIN32
+  const char *sep;
+#endif
+  struct file_list *file;
+  catalog_dir *dir;
+  int *matches = NULL, n = 0, i;
+  size_t len;
+
+  base = strrchr (pattern, '/');
+#ifdef _WIN32
+  if ((sep = strrchr (pattern, '\\')) && (!base || sep > base))
+  {
+    base = sep;
+  }
+#endif
+  base = base ? base + 1 : pattern;
+  len = base - pattern;
+  /* only the patterns used by find_files() */
+  if (strncmp (base, CATALOG_PREFIX, strlen (CATALOG_PREFIX))
+      || ((wild = strpbrk (pattern, CATALOG_WILDCARDS)) && wild < base))
+  {
+    return -1;
+  }
+
+  mutex_lock (catalog->mutex);
+  if (!find_dir (log, catalog, pattern, len, &dir) && !match_dir (log, dir, base, &matches, &n))
+  {
+    /* in the reverse of name order, as get_names() */
+    for (i = 0; i < n; i++)
+    {
+      if (!(file = alloc_file_list (log))
+          || !(file->name = alloc_char (len + strlen (dir->names[matches[i]]) + 1, log)))
+      {
+        free (file);
+        break;
+      }
+      memcpy (file->name, pattern, len);
+      strcpy (file->name + len, dir->names[matches[i]]);
+      file->next_file = files->first_list;
+      files->first_list = file;
+      files->nfiles++;
+    }
+  }
+  mutex_unlock (catalog->mutex);
+  free (matches);
+  return files->nfiles;
+}
+
+int
+catalog_names (evalresp_logger *log, evalresp_catalog *catalog, char *in_file, struct matched_files *files)
+{
+  char *second, copy[CATALOG_LINE_LEN];
+  int n;
+
+  if (!catalog)
+  {
+    return get_names (in_file, files, log);
+  }
+  /* as get_names(), the second pattern (if any) is only used when the
+     first matches nothing (and the first is left terminated) */
+  if ((second = strchr (in_file, ' ')))
+  {
+    *second++ = '\0';
+  }
+  if ((n = catalog_pattern (log, catalog, in_file, files)) < 0)
+  {
+    strncpy (copy, in_file, sizeof (copy) - 1);
+    copy[sizeof (copy) - 1] = '\0';
+    n = get_names (copy, files, log);
+  }
+  if (!n && second && *second && (n = catalog_pattern (log, catalog, second, files)) < 0)
+  {
+    strncpy (copy, second, sizeof (copy) - 1);
+    copy[sizeof (copy) - 1] = '\0';
+    n = get_names (copy, files, log);
+  }
+  return n;
+}
@@ -0,0 +1,527 @@
+#include <config.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "evalresp/private.h"
+#include "evalresp/public.h"
+#include "zipc.h"
+
+/* a container is a header, an index with an entry for each response, the
+   options used to evaluate the responses (as text), and then the
+   frequencies and responses themselves.  all numbers are little-endian
+   and the index entries have a fixed size, so the container can be read
+   with a single seek to any response (or mapped into memory). */
+
+#define CONTAINER_CODE_LEN 64 /* network, station, location and channel */
+#define CONTAINER_TIME_LEN 24 /* start and end of epoch */
+#define CONTAINER_ENTRY_SIZE (4 * CONTAINER_CODE_LEN + 2 * CONTAINER_TIME_LEN + 16)
+#define CONTAINER_ALIGN 8
+
+/* the zip format (without zip64) counts entries in 16 bits */
+#define ZIP_MAX_FILES 65535
+
+static const char *unit_names[] = {"DEF", "DIS", "VEL", "ACC"};
+
+/* copy text into a fixed width field, nul padded (and terminated) */
+static void
+put_text (unsigned char *out, const char *text, size_t width)
+{
+  memset (out, 0, width);
+  strncpy ((char *)out, text, width - 1);
+}
+
+/* copy a fixed width field into a string of size len */
+static void
+get_text (char *out, size_t len, const unsigned char *text, size_t width)
+{
+  size_t n = width < len ? width : len - 1;
+  memcpy (out, text, n);
+  out[n] = '\0';
+}
+
+/* the options that affect the responses, as lines of key=value */
+static int
+options_to_metadata (evalresp_logger *log, evalresp_options const *options, text_buffer *metadata)
+{
+  char line[MAXLINELEN];
+  int status = EVALRESP_OK, i, len;
+
+  for (i = 0; !status; i++)
+  {
+    switch (i)
+    {
+    case 0:
+      len = _evalresp_snprintf (line, sizeof (line), "evalresp=%s\n", REVNUM);
+      break;
+    case 1:
+      len = _evalresp_snprintf (line, sizeof (line), "input=%s\n", options->filename ? options->filename : "");
+      break;
+    case 2:
+      len = _evalresp_snprintf (line, sizeof (line), "unit=%s\n", unit_names[options->unit]);
+      break;
+    case 3:
+      len = _evalresp_snprintf (line, sizeof (line), "min_freq=%.17g\nmax_freq=%.17g\nnfreq=%d\nlin_freq=%d\n",
+                                options->min_freq, options->max_freq, options->nfreq, options->lin_freq);
+      break;
+    case 4:
+      len = _evalresp_snprintf (line, sizeof (line), "start_stage=%d\nstop_stage=%d\n",
+                                options->start_stage, options->stop_stage);
+      break;
+    case 5:
+      len = _evalresp_snprintf (line, sizeof (line), "use_estimated_delay=%d\nuse_total_sensitivity=%d\nb55_interpolate=%d\nb62_x=%.17g\n",
+                                options->use_estimated_delay, options->use_total_sensitivity,
+                                options->b55_interpolate, options->b62_x);
+      break;
+    case 6:
+      len = _evalresp_snprintf (line, sizeof (line), "single_precision=%d\nsimplify=%d\nsimplify_tol=%.17g\nadaptive_tol=%.17g\n",
+                                options->single_precision, options->simplify, options->simplify_tol,
+                                options->adaptive_tol);
+      break;
+    default:
+      return EVALRESP_OK;
+    }
+    if (len >= (int)sizeof (line))
+    {
+      len = sizeof (line) - 1;
+    }
+    status = text_buffer_append (log, metadata, line, len);
+  }
+  return status;
+}
+
+int
+evalresp_responses_to_container (evalresp_logger *log, const evalresp_responses *responses,
+                                 evalresp_options const *options, const char *filename)
+{
+  int status = EVALRESP_OK, i, j;
+  const evalresp_response *response;
+  text_buffer metadata = {NULL, 0, 0, NULL}, buffer = {NULL, 0, 0, NULL};
+  unsigned char header[EVALRESP_BINARY_HEADER_SIZE], entry[CONTAINER_ENTRY_SIZE], *row;
+  static const char padding[CONTAINER_ALIGN] = {0};
+  uint64_t offset;
+  size_t metadata_len;
+
+  if (!responses || !filename)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Missing responses or container name");
+    return EVALRESP_ERR;
+  }
+  if (options)
+  {
+    status = options_to_metadata (log, options, &metadata);
+  }
+  if (!status && !(buffer.file = fopen (filename, "wb")))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "could not open output file %s", filename);
+    status = EVALRESP_IO;
+  }
+
+  if (!status)
+  {
+    metadata_len = metadata.len;
+    memcpy (header, EVALRESP_BINARY_MAGIC, 8);
+    put_le (header + 8, EVALRESP_BINARY_VERSION, 4);
+    put_le (header + 12, EVALRESP_BINARY_CONTAINER, 4);
+    put_le (header + 16, responses->nresponses, 8);
+    put_le (header + 24, metadata_len, 8);
+    status = text_buffer_append (log, &buffer, (char *)header, sizeof (header));
+
+    /* the data start after the (aligned) metadata */
+    offset = sizeof (header) + (uint64_t)CONTAINER_ENTRY_SIZE * responses->nresponses;
+    offset += (metadata_len + CONTAINER_ALIGN - 1) / CONTAINER_ALIGN * CONTAINER_ALIGN;
+    for (i = 0; !status && i < responses->nresponses; i++)
+    {
+      response = responses->responses[i];
+      put_text (entry, response->network, CONTAINER_CODE_LEN);
+      put_text (entry + CONTAINER_CODE_LEN, response->station, CONTAINER_CODE_LEN);
+      put_text (entry + 2 * CONTAINER_CODE_LEN, response->locid, CONTAINER_CODE_LEN);
+      put_text (entry + 3 * CONTAINER_CODE_LEN, response->channel, CONTAINER_CODE_LEN);
+      put_text (entry + 4 * CONTAINER_CODE_LEN, response->beg_t, CONTAINER_TIME_LEN);
+      put_text (entry + 4 * CONTAINER_CODE_LEN + CONTAINER_TIME_LEN, response->end_t, CONTAINER_TIME_LEN);
+      put_le (entry + CONTAINER_ENTRY_SIZE - 16, offset, 8);
+      put_le (entry + CONTAINER_ENTRY_SIZE - 8, response->nfreqs, 8);
+      status = text_buffer_append (log, &buffer, (char *)entry, sizeof (entry));
+      offset += (uint64_t)EVALRESP_BINARY_ROW_SIZE * response->nfreqs;
+    }
+    if (!status && !(status = text_buffer_append (log, &buffer, metadata.text, metadata_len)))
+    {
+      status = text_buffer_append (log, &buffer, padding, (CONTAINER_ALIGN - metadata_len % CONTAINER_ALIGN) % CONTAINER_ALIGN);
+    }
+
+    /* rows of frequency, real and imaginary parts */
+    for (i = 0; !status && i < responses->nresponses; i++)
+    {
+      response = responses->responses[i];
+      for (j = 0; !status && j < response->nfreqs; j++)
+      {
+        if (!(status = text_buffer_reserve (log, &buffer, EVALRESP_BINARY_ROW_SIZE)))
+        {
+          row = (unsigned char *)buffer.text + buffer.len;
+          put_le_double (row, response->freqs[j]);
+          put_le_double (row + 8, response->rvec[j].real);
+          put_le_double (row + 16, response->rvec[j].imag);
+          buffer.len += EVALRESP_BINARY_ROW_SIZE;
+        }
+      }
+    }
+    if (!status)
+    {
+      status = text_buffer_flush (log, &buffer);
+    }
+    if (fclose (buffer.file) && !status)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Failed to write to file");
+      status = EVALRESP_IO;
+    }
+  }
+
+  free (metadata.text);
+  free (buffer.text);
+  return status;
+}
+
+/* read one response, given its index entry */
+static int
+read_container_response (evalresp_logger *log, FILE *file, const char *filename,
+                         const unsigned char *entry, evalresp_response **response)
+{
+  uint64_t offset, nfreqs;
+  unsigned char *rows = NULL;
+  int status = EVALRESP_OK, i;
+
+  offset = get_le (entry + CONTAINER_ENTRY_SIZE - 16, 8);
+  nfreqs = get_le (entry + CONTAINER_ENTRY_SIZE - 8, 8);
+  if (nfreqs > INT_MAX / EVALRESP_BINARY_ROW_SIZE || offset > LONG_MAX)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Corrupt index in container %s", filename);
+    return EVALRESP_IO;
+  }
+
+  if (!(*response = calloc (1, sizeof (**response)))
+      || !((*response)->freqs = calloc (nfreqs ? nfreqs : 1, sizeof (*(*response)->freqs)))
+      || !((*response)->rvec = calloc (nfreqs ? nfreqs : 1, sizeof (*(*response)->rvec)))
+      || !(rows = malloc (nfreqs ? nfreqs * EVALRESP_BINARY_ROW_SIZE : 1)))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate response");
+    status = EVALRESP_MEM;
+  }
+  else
+  {
+    get_text ((*response)->network, NETLEN, entry, CONTAINER_CODE_LEN);
+    get_text ((*response)->station, STALEN, entry + CONTAINER_CODE_LEN, CONTAINER_CODE_LEN);
+    get_text ((*response)->locid, LOCIDLEN, entry + 2 * CONTAINER_CODE_LEN, CONTAINER_CODE_LEN);
+    get_text ((*response)->channel, CHALEN, entry + 3 * CONTAINER_CODE_LEN, CONTAINER_CODE_LEN);
+    get_text ((*response)->beg_t, DATIMLEN, entry + 4 * CONTAINER_CODE_LEN, CONTAINER_TIME_LEN);
+    get_text ((*response)->end_t, DATIMLEN, entry + 4 * CONTAINER_CODE_LEN + CONTAINER_TIME_LEN, CONTAINER_TIME_LEN);
+    (*response)->nfreqs = (int)nfreqs;
+    if (fseek (file, (long)offset, SEEK_SET)
+        || fread (rows, EVALRESP_BINARY_ROW_SIZE, nfreqs, file) != nfreqs)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Truncated container %s", filename);
+      status = EVALRESP_IO;
+    }
+    for (i = 0; !status && i < (int)nfreqs; i++)
+    {
+      (*response)->freqs[i] = get_le_double (rows + i * EVALRESP_BINARY_ROW_SIZE);
+      (*response)->rvec[i].real = get_le_double (rows + i * EVALRESP_BINARY_ROW_SIZE + 8);
+      (*response)->rvec[i].imag = get_le_double (rows + i * EVALRESP_BINARY_ROW_SIZE + 16);
+    }
+  }
+
+  free (rows);
+  return status;
+}
+
+int
+evalresp_container_to_responses (evalresp_logger *log, const char *filename,
+                                 evalresp_responses **responses, char **metadata)
+{
+  int status = EVALRESP_OK, i;
+  unsigned char header[EVALRESP_BINARY_HEADER_SIZE], *index = NULL;
+  uint64_t nresponses, metadata_len;
+  char *text = NULL;
+  FILE *file;
+
+  if (*responses)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "cannot read a container into already allocated responses");
+    return EVALRESP_ERR;
+  }
+  if (!(file = fopen (filename, "rb")))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Unable to open container %s", filename);
+    return EVALRESP_IO;
+  }
+
+  if (fread (header, sizeof (header), 1, file) != 1
+      || memcmp (header, EVALRESP_BINARY_MAGIC, 8)
+      || get_le (header + 12, 4) != EVALRESP_BINARY_CONTAINER)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "%s is not an evalresp container", filename);
+    status = EVALRESP_INP;
+  }
+  else if (get_le (header + 8, 4) != EVALRESP_BINARY_VERSION)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Unsupported version of container %s", filename);
+    status = EVALRESP_INP;
+  }
+
+  if (!status)
+  {
+    nresponses = get_le (header + 16, 8);
+    metadata_len = get_le (header + 24, 8);
+    if (nresponses > INT_MAX / CONTAINER_ENTRY_SIZE || metadata_len > INT_MAX)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Corrupt header in container %s", filename);
+      status = EVALRESP_IO;
+    }
+    else if (!(index = malloc (nresponses ? nresponses * CONTAINER_ENTRY_SIZE : 1))
+             || !(text = calloc (metadata_len + 1, 1))
+             || !(*responses = calloc (1, sizeof (**responses)))
+             || !((*responses)->responses = calloc (nresponses ? nresponses : 1, sizeof (*(*responses)->responses))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate container index");
+      status = EVALRESP_MEM;
+    }
+    else if (fread (index, CONTAINER_ENTRY_SIZE, nresponses, file) != nresponses
+             || fread (text, 1, metadata_len, file) != metadata_len)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Truncated container %s", filename);
+      status = EVALRESP_IO;
+    }
+    for (i = 0; !status && i < (int)nresponses; i++)
+    {
+      status = read_container_response (log, file, filename, index + i * CONTAINER_ENTRY_SIZE,
+                                        &(*responses)->responses[i]);
+      (*responses)->nresponses = i + 1;
+    }
+  }
+
+  if (!status && metadata)
+  {
+    *metadata = text;
+    text = NULL;
+  }
+  free (text);
+  free (index);
+  fclose (file);
+  return status;
+}
+
+static int
+zip_open (evalresp_logger *log, const char *filename, zipc_t **zc)
+{
+  if (!(*zc = zipcOpen (filename, "w")))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "could not open output file %s", filename);
+    return EVALRESP_IO;
+  }
+  return EVALRESP_OK;
+}
+
+/* add the files for the responses to an open archive that already holds
+   nzipped files (updated) */
+static int
+zip_responses (evalresp_logger *log, zipc_t *zc, const char *filename, const evalresp_responses *responses,
+               int unwrap, evalresp_output_format format, text_buffer *buffer, int *nzipped)
+{
+  int status = EVALRESP_OK, i, j, nfiles;
+  evalresp_file_format file_formats[EVALRESP_MAX_OUTPUT_FILES];
+  char *name = NULL;
+  zipc_file_t *zf;
+
+  nfiles = output_file_formats (format, file_formats);
+  if (*nzipped + (long)responses->nresponses * nfiles > ZIP_MAX_FILES)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Too many files (%ld) for ZIP archive %s",
+                  *nzipped + (long)responses->nresponses * nfiles, filename);
+    return EVALRESP_ERR;
+  }
+
+  for (i = 0; !status && i < responses->nresponses; i++)
+  {
+    for (j = 0; !status && j < nfiles; j++)
+    {
+      buffer->len = 0;
+      if (!(status = response_filename (log, responses->responses[i], file_formats[j], 0, &name))
+          && !(status = response_to_buffer (log, responses->responses[i], unwrap, file_formats[j], buffer)))
+      {
+        if (!(zf = zipcCreateFile (zc, name, 1))
+            || zipcFileWrite (zf, buffer->text, buffer->len)
+            || zipcFileFinish (zf))
+        {
+          evalresp_log (log, EV_ERROR, EV_ERROR, "Failed to write %s to %s: %s", name, filename, zipcError (zc));
+          status = EVALRESP_IO;
+        }
+        else
+        {
+          (*nzipped)++;
+        }
+      }
+      free (name);
+      name = NULL;
+    }
+  }
+  return status;
+}
+
+static int
+zip_close (evalresp_logger *log, zipc_t *zc, const char *filename, int status)
+{
+  if (zipcClose (zc) && !status)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Failed to write to file %s", filename);
+    status = EVALRESP_IO;
+  }
+  return status;
+}
+
+int
+evalresp_responses_to_zip (evalresp_logger *log, const evalresp_responses *responses,
+                           int unwrap, evalresp_output_format format, const char *filename)
+{
+  int status = EVALRESP_OK, nzipped = 0;
+  text_buffer buffer = {NULL, 0, 0, NULL};
+  zipc_t *zc;
+
+  if (!responses || !filename)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Missing responses or ZIP archive name");
+    return EVALRESP_ERR;
+  }
+  if (!(status = zip_open (log, filename, &zc)))
+  {
+    status = zip_responses (log, zc, filename, responses, unwrap, format, &buffer, &nzipped);
+    status = zip_close (log, zc, filename, status);
+  }
+  free (buffer.text);
+  return status;
+}
+
+int
+responses_to_output (evalresp_logger *log, evalresp_options const *options,
+                     const evalresp_responses *responses)
+{
+  if (options->container)
+  {
+    return evalresp_responses_to_container (log, responses, options, options->container);
+  }
+  if (options->zip)
+  {
+    return evalresp_responses_to_zip (log, responses, output_unwrap (options), options->format, options->zip);
+  }
+  return responses_to_cwd (log, responses, output_unwrap (options), options->format, options->use_stdio);
+}
+
+int
+response_writer_open (evalresp_logger *log, evalresp_options const *options, response_writer *writer)
+{
+  int status = EVALRESP_OK;
+
+  memset (writer, 0, sizeof (*writer));
+  writer->options = options;
+  if (options->container)
+  {
+    if (!(writer->kept = calloc (1, sizeof (*writer->kept))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate responses");
+      status = EVALRESP_MEM;
+    }
+  }
+  else if (options->zip)
+  {
+    status = zip_open (log, options->zip, &writer->zip);
+  }
+  return status;
+}
+
+int
+response_writer_write (evalresp_logger *log, response_writer *writer, evalresp_responses *responses)
+{
+  evalresp_options const *options = writer->options;
+  evalresp_response **kept;
+  int n;
+
+  if (writer->kept)
+  {
+    /* the index comes first, so nothing is written until all are known */
+    if (responses->nresponses > 0)
+    {
+      n = writer->kept->nresponses + responses->nresponses;
+      if (!(kept = realloc (writer->kept->responses, n * sizeof (*kept))))
+      {
+        evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate responses");
+        return EVALRESP_MEM;
+      }
+      memcpy (kept + writer->kept->nresponses, responses->responses,
+              responses->nresponses * sizeof (*kept));
+      writer->kept->responses = kept;
+      writer->kept->nresponses = n;
+      responses->nresponses = 0;
+    }
+    return EVALRESP_OK;
+  }
+  if (writer->zip)
+  {
+    return zip_responses (log, writer->zip, options->zip, responses, output_unwrap (options),
+                          options->format, &writer->buffer, &writer->nzipped);
+  }
+  return responses_to_cwd (log, responses, output_unwrap (options), options->format, options->use_stdio);
+}
+
+int
+response_writer_close (evalresp_logger *log, response_writer *writer, int status)
+{
+  if (writer->kept)
+  {
+    if (!status)
+    {
+      status = evalresp_responses_to_container (log, writer->kept, writer->options,
+                                                writer->options->container);
+    }
+    evalresp_free_responses (&writer->kept);
+  }
+  if (writer->zip)
+  {
+    status = zip_close (log, writer->zip, writer->options->zip, status);
+    writer->zip = NULL;
+  }
+  free (writer->buffer.text);
+  writer->buffer.text = NULL;
+  return status;
+}
+
+int
+evalresp_container_to_cwd (evalresp_logger *log, evalresp_options *options, const char *filename)
+{
+  int status, free_options = 0;
+  evalresp_responses *responses = NULL;
+  evalresp_options copy;
+
+  if (!options)
+  {
+    if ((status = evalresp_new_options (log, &options)))
+    {
+      return status;
+    }
+    free_options = 1;
+  }
+
+  if (!(status = evalresp_container_to_responses (log, filename, &responses, NULL)))
+  {
+    /* extract, rather than writing another container */
+    copy = *options;
+    copy.container = NULL;
+    status = responses_to_output (log, &copy, responses);
+  }
+
+  evalresp_free_responses (&responses);
+  if (free_options)
+  {
+    evalresp_free_options (&options);
+  }
+  return status;
+}
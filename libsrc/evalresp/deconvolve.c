@@ -0,0 +1,418 @@
+#include <stdlib.h>
+#include <string.h>
+
+/* NEEDED for M_PI on windows */
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "evalresp/private.h"
+
+/* the inverse filter (and FFT tables) for one transform length.  each
+   block is zero padded to a power of two at least twice its length, so
+   that the circular convolution of the FFT does not wrap around within
+   the block, and blocks of equal length share these. */
+typedef struct spectrum_s
+{
+  int nfft;
+  evalresp_complex *twiddles; /* e^{-2 pi i k / nfft}, k < nfft / 2 */
+  evalresp_complex *inverse;  /* water-levelled, pre-filtered 1 / H, nfft / 2 + 1 bins */
+  evalresp_complex *work;     /* scratch for one transform */
+  struct spectrum_s *next;
+} spectrum;
+
+struct evalresp_deconvolver_s
+{
+  evalresp_plan const *plan;
+  double sample_rate;
+  double water_level;
+  int use_pre_filt;
+  double pre_filt[4];
+  spectrum *spectra;
+  /* streaming: the current block and how much of it is filled */
+  int block;
+  int overlap;
+  double *window;
+  double *deconvolved;
+  int fill;
+  long pending; /* input samples in the window not yet output */
+};
+
+int
+evalresp_new_deconvolver (evalresp_logger *log, evalresp_plan const *plan, double sample_rate,
+                          double water_level, double const *pre_filt, int block, int overlap,
+                          evalresp_deconvolver **deconvolver)
+{
+  int status = EVALRESP_OK;
+
+  *deconvolver = NULL;
+  if (sample_rate <= 0)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Sample rate must be positive");
+    return EVALRESP_INP;
+  }
+  if (pre_filt && !(0 <= pre_filt[0] && pre_filt[0] < pre_filt[1]
+                    && pre_filt[1] <= pre_filt[2] && pre_filt[2] < pre_filt[3]))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Pre-filter corners must increase");
+    return EVALRESP_INP;
+  }
+  if (block < 0 || overlap < 0 || (block && overlap >= block))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Overlap must be smaller than the block");
+    return EVALRESP_INP;
+  }
+  if (!(*deconvolver = calloc (1, sizeof (**deconvolver))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate deconvolver");
+    return EVALRESP_MEM;
+  }
+  (*deconvolver)->plan = plan;
+  (*deconvolver)->sample_rate = sample_rate;
+  (*deconvolver)->water_level = water_level;
+  if (pre_filt)
+  {
+    (*deconvolver)->use_pre_filt = 1;
+    memcpy ((*deconvolver)->pre_filt, pre_filt, sizeof ((*deconvolver)->pre_filt));
+  }
+  (*deconvolver)->block = block;
+  (*deconvolver)->overlap = overlap;
+  if (block)
+  {
+    if ((status = calloc_doubles (log, "deconvolution block", block, &(*deconvolver)->window))
+        || (status = calloc_doubles (log, "deconvolved block", block, &(*deconvolver)->deconvolved)))
+    {
+      evalresp_free_deconvolver (deconvolver);
+    }
+    else
+    {
+      /* the output for the first samples comes from the middle of the
+         first block, as for all the others */
+      (*deconvolver)->fill = overlap / 2;
+    }
+  }
+  return status;
+}
+
+static void
+free_spectrum (spectrum *spec)
+{
+  free (spec->twiddles);
+  free (spec->inverse);
+  free (spec->work);
+  free (spec);
+}
+
+void
+evalresp_free_deconvolver (evalresp_deconvolver **deconvolver)
+{
+  spectrum *spec, *next;
+
+  if (*deconvolver)
+  {
+    for (spec = (*deconvolver)->spectra; spec; spec = next)
+    {
+      next = spec->next;
+      free_spectrum (spec);
+    }
+    free ((*deconvolver)->window);
+    free ((*deconvolver)->deconvolved);
+    free (*deconvolver);
+    *deconvolver = NULL;
+  }
+}
+
+/* in-place radix-2 FFT of nfft (a power of two) values; the inverse is
+   not scaled */
+static void
+fft (evalresp_complex *x, int nfft, evalresp_complex const *twiddles, int inverse)
+{
+  evalresp_complex t, w, u;
+  int i, j, k, len, half, step;
+
+  for (i = 1, j = 0; i < nfft; i++)
+  {
+    for (k = nfft >> 1; j & k; k >>= 1)
+      j ^= k;
+    j |= k;
+    if (i < j)
+    {
+      t = x[i];
+      x[i] = x[j];
+      x[j] = t;
+    }
+  }
+  for (len = 2; len <= nfft; len <<= 1)
+  {
+    half = len >> 1;
+    step = nfft / len;
+    for (i = 0; i < nfft; i += len)
+    {
+      for (k = 0; k < half; k++)
+      {
+        w = twiddles[k * step];
+        if (inverse)
+          w.imag = -w.imag;
+        u = x[i + k];
+        t.real = x[i + k + half].real * w.real - x[i + k + half].imag * w.imag;
+        t.imag = x[i + k + half].real * w.imag + x[i + k + half].imag * w.real;
+        x[i + k].real = u.real + t.real;
+        x[i + k].imag = u.imag + t.imag;
+        x[i + k + half].real = u.real - t.real;
+        x[i + k + half].imag = u.imag - t.imag;
+      }
+    }
+  }
+}
+
+/* the pre-filter: a cosine taper rising from pre_filt[0] to pre_filt[1]
+   and falling from pre_filt[2] to pre_filt[3] */
+static double
+pre_filter (double const *corners, double f)
+{
+  if (f <= corners[0] || f >= corners[3])
+    return 0;
+  if (f < corners[1])
+    return 0.5 * (1 - cos (M_PI * (f - corners[0]) / (corners[1] - corners[0])));
+  if (f > corners[2])
+    return 0.5 * (1 + cos (M_PI * (f - corners[2]) / (corners[3] - corners[2])));
+  return 1;
+}
+
+/* evaluate the response on the bins of the transform and invert it,
+   raising amplitudes below the water level (keeping their phase) */
+static int
+invert_response (evalresp_logger *log, evalresp_deconvolver *deconvolver, spectrum *spec)
+{
+  int status, nbins = spec->nfft / 2 + 1, k;
+  double *freqs = NULL, amp, max_amp = 0, level, f, taper;
+  evalresp_complex h;
+
+  if (!(status = calloc_doubles (log, "deconvolution frequencies", nbins, &freqs)))
+  {
+    for (k = 0; k < nbins; k++)
+    {
+      freqs[k] = k * deconvolver->sample_rate / spec->nfft;
+    }
+    status = evaluate_plan (log, deconvolver->plan, freqs, nbins, spec->inverse);
+  }
+  if (!status)
+  {
+    for (k = 0; k < nbins; k++)
+    {
+      amp = hypot (spec->inverse[k].real, spec->inverse[k].imag);
+      max_amp = amp > max_amp ? amp : max_amp;
+    }
+    level = deconvolver->water_level >= 0 ? max_amp * pow (10, -deconvolver->water_level / 20) : 0;
+    for (k = 0; k < nbins; k++)
+    {
+      f = freqs[k];
+      h = spec->inverse[k];
+      amp = hypot (h.real, h.imag);
+      taper = deconvolver->use_pre_filt ? pre_filter (deconvolver->pre_filt, f) : 1;
+      if (amp < level)
+      {
+        if (amp > 0)
+        {
+          h.real *= level / amp;
+          h.imag *= level / amp;
+        }
+        else
+        {
+          h.real = level;
+          h.imag = 0;
+        }
+        amp = level;
+      }
+      if (amp > 0 && taper > 0)
+      {
+        /* taper / h */
+        spec->inverse[k].real = taper * h.real / (amp * amp);
+        spec->inverse[k].imag = -taper * h.imag / (amp * amp);
+      }
+      else
+      {
+        spec->inverse[k].real = 0;
+        spec->inverse[k].imag = 0;
+      }
+    }
+  }
+  free (freqs);
+  return status;
+}
+
+/* the spectrum for blocks of n samples, calculated once */
+static int
+find_spectrum (evalresp_logger *log, evalresp_deconvolver *deconvolver, int n, spectrum **spec)
+{
+  int status = EVALRESP_OK, nfft, k;
+
+  for (nfft = 2; nfft < 2 * n; nfft <<= 1)
+    ;
+  for (*spec = deconvolver->spectra; *spec && (*spec)->nfft != nfft; *spec = (*spec)->next)
+    ;
+  if (*spec)
+  {
+    return EVALRESP_OK;
+  }
+  if (!(*spec = calloc (1, sizeof (**spec)))
+      || !((*spec)->twiddles = calloc (nfft / 2, sizeof (*(*spec)->twiddles)))
+      || !((*spec)->inverse = calloc (nfft / 2 + 1, sizeof (*(*spec)->inverse)))
+      || !((*spec)->work = calloc (nfft, sizeof (*(*spec)->work))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate deconvolution spectrum");
+    status = EVALRESP_MEM;
+  }
+  else
+  {
+    (*spec)->nfft = nfft;
+    for (k = 0; k < nfft / 2; k++)
+    {
+      (*spec)->twiddles[k].real = cos (2 * M_PI * k / nfft);
+      (*spec)->twiddles[k].imag = -sin (2 * M_PI * k / nfft);
+    }
+    status = invert_response (log, deconvolver, *spec);
+  }
+  if (status)
+  {
+    if (*spec)
+    {
+      free_spectrum (*spec);
+      *spec = NULL;
+    }
+  }
+  else
+  {
+    (*spec)->next = deconvolver->spectra;
+    deconvolver->spectra = *spec;
+  }
+  return status;
+}
+
+int
+evalresp_deconvolve (evalresp_logger *log, evalresp_deconvolver *deconvolver,
+                     double const *input, int n, double *output)
+{
+  spectrum *spec;
+  evalresp_complex *x, y;
+  int status, nfft, k;
+
+  if (n <= 0)
+  {
+    return EVALRESP_OK;
+  }
+  if ((status = find_spectrum (log, deconvolver, n, &spec)))
+  {
+    return status;
+  }
+  nfft = spec->nfft;
+  x = spec->work;
+  for (k = 0; k < n; k++)
+  {
+    x[k].real = input[k];
+    x[k].imag = 0;
+  }
+  memset (x + n, 0, (nfft - n) * sizeof (*x));
+  fft (x, nfft, spec->twiddles, 0);
+  /* multiply the non-negative frequencies by the inverse filter and
+     mirror them, so that the result is real */
+  for (k = 0; k <= nfft / 2; k++)
+  {
+    y.real = x[k].real * spec->inverse[k].real - x[k].imag * spec->inverse[k].imag;
+    y.imag = x[k].real * spec->inverse[k].imag + x[k].imag * spec->inverse[k].real;
+    if (k == 0 || k == nfft / 2)
+    {
+      y.imag = 0;
+    }
+    x[k] = y;
+    if (k > 0 && k < nfft / 2)
+    {
+      x[nfft - k].real = y.real;
+      x[nfft - k].imag = -y.imag;
+    }
+  }
+  fft (x, nfft, spec->twiddles, 1);
+  for (k = 0; k < n; k++)
+  {
+    output[k] = x[k].real / nfft;
+  }
+  return EVALRESP_OK;
+}
+
+/* deconvolve the full window and output the samples between the overlaps
+   (at most max of them), then keep the overlap for the next block */
+static int
+stream_block (evalresp_logger *log, evalresp_deconvolver *deconvolver, int max,
+              double *output, int *nout)
+{
+  int status, left = deconvolver->overlap / 2, hop = deconvolver->block - deconvolver->overlap;
+
+  if (!(status = evalresp_deconvolve (log, deconvolver, deconvolver->window, deconvolver->block,
+                                      deconvolver->deconvolved)))
+  {
+    if (max > hop)
+      max = hop;
+    memcpy (output + *nout, deconvolver->deconvolved + left, max * sizeof (*output));
+    *nout += max;
+    deconvolver->pending -= max;
+    memmove (deconvolver->window, deconvolver->window + hop,
+             deconvolver->overlap * sizeof (*deconvolver->window));
+    deconvolver->fill = deconvolver->overlap;
+  }
+  return status;
+}
+
+int
+evalresp_deconvolve_stream (evalresp_logger *log, evalresp_deconvolver *deconvolver,
+                            double const *input, int n, double *output, int *nout)
+{
+  int status = EVALRESP_OK, copy;
+
+  *nout = 0;
+  if (!deconvolver->block)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Deconvolver has no block size for streaming");
+    return EVALRESP_INP;
+  }
+  while (!status && n > 0)
+  {
+    copy = deconvolver->block - deconvolver->fill;
+    copy = copy < n ? copy : n;
+    memcpy (deconvolver->window + deconvolver->fill, input, copy * sizeof (*input));
+    deconvolver->fill += copy;
+    deconvolver->pending += copy;
+    input += copy;
+    n -= copy;
+    if (deconvolver->fill == deconvolver->block)
+    {
+      status = stream_block (log, deconvolver, deconvolver->block, output, nout);
+    }
+  }
+  return status;
+}
+
+int
+evalresp_deconvolve_flush (evalresp_logger *log, evalresp_deconvolver *deconvolver,
+                           double *output, int *nout)
+{
+  int status = EVALRESP_OK;
+
+  *nout = 0;
+  if (!deconvolver->block)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Deconvolver has no block size for streaming");
+    return EVALRESP_INP;
+  }
+  /* pad with zeros until every sample has been output */
+  while (!status && deconvolver->pending > 0)
+  {
+    memset (deconvolver->window + deconvolver->fill, 0,
+            (deconvolver->block - deconvolver->fill) * sizeof (*deconvolver->window));
+    deconvolver->fill = deconvolver->block;
+    status = stream_block (log, deconvolver, (int)deconvolver->pending, output, nout);
+  }
+  /* ready for a new stream */
+  memset (deconvolver->window, 0, deconvolver->block * sizeof (*deconvolver->window));
+  deconvolver->fill = deconvolver->overlap / 2;
+  deconvolver->pending = 0;
+  return status;
+}
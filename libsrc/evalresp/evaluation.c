@@ -1,6 +1,12 @@
 
+#include <errno.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#ifdef _WIN32
+#include <direct.h>
+#define mkdir(dir, mode) _mkdir (dir)
+#endif
 
 /* NEEDED for M_PI on windows */
 #define _USE_MATH_DEFINES
@@ -10,6 +16,7 @@
 #include "evalresp/constants.h"
 #include "evalresp/public.h"
 #include "evalresp/public_api.h"
+#include "evalresp_log/examples/to_buffer.h"
 #include "evalresp_log/log.h"
 
 // new code as a clean wrapper for calc_resp etc.
@@ -30,6 +37,13 @@ evalresp_new_options (evalresp_logger *log, evalresp_options **options)
     (*options)->max_freq = EVALRESP_NO_FREQ;
     (*options)->nfreq = 1;
     (*options)->unit = evalresp_velocity_unit;
+    (*options)->threads = 1;
+    (*options)->freq_threads = EVALRESP_THREADS_AUTO;
+    (*options)->parallel_nfreq = EVALRESP_PARALLEL_NFREQ;
+    (*options)->simplify_tol = EVALRESP_SIMPLIFY_TOL;
+    (*options)->response_cache_bytes = EVALRESP_RESPONSE_CACHE_BYTES;
+    (*options)->adaptive_max_nfreq = EVALRESP_ADAPTIVE_MAX_NFREQ;
+    (*options)->pipeline_depth = EVALRESP_PIPELINE_DEPTH;
   }
   return status;
 }
@@ -40,6 +54,9 @@ evalresp_free_options (evalresp_options **options)
   if (*options)
   {
     free ((*options)->filename);
+    free ((*options)->response_cache);
+    free ((*options)->container);
+    free ((*options)->zip);
     free (*options);
     *options = NULL;
   }
@@ -105,7 +122,11 @@ parse_option (evalresp_logger *log, const char *name, int noptions, option_pair
 static option_pair formats[] = {
     {evalresp_ap_output_format, "AP"},
     {evalresp_fap_output_format, "FAP"},
-    {evalresp_complex_output_format, "CS"}};
+    {evalresp_complex_output_format, "CS"},
+    {evalresp_raw_fap_output_format, "RAW"},
+    {evalresp_raw_complex_output_format, "RAWCS"},
+    {evalresp_npy_fap_output_format, "NPY"},
+    {evalresp_npy_complex_output_format, "NPYCS"}};
 
 int
 evalresp_set_format (evalresp_logger *log, evalresp_options *options,
@@ -192,6 +213,102 @@ evalresp_set_b62_x (evalresp_logger *log, evalresp_options *options,
   return parse_double (log, "block 62 x value", b62_x, &options->b62_x);
 }
 
+int
+evalresp_set_threads (evalresp_logger *log, evalresp_options *options,
+                      const char *threads)
+{
+  int status;
+  if (!(status = parse_int (log, "number of threads", threads, &options->threads)))
+  {
+    if (options->threads < 0)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Number of threads cannot be negative");
+      status = EVALRESP_INP;
+    }
+  }
+  return status;
+}
+
+int
+evalresp_set_pipeline_depth (evalresp_logger *log, evalresp_options *options,
+                             const char *depth)
+{
+  int status;
+  if (!(status = parse_int (log, "pipeline depth", depth, &options->pipeline_depth)))
+  {
+    if (options->pipeline_depth < 0)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Pipeline depth cannot be negative");
+      status = EVALRESP_INP;
+    }
+  }
+  return status;
+}
+
+int
+evalresp_set_adaptive_tol (evalresp_logger *log, evalresp_options *options,
+                           const char *tol)
+{
+  int status;
+  if (!(status = parse_double (log, "adaptive tolerance", tol, &options->adaptive_tol)))
+  {
+    if (options->adaptive_tol < 0)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Adaptive tolerance cannot be negative");
+      status = EVALRESP_INP;
+    }
+  }
+  return status;
+}
+
+int
+evalresp_set_response_cache (evalresp_logger *log, evalresp_options *options, const char *dir)
+{
+  struct stat buf;
+
+  /* a missing directory is created, so that the first run fills it */
+  if (stat (dir, &buf) && errno == ENOENT && !mkdir (dir, 0777))
+  {
+    evalresp_log (log, EV_INFO, EV_INFO, "Created response cache %s", dir);
+  }
+  else if (stat (dir, &buf) || !(buf.st_mode & S_IFDIR))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Response cache %s is not a directory", dir);
+    return EVALRESP_INP;
+  }
+  free (options->response_cache);
+  if (!(options->response_cache = strdup (dir)))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate response cache name");
+    return EVALRESP_MEM;
+  }
+  return EVALRESP_OK;
+}
+
+static int
+set_output_name (evalresp_logger *log, const char *name, char **field, const char *filename)
+{
+  free (*field);
+  if (!(*field = strdup (filename)))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate %s name", name);
+    return EVALRESP_MEM;
+  }
+  return EVALRESP_OK;
+}
+
+int
+evalresp_set_container (evalresp_logger *log, evalresp_options *options, const char *filename)
+{
+  return set_output_name (log, "container", &options->container, filename);
+}
+
+int
+evalresp_set_zip (evalresp_logger *log, evalresp_options *options, const char *filename)
+{
+  return set_output_name (log, "ZIP archive", &options->zip, filename);
+}
+
 // don't use alloc_response because it does too much
 static int
 local_alloc_response (evalresp_logger *log, evalresp_response **response)
@@ -238,9 +355,8 @@ validate_freqs (evalresp_logger *log, evalresp_options *options)
   return status;
 }
 
-static int
-calculate_default_freqs (evalresp_logger *log, evalresp_options *options,
-                         evalresp_response *response)
+int
+calculate_freqs (evalresp_logger *log, evalresp_options *options, int *nfreqs, double **freqs)
 {
   int status = EVALRESP_OK, i;
   double delta = 0, lo, hi;
@@ -258,34 +374,24 @@ calculate_default_freqs (evalresp_logger *log, evalresp_options *options,
       hi = log10 (options->max_freq);
     }
     delta = options->nfreq == 1 ? 0 : (hi - lo) / (options->nfreq - 1);
-    if (!(status = calloc_doubles (log, "frequencies", options->nfreq, &response->freqs)))
+    if (!(status = calloc_doubles (log, "frequencies", options->nfreq, freqs)))
     {
-      response->nfreqs = options->nfreq;
-      for (i = 0; i < response->nfreqs; ++i)
+      *nfreqs = options->nfreq;
+      for (i = 0; i < *nfreqs; ++i)
       {
-        response->freqs[i] = lo + i * delta;
+        (*freqs)[i] = lo + i * delta;
         if (!options->lin_freq)
         {
-          response->freqs[i] = pow (10, response->freqs[i]);
+          (*freqs)[i] = pow (10, (*freqs)[i]);
         }
       }
     }
   }
-
-  if (!status)
-  {
-    if (!(response->rvec = calloc (response->nfreqs, sizeof (*response->rvec))))
-    {
-      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate complex result");
-      status = EVALRESP_MEM;
-    }
-  }
-
   return status;
 }
 
 static int
-save_doubles (evalresp_logger *log, const char *name, int n, double **dest, double *src)
+save_doubles (evalresp_logger *log, const char *name, int n, double **dest, double const *src)
 {
   int status = EVALRESP_OK, i;
   if (!(status = calloc_doubles (log, name, n, dest)))
@@ -299,34 +405,33 @@ save_doubles (evalresp_logger *log, const char *name, int n, double **dest, doub
 }
 
 static int
-save_b55 (evalresp_logger *log, evalresp_channel *channel,
-          evalresp_blkt **b55_save)
+calculate_default_freqs (evalresp_logger *log, evalresp_options *options,
+                         evalresp_response *response)
 {
   int status = EVALRESP_OK;
-  evalresp_blkt *b55 = channel->first_stage->first_blkt;
-  evalresp_list *list = &b55->blkt_info.list;
-  if (!(*b55_save = calloc (1, sizeof (**b55_save))))
+
+  if (options->freq_grid)
   {
-    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate blockette 55");
-    status = EVALRESP_MEM;
+    if (!(status = save_doubles (log, "frequencies", evalresp_freq_grid_nfreqs (options->freq_grid),
+                                 &response->freqs, evalresp_freq_grid_freqs (options->freq_grid))))
+    {
+      response->nfreqs = evalresp_freq_grid_nfreqs (options->freq_grid);
+    }
   }
   else
   {
-    memcpy (*b55_save, b55, sizeof (*b55));
-    /* interpolation will free the freq, phase and amp arrays, so we must
-     * allocate further copies
-     */
-    if (!(status = save_doubles (log, "b55 frequencies", list->nresp,
-                                 &(*b55_save)->blkt_info.list.freq, list->freq)))
+    status = calculate_freqs (log, options, &response->nfreqs, &response->freqs);
+  }
+
+  if (!status)
+  {
+    if (!(response->rvec = calloc (response->nfreqs, sizeof (*response->rvec))))
     {
-      if (!(status = save_doubles (log, "b55 amplitudes", list->nresp,
-                                   &(*b55_save)->blkt_info.list.amp, list->amp)))
-      {
-        status = save_doubles (log, "b55 phases", list->nresp,
-                               &(*b55_save)->blkt_info.list.phase, list->phase);
-      }
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate complex result");
+      status = EVALRESP_MEM;
     }
   }
+
   return status;
 }
 
@@ -369,23 +474,15 @@ restrict_frequency_range (evalresp_logger *log, double lo, double hi, int *nfreq
   return status;
 }
 
+/* drop the response frequencies outside the list (which is then
+   interpolated to them by the plan) */
 static int
-interpolate_b55 (evalresp_logger *log, evalresp_channel *channel,
-                 evalresp_response *response, evalresp_blkt **b55_save)
+restrict_b55_freqs (evalresp_logger *log, evalresp_channel const *channel,
+                    evalresp_response *response)
 {
-  int status = EVALRESP_OK;
-  evalresp_blkt *b55 = channel->first_stage->first_blkt;
-  evalresp_list *list = &b55->blkt_info.list;
-  if (!(status = save_b55 (log, channel, b55_save)))
-  {
-    if (!(status = restrict_frequency_range (log, list->freq[0], list->freq[list->nresp - 1],
-                                             &response->nfreqs, response->freqs)))
-    {
-      status = interpolate_list_blockette (&list->freq, &list->amp, &list->phase, &list->nresp,
-                                           response->freqs, response->nfreqs, log);
-    }
-  }
-  return status;
+  evalresp_list const *list = &channel->first_stage->first_blkt->blkt_info.list;
+  return restrict_frequency_range (log, list->freq[0], list->freq[list->nresp - 1],
+                                   &response->nfreqs, response->freqs);
 }
 
 static int
@@ -413,19 +510,27 @@ use_b55_freqs (evalresp_logger *log, evalresp_channel *channel,
   return status;
 }
 
-static void
-restore_b55 (evalresp_channel *channel, evalresp_blkt *b55_save)
+/* replace the frequencies of the response with those chosen adaptively,
+   starting from them */
+static int
+adapt_response (evalresp_logger *log, evalresp_plan const *plan, evalresp_options *options,
+                evalresp_response *response)
 {
-  evalresp_blkt *b55 = channel->first_stage->first_blkt;
-  evalresp_list *list = &b55->blkt_info.list;
-  evalresp_list *list_save = &b55_save->blkt_info.list;
-  list->nresp = list_save->nresp;
-  free (list->freq);
-  list->freq = list_save->freq;
-  free (list->amp);
-  list->amp = list_save->amp;
-  free (list->phase);
-  list->phase = list_save->phase;
+  int status, nfreqs;
+  double *freqs;
+  evalresp_complex *values;
+
+  if (!(status = evaluate_plan_adaptive (log, plan, response->freqs, response->nfreqs,
+                                         options->lin_freq, options->adaptive_tol,
+                                         options->adaptive_max_nfreq, &nfreqs, &freqs, &values)))
+  {
+    free (response->freqs);
+    free (response->rvec);
+    response->nfreqs = nfreqs;
+    response->freqs = freqs;
+    response->rvec = values;
+  }
+  return status;
 }
 
 int
@@ -433,7 +538,7 @@ evalresp_channel_to_response (evalresp_logger *log, evalresp_channel *channel,
                               evalresp_options *options, evalresp_response **response)
 {
   int status = EVALRESP_OK, free_options = 0;
-  evalresp_blkt *b55_save = NULL;
+  evalresp_plan *plan = NULL;
 
   /* allow NULL options */
   if (!options)
@@ -450,13 +555,13 @@ evalresp_channel_to_response (evalresp_logger *log, evalresp_channel *channel,
       {
         /* if it's a b55 block then calc_resp is just going to copy its data
          * to the response.  so we need to make sure that frequencies agree
-         * beforehand.  either by interpolating the blockette data (in which
-         * case we keep a backup and restore it below) or by changing the
-         * output frequencies to match.
+         * beforehand.  either by interpolating the blockette data (into a
+         * copy held by the plan, below) or by changing the output
+         * frequencies to match.
          */
         if (options->b55_interpolate)
         {
-          status = interpolate_b55 (log, channel, *response, &b55_save);
+          status = restrict_b55_freqs (log, channel, *response);
         }
         else
         {
@@ -468,31 +573,47 @@ evalresp_channel_to_response (evalresp_logger *log, evalresp_channel *channel,
 
   if (!status)
   {
-    if (!(status = normalize_response (log, options, channel)))
+    if (!(status = evalresp_channel_to_plan (log, channel, options, &plan))
+        && is_block_55 (channel) && options->b55_interpolate)
     {
-      if (!(status = calculate_response (log, options, channel, (*response)->freqs, (*response)->nfreqs, (*response)->rvec)))
+      status = interpolate_plan_lists (log, plan, (*response)->freqs, (*response)->nfreqs);
+    }
+    if (!status)
+    {
+      /* blockette 55 may have changed the frequencies */
+      if (options->adaptive_tol > 0 && !is_block_55 (channel))
+      {
+        status = adapt_response (log, plan, options, *response);
+      }
+      else if (options->freq_grid && !is_block_55 (channel))
+      {
+        status = evaluate_plan_grid (log, plan, options->freq_grid, (*response)->rvec);
+      }
+      else
+      {
+        status = evaluate_plan (log, plan, (*response)->freqs, (*response)->nfreqs, (*response)->rvec);
+      }
+      if (!status)
       {
         strncpy ((*response)->network, channel->network, NETLEN);
         strncpy ((*response)->station, channel->staname, STALEN);
         strncpy ((*response)->locid, channel->locid, LOCIDLEN);
         strncpy ((*response)->channel, channel->chaname, CHALEN);
+        strncpy ((*response)->beg_t, channel->beg_t, DATIMLEN);
+        strncpy ((*response)->end_t, channel->end_t, DATIMLEN);
         if (options->verbose)
         {
-          evalresp_channel_to_log (log, options, channel);
+          log_channel_plan (log, options, channel, plan);
         }
       }
     }
   }
 
-  if (b55_save)
-  {
-    restore_b55 (channel, b55_save);
-  }
+  free_plan (&plan);
   if (free_options)
   {
     evalresp_free_options (&options);
   }
-  free (b55_save);
 
   if (status && *response)
   {
@@ -502,35 +623,336 @@ evalresp_channel_to_response (evalresp_logger *log, evalresp_channel *channel,
   return status;
 }
 
+int
+evalresp_channel_to_plan (evalresp_logger *log, evalresp_channel const *channel,
+                          evalresp_options const *const options, evalresp_plan **plan)
+{
+  return compile_plan (log, options, channel, 1, plan);
+}
+
+int
+evalresp_plan_evaluate (evalresp_logger *log, evalresp_plan const *plan,
+                        double const *freqs, int nfreqs, evalresp_complex *output)
+{
+  return evaluate_plan (log, plan, freqs, nfreqs, output);
+}
+
+int
+evalresp_plan_evaluate_split (evalresp_logger *log, evalresp_plan const *plan,
+                              double const *freqs, int nfreqs, double *real, double *imag)
+{
+  return evaluate_plan_split (log, plan, freqs, nfreqs, real, imag);
+}
+
+int
+evalresp_plan_evaluate_grid (evalresp_logger *log, evalresp_plan const *plan,
+                             evalresp_freq_grid *grid, evalresp_complex *output)
+{
+  return evaluate_plan_grid (log, plan, grid, output);
+}
+
+int
+evalresp_plan_evaluate_adaptive (evalresp_logger *log, evalresp_plan const *plan,
+                                 double const *freqs, int nfreqs, int lin, double tol,
+                                 int max_nfreqs, int *nout, double **freqs_out,
+                                 evalresp_complex **output)
+{
+  return evaluate_plan_adaptive (log, plan, freqs, nfreqs, lin, tol, max_nfreqs,
+                                 nout, freqs_out, output);
+}
+
+int
+evalresp_polynomial_evaluate (evalresp_logger *log, evalresp_blkt const *blkt,
+                              double const *x, int nx, double *value, double *derivative)
+{
+  return evaluate_polynomial (log, blkt, x, nx, value, derivative);
+}
+
+int
+evalresp_plan_evaluate_polynomial (evalresp_logger *log, evalresp_plan const *plan,
+                                   double freq, double const *x, int nx,
+                                   double *value, double *derivative)
+{
+  return evaluate_plan_polynomial (log, plan, freq, x, nx, value, derivative);
+}
+
+void
+evalresp_free_plan (evalresp_plan **plan)
+{
+  free_plan (plan);
+}
+
+/* evaluate channel i into element i of an array of results (responses
+   or sensitivities), or free that element */
+typedef int (*channel_task) (evalresp_logger *log, evalresp_channel *channel,
+                             evalresp_options *options, void *results, int i);
+typedef void (*channel_discard) (void *results, int i);
+
+typedef struct
+{
+  evalresp_channels *channels;
+  evalresp_options *options;
+  channel_task task;
+  void *results;
+  int *status;
+  evalresp_log_buffer *logs;
+} channels_task_data;
+
+/* evaluate channels [begin, end), keeping the log messages of each
+   channel in its own buffer */
+static int
+channels_task (void *arg, int thread, int begin, int end)
+{
+  channels_task_data *data = arg;
+  evalresp_logger log[1];
+  int i;
+
+  for (i = begin; i < end; ++i)
+  {
+    evalresp_log_intialize_log_for_buffer (log, &data->logs[i]);
+    if ((data->status[i] = data->task (log, data->channels->channels[i], data->options,
+                                       data->results, i)))
+    {
+      return data->status[i];
+    }
+  }
+  return EVALRESP_OK;
+}
+
+/* evaluate all channels on several threads, then keep the results (and
+   the log messages) in channel order, up to and including the first
+   channel that failed - the same as would be seen evaluating serially */
+static int
+channels_parallel (evalresp_logger *log, evalresp_channels *channels, evalresp_options *options,
+                   int nthreads, channel_task task, channel_discard discard, void *results,
+                   int *nresults)
+{
+  int status = EVALRESP_OK, i, n = channels->nchannels;
+  channels_task_data data;
+  evalresp_options channel_options;
+
+  /* the threads are already busy with channels, so each channel is
+     evaluated on a single thread */
+  channel_options = *options;
+  channel_options.freq_threads = 1;
+  data.channels = channels;
+  data.options = &channel_options;
+  data.task = task;
+  data.results = results;
+  data.status = calloc (n, sizeof (*data.status));
+  data.logs = calloc (n, sizeof (*data.logs));
+  if (!data.status || !data.logs)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate per-channel status");
+    status = EVALRESP_MEM;
+  }
+  else
+  {
+    (void)run_parallel (log, nthreads, n, 1, channels_task, &data);
+    for (i = 0; i < n; ++i)
+    {
+      if (!status)
+      {
+        evalresp_log_buffer_replay (log, &data.logs[i]);
+        if (!(status = data.status[i]))
+        {
+          (*nresults)++;
+        }
+      }
+      else
+      {
+        discard (results, i);
+      }
+      evalresp_log_buffer_clear (&data.logs[i]);
+    }
+  }
+  free (data.status);
+  free (data.logs);
+  return status;
+}
+
+/* evaluate the channels in order (on options->threads threads) until one
+   fails, counting the results kept */
+static int
+channels_to_results (evalresp_logger *log, evalresp_channels *channels, evalresp_options *options,
+                     channel_task task, channel_discard discard, void *results, int *nresults)
+{
+  int status = EVALRESP_OK, i, nthreads;
+
+  nthreads = options ? parallel_threads (options->threads) : 1;
+  if (nthreads > 1 && channels->nchannels > 1)
+  {
+    status = channels_parallel (log, channels, options, nthreads, task, discard, results, nresults);
+  }
+  else
+  {
+    for (i = 0; !status && i < channels->nchannels; ++i)
+    {
+      if (!(status = task (log, channels->channels[i], options, results, i)))
+      {
+        (*nresults)++;
+      }
+    }
+  }
+  return status;
+}
+
+static int
+response_task (evalresp_logger *log, evalresp_channel *channel, evalresp_options *options,
+               void *results, int i)
+{
+  return evalresp_channel_to_response (log, channel, options, &((evalresp_response **)results)[i]);
+}
+
+static void
+response_discard (void *results, int i)
+{
+  evalresp_free_response (&((evalresp_response **)results)[i]);
+}
+
 int
 evalresp_channels_to_responses (evalresp_logger *log, evalresp_channels *channels,
                                 evalresp_options *options, evalresp_responses **responses)
 {
-  int status = EVALRESP_OK, i;
+  int status = EVALRESP_OK;
+  evalresp_response **array;
+  evalresp_options grid_options;
+  evalresp_freq_grid *grid = NULL;
+
   if (!*responses && !(*responses = calloc (1, sizeof (**responses))))
   {
     evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate responses");
     status = EVALRESP_MEM;
   }
-  else
+  else if (channels->nchannels > 0)
   {
-    for (i = 0; !status && i < channels->nchannels; ++i)
+    if (!(array = realloc ((*responses)->responses,
+                           ((*responses)->nresponses + channels->nchannels) * sizeof (*array))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate array for new responses");
+      status = EVALRESP_MEM;
+    }
+    else
     {
-      evalresp_response *response = NULL;
-      if (!(status = evalresp_channel_to_response (log, channels->channels[i], options, &response)))
+      (*responses)->responses = array;
+      memset (array + (*responses)->nresponses, 0, channels->nchannels * sizeof (*array));
+      /* calculate the frequencies (and their tables) once for all channels */
+      if (options && !options->freq_grid && !(options->adaptive_tol > 0) && channels->nchannels > 1
+          && !(status = evalresp_new_freq_grid (log, options, &grid)))
       {
-        (*responses)->nresponses++;
-        if (!((*responses)->responses = realloc ((*responses)->responses, (*responses)->nresponses * sizeof (*(*responses)->responses))))
-        {
-          evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate array for new response");
-          status = EVALRESP_MEM;
-        }
-        else
-        {
-          (*responses)->responses[(*responses)->nresponses - 1] = response;
-        }
+        grid_options = *options;
+        grid_options.freq_grid = grid;
+        options = &grid_options;
+      }
+      if (!status)
+      {
+        status = channels_to_results (log, channels, options, response_task, response_discard,
+                                      array + (*responses)->nresponses, &(*responses)->nresponses);
+      }
+      evalresp_free_freq_grid (&grid);
+    }
+  }
+  return status;
+}
+
+int
+evalresp_channel_to_sensitivity (evalresp_logger *log, evalresp_channel const *channel,
+                                 evalresp_options const *options, evalresp_sensitivity **sensitivity)
+{
+  int status = EVALRESP_OK, i;
+  evalresp_options *default_options = NULL;
+  evalresp_plan *plan = NULL;
+
+  *sensitivity = NULL;
+  /* allow NULL options */
+  if (!options && !(status = evalresp_new_options (log, &default_options)))
+  {
+    options = default_options;
+  }
+  /* normalizing the plan calculates the sensitivity; nothing is evaluated
+     at other frequencies */
+  if (!status && !(status = compile_plan (log, options, channel, 1, &plan)))
+  {
+    if (!(*sensitivity = calloc (1, sizeof (**sensitivity)))
+        || !((*sensitivity)->stages = calloc (plan->ngains ? plan->ngains : 1, sizeof (int)))
+        || !((*sensitivity)->gains = calloc (plan->ngains ? plan->ngains : 1, sizeof (double))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate sensitivity");
+      status = EVALRESP_MEM;
+    }
+    else
+    {
+      strncpy ((*sensitivity)->network, channel->network, NETLEN);
+      strncpy ((*sensitivity)->station, channel->staname, STALEN);
+      strncpy ((*sensitivity)->locid, channel->locid, LOCIDLEN);
+      strncpy ((*sensitivity)->channel, channel->chaname, CHALEN);
+      strncpy ((*sensitivity)->beg_t, channel->beg_t, DATIMLEN);
+      strncpy ((*sensitivity)->end_t, channel->end_t, DATIMLEN);
+      (*sensitivity)->sensit = plan->sensit;
+      (*sensitivity)->sensfreq = plan->sensfreq;
+      (*sensitivity)->calc_sensit = plan->calc_sensit;
+      if (plan->sensit != 0.0)
+      {
+        (*sensitivity)->percent_diff = 100.0 * fabs ((plan->sensit - plan->calc_sensit) / plan->sensit);
+      }
+      (*sensitivity)->ngains = plan->ngains;
+      for (i = 0; i < plan->ngains; ++i)
+      {
+        (*sensitivity)->stages[i] = plan->gains[i].sequence_no;
+        (*sensitivity)->gains[i] = plan->gains[i].gain;
       }
     }
   }
+  free_plan (&plan);
+  evalresp_free_options (&default_options);
+  if (status)
+  {
+    evalresp_free_sensitivity (sensitivity);
+  }
+  return status;
+}
+
+static int
+sensitivity_task (evalresp_logger *log, evalresp_channel *channel, evalresp_options *options,
+                  void *results, int i)
+{
+  return evalresp_channel_to_sensitivity (log, channel, options, &((evalresp_sensitivity **)results)[i]);
+}
+
+static void
+sensitivity_discard (void *results, int i)
+{
+  evalresp_free_sensitivity (&((evalresp_sensitivity **)results)[i]);
+}
+
+int
+evalresp_channels_to_sensitivities (evalresp_logger *log, evalresp_channels *channels,
+                                    evalresp_options *options, evalresp_sensitivities **sensitivities)
+{
+  int status = EVALRESP_OK;
+  evalresp_sensitivity **array;
+
+  if (!*sensitivities && !(*sensitivities = calloc (1, sizeof (**sensitivities))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate sensitivities");
+    status = EVALRESP_MEM;
+  }
+  else if (channels->nchannels > 0)
+  {
+    if (!(array = realloc ((*sensitivities)->sensitivities,
+                           ((*sensitivities)->nsensitivities + channels->nchannels) * sizeof (*array))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate array for new sensitivities");
+      status = EVALRESP_MEM;
+    }
+    else
+    {
+      (*sensitivities)->sensitivities = array;
+      memset (array + (*sensitivities)->nsensitivities, 0, channels->nchannels * sizeof (*array));
+      status = channels_to_results (log, channels, options, sensitivity_task, sensitivity_discard,
+                                    array + (*sensitivities)->nsensitivities,
+                                    &(*sensitivities)->nsensitivities);
+    }
+  }
   return status;
 }
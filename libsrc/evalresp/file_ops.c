@@ -46,19 +46,28 @@
 // TODO - change mode to enum
 struct matched_files *
 find_files (char *file, evalresp_sncls *scn_lst,
-            int *mode, evalresp_logger *log)
+            int *mode, evalresp_catalog *catalog, evalresp_logger *log)
 {
   char *basedir, testdir[MAXLINELEN];
   char comp_name[MAXLINELEN], new_name[MAXLINELEN];
   int i, nscn, nfiles, loc_wild;
   struct matched_files *flst_head, *flst_ptr, *tmp_ptr;
   evalresp_sncl *scn_ptr;
+  evalresp_catalog *own_catalog = NULL;
   struct stat buf;
 
   /* first determine the number of station-channel-networks to look at */
 
   nscn = scn_lst->nscn;
 
+  /* read each directory once, even without a catalog from the caller */
+
+  if (!catalog && !evalresp_new_catalog (log, NULL, &own_catalog))
+  {
+    catalog = own_catalog;
+  }
+  catalog_check (catalog);
+
   /* allocate space for the first element of the file pointer linked list */
 
   flst_head = alloc_matched_files (log);
@@ -89,7 +98,7 @@ find_files (char *file, evalresp_sncls *scn_lst,
                  scn_ptr->network, scn_ptr->station,
                  loc_wild ? "*" : scn_ptr->locid,
                  scn_ptr->channel);
-        nfiles = get_names (comp_name, flst_ptr, log);
+        nfiles = catalog_names (log, catalog, comp_name, flst_ptr);
         if (!nfiles && !loc_wild)
         {
           evalresp_log (log, EV_WARN, EV_WARN, "no files match '%s'",
@@ -101,7 +110,7 @@ find_files (char *file, evalresp_sncls *scn_lst,
           sprintf (comp_name, "%s/RESP.%s.%s.%s", file,
                    scn_ptr->network, scn_ptr->station,
                    scn_ptr->channel);
-          nfiles = get_names (comp_name, flst_ptr, log);
+          nfiles = catalog_names (log, catalog, comp_name, flst_ptr);
           if (!nfiles)
           {
             evalresp_log (log, EV_WARN, EV_WARN,
@@ -120,29 +129,32 @@ find_files (char *file, evalresp_sncls *scn_lst,
   }
   else
   {
+    /* if the current directory is not the same as the SEEDRESP
+       directory (and the SEEDRESP directory exists) add it to the
+       search path */
+    if ((basedir = (char *)getenv ("SEEDRESP")) != NULL)
+    {
+      (void)getcwd (testdir, MAXLINELEN);
+      if (stat (basedir, &buf) || !S_ISDIR (buf.st_mode) || !strcmp (testdir, basedir))
+      {
+        basedir = NULL;
+      }
+    }
     for (i = 0; i < nscn; i++)
     { /* for each station-channel-net in list */
       scn_ptr = scn_lst->scn_vec[i];
       memset (comp_name, 0, MAXLINELEN);
       sprintf (comp_name, "./RESP.%s.%s.%s.%s", scn_ptr->network,
                scn_ptr->station, scn_ptr->locid, scn_ptr->channel);
-      if ((basedir = (char *)getenv ("SEEDRESP")) != NULL)
+      if (basedir != NULL)
       {
-        /* if the current directory is not the same as the SEEDRESP
-                 directory (and the SEEDRESP directory exists) add it to the
-                 search path */
-        stat (basedir, &buf);
-        (void)getcwd (testdir, MAXLINELEN);
-        if (S_ISDIR (buf.st_mode) && strcmp (testdir, basedir))
-        {
-          memset (new_name, 0, MAXLINELEN);
-          sprintf (new_name, " %s/RESP.%s.%s.%s.%s", basedir,
-                   scn_ptr->network, scn_ptr->station, scn_ptr->locid,
-                   scn_ptr->channel);
-          strcat (comp_name, new_name);
-        }
+        memset (new_name, 0, MAXLINELEN);
+        sprintf (new_name, " %s/RESP.%s.%s.%s.%s", basedir,
+                 scn_ptr->network, scn_ptr->station, scn_ptr->locid,
+                 scn_ptr->channel);
+        strcat (comp_name, new_name);
       }
-      nfiles = get_names (comp_name, flst_ptr, log);
+      nfiles = catalog_names (log, catalog, comp_name, flst_ptr);
       if (!nfiles && strcmp (scn_ptr->locid, "*"))
       {
         evalresp_log (log, EV_WARN, EV_WARN, "no files match '%s'",
@@ -155,18 +167,13 @@ find_files (char *file, evalresp_sncls *scn_lst,
                  scn_ptr->station, scn_ptr->channel);
         if (basedir != NULL)
         {
-          stat (basedir, &buf);
-          (void)getcwd (testdir, MAXLINELEN);
-          if (S_ISDIR (buf.st_mode) && strcmp (testdir, basedir))
-          {
-            memset (new_name, 0, MAXLINELEN);
-            sprintf (new_name, " %s/RESP.%s.%s.%s", basedir,
-                     scn_ptr->network, scn_ptr->station,
-                     scn_ptr->channel);
-            strcat (comp_name, new_name);
-          }
+          memset (new_name, 0, MAXLINELEN);
+          sprintf (new_name, " %s/RESP.%s.%s.%s", basedir,
+                   scn_ptr->network, scn_ptr->station,
+                   scn_ptr->channel);
+          strcat (comp_name, new_name);
         }
-        nfiles = get_names (comp_name, flst_ptr, log);
+        nfiles = catalog_names (log, catalog, comp_name, flst_ptr);
         if (!nfiles)
         {
           evalresp_log (log, EV_WARN, EV_WARN, "no files match '%s'",
@@ -179,6 +186,8 @@ find_files (char *file, evalresp_sncls *scn_lst,
     }
   }
 
+  evalresp_free_catalog (&own_catalog);
+
   /* return the pointer to the head of the linked list, which is null
      if no files were found that match request */
 
@@ -199,6 +208,7 @@ get_names (char *in_file, struct matched_files *files, evalresp_logger *log)
   int rv;
   char *first_infile = NULL;
   char *second_infile = NULL;
+  char *save = NULL;
 
   /* IGD 05/30/2013: in_file can contain one token (pathname with possible widlcards)
      * or two tokens pathname + default pathname pointed by SEEDRESP environmental variable.
@@ -206,12 +216,12 @@ get_names (char *in_file, struct matched_files *files, evalresp_logger *log)
      * function
      */
 
-  first_infile = strtok (in_file, " "); /*IGD 05/30/2013 Assumed to be always present */
+  first_infile = strtok_r (in_file, " ", &save); /*IGD 05/30/2013 Assumed to be always present */
 
   /* Search for matching file names */
   if ((rv = glob (first_infile, 0, NULL, &globs)))
   {
-    second_infile = strtok (NULL, " ");
+    second_infile = strtok_r (NULL, " ", &save);
     if (!second_infile)
     {
       if (GLOB_NOMATCH != rv)
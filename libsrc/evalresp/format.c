@@ -0,0 +1,206 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "evalresp/private.h"
+
+/* the powers of ten that are exact in double precision */
+static const double exact_tens[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+#define MAX_EXACT_TEN 22
+
+/* the value scaled by one (correctly rounded) multiplication or division
+   by an exact power of ten, so that it is within 1e7 * 2^-53 of the true
+   product, or -1 if the power is not exact */
+static double
+scale_ten (double mag, int k)
+{
+  if (k > MAX_EXACT_TEN || k < -MAX_EXACT_TEN)
+    return -1;
+  return k >= 0 ? mag * exact_tens[k] : mag / exact_tens[-k];
+}
+
+int
+format_e6 (double value, char *out)
+{
+  double mag, scaled, whole, frac;
+  long digits = 0;
+  int exponent, tries, i, n = 0, found = 0;
+  char exp_digits[4];
+
+  if (value == 0)
+  {
+    return _evalresp_snprintf (out, FORMAT_E6_SIZE, signbit (value) ? "-0.000000E+00" : "0.000000E+00");
+  }
+  if (!isfinite (value))
+  {
+    return _evalresp_snprintf (out, FORMAT_E6_SIZE, "%.6E", value);
+  }
+
+  /* seven significant digits: find the exponent for which the rounded
+     value is in [1e6, 1e7), correcting the estimate from log10() */
+  mag = fabs (value);
+  exponent = (int)floor (log10 (mag));
+  for (tries = 0; tries < 3 && !found; tries++)
+  {
+    if ((scaled = scale_ten (mag, 6 - exponent)) < 0)
+      break;
+    whole = floor (scaled);
+    frac = scaled - whole;
+    /* too close to a tie for the scaled value to decide the rounding */
+    if (fabs (frac - 0.5) < 1e-6)
+      break;
+    digits = (long)whole + (frac > 0.5);
+    if (digits >= 10000000L)
+      exponent++;
+    else if (digits < 1000000L)
+      exponent--;
+    else
+      found = 1;
+  }
+  if (!found)
+  {
+    return _evalresp_snprintf (out, FORMAT_E6_SIZE, "%.6E", value);
+  }
+
+  if (value < 0)
+    out[n++] = '-';
+  out[n + 7] = '0' + digits % 10;
+  for (i = 6; i > 1; i--)
+  {
+    digits /= 10;
+    out[n + i] = '0' + digits % 10;
+  }
+  digits /= 10;
+  out[n + 1] = '.';
+  out[n] = '0' + digits;
+  n += 8;
+  out[n++] = 'E';
+  out[n++] = exponent < 0 ? '-' : '+';
+  exponent = abs (exponent);
+  for (i = 0; i == 0 || exponent; i++)
+  {
+    exp_digits[i] = '0' + exponent % 10;
+    exponent /= 10;
+  }
+  if (i < 2)
+    exp_digits[i++] = '0';
+  while (i)
+    out[n++] = exp_digits[--i];
+  out[n] = '\0';
+  return n;
+}
+
+void
+put_le (unsigned char *out, uint64_t value, int nbytes)
+{
+  int i;
+  for (i = 0; i < nbytes; i++, value >>= 8)
+  {
+    out[i] = value & 0xff;
+  }
+}
+
+void
+put_le_double (unsigned char *out, double value)
+{
+  uint64_t bits;
+  memcpy (&bits, &value, sizeof (bits));
+  put_le (out, bits, sizeof (bits));
+}
+
+uint64_t
+get_le (const unsigned char *bytes, int nbytes)
+{
+  uint64_t value = 0;
+  while (nbytes--)
+  {
+    value = (value << 8) | bytes[nbytes];
+  }
+  return value;
+}
+
+double
+get_le_double (const unsigned char *bytes)
+{
+  uint64_t bits = get_le (bytes, sizeof (bits));
+  double value;
+  memcpy (&value, &bits, sizeof (value));
+  return value;
+}
+
+int
+text_buffer_reserve (evalresp_logger *log, text_buffer *buffer, size_t n)
+{
+  char *text;
+  size_t size;
+
+  if (buffer->len + n <= buffer->size)
+    return EVALRESP_OK;
+  if (buffer->file && buffer->len)
+  {
+    if (fwrite (buffer->text, 1, buffer->len, buffer->file) != buffer->len)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Failed to write to file");
+      return EVALRESP_IO;
+    }
+    buffer->len = 0;
+    if (n <= buffer->size)
+      return EVALRESP_OK;
+  }
+  for (size = buffer->size ? buffer->size : TEXT_BUFFER_SIZE; size < buffer->len + n; size *= 2)
+    ;
+  if (!(text = realloc (buffer->text, size)))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate output");
+    return EVALRESP_MEM;
+  }
+  buffer->text = text;
+  buffer->size = size;
+  return EVALRESP_OK;
+}
+
+int
+text_buffer_append (evalresp_logger *log, text_buffer *buffer, const char *text, size_t n)
+{
+  int status;
+
+  if (!(status = text_buffer_reserve (log, buffer, n)))
+  {
+    memcpy (buffer->text + buffer->len, text, n);
+    buffer->len += n;
+  }
+  return status;
+}
+
+int
+text_buffer_append_e6 (evalresp_logger *log, text_buffer *buffer, double value)
+{
+  int status;
+
+  if (!(status = text_buffer_reserve (log, buffer, FORMAT_E6_SIZE)))
+  {
+    buffer->len += format_e6 (value, buffer->text + buffer->len);
+  }
+  return status;
+}
+
+int
+text_buffer_flush (evalresp_logger *log, text_buffer *buffer)
+{
+  if (buffer->file)
+  {
+    /* pass everything on, so that a reader (of a pipe) sees it now */
+    if ((buffer->len && fwrite (buffer->text, 1, buffer->len, buffer->file) != buffer->len)
+        || fflush (buffer->file))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Failed to write to file");
+      return EVALRESP_IO;
+    }
+    buffer->len = 0;
+  }
+  return EVALRESP_OK;
+}
@@ -0,0 +1,173 @@
+#include <stdlib.h>
+#include <string.h>
+
+/* NEEDED for M_PI on windows */
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#include "evalresp/private.h"
+
+/* e^{-i omega dt} at each frequency of the grid, for one dt */
+typedef struct grid_phasors_s
+{
+  double dt;
+  evalresp_complex *values;
+  struct grid_phasors_s *next;
+} grid_phasors;
+
+/* the tables are only added to (under the mutex) and never change once
+   made, so they can be read from any thread */
+struct evalresp_freq_grid_s
+{
+  int nfreqs;
+  double *freqs;
+  double *omega;
+  uint64_t hash;
+  evalresp_mutex *mutex;
+  grid_phasors *phasors;
+};
+
+/* take ownership of freqs and fill in the derived values */
+static int
+new_grid (evalresp_logger *log, double *freqs, int nfreqs, evalresp_freq_grid **grid)
+{
+  int status = EVALRESP_OK, i;
+
+  if (!(*grid = calloc (1, sizeof (**grid))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate frequency grid");
+    free (freqs);
+    return EVALRESP_MEM;
+  }
+  (*grid)->nfreqs = nfreqs;
+  (*grid)->freqs = freqs;
+  if (!(status = calloc_doubles (log, "angular frequencies", nfreqs ? nfreqs : 1, &(*grid)->omega)))
+  {
+    for (i = 0; i < nfreqs; i++)
+    {
+      (*grid)->omega[i] = 2 * M_PI * freqs[i];
+    }
+    (*grid)->hash = stage_cache_hash (freqs, nfreqs * sizeof (*freqs), EVALRESP_HASH_INIT);
+    status = mutex_new (log, &(*grid)->mutex);
+  }
+  if (status)
+  {
+    evalresp_free_freq_grid (grid);
+  }
+  return status;
+}
+
+int
+evalresp_new_freq_grid (evalresp_logger *log, evalresp_options *options,
+                        evalresp_freq_grid **grid)
+{
+  int status = EVALRESP_OK, nfreqs;
+  double *freqs = NULL;
+
+  *grid = NULL;
+  if (!(status = calculate_freqs (log, options, &nfreqs, &freqs)))
+  {
+    status = new_grid (log, freqs, nfreqs, grid);
+  }
+  return status;
+}
+
+int
+evalresp_new_freq_grid_from_array (evalresp_logger *log, double const *freqs, int nfreqs,
+                                   evalresp_freq_grid **grid)
+{
+  int status = EVALRESP_OK;
+  double *copy = NULL;
+
+  *grid = NULL;
+  if (nfreqs < 0)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot have a negative number of frequency bins");
+    status = EVALRESP_INP;
+  }
+  else if (!(status = calloc_doubles (log, "frequencies", nfreqs ? nfreqs : 1, &copy)))
+  {
+    memcpy (copy, freqs, nfreqs * sizeof (*copy));
+    status = new_grid (log, copy, nfreqs, grid);
+  }
+  return status;
+}
+
+int
+evalresp_freq_grid_nfreqs (evalresp_freq_grid const *grid)
+{
+  return grid->nfreqs;
+}
+
+double const *
+evalresp_freq_grid_freqs (evalresp_freq_grid const *grid)
+{
+  return grid->freqs;
+}
+
+void
+evalresp_free_freq_grid (evalresp_freq_grid **grid)
+{
+  grid_phasors *phasors, *next;
+
+  if (*grid)
+  {
+    for (phasors = (*grid)->phasors; phasors; phasors = next)
+    {
+      next = phasors->next;
+      free (phasors->values);
+      free (phasors);
+    }
+    free ((*grid)->freqs);
+    free ((*grid)->omega);
+    mutex_free (&(*grid)->mutex);
+    free (*grid);
+    *grid = NULL;
+  }
+}
+
+double const *
+freq_grid_omega (evalresp_freq_grid const *grid)
+{
+  return grid->omega;
+}
+
+uint64_t
+freq_grid_hash (evalresp_freq_grid const *grid)
+{
+  return grid->hash;
+}
+
+evalresp_complex const *
+freq_grid_phasors (evalresp_freq_grid *grid, double dt)
+{
+  grid_phasors *phasors;
+  double theta;
+  int i;
+
+  mutex_lock (grid->mutex);
+  for (phasors = grid->phasors; phasors && phasors->dt != dt; phasors = phasors->next)
+    ;
+  if (!phasors && (phasors = calloc (1, sizeof (*phasors))))
+  {
+    if (!(phasors->values = malloc ((grid->nfreqs ? grid->nfreqs : 1) * sizeof (*phasors->values))))
+    {
+      free (phasors);
+      phasors = NULL;
+    }
+    else
+    {
+      phasors->dt = dt;
+      for (i = 0; i < grid->nfreqs; i++)
+      {
+        theta = grid->omega[i] * dt;
+        phasors->values[i].real = cos (theta);
+        phasors->values[i].imag = -sin (theta);
+      }
+      phasors->next = grid->phasors;
+      grid->phasors = phasors;
+    }
+  }
+  mutex_unlock (grid->mutex);
+  return phasors ? phasors->values : NULL;
+}
@@ -7,13 +7,18 @@
 #include "evalresp/constants.h"
 #include "evalresp/public.h"
 #include "evalresp/public_api.h"
+#include "evalresp_log/examples/to_buffer.h"
 #include "evalresp_log/log.h"
 
 // new code giving a high level interface.
 
-static char *prefixes[] = {"FAP", "AMP", "PHASE", "SPECTRA", "AMP/PHS"};
+/* indexed by evalresp_file_format */
+static char *prefixes[] = {"FAP", "AMP", "PHASE", "SPECTRA", "FAP", "SPECTRA", "FAP", "SPECTRA"};
+static char *suffixes[] = {"", "", "", "", ".raw", ".raw", ".npy", ".npy"};
 
-#define FILENAME_TEMPLATE "%s.%s.%s.%s.%s"
+#define STDIO_FAP_PREFIX "AMP/PHS"
+
+#define FILENAME_TEMPLATE "%s.%s.%s.%s.%s%s"
 
 /* IGD This function is needed for MS Windows VS2013 and below */
 
@@ -33,24 +38,40 @@ _evalresp_snprintf (char *buffer,       /* I - Output buffer */
   return (bytes);
 }
 
-static int
-print_file (evalresp_logger *log, int unwrap, evalresp_file_format format,
-            int use_stdio, const evalresp_response *response)
+int
+response_filename (evalresp_logger *log, const evalresp_response *response,
+                   evalresp_file_format format, int use_stdio, char **filename)
 {
-  int status = EVALRESP_OK, length;
-  char *filename = NULL, *prefix = prefixes[(use_stdio && (format == evalresp_fap_file_format)) ? 4 : format];
-  length = _evalresp_snprintf (filename, 0, FILENAME_TEMPLATE, prefix,
-                               response->network, response->station, response->locid, response->channel);
-  if (!(filename = calloc (length + 1, sizeof (*filename))))
+  int length;
+  char *prefix = (use_stdio && (format == evalresp_fap_file_format)) ? STDIO_FAP_PREFIX : prefixes[format];
+  length = _evalresp_snprintf (NULL, 0, FILENAME_TEMPLATE, prefix,
+                               response->network, response->station, response->locid, response->channel,
+                               suffixes[format]);
+  if (!(*filename = calloc (length + 1, sizeof (**filename))))
   {
     evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate filename");
-    status = EVALRESP_MEM;
+    return EVALRESP_MEM;
   }
-  else
+  (void)_evalresp_snprintf (*filename, length + 1, FILENAME_TEMPLATE, prefix,
+                            response->network, response->station, response->locid, response->channel,
+                            suffixes[format]);
+  return EVALRESP_OK;
+}
+
+static int
+print_file (evalresp_logger *log, int unwrap, evalresp_file_format format,
+            int use_stdio, const evalresp_response *response)
+{
+  int status = EVALRESP_OK;
+  char *filename = NULL;
+  if (!(status = response_filename (log, response, format, use_stdio, &filename)))
   {
-    (void)_evalresp_snprintf (filename, length + 1, FILENAME_TEMPLATE, prefix,
-                              response->network, response->station, response->locid, response->channel);
-    if (use_stdio)
+    if (use_stdio && is_binary_file_format (format))
+    {
+      /* no banner - each response is self-describing and follows the last */
+      status = evalresp_response_to_stream (log, response, unwrap, format, stdout);
+    }
+    else if (use_stdio)
     {
       fprintf (stdout, " --------------------------------------------------\n");
       fprintf (stdout, " %s\n", filename);
@@ -68,36 +89,81 @@ print_file (evalresp_logger *log, int unwrap, evalresp_file_format format,
   return status;
 }
 
+int
+output_file_formats (evalresp_output_format format, evalresp_file_format *file_formats)
+{
+  switch (format)
+  {
+  case evalresp_ap_output_format:
+    file_formats[0] = evalresp_amplitude_file_format;
+    file_formats[1] = evalresp_phase_file_format;
+    return 2;
+  case evalresp_fap_output_format:
+    file_formats[0] = evalresp_fap_file_format;
+    return 1;
+  case evalresp_complex_output_format:
+    file_formats[0] = evalresp_complex_file_format;
+    return 1;
+  case evalresp_raw_fap_output_format:
+    file_formats[0] = evalresp_raw_fap_file_format;
+    return 1;
+  case evalresp_raw_complex_output_format:
+    file_formats[0] = evalresp_raw_complex_file_format;
+    return 1;
+  case evalresp_npy_fap_output_format:
+    file_formats[0] = evalresp_npy_fap_file_format;
+    return 1;
+  case evalresp_npy_complex_output_format:
+    file_formats[0] = evalresp_npy_complex_file_format;
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+int
+output_unwrap (evalresp_options const *options)
+{
+  /* Traditionally, FAP is always unwrapped (and so are the binary FAP files). */
+  return options->unwrap_phase || options->format == evalresp_fap_output_format
+         || options->format == evalresp_raw_fap_output_format
+         || options->format == evalresp_npy_fap_output_format;
+}
+
 int
 responses_to_cwd (evalresp_logger *log, const evalresp_responses *responses,
                   int unwrap, evalresp_output_format format, int use_stdio)
 {
-  int status = EVALRESP_OK, i;
+  int status = EVALRESP_OK, i, j, nfiles;
+  evalresp_file_format file_formats[EVALRESP_MAX_OUTPUT_FILES];
 
+  nfiles = output_file_formats (format, file_formats);
   for (i = 0; !status && i < responses->nresponses; ++i)
   {
-    switch (format)
+    for (j = 0; !status && j < nfiles; ++j)
     {
-    case evalresp_fap_output_format:
-      status = print_file (log, unwrap, evalresp_fap_file_format, use_stdio, responses->responses[i]);
-      break;
-    case evalresp_ap_output_format:
-      if (!(status = print_file (log, unwrap, evalresp_amplitude_file_format, use_stdio, responses->responses[i])))
-      {
-        status = print_file (log, unwrap, evalresp_phase_file_format, use_stdio, responses->responses[i]);
-      }
-      break;
-    case evalresp_complex_output_format:
-      status = print_file (log, unwrap, evalresp_complex_file_format, use_stdio, responses->responses[i]);
-      break;
+      status = print_file (log, unwrap, file_formats[j], use_stdio, responses->responses[i]);
     }
   }
 
   return status;
 }
 
+// evaluate the channels, or only check their sensitivities
+static int
+process_channels (evalresp_logger *log, evalresp_options *options, evalresp_channels *channels,
+                  evalresp_responses **responses, evalresp_sensitivities **sensitivities)
+{
+  if (options->sensitivity_only && sensitivities)
+  {
+    return evalresp_channels_to_sensitivities (log, channels, options, sensitivities);
+  }
+  return evalresp_channels_to_responses (log, channels, options, responses);
+}
+
 int
-process_stdio (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter, evalresp_responses **responses)
+process_stdio (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter,
+               evalresp_responses **responses, evalresp_sensitivities **sensitivities)
 {
   int status = EVALRESP_OK;
   evalresp_channels *channels;
@@ -108,7 +174,7 @@ process_stdio (evalresp_logger *log, evalresp_options *options, evalresp_filter
   }
   if (!(status = evalresp_file_to_channels (log, stdin, options, filter, &channels)))
   {
-    status = evalresp_channels_to_responses (log, channels, options, responses);
+    status = process_channels (log, options, channels, responses, sensitivities);
   }
   evalresp_free_channels (&channels);
 
@@ -117,14 +183,44 @@ process_stdio (evalresp_logger *log, evalresp_options *options, evalresp_filter
 
 // process a single named file
 static int
-process_file (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter, const char *filename, evalresp_responses **responses)
+process_file (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter, const char *filename,
+              evalresp_responses **responses, evalresp_sensitivities **sensitivities)
 {
-  int status = EVALRESP_OK;
+  int status = EVALRESP_OK, cached = 0, hit = 0, first = 0;
   evalresp_channels *channels = NULL;
+  response_cache_key key;
 
-  if (!(status = evalresp_filename_to_channels (log, filename, options, filter, &channels)))
+  /* responses saved by an earlier run are used without parsing the file */
+  if (options->response_cache && !(options->sensitivity_only && sensitivities)
+      && !response_cache_key_file (filename, options, filter, &key))
+  {
+    cached = 1;
+    first = *responses ? (*responses)->nresponses : 0;
+    status = response_cache_load (log, options->response_cache, &key, responses, &hit);
+    if (hit && options->verbose)
+    {
+      evalresp_log (log, EV_INFO, 0, "Using %d cached responses for %s",
+                    (*responses)->nresponses - first, filename);
+    }
+  }
+  if (!status && !hit)
   {
-    status = evalresp_channels_to_responses (log, channels, options, responses);
+    if (options->inventory_cache)
+    {
+      status = inventory_cache_channels (log, options->inventory_cache, filename, options, filter, &channels);
+    }
+    else
+    {
+      status = evalresp_filename_to_channels (log, filename, options, filter, &channels);
+    }
+    if (!status)
+    {
+      status = process_channels (log, options, channels, responses, sensitivities);
+    }
+    if (!status && cached)
+    {
+      response_cache_save (log, options->response_cache, &key, *responses, first);
+    }
   }
   evalresp_free_channels (&channels);
   return status;
@@ -136,67 +232,544 @@ add_sncl (evalresp_logger *log, evalresp_filter *filter, evalresp_sncl *sncl)
   return evalresp_add_sncl_text (log, filter, sncl->network, sncl->station, sncl->locid, sncl->channel);
 }
 
+/* a file found for an sncl, in the order found */
+typedef struct
+{
+  const char *name;
+  int sncl;
+  int order;
+} cwd_match;
+
+/* the matches for one file, matches[start, start + n) once sorted by name */
+typedef struct
+{
+  int order; /* of the first match */
+  int start;
+  int n;
+} cwd_group;
+
+/* the input files, each once, with the filter to use for each */
+typedef struct
+{
+  int nfiles;
+  const char **filenames;
+  evalresp_filter **filters;
+  evalresp_filter *shared; /* the filter for files found for every sncl */
+} cwd_plan;
+
+static int
+compare_match_names (const void *a, const void *b)
+{
+  const cwd_match *x = a, *y = b;
+  int cmp = strcmp (x->name, y->name);
+  return cmp ? cmp : x->order - y->order;
+}
+
 static int
-process_cwd_files (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter, struct matched_files *files, evalresp_responses **responses)
+compare_group_orders (const void *a, const void *b)
 {
-  int status = EVALRESP_OK, i;
-  struct matched_files *files_for_sncls;
+  return ((const cwd_group *)a)->order - ((const cwd_group *)b)->order;
+}
+
+static void
+free_cwd_plan (cwd_plan *plan)
+{
+  int i;
+
+  for (i = 0; plan->filters && i < plan->nfiles; i++)
+  {
+    if (plan->filters[i] && plan->filters[i] != plan->shared)
+    {
+      plan->filters[i]->datetime = NULL; // don't free this as shared
+      evalresp_free_filter (&plan->filters[i]);
+    }
+  }
+  free (plan->filters);
+  free (plan->filenames);
+  memset (plan, 0, sizeof (*plan));
+}
+
+/* a filter for the sncls that found a file (matches[0, n), in order) */
+static int
+plan_filter (evalresp_logger *log, evalresp_filter *filter, const cwd_match *matches, int n,
+             evalresp_filter **file_filter)
+{
+  int status = EVALRESP_OK, i, nsncls = 0;
+
+  for (i = 0; i < n; i++)
+  {
+    nsncls += !i || matches[i].sncl != matches[i - 1].sncl;
+  }
+  if (nsncls == filter->sncls->nscn)
+  {
+    *file_filter = filter;
+    return EVALRESP_OK;
+  }
+  if (!(status = evalresp_new_filter (log, file_filter)))
+  {
+    (*file_filter)->datetime = filter->datetime; // shared
+    for (i = 0; !status && i < n; i++)
+    {
+      if (!i || matches[i].sncl != matches[i - 1].sncl)
+      {
+        status = add_sncl (log, *file_filter, filter->sncls->scn_vec[matches[i].sncl]);
+      }
+    }
+  }
+  return status;
+}
+
+// the files found by find_files(), for all the sncls, each of which is
+// read once (in the order first found) with a filter for the sncls that
+// found it
+static int
+plan_cwd_files (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter,
+                struct matched_files *files, int mode, cwd_plan *plan)
+{
+  int status = EVALRESP_OK, i, j, n = 0, ngroups = 0;
+  struct matched_files *files_for_sncl;
   struct file_list *file;
+  cwd_match *matches = NULL;
+  cwd_group *groups = NULL;
 
-  for (i = 0, files_for_sncls = files;
-       !status && i < filter->sncls->nscn;
-       ++i, files_for_sncls = files_for_sncls->ptr_next)
+  memset (plan, 0, sizeof (*plan));
+  plan->shared = filter;
+  if (!mode)
+  {
+    n = 1;
+  }
+  else
   {
-    // if i understand correctly, then we need to use a separate
-    // filter for each sncl
-    evalresp_sncl *sncl = filter->sncls->scn_vec[i];
-    evalresp_filter *sncl_filter = NULL;
-    if (!(status = evalresp_new_filter (log, &sncl_filter)))
+    for (i = 0, files_for_sncl = files; files_for_sncl && i < filter->sncls->nscn;
+         ++i, files_for_sncl = files_for_sncl->ptr_next)
     {
-      sncl_filter->datetime = filter->datetime; // shared
-      if (!(status = add_sncl (log, sncl_filter, sncl)))
+      for (file = files_for_sncl->first_list; file; file = file->next_file)
       {
-        file = files->first_list;
-        while (!status && file)
-        {
-          status = process_file (log, options, filter, file->name, responses);
-          file = file->next_file;
-        }
+        n++;
+      }
+    }
+  }
+  if (!(plan->filenames = calloc (n + 1, sizeof (*plan->filenames)))
+      || !(plan->filters = calloc (n + 1, sizeof (*plan->filters)))
+      || !(matches = calloc (n + 1, sizeof (*matches)))
+      || !(groups = calloc (n + 1, sizeof (*groups))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate file list");
+    status = EVALRESP_MEM;
+  }
+  else if (!mode)
+  {
+    plan->filenames[0] = options->filename;
+    plan->filters[0] = filter;
+    plan->nfiles = 1;
+  }
+  else
+  {
+    for (i = 0, n = 0, files_for_sncl = files; files_for_sncl && i < filter->sncls->nscn;
+         ++i, files_for_sncl = files_for_sncl->ptr_next)
+    {
+      for (file = files_for_sncl->first_list; file; file = file->next_file, n++)
+      {
+        matches[n].name = file->name;
+        matches[n].sncl = i;
+        matches[n].order = n;
       }
-      sncl_filter->datetime = NULL; // don't free this as shared
-      evalresp_free_filter (&sncl_filter);
     }
+    /* group the matches for each file, then keep the files in the order
+       they were first found */
+    qsort (matches, n, sizeof (*matches), compare_match_names);
+    for (i = 0; i < n; i = j)
+    {
+      for (j = i + 1; j < n && !strcmp (matches[i].name, matches[j].name); j++)
+        ;
+      groups[ngroups].order = matches[i].order;
+      groups[ngroups].start = i;
+      groups[ngroups++].n = j - i;
+    }
+    qsort (groups, ngroups, sizeof (*groups), compare_group_orders);
+    for (i = 0; !status && i < ngroups; i++)
+    {
+      plan->filenames[i] = matches[groups[i].start].name;
+      status = plan_filter (log, filter, &matches[groups[i].start], groups[i].n, &plan->filters[i]);
+      plan->nfiles = i + 1;
+    }
+  }
+  free (matches);
+  free (groups);
+  if (status)
+  {
+    free_cwd_plan (plan);
+  }
+  return status;
+}
+
+static int
+process_cwd_files (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter, struct matched_files *files,
+                   evalresp_responses **responses, evalresp_sensitivities **sensitivities)
+{
+  int status = EVALRESP_OK, i;
+  cwd_plan plan;
+
+  if (!(status = plan_cwd_files (log, options, filter, files, 1, &plan)))
+  {
+    for (i = 0; !status && i < plan.nfiles; i++)
+    {
+      status = process_file (log, options, plan.filters[i], plan.filenames[i], responses, sensitivities);
+    }
+    free_cwd_plan (&plan);
   }
   return status;
 }
 
 int
 process_cwd (evalresp_logger *log, evalresp_options *options,
-             evalresp_filter *filter, evalresp_responses **responses)
+             evalresp_filter *filter, evalresp_responses **responses,
+             evalresp_sensitivities **sensitivities)
 {
   int status = EVALRESP_OK, mode;
   struct matched_files *files = NULL;
 
-  files = find_files (options->filename, filter->sncls, &mode, log);
+  files = find_files (options->filename, filter->sncls, &mode, options->catalog, log);
   switch (mode)
   {
   case 0:
-    status = process_file (log, options, filter, options->filename, responses);
+    status = process_file (log, options, filter, options->filename, responses, sensitivities);
     break;
   default:
     // TODO - do we need to handle other modes?
-    status = process_cwd_files (log, options, filter, files, responses);
+    status = process_cwd_files (log, options, filter, files, responses, sensitivities);
     break;
   }
   free_matched_files (files);
   return status;
 }
 
+/* the steps taken by each input file in process_cwd_pipelined() */
+enum
+{
+  CWD_READ,
+  CWD_PARSE,
+  CWD_EVALUATE,
+  CWD_WRITE,
+  CWD_NSTAGES
+};
+
+/* an input file on its way through the pipeline */
+typedef struct
+{
+  const char *filename;
+  evalresp_filter *filter;
+  response_cache_key key;
+  int cached;                    /* key is set (the response cache is used) */
+  int hit;                       /* responses were loaded from the cache */
+  char *seed;                    /* contents, once read */
+  evalresp_channels *channels;   /* channels, once parsed */
+  evalresp_responses *responses; /* responses, once evaluated (or loaded) */
+  evalresp_logger log;           /* messages are kept until the file is written */
+  evalresp_log_buffer logs;
+} cwd_slot;
+
+typedef struct
+{
+  evalresp_logger *log; /* used by the last stage only */
+  evalresp_options *options;
+  cwd_plan plan;
+  cwd_slot *slots;
+  int nslots;
+  evalresp_mutex *cache_mutex; /* the cache is read and written by different stages */
+  response_writer writer;
+} cwd_pipeline;
+
+static void
+free_cwd_slot (cwd_slot *slot)
+{
+  free (slot->seed);
+  slot->seed = NULL;
+  evalresp_free_channels (&slot->channels);
+  evalresp_free_responses (&slot->responses);
+  evalresp_log_buffer_clear (&slot->logs);
+}
+
+static int
+cwd_read (cwd_pipeline *pipeline, cwd_slot *slot)
+{
+  evalresp_options *options = pipeline->options;
+  int status = EVALRESP_OK;
+
+  /* responses saved by an earlier run are used without parsing the file */
+  if (options->response_cache
+      && !response_cache_key_file (slot->filename, options, slot->filter, &slot->key))
+  {
+    slot->cached = 1;
+    mutex_lock (pipeline->cache_mutex);
+    status = response_cache_load (&slot->log, options->response_cache, &slot->key, &slot->responses, &slot->hit);
+    mutex_unlock (pipeline->cache_mutex);
+    if (slot->hit && options->verbose)
+    {
+      evalresp_log (&slot->log, EV_INFO, 0, "Using %d cached responses for %s",
+                    slot->responses->nresponses, slot->filename);
+    }
+  }
+  /* with an inventory cache the file is only read if it must be parsed */
+  if (!status && !slot->hit && !options->inventory_cache)
+  {
+    status = filename_to_char (&slot->log, slot->filename, options, &slot->seed);
+  }
+  return status;
+}
+
+static int
+cwd_evaluate (cwd_pipeline *pipeline, cwd_slot *slot)
+{
+  evalresp_options *options = pipeline->options;
+  int status;
+
+  status = evalresp_channels_to_responses (&slot->log, slot->channels, options, &slot->responses);
+  evalresp_free_channels (&slot->channels);
+  if (!status && slot->cached)
+  {
+    mutex_lock (pipeline->cache_mutex);
+    response_cache_save (&slot->log, options->response_cache, &slot->key, slot->responses, 0);
+    mutex_unlock (pipeline->cache_mutex);
+  }
+  return status;
+}
+
+static int
+cwd_task (void *arg, int stage, int item)
+{
+  cwd_pipeline *pipeline = arg;
+  cwd_slot *slot = &pipeline->slots[item % pipeline->nslots];
+  int status = EVALRESP_OK;
+
+  switch (stage)
+  {
+  case CWD_READ:
+    memset (slot, 0, sizeof (*slot));
+    slot->filename = pipeline->plan.filenames[item];
+    slot->filter = pipeline->plan.filters[item];
+    evalresp_log_intialize_log_for_buffer (&slot->log, &slot->logs);
+    status = cwd_read (pipeline, slot);
+    break;
+  case CWD_PARSE:
+    if (!slot->hit && pipeline->options->inventory_cache)
+    {
+      status = inventory_cache_channels (&slot->log, pipeline->options->inventory_cache, slot->filename,
+                                         pipeline->options, slot->filter, &slot->channels);
+    }
+    else if (!slot->hit)
+    {
+      status = evalresp_char_to_channels (&slot->log, slot->seed, pipeline->options, slot->filter,
+                                          &slot->channels);
+      free (slot->seed);
+      slot->seed = NULL;
+    }
+    break;
+  case CWD_EVALUATE:
+    if (!slot->hit)
+    {
+      status = cwd_evaluate (pipeline, slot);
+    }
+    break;
+  case CWD_WRITE:
+    evalresp_log_buffer_replay (pipeline->log, &slot->logs);
+    status = response_writer_write (pipeline->log, &pipeline->writer, slot->responses);
+    free_cwd_slot (slot);
+    break;
+  }
+  return status;
+}
+
+// read, parse, evaluate and write the files found by find_files(), each
+// step on its own thread, with options->pipeline_depth files held at once
+static int
+process_cwd_pipelined (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter)
+{
+  int status = EVALRESP_OK, mode, i, failed;
+  struct matched_files *files = NULL;
+  cwd_pipeline pipeline;
+
+  memset (&pipeline, 0, sizeof (pipeline));
+  pipeline.log = log;
+  pipeline.options = options;
+  pipeline.nslots = options->pipeline_depth > 1 ? options->pipeline_depth : 1;
+
+  files = find_files (options->filename, filter->sncls, &mode, options->catalog, log);
+  if (!(status = plan_cwd_files (log, options, filter, files, mode, &pipeline.plan)))
+  {
+    if (!(pipeline.slots = calloc (pipeline.nslots, sizeof (*pipeline.slots))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate pipeline");
+      status = EVALRESP_MEM;
+    }
+  }
+  if (!status && !(status = mutex_new (log, &pipeline.cache_mutex))
+      && !(status = response_writer_open (log, options, &pipeline.writer)))
+  {
+    status = run_pipeline (log, CWD_NSTAGES, pipeline.plan.nfiles, options->pipeline_depth, cwd_task,
+                           &pipeline, &failed);
+    if (status)
+    {
+      /* a file that failed before it was written still holds its messages */
+      evalresp_log_buffer_replay (log, &pipeline.slots[failed % pipeline.nslots].logs);
+    }
+    status = response_writer_close (log, &pipeline.writer, status);
+  }
+  if (pipeline.slots)
+  {
+    for (i = 0; i < pipeline.nslots; i++)
+    {
+      free_cwd_slot (&pipeline.slots[i]);
+    }
+  }
+  free (pipeline.slots);
+  free_cwd_plan (&pipeline.plan);
+  mutex_free (&pipeline.cache_mutex);
+  free_matched_files (files);
+  return status;
+}
+
+/* one request of evalresp_batch_to_cwd(), from evaluation to output */
+typedef struct
+{
+  evalresp_responses *responses;
+  evalresp_sensitivities *sensitivities;
+  evalresp_logger log; /* messages are kept until the request is written */
+  evalresp_log_buffer logs;
+  int status;
+} batch_request;
+
+typedef struct
+{
+  evalresp_logger *log; /* used by the in-order calls only */
+  evalresp_options **options;
+  evalresp_filter **filters;
+  batch_request *requests;
+  int *statuses;
+  int threads;
+} batch_state;
+
+static int
+batch_evaluate (evalresp_options *options, evalresp_filter *filter, int threads, batch_request *request)
+{
+  evalresp_options request_options;
+
+  evalresp_log_intialize_log_for_buffer (&request->log, &request->logs);
+  if (options->use_stdio)
+  {
+    /* stdin and stdout are shared by all the requests */
+    evalresp_log (&request->log, EV_ERROR, EV_ERROR, "Cannot use stdio for a request in a batch");
+    return EVALRESP_INP;
+  }
+  if (options->verbose)
+  {
+    evalresp_log (&request->log, EV_INFO, 0, "<< EVALRESP RESPONSE OUTPUT V%s >>", REVNUM);
+  }
+  if (threads != 1)
+  {
+    /* the threads are already busy with requests, so each response is
+       evaluated on a single thread */
+    request_options = *options;
+    request_options.freq_threads = 1;
+    options = &request_options;
+  }
+  return process_cwd (&request->log, options, filter, &request->responses, &request->sensitivities);
+}
+
+static int
+batch_write (evalresp_logger *log, evalresp_options *options, batch_request *request)
+{
+  int status = request->status;
+  response_writer writer;
+
+  evalresp_log_buffer_replay (log, &request->logs);
+  if (!status && options->sensitivity_only)
+  {
+    status = evalresp_sensitivities_to_stream (log, request->sensitivities, stdout);
+  }
+  /* a request whose files matched no channel has no responses */
+  else if (!status && request->responses
+           && !(status = response_writer_open (log, options, &writer)))
+  {
+    status = response_writer_write (log, &writer, request->responses);
+    status = response_writer_close (log, &writer, status);
+  }
+  evalresp_free_responses (&request->responses);
+  evalresp_free_sensitivities (&request->sensitivities);
+  evalresp_log_buffer_clear (&request->logs);
+  return status;
+}
+
+static int
+batch_task (void *arg, int thread, int item, int in_order)
+{
+  batch_state *batch = arg;
+  batch_request *request = &batch->requests[item];
+
+  (void)thread;
+  if (!in_order)
+  {
+    return request->status = batch_evaluate (batch->options[item], batch->filters[item], batch->threads, request);
+  }
+  request->status = batch_write (batch->log, batch->options[item], request);
+  if (batch->statuses)
+  {
+    batch->statuses[item] = request->status;
+  }
+  return request->status;
+}
+
+int
+evalresp_batch_to_cwd (evalresp_logger *log, int n, evalresp_options **options,
+                       evalresp_filter **filter, int threads, int *statuses)
+{
+  int status, failed, i, j;
+  batch_state batch;
+
+  batch.log = log;
+  batch.options = options;
+  batch.filters = filter;
+  batch.statuses = statuses;
+  batch.threads = threads;
+  if (n < 1)
+  {
+    return EVALRESP_OK;
+  }
+  if (!(batch.requests = calloc (n, sizeof (*batch.requests))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate batch");
+    return EVALRESP_MEM;
+  }
+  status = run_ordered (log, threads, n, batch_task, &batch, &failed);
+  free (batch.requests);
+
+  /* each cache directory is trimmed once, for the whole batch */
+  for (i = 0; i < n; i++)
+  {
+    if (options[i]->response_cache)
+    {
+      for (j = 0; j < i; j++)
+      {
+        if (options[j]->response_cache && !strcmp (options[j]->response_cache, options[i]->response_cache))
+        {
+          break;
+        }
+      }
+      if (j == i)
+      {
+        response_cache_evict (log, options[i]->response_cache, options[i]->response_cache_bytes);
+      }
+    }
+  }
+  return status;
+}
+
 int
 evalresp_cwd_to_cwd (evalresp_logger *log, evalresp_options *options, evalresp_filter *filter)
 {
   int status, free_options = 0;
   evalresp_responses *responses = NULL;
+  evalresp_sensitivities *sensitivities = NULL;
 
   /* allow NULL options */
   if (!options)
@@ -211,22 +784,34 @@ evalresp_cwd_to_cwd (evalresp_logger *log, evalresp_options *options, evalresp_f
   }
   if (options->use_stdio)
   {
-    status = process_stdio (log, options, filter, &responses);
+    status = process_stdio (log, options, filter, &responses, &sensitivities);
+  }
+  else if (options->sensitivity_only)
+  {
+    status = process_cwd (log, options, filter, &responses, &sensitivities);
   }
   else
   {
-    status = process_cwd (log, options, filter, &responses);
+    /* each file is written as soon as it is evaluated */
+    status = process_cwd_pipelined (log, options, filter);
   }
 
-  if (!status)
+  if (!status && options->sensitivity_only)
+  {
+    status = evalresp_sensitivities_to_stream (log, sensitivities, stdout);
+  }
+  else if (!status && options->use_stdio)
+  {
+    status = responses_to_output (log, options, responses);
+  }
+  /* the cache directory is read once per run to trim it to its size */
+  if (options->response_cache)
   {
-    /* Traditionally, FAP is always unwrapped. */
-    status = responses_to_cwd (log, responses,
-                               options->unwrap_phase || options->format == evalresp_fap_output_format,
-                               options->format, options->use_stdio);
+    response_cache_evict (log, options->response_cache, options->response_cache_bytes);
   }
 
   evalresp_free_responses (&responses);
+  evalresp_free_sensitivities (&sensitivities);
   if (free_options)
   {
     evalresp_free_options (&options);
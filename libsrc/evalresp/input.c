@@ -2279,6 +2279,10 @@ read_channel_data (evalresp_logger *log, evalresp_options const *const options,
     }
   }
 
+  /* the unit strings of the last blockette (eg a blockette 62 with no gain
+     after it) belong to the stage now */
+  tmp_stage->input_units_str = NULL;
+  tmp_stage->output_units_str = NULL;
   free_stages (tmp_stage);
 
   return (status && status != EVALRESP_EOF) ? status : (first_field ? EVALRESP_OK : EVALRESP_PAR);
@@ -2738,6 +2742,44 @@ evalresp_char_to_channels (evalresp_logger *log, const char *seed_or_xml,
   return status;
 }
 
+int
+select_channels (evalresp_logger *log, const evalresp_channels *all_channels,
+                 const evalresp_filter *filter, evalresp_channels **channels)
+{
+  int status = EVALRESP_OK, i;
+  evalresp_channels *copies = NULL;
+  evalresp_channel *copy;
+
+  /* filter_channels() changes the channels it is given, so works on copies
+     of those that can match */
+  *channels = NULL;
+  if (!(status = evalresp_alloc_channels (log, &copies)))
+  {
+    for (i = 0; !status && i < all_channels->nchannels; i++)
+    {
+      if (all_channels->channels[i]
+          && (!filter || channel_matches (log, filter, all_channels->channels[i]))
+          && !(status = copy_channel (log, all_channels->channels[i], &copy))
+          && (status = add_channel (log, copy, copies)))
+      {
+        evalresp_free_channel (&copy);
+      }
+    }
+  }
+  if (!status)
+  {
+    status = filter_channels (log, filter, copies, channels);
+  }
+
+  evalresp_free_channels (&copies);
+  if (status)
+  {
+    evalresp_free_channels (channels);
+  }
+
+  return status;
+}
+
 int
 evalresp_file_to_channels (evalresp_logger *log, FILE *file,
                            evalresp_options const *const options,
@@ -2782,13 +2824,14 @@ evalresp_file_detect_stationxml (evalresp_logger *log, FILE *file)
 }
 
 int
-evalresp_filename_to_channels (evalresp_logger *log, const char *filename, evalresp_options const *const options,
-                               const evalresp_filter *filter, evalresp_channels **channels)
+filename_to_char (evalresp_logger *log, const char *filename, evalresp_options const *const options,
+                  char **seed)
 {
   FILE *file = NULL;
   int status = EVALRESP_OK;
   int station_xml = options != NULL ? options->station_xml : 0;
 
+  *seed = NULL;
   if (!(status = open_file (log, filename, &file)))
   {
     FILE *temp_file = NULL;
@@ -2817,7 +2860,7 @@ evalresp_filename_to_channels (evalresp_logger *log, const char *filename, evalr
     }
     if (EVALRESP_OK == status)
     {
-      status = evalresp_file_to_channels (log, file, options, filter, channels);
+      status = file_to_char (log, file, seed);
     }
   }
   if (file)
@@ -2827,6 +2870,20 @@ evalresp_filename_to_channels (evalresp_logger *log, const char *filename, evalr
   return status;
 }
 
+int
+evalresp_filename_to_channels (evalresp_logger *log, const char *filename, evalresp_options const *const options,
+                               const evalresp_filter *filter, evalresp_channels **channels)
+{
+  char *seed = NULL;
+  int status = EVALRESP_OK;
+  if (!(status = filename_to_char (log, filename, options, &seed)))
+  {
+    status = evalresp_char_to_channels (log, seed, options, filter, channels);
+  }
+  free (seed);
+  return status;
+}
+
 int
 evalresp_new_filter (evalresp_logger *log, evalresp_filter **filter)
 {
@@ -0,0 +1,256 @@
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#include "evalresp/private.h"
+#include "evalresp_log/examples/to_buffer.h"
+
+/* the channels parsed from a file, with the messages logged while it was
+   read and parsed (which are logged again each time it is used).  entries
+   are in a list ordered by last use (most recent first); entries in use
+   (refs > 0) are never evicted */
+typedef struct inventory_entry_s inventory_entry;
+
+struct inventory_entry_s
+{
+  uint64_t hash;
+  char *filename;
+  off_t size;      /* the file is parsed again if it changes */
+  time_t mtime;
+  int station_xml; /* options that affect parsing */
+  int file_unit;
+  evalresp_channels *channels;
+  evalresp_log_buffer logs;
+  size_t bytes;
+  int refs;
+  inventory_entry *newer;
+  inventory_entry *older;
+};
+
+struct evalresp_inventory_cache_s
+{
+  evalresp_mutex *mutex;
+  size_t max_bytes;
+  size_t bytes;
+  inventory_entry *newest;
+  inventory_entry *oldest;
+};
+
+int
+evalresp_new_inventory_cache (evalresp_logger *log, size_t max_bytes,
+                              evalresp_inventory_cache **cache)
+{
+  int status = EVALRESP_OK;
+
+  if (!(*cache = calloc (1, sizeof (**cache))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate inventory cache");
+    status = EVALRESP_MEM;
+  }
+  else
+  {
+    (*cache)->max_bytes = max_bytes;
+    status = mutex_new (log, &(*cache)->mutex);
+  }
+  if (status)
+  {
+    evalresp_free_inventory_cache (cache);
+  }
+  return status;
+}
+
+static void
+free_entry (inventory_entry *entry)
+{
+  if (entry)
+  {
+    free (entry->filename);
+    evalresp_free_channels (&entry->channels);
+    evalresp_log_buffer_clear (&entry->logs);
+    free (entry);
+  }
+}
+
+void
+evalresp_free_inventory_cache (evalresp_inventory_cache **cache)
+{
+  inventory_entry *entry, *older;
+
+  if (*cache)
+  {
+    for (entry = (*cache)->newest; entry; entry = older)
+    {
+      older = entry->older;
+      free_entry (entry);
+    }
+    mutex_free (&(*cache)->mutex);
+    free (*cache);
+    *cache = NULL;
+  }
+}
+
+/* the following are called with the mutex held */
+
+static void
+unlink_lru (evalresp_inventory_cache *cache, inventory_entry *entry)
+{
+  if (entry->newer)
+    entry->newer->older = entry->older;
+  else
+    cache->newest = entry->older;
+  if (entry->older)
+    entry->older->newer = entry->newer;
+  else
+    cache->oldest = entry->newer;
+  entry->newer = entry->older = NULL;
+}
+
+static void
+link_newest (evalresp_inventory_cache *cache, inventory_entry *entry)
+{
+  entry->older = cache->newest;
+  entry->newer = NULL;
+  if (cache->newest)
+    cache->newest->newer = entry;
+  else
+    cache->oldest = entry;
+  cache->newest = entry;
+}
+
+static inventory_entry *
+find_entry (evalresp_inventory_cache *cache, const inventory_entry *key)
+{
+  inventory_entry *entry;
+
+  for (entry = cache->newest; entry; entry = entry->older)
+  {
+    if (entry->hash == key->hash && entry->size == key->size && entry->mtime == key->mtime
+        && entry->station_xml == key->station_xml && entry->file_unit == key->file_unit
+        && !strcmp (entry->filename, key->filename))
+    {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+/* remove the least recently used entries not in use until within
+   max_bytes */
+static void
+evict (evalresp_inventory_cache *cache)
+{
+  inventory_entry *entry, *newer;
+
+  for (entry = cache->oldest; entry && cache->bytes > cache->max_bytes; entry = newer)
+  {
+    newer = entry->newer;
+    if (!entry->refs)
+    {
+      unlink_lru (cache, entry);
+      cache->bytes -= entry->bytes;
+      free_entry (entry);
+    }
+  }
+}
+
+/* the end of the functions called with the mutex held */
+
+/* read and parse a file into a new entry (not yet in the cache) */
+static int
+parse_entry (evalresp_options const *options, inventory_entry *entry)
+{
+  evalresp_logger log;
+  char *seed = NULL;
+  int status;
+
+  evalresp_log_intialize_log_for_buffer (&log, &entry->logs);
+  if (!(status = filename_to_char (&log, entry->filename, options, &seed)))
+  {
+    entry->bytes = strlen (seed);
+    status = collect_channels (&log, seed, options, &entry->channels);
+  }
+  free (seed);
+  return status;
+}
+
+int
+inventory_cache_channels (evalresp_logger *log, evalresp_inventory_cache *cache,
+                          const char *filename, evalresp_options const *options,
+                          const evalresp_filter *filter, evalresp_channels **channels)
+{
+  inventory_entry key, *entry, *found;
+  struct stat buf;
+  int status = EVALRESP_OK;
+
+  if (stat (filename, &buf))
+  {
+    /* reported by the usual route */
+    return evalresp_filename_to_channels (log, filename, options, filter, channels);
+  }
+
+  memset (&key, 0, sizeof (key));
+  key.hash = stage_cache_hash (filename, strlen (filename), EVALRESP_HASH_INIT);
+  key.filename = (char *)filename;
+  key.size = buf.st_size;
+  key.mtime = buf.st_mtime;
+  key.station_xml = options->station_xml;
+  key.file_unit = options->unit == evalresp_file_unit;
+
+  mutex_lock (cache->mutex);
+  if ((entry = find_entry (cache, &key)))
+  {
+    entry->refs++;
+    unlink_lru (cache, entry);
+    link_newest (cache, entry);
+  }
+  mutex_unlock (cache->mutex);
+
+  if (!entry)
+  {
+    /* parsed without the lock, so another thread may parse the same file;
+       then the first entry added is kept */
+    if (!(entry = calloc (1, sizeof (*entry))) || !(entry->filename = strdup (filename)))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate inventory cache entry");
+      free (entry);
+      return EVALRESP_MEM;
+    }
+    entry->hash = key.hash;
+    entry->size = key.size;
+    entry->mtime = key.mtime;
+    entry->station_xml = key.station_xml;
+    entry->file_unit = key.file_unit;
+    if ((status = parse_entry (options, entry)))
+    {
+      evalresp_log_buffer_replay (log, &entry->logs);
+      free_entry (entry);
+      return status;
+    }
+    mutex_lock (cache->mutex);
+    if ((found = find_entry (cache, &key)))
+    {
+      free_entry (entry);
+      entry = found;
+      unlink_lru (cache, entry);
+    }
+    else
+    {
+      cache->bytes += entry->bytes;
+    }
+    entry->refs++;
+    link_newest (cache, entry);
+    mutex_unlock (cache->mutex);
+  }
+
+  /* the parsed channels are not changed, so several threads can select
+     from them at once */
+  evalresp_log_buffer_replay (log, &entry->logs);
+  status = select_channels (log, entry->channels, filter, channels);
+
+  mutex_lock (cache->mutex);
+  entry->refs--;
+  evict (cache);
+  mutex_unlock (cache->mutex);
+  return status;
+}
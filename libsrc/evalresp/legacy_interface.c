@@ -225,11 +225,11 @@ evresp_itp (char *stalst, char *chalst, char *net_code,
   /*Call to new evresp */
   if (options->use_stdio)
   {
-    process_stdio (log, options, filter, &responses);
+    process_stdio (log, options, filter, &responses, NULL);
   }
   else
   {
-    process_cwd (log, options, filter, &responses);
+    process_cwd (log, options, filter, &responses, NULL);
   }
 
   if (responses)
@@ -9,138 +9,264 @@
 #include "./private.h"
 #include "evalresp/public_api.h"
 
-int
-evalresp_response_to_char (evalresp_logger *log, const evalresp_response *response,
-                           int unwrap, evalresp_file_format format, char **output)
+/* the amplitude of a response point */
+static double
+point_amplitude (const evalresp_complex *value)
 {
-  int status = EVALRESP_OK;
-  int num_of_points = 0;
-  int i, length, offset;
-  double added_value = 0, prev_phase = 0;
-  double *amp_arr = NULL;
-  double *pha_arr = NULL;
-  double *freq_arr = NULL;
-
-  if (*output)
-  {
-    /* don't want to get bad memory location to write to
-       or we don't want to zombify stuff */
-    evalresp_log (log, EV_ERROR, EV_ERROR, "cannot out put to an already allocated output");
-    return EVALRESP_ERR;
-  }
+  return sqrt (value->real * value->real + value->imag * value->imag);
+}
 
-  if (!response)
+/* the phase (degrees) of point i of a response, called for each point in
+   turn so that the phase can be unwrapped */
+static double
+point_phase (const evalresp_complex *value, int i, int unwrap,
+             double *added_value, double *prev_phase)
+{
+  double pha = atan2 (value->imag, value->real + 1.e-200) * 180.0 / M_PI;
+  if (unwrap)
   {
-    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot Process Empty Response");
-    return EVALRESP_ERR;
+    if (i == 0) /* force initial phase to [0,360) */
+    {
+      while (pha + *added_value < 0)
+        *added_value += 360;
+      while (pha + *added_value >= 360)
+        *added_value -= 360;
+      *prev_phase = pha + *added_value;
+    }
+    pha = unwrap_phase (pha, *prev_phase, 360, added_value);
+    *prev_phase = pha;
   }
+  return pha;
+}
 
-  num_of_points = response->nfreqs;
-  freq_arr = response->freqs;
+/* write each point of the response as a line of text, computing the
+   amplitude and phase as we go (so no per-point arrays are needed) */
+static int
+response_to_text (evalresp_logger *log, const evalresp_response *response,
+                  int unwrap, evalresp_file_format format, text_buffer *buffer)
+{
+  int status = EVALRESP_OK;
+  int i;
+  double added_value = 0, prev_phase = 0, amp, pha;
+  const char *separator;
+  size_t sep_len;
 
   switch (format)
   {
   case evalresp_fap_file_format:
-    if (!(status = calloc_doubles (log, "amplitude", num_of_points, &amp_arr)))
-    {
-      status = calloc_doubles (log, "phase", num_of_points, &pha_arr);
-    }
-    break;
   case evalresp_amplitude_file_format:
-    status = calloc_doubles (log, "amplitude", num_of_points, &amp_arr);
-    break;
   case evalresp_phase_file_format:
-    status = calloc_doubles (log, "phase", num_of_points, &pha_arr);
+    separator = " ";
     break;
   case evalresp_complex_file_format:
+    separator = "  ";
     break;
   default:
     evalresp_log (log, EV_ERROR, EV_ERROR, "Invalid format sent to evalresp_response_to_char");
-    status = EVALRESP_ERR;
+    return EVALRESP_ERR;
   }
+  sep_len = strlen (separator);
 
-  if (!status)
+  for (i = 0; !status && i < response->nfreqs; i++)
   {
-    for (i = 0; i < num_of_points; i++)
+    amp = pha = 0;
+    if (format == evalresp_fap_file_format || format == evalresp_amplitude_file_format)
     {
-      if (amp_arr)
-      {
-        amp_arr[i] = sqrt (response->rvec[i].real * response->rvec[i].real + response->rvec[i].imag * response->rvec[i].imag);
-      }
-      if (pha_arr)
-      {
-        pha_arr[i] = atan2 (response->rvec[i].imag, response->rvec[i].real + 1.e-200) * 180.0 / M_PI;
-        if (unwrap)
-        {
-          if (i == 0) /* force initial phase to [0,360) */
-          {
-            while (pha_arr[0] + added_value < 0)
-              added_value += 360;
-            while (pha_arr[0] + added_value >= 360)
-              added_value -= 360;
-            prev_phase = pha_arr[0] + added_value;
-          }
-          pha_arr[i] = unwrap_phase (pha_arr[i], prev_phase, 360, &added_value);
-          prev_phase = pha_arr[i];
-        }
-      }
+      amp = point_amplitude (&response->rvec[i]);
+    }
+    if (format == evalresp_fap_file_format || format == evalresp_phase_file_format)
+    {
+      pha = point_phase (&response->rvec[i], i, unwrap, &added_value, &prev_phase);
     }
-    /* Get Size of output string */
-    for (i = 0, length = 0; i < num_of_points; i++)
+    if (!(status = text_buffer_append_e6 (log, buffer, response->freqs[i]))
+        && !(status = text_buffer_append (log, buffer, separator, sep_len)))
     {
       switch (format)
       {
       case evalresp_fap_file_format:
-        length += _evalresp_snprintf (NULL, 0, "%.6E %.6E %.6E\n", freq_arr[i], amp_arr[i], pha_arr[i]);
+        if (!(status = text_buffer_append_e6 (log, buffer, amp))
+            && !(status = text_buffer_append (log, buffer, separator, sep_len)))
+        {
+          status = text_buffer_append_e6 (log, buffer, pha);
+        }
         break;
       case evalresp_amplitude_file_format:
-        length += _evalresp_snprintf (NULL, 0, "%.6E %.6E\n", freq_arr[i], amp_arr[i]);
+        status = text_buffer_append_e6 (log, buffer, amp);
         break;
       case evalresp_phase_file_format:
-        length += _evalresp_snprintf (NULL, 0, "%.6E %.6E\n", freq_arr[i], pha_arr[i]);
+        status = text_buffer_append_e6 (log, buffer, pha);
         break;
-      case evalresp_complex_file_format:
-        length += _evalresp_snprintf (NULL, 0, "%.6E  %.6E  %.6E\n", freq_arr[i], response->rvec[i].real, response->rvec[i].imag);
+      default:
+        if (!(status = text_buffer_append_e6 (log, buffer, response->rvec[i].real))
+            && !(status = text_buffer_append (log, buffer, separator, sep_len)))
+        {
+          status = text_buffer_append_e6 (log, buffer, response->rvec[i].imag);
+        }
         break;
       }
     }
-    length++; /* Adding one for NULL termination */
+    if (!status)
+    {
+      status = text_buffer_append (log, buffer, "\n", 1);
+    }
+  }
+
+  return status;
+}
+
+#define NPY_MAGIC "\x93NUMPY\x01\x00"
+#define NPY_MAGIC_SIZE 8
+#define NPY_HEADER_TEMPLATE "{'descr': '<f8', 'fortran_order': False, 'shape': (%d, 3), }"
+#define NPY_ALIGN 64
+
+int
+is_binary_file_format (evalresp_file_format format)
+{
+  switch (format)
+  {
+  case evalresp_raw_fap_file_format:
+  case evalresp_raw_complex_file_format:
+  case evalresp_npy_fap_file_format:
+  case evalresp_npy_complex_file_format:
+    return 1;
+  default:
+    return 0;
   }
+}
+
+/* build the header for a binary file of nfreqs rows */
+static int
+binary_header (evalresp_logger *log, evalresp_file_format format, int nfreqs,
+               unsigned char *header, size_t *length)
+{
+  int dict_len;
+  size_t padded;
+
+  switch (format)
+  {
+  case evalresp_raw_fap_file_format:
+  case evalresp_raw_complex_file_format:
+    memcpy (header, EVALRESP_BINARY_MAGIC, 8);
+    put_le (header + 8, EVALRESP_BINARY_VERSION, 4);
+    put_le (header + 12, format == evalresp_raw_fap_file_format ? EVALRESP_BINARY_FAP : EVALRESP_BINARY_COMPLEX, 4);
+    put_le (header + 16, nfreqs, 8);
+    put_le (header + 24, 3, 8);
+    *length = EVALRESP_BINARY_HEADER_SIZE;
+    return EVALRESP_OK;
+  case evalresp_npy_fap_file_format:
+  case evalresp_npy_complex_file_format:
+    /* version 1.0: magic, uint16 length of the dict, then the dict padded
+       with spaces and a newline so that the data are aligned */
+    memcpy (header, NPY_MAGIC, NPY_MAGIC_SIZE);
+    dict_len = _evalresp_snprintf ((char *)header + NPY_MAGIC_SIZE + 2, NPY_ALIGN * 2 - NPY_MAGIC_SIZE - 2,
+                                   NPY_HEADER_TEMPLATE, nfreqs);
+    padded = NPY_ALIGN * ((NPY_MAGIC_SIZE + 2 + dict_len + 1 + NPY_ALIGN - 1) / NPY_ALIGN);
+    memset (header + NPY_MAGIC_SIZE + 2 + dict_len, ' ', padded - NPY_MAGIC_SIZE - 2 - dict_len);
+    header[padded - 1] = '\n';
+    put_le (header + NPY_MAGIC_SIZE, padded - NPY_MAGIC_SIZE - 2, 2);
+    *length = padded;
+    return EVALRESP_OK;
+  default:
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Invalid binary format");
+    return EVALRESP_ERR;
+  }
+}
+
+/* write the response as a header and rows of little-endian float64
+   values, (freq, amp, phase) or (freq, real, imag).  a stream receives
+   the rows as the buffer fills; otherwise the buffer is allocated once */
+static int
+response_to_binary (evalresp_logger *log, const evalresp_response *response,
+                    int unwrap, evalresp_file_format format, text_buffer *buffer)
+{
+  int status = EVALRESP_OK, i, fap;
+  double added_value = 0, prev_phase = 0;
+  unsigned char header[NPY_ALIGN * 2], *row;
+  size_t header_len;
 
-  if (!status)
+  if (!(status = binary_header (log, format, response->nfreqs, header, &header_len)))
   {
-    if (!(*output = (char *)calloc (length, sizeof (char))))
+    if (!buffer->file)
     {
-      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate output");
-      status = EVALRESP_MEM;
+      status = text_buffer_reserve (log, buffer, header_len + EVALRESP_BINARY_ROW_SIZE * (size_t)response->nfreqs);
+    }
+    if (!status)
+    {
+      status = text_buffer_append (log, buffer, (char *)header, header_len);
     }
   }
 
-  if (!status)
+  fap = format == evalresp_raw_fap_file_format || format == evalresp_npy_fap_file_format;
+  for (i = 0; !status && i < response->nfreqs; i++)
   {
-    for (i = 0, offset = 0; i < num_of_points; i++)
+    if (!(status = text_buffer_reserve (log, buffer, EVALRESP_BINARY_ROW_SIZE)))
     {
-      switch (format)
+      row = (unsigned char *)buffer->text + buffer->len;
+      put_le_double (row, response->freqs[i]);
+      if (fap)
       {
-      case evalresp_fap_file_format:
-        offset += _evalresp_snprintf (*output + offset, length - offset, "%.6E %.6E %.6E\n", freq_arr[i], amp_arr[i], pha_arr[i]);
-        break;
-      case evalresp_amplitude_file_format:
-        offset += _evalresp_snprintf (*output + offset, length - offset, "%.6E %.6E\n", freq_arr[i], amp_arr[i]);
-        break;
-      case evalresp_phase_file_format:
-        offset += _evalresp_snprintf (*output + offset, length - offset, "%.6E %.6E\n", freq_arr[i], pha_arr[i]);
-        break;
-      case evalresp_complex_file_format:
-        offset += _evalresp_snprintf (*output + offset, length - offset, "%.6E  %.6E  %.6E\n", freq_arr[i], response->rvec[i].real, response->rvec[i].imag);
-        break;
+        put_le_double (row + 8, point_amplitude (&response->rvec[i]));
+        put_le_double (row + 16, point_phase (&response->rvec[i], i, unwrap, &added_value, &prev_phase));
+      }
+      else
+      {
+        put_le_double (row + 8, response->rvec[i].real);
+        put_le_double (row + 16, response->rvec[i].imag);
       }
+      buffer->len += EVALRESP_BINARY_ROW_SIZE;
     }
   }
 
-  free (amp_arr);
-  free (pha_arr);
+  return status;
+}
+
+int
+response_to_buffer (evalresp_logger *log, const evalresp_response *response,
+                    int unwrap, evalresp_file_format format, text_buffer *buffer)
+{
+  if (!response)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot Process Empty Response");
+    return EVALRESP_ERR;
+  }
+  if (is_binary_file_format (format))
+  {
+    return response_to_binary (log, response, unwrap, format, buffer);
+  }
+  return response_to_text (log, response, unwrap, format, buffer);
+}
+
+int
+evalresp_response_to_char (evalresp_logger *log, const evalresp_response *response,
+                           int unwrap, evalresp_file_format format, char **output)
+{
+  int status = EVALRESP_OK;
+  text_buffer buffer = {NULL, 0, 0, NULL};
 
+  if (*output)
+  {
+    /* don't want to get bad memory location to write to
+       or we don't want to zombify stuff */
+    evalresp_log (log, EV_ERROR, EV_ERROR, "cannot out put to an already allocated output");
+    return EVALRESP_ERR;
+  }
+
+  if (is_binary_file_format (format))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Binary formats cannot be written to a string");
+    return EVALRESP_ERR;
+  }
+
+  if (!(status = response_to_buffer (log, response, unwrap, format, &buffer)))
+  {
+    if (!(status = text_buffer_append (log, &buffer, "", 1))) /* nul termination */
+    {
+      *output = buffer.text;
+      buffer.text = NULL;
+    }
+  }
+
+  free (buffer.text);
   return status;
 }
 
@@ -148,32 +274,24 @@ int
 evalresp_response_to_stream (evalresp_logger *log, const evalresp_response *response,
                              int unwrap, evalresp_file_format format, FILE *const file)
 {
-  char *resp_string = NULL;
-  int status = EVALRESP_OK, len;
+  int status = EVALRESP_OK;
+  text_buffer buffer = {NULL, 0, 0, NULL};
 
   /* need to check for valid FILE subsequent calls handle other error checks */
   if (!file)
   {
     evalresp_log (log, EV_ERROR, EV_ERROR, "the stream is not open");
-    status = EVALRESP_ERR;
+    return EVALRESP_ERR;
   }
-  else
+
+  /* the text goes to the stream as the buffer fills */
+  buffer.file = file;
+  if (!(status = response_to_buffer (log, response, unwrap, format, &buffer)))
   {
-    /* get the output string */
-    if (!(status = evalresp_response_to_char (log, response, unwrap, format, &resp_string)))
-    {
-      /* print to the FILE * */
-      len = fprintf (file, "%s", resp_string);
-      if (len != strlen (resp_string))
-      {
-        evalresp_log (log, EV_ERROR, EV_ERROR, "Failed to write to file");
-        status = EVALRESP_IO;
-      }
-    }
+    status = text_buffer_flush (log, &buffer);
   }
 
-  /* clean up the string */
-  free (resp_string);
+  free (buffer.text);
   return status;
 }
 
@@ -193,7 +311,7 @@ evalresp_response_to_file (evalresp_logger *log, const evalresp_response *respon
   else
   {
     /* open file and check that it did open */
-    if (!(file = fopen (filename, "w")))
+    if (!(file = fopen (filename, is_binary_file_format (format) ? "wb" : "w")))
     {
       evalresp_log (log, EV_ERROR, EV_ERROR, "could not open output file %s", filename);
       status = EVALRESP_IO;
@@ -209,8 +327,108 @@ evalresp_response_to_file (evalresp_logger *log, const evalresp_response *respon
   return status;
 }
 
+int
+evalresp_sensitivities_to_stream (evalresp_logger *log, const evalresp_sensitivities *sensitivities,
+                                  FILE *const file)
+{
+  const evalresp_sensitivity *sensitivity;
+  int status = EVALRESP_OK, i, j;
+
+  if (!file)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "the stream is not open");
+    return EVALRESP_ERR;
+  }
+  if (fprintf (file, "%-3s %-5s %-3s %-3s %-22s %-22s %-13s %-13s %-13s %-10s %s\n",
+               "NET", "STA", "LOC", "CHA", "START", "END", "SENSIT", "CALC_SENSIT",
+               "FREQ", "DIFF(%)", "STAGE:GAIN") < 0)
+  {
+    status = EVALRESP_IO;
+  }
+  for (i = 0; !status && sensitivities && i < sensitivities->nsensitivities; i++)
+  {
+    sensitivity = sensitivities->sensitivities[i];
+    if (fprintf (file, "%-3s %-5s %-3s %-3s %-22s %-22s %-13.6E %-13.6E %-13.6E %-10.4f",
+                 sensitivity->network, sensitivity->station,
+                 strlen (sensitivity->locid) ? sensitivity->locid : "--",
+                 sensitivity->channel, sensitivity->beg_t, sensitivity->end_t,
+                 sensitivity->sensit, sensitivity->calc_sensit, sensitivity->sensfreq,
+                 sensitivity->percent_diff) < 0)
+    {
+      status = EVALRESP_IO;
+    }
+    for (j = 0; !status && j < sensitivity->ngains; j++)
+    {
+      if (fprintf (file, " %d:%.6E", sensitivity->stages[j], sensitivity->gains[j]) < 0)
+      {
+        status = EVALRESP_IO;
+      }
+    }
+    if (!status && fprintf (file, "\n") < 0)
+    {
+      status = EVALRESP_IO;
+    }
+  }
+  if (status)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Failed to write to file");
+  }
+  return status;
+}
+
+/* the normalization (a0 or h0) of a filter, as held by the plan if
+   there is one */
+static double
+plan_filter_gain (evalresp_plan const *plan, const evalresp_blkt *blkt, double gain)
+{
+  int i;
+
+  for (i = 0; plan && i < plan->ngains; i++)
+  {
+    if (plan->gains[i].filt == blkt)
+      return plan->gains[i].filt_gain;
+  }
+  return gain;
+}
+
+/* a stage gain, as held by the plan if there is one (a NULL blockette
+   is the reported sensitivity used as a stage gain) */
+static double
+plan_stage_gain (evalresp_plan const *plan, const evalresp_blkt *blkt)
+{
+  int i;
+
+  for (i = 0; plan && i < plan->ngains; i++)
+  {
+    if (plan->gains[i].blkt == blkt)
+      return plan->gains[i].gain;
+  }
+  return blkt ? blkt->blkt_info.gain.gain : 0.0;
+}
+
+/* was the reported sensitivity used as a stage gain? */
+static int
+plan_stage_gain_used (evalresp_plan const *plan)
+{
+  int i;
+
+  for (i = 0; plan && i < plan->ngains; i++)
+  {
+    if (!plan->gains[i].blkt)
+      return 1;
+  }
+  return 0;
+}
+
 int
 evalresp_channel_to_log (evalresp_logger *log, evalresp_options const *const options, evalresp_channel *const channel)
+{
+  return log_channel_plan (log, options, channel, NULL);
+}
+
+int
+log_channel_plan (evalresp_logger *log, evalresp_options const *const options,
+                  evalresp_channel const *channel, evalresp_plan const *plan)
 {
   evalresp_stage *this_stage, *last_stage, *first_stage;
   evalresp_blkt *this_blkt;
@@ -282,7 +500,9 @@ evalresp_channel_to_log (evalresp_logger *log, evalresp_options const *const opt
   evalresp_log (log, EV_INFO, 0, "   requested units: %s", evalresp_unit_string(options->unit));
 
   evalresp_log (log, EV_INFO, 0, "   computed sens=%.5E (reported=%.5E) @ %.5E Hz",
-                channel->calc_sensit, channel->sensit, channel->sensfreq);
+                plan ? plan->calc_sensit : channel->calc_sensit,
+                plan ? plan->sensit : channel->sensit,
+                plan ? plan->sensfreq : channel->sensfreq);
   evalresp_log (log, EV_INFO, 0,
                 "   calc_del=%.5E  corr_app=%.5E  est_delay=%.5E  final_sint=%.3g(sec/sample)",
                 channel->calc_delay, channel->applied_corr, channel->estim_delay,
@@ -329,51 +549,51 @@ evalresp_channel_to_log (evalresp_logger *log, evalresp_options const *const opt
         break;
       case LAPLACE_PZ:
         sprintf (tmp_str, " LAPLACE     A0=%E NZeros= %2d NPoles= %2d",
-                 this_blkt->blkt_info.pole_zero.a0,
+                 plan_filter_gain (plan, this_blkt, this_blkt->blkt_info.pole_zero.a0),
                  this_blkt->blkt_info.pole_zero.nzeros,
                  this_blkt->blkt_info.pole_zero.npoles);
         break;
       case ANALOG_PZ:
         sprintf (tmp_str, " ANALOG      A0=%E NZeros= %2d NPoles= %2d",
-                 this_blkt->blkt_info.pole_zero.a0,
+                 plan_filter_gain (plan, this_blkt, this_blkt->blkt_info.pole_zero.a0),
                  this_blkt->blkt_info.pole_zero.nzeros,
                  this_blkt->blkt_info.pole_zero.npoles);
         break;
       case FIR_SYM_1:
         sprintf (tmp_str, " FIR_SYM_1   H0=%E Ncoeff=%3d",
-                 this_blkt->blkt_info.fir.h0,
+                 plan_filter_gain (plan, this_blkt, this_blkt->blkt_info.fir.h0),
                  this_blkt->blkt_info.fir.ncoeffs * 2 - 1);
         break;
       case FIR_SYM_2:
         sprintf (tmp_str, " FIR_SYM_2   H0=%E Ncoeff=%3d",
-                 this_blkt->blkt_info.fir.h0,
+                 plan_filter_gain (plan, this_blkt, this_blkt->blkt_info.fir.h0),
                  this_blkt->blkt_info.fir.ncoeffs * 2);
         strcat (out_str, tmp_str);
         strncpy (tmp_str, "", TMPSTRLEN);
         break;
       case FIR_ASYM:
         sprintf (tmp_str, " FIR_ASYM    H0=%E Ncoeff=%3d",
-                 this_blkt->blkt_info.fir.h0,
+                 plan_filter_gain (plan, this_blkt, this_blkt->blkt_info.fir.h0),
                  this_blkt->blkt_info.fir.ncoeffs);
         break;
       case IIR_PZ:
         sprintf (tmp_str, " IIR_PZ      A0=%E NZeros= %2d NPoles= %2d",
-                 this_blkt->blkt_info.pole_zero.a0,
+                 plan_filter_gain (plan, this_blkt, this_blkt->blkt_info.pole_zero.a0),
                  this_blkt->blkt_info.pole_zero.nzeros,
                  this_blkt->blkt_info.pole_zero.npoles);
         break;
       case IIR_COEFFS:
         sprintf (tmp_str, "IIR_COEFFS   H0=%E NNumers=%2d NDenums= %2d",
-                 this_blkt->blkt_info.coeff.h0,
+                 plan_filter_gain (plan, this_blkt, this_blkt->blkt_info.coeff.h0),
                  this_blkt->blkt_info.coeff.nnumer,
                  this_blkt->blkt_info.coeff.ndenom);
         break;
       case GAIN:
         if (first_blkt && this_stage->sequence_no)
           sprintf (tmp_str, " GAIN        Sd=%E",
-                   this_blkt->blkt_info.gain.gain);
+                   plan_stage_gain (plan, this_blkt));
         else if (this_stage->sequence_no)
-          sprintf (tmp_str, " Sd=%E", this_blkt->blkt_info.gain.gain);
+          sprintf (tmp_str, " Sd=%E", plan_stage_gain (plan, this_blkt));
         break;
       case DECIMATION:
         sprintf (tmp_str, " SamInt=%E",
@@ -411,6 +631,12 @@ evalresp_channel_to_log (evalresp_logger *log, evalresp_options const *const opt
       }
       this_blkt = this_blkt->next_blkt;
     }
+    /* the reported sensitivity used as the gain of the first stage */
+    if (this_stage == first_stage && this_stage->sequence_no && plan_stage_gain_used (plan))
+    {
+      sprintf (tmp_str, " Sd=%E", plan_stage_gain (plan, NULL));
+      strcat (out_str, tmp_str);
+    }
     if (this_stage->sequence_no)
     {
       evalresp_log (log, EV_INFO, 0, " %s", out_str);
@@ -424,11 +650,13 @@ evalresp_channel_to_log (evalresp_logger *log, evalresp_options const *const opt
   {
     if (options->b55_interpolate)
     {
+      /* the interpolated list is held by the plan */
       evalresp_log (log, EV_INFO, 0,
                     " Note:  The input has been interpolated from the response List stage");
       evalresp_log (log, EV_INFO, 0,
                     " (blockette 55) to generate output for the %d frequencies requested",
-                    channel->first_stage->first_blkt->blkt_info.list.nresp);
+                    plan && plan->nlists ? plan->lists[0].blkt_info.list.nresp
+                                         : channel->first_stage->first_blkt->blkt_info.list.nresp);
     }
     else if (options->b55_interpolate)
     {
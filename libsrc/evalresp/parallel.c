@@ -0,0 +1,677 @@
+#include <stdlib.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#include <unistd.h>
+#endif
+
+#include "evalresp/private.h"
+
+#ifdef _WIN32
+typedef CRITICAL_SECTION parallel_mutex;
+typedef CONDITION_VARIABLE parallel_cond;
+#define parallel_lock(m) EnterCriticalSection (m)
+#define parallel_unlock(m) LeaveCriticalSection (m)
+#define parallel_wait(c, m) SleepConditionVariableCS (c, m, INFINITE)
+#define parallel_wake(c) WakeAllConditionVariable (c)
+#else
+typedef pthread_mutex_t parallel_mutex;
+typedef pthread_cond_t parallel_cond;
+#define parallel_lock(m) pthread_mutex_lock (m)
+#define parallel_unlock(m) pthread_mutex_unlock (m)
+#define parallel_wait(c, m) pthread_cond_wait (c, m)
+#define parallel_wake(c) pthread_cond_broadcast (c)
+#endif
+
+/* state shared by all the threads of one run_parallel() call */
+typedef struct
+{
+  parallel_task task;
+  void *arg;
+  int n;
+  int block;
+  int next;      /* start of the next block to claim */
+  int failed_at; /* start of the first block that failed (n if none) */
+  int status;    /* status of that block */
+  parallel_mutex mutex;
+} parallel_state;
+
+typedef struct
+{
+  parallel_state *state;
+  int thread;
+} parallel_worker;
+
+/* claim blocks in increasing order until none are left.  once a block has
+   failed no later block is claimed, but the blocks before it (which were
+   claimed already) complete, so the status kept is always that of the
+   first failing block, independent of the scheduling. */
+static void
+parallel_work (parallel_worker *worker)
+{
+  parallel_state *state = worker->state;
+  int begin, end, status;
+
+  for (;;)
+  {
+    parallel_lock (&state->mutex);
+    begin = state->next;
+    if (begin >= state->failed_at)
+    {
+      parallel_unlock (&state->mutex);
+      break;
+    }
+    end = begin + state->block < state->n ? begin + state->block : state->n;
+    state->next = end;
+    parallel_unlock (&state->mutex);
+
+    if ((status = state->task (state->arg, worker->thread, begin, end)))
+    {
+      parallel_lock (&state->mutex);
+      if (begin < state->failed_at)
+      {
+        state->failed_at = begin;
+        state->status = status;
+      }
+      parallel_unlock (&state->mutex);
+    }
+  }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+parallel_thread (LPVOID worker)
+{
+  parallel_work ((parallel_worker *)worker);
+  return 0;
+}
+#else
+static void *
+parallel_thread (void *worker)
+{
+  parallel_work ((parallel_worker *)worker);
+  return NULL;
+}
+#endif
+
+struct evalresp_mutex_s
+{
+  parallel_mutex mutex;
+};
+
+int
+mutex_new (evalresp_logger *log, evalresp_mutex **mutex)
+{
+  if (!(*mutex = calloc (1, sizeof (**mutex))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate mutex");
+    return EVALRESP_MEM;
+  }
+#ifdef _WIN32
+  InitializeCriticalSection (&(*mutex)->mutex);
+#else
+  pthread_mutex_init (&(*mutex)->mutex, NULL);
+#endif
+  return EVALRESP_OK;
+}
+
+void
+mutex_lock (evalresp_mutex *mutex)
+{
+  parallel_lock (&mutex->mutex);
+}
+
+void
+mutex_unlock (evalresp_mutex *mutex)
+{
+  parallel_unlock (&mutex->mutex);
+}
+
+void
+mutex_free (evalresp_mutex **mutex)
+{
+  if (*mutex)
+  {
+#ifdef _WIN32
+    DeleteCriticalSection (&(*mutex)->mutex);
+#else
+    pthread_mutex_destroy (&(*mutex)->mutex);
+#endif
+    free (*mutex);
+    *mutex = NULL;
+  }
+}
+
+int
+parallel_threads (int nthreads)
+{
+  if (nthreads == EVALRESP_THREADS_AUTO)
+  {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo (&info);
+    nthreads = (int)info.dwNumberOfProcessors;
+#elif defined(_SC_NPROCESSORS_ONLN)
+    nthreads = (int)sysconf (_SC_NPROCESSORS_ONLN);
+#else
+    nthreads = 1;
+#endif
+  }
+  return nthreads > 1 ? nthreads : 1;
+}
+
+int
+run_parallel (evalresp_logger *log, int nthreads, int n, int block,
+              parallel_task task, void *arg)
+{
+  parallel_state state;
+  parallel_worker *workers = NULL;
+#ifdef _WIN32
+  HANDLE *threads = NULL;
+#else
+  pthread_t *threads = NULL;
+#endif
+  int i, nstarted = 0;
+
+  if (n <= 0)
+  {
+    return EVALRESP_OK;
+  }
+  if (block < 1)
+  {
+    block = 1;
+  }
+  nthreads = parallel_threads (nthreads);
+  if (nthreads > (n + block - 1) / block)
+  {
+    nthreads = (n + block - 1) / block;
+  }
+
+  state.task = task;
+  state.arg = arg;
+  state.n = n;
+  state.block = block;
+  state.next = 0;
+  state.failed_at = n;
+  state.status = EVALRESP_OK;
+
+  if (nthreads > 1
+      && (!(workers = calloc (nthreads, sizeof (*workers)))
+          || !(threads = calloc (nthreads, sizeof (*threads)))))
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Cannot allocate threads, evaluating serially");
+    nthreads = 1;
+  }
+
+  if (nthreads <= 1)
+  {
+    free (workers);
+    free (threads);
+    for (i = 0; i < n; i += block)
+    {
+      if ((state.status = task (arg, 0, i, i + block < n ? i + block : n)))
+      {
+        break;
+      }
+    }
+    return state.status;
+  }
+
+#ifdef _WIN32
+  InitializeCriticalSection (&state.mutex);
+#else
+  pthread_mutex_init (&state.mutex, NULL);
+#endif
+
+  /* the calling thread is thread 0; if a thread cannot be started the
+     remaining threads simply claim more blocks */
+  for (i = 0; i < nthreads; i++)
+  {
+    workers[i].state = &state;
+    workers[i].thread = i;
+  }
+  for (i = 1; i < nthreads; i++, nstarted++)
+  {
+#ifdef _WIN32
+    if (!(threads[i] = CreateThread (NULL, 0, parallel_thread, &workers[i], 0, NULL)))
+#else
+    if (pthread_create (&threads[i], NULL, parallel_thread, &workers[i]))
+#endif
+    {
+      evalresp_log (log, EV_DEBUG, EV_DEBUG, "Started %d of %d threads", i, nthreads);
+      break;
+    }
+  }
+  parallel_work (&workers[0]);
+  for (i = 1; i <= nstarted; i++)
+  {
+#ifdef _WIN32
+    WaitForSingleObject (threads[i], INFINITE);
+    CloseHandle (threads[i]);
+#else
+    pthread_join (threads[i], NULL);
+#endif
+  }
+
+#ifdef _WIN32
+  DeleteCriticalSection (&state.mutex);
+#else
+  pthread_mutex_destroy (&state.mutex);
+#endif
+  free (workers);
+  free (threads);
+  return state.status;
+}
+
+/* state shared by all the threads of one run_pipeline() call */
+typedef struct
+{
+  pipeline_task task;
+  void *arg;
+  int nstages;
+  int n;
+  int depth;
+  int *done;     /* items finished by each stage */
+  int failed_at; /* first item that failed (n if none) */
+  int status;    /* status of that item */
+  parallel_mutex mutex;
+  parallel_cond cond;
+} pipeline_state;
+
+/* a thread that runs the stages [first, last) on each item in turn */
+typedef struct
+{
+  pipeline_state *state;
+  int first;
+  int last;
+} pipeline_worker;
+
+/* can the worker start on item i?  the first stage waits until the item
+   that last used the same slot has left the last stage */
+static int
+pipeline_ready (pipeline_worker *worker, int i)
+{
+  pipeline_state *state = worker->state;
+
+  if (worker->first == 0)
+  {
+    return i < state->done[state->nstages - 1] + state->depth;
+  }
+  return i < state->done[worker->first - 1];
+}
+
+/* take the items in order, as they leave the previous stage, until they
+   are all done or one has failed.  an item only fails after all the items
+   before it have passed its stage, so those still complete the pipeline
+   and the status kept is that of the first failing item. */
+static void
+pipeline_work (pipeline_worker *worker)
+{
+  pipeline_state *state = worker->state;
+  int i, stage, status = EVALRESP_OK;
+
+  for (i = 0; !status; i++)
+  {
+    parallel_lock (&state->mutex);
+    while (i < state->failed_at && !pipeline_ready (worker, i))
+    {
+      parallel_wait (&state->cond, &state->mutex);
+    }
+    if (i >= state->failed_at)
+    {
+      parallel_unlock (&state->mutex);
+      break;
+    }
+    parallel_unlock (&state->mutex);
+
+    for (stage = worker->first; !status && stage < worker->last; stage++)
+    {
+      status = state->task (state->arg, stage, i);
+    }
+
+    parallel_lock (&state->mutex);
+    if (status)
+    {
+      if (i < state->failed_at)
+      {
+        state->failed_at = i;
+        state->status = status;
+      }
+    }
+    else
+    {
+      state->done[worker->last - 1] = i + 1;
+    }
+    parallel_wake (&state->cond);
+    parallel_unlock (&state->mutex);
+  }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+pipeline_thread (LPVOID worker)
+{
+  pipeline_work ((pipeline_worker *)worker);
+  return 0;
+}
+#else
+static void *
+pipeline_thread (void *worker)
+{
+  pipeline_work ((pipeline_worker *)worker);
+  return NULL;
+}
+#endif
+
+int
+run_pipeline (evalresp_logger *log, int nstages, int n, int depth,
+              pipeline_task task, void *arg, int *failed)
+{
+  pipeline_state state;
+  pipeline_worker *workers = NULL;
+#ifdef _WIN32
+  HANDLE *threads = NULL;
+#else
+  pthread_t *threads = NULL;
+#endif
+  int i, stage, nstarted = 0;
+
+  state.task = task;
+  state.arg = arg;
+  state.nstages = nstages;
+  state.n = n;
+  state.depth = depth;
+  state.failed_at = n;
+  state.status = EVALRESP_OK;
+  state.done = NULL;
+
+  if (n > 0 && nstages > 1 && depth > 1
+      && (!(state.done = calloc (nstages, sizeof (*state.done)))
+          || !(workers = calloc (nstages, sizeof (*workers)))
+          || !(threads = calloc (nstages, sizeof (*threads)))))
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Cannot allocate threads, processing serially");
+    free (state.done);
+    free (workers);
+    state.done = NULL;
+    workers = NULL;
+  }
+
+  if (!threads)
+  {
+    /* one item at a time, through all the stages */
+    for (i = 0; i < n && !state.status; i++)
+    {
+      for (stage = 0; stage < nstages && !state.status; stage++)
+      {
+        if ((state.status = task (arg, stage, i)))
+        {
+          state.failed_at = i;
+        }
+      }
+    }
+    *failed = state.failed_at;
+    return state.status;
+  }
+
+#ifdef _WIN32
+  InitializeCriticalSection (&state.mutex);
+  InitializeConditionVariable (&state.cond);
+#else
+  pthread_mutex_init (&state.mutex, NULL);
+  pthread_cond_init (&state.cond, NULL);
+#endif
+
+  /* each stage but the last has a thread, and the calling thread runs the
+     last stage, along with any stages whose thread could not be started */
+  for (i = 0; i < nstages; i++)
+  {
+    workers[i].state = &state;
+    workers[i].first = i;
+    workers[i].last = i + 1;
+  }
+  for (i = 0; i < nstages - 1; i++, nstarted++)
+  {
+#ifdef _WIN32
+    if (!(threads[i] = CreateThread (NULL, 0, pipeline_thread, &workers[i], 0, NULL)))
+#else
+    if (pthread_create (&threads[i], NULL, pipeline_thread, &workers[i]))
+#endif
+    {
+      evalresp_log (log, EV_DEBUG, EV_DEBUG, "Started %d of %d pipeline threads", i, nstages - 1);
+      break;
+    }
+  }
+  workers[nstarted].last = nstages;
+  pipeline_work (&workers[nstarted]);
+  for (i = 0; i < nstarted; i++)
+  {
+#ifdef _WIN32
+    WaitForSingleObject (threads[i], INFINITE);
+    CloseHandle (threads[i]);
+#else
+    pthread_join (threads[i], NULL);
+#endif
+  }
+
+#ifdef _WIN32
+  DeleteCriticalSection (&state.mutex);
+#else
+  pthread_cond_destroy (&state.cond);
+  pthread_mutex_destroy (&state.mutex);
+#endif
+  free (state.done);
+  free (workers);
+  free (threads);
+  *failed = state.failed_at;
+  return state.status;
+}
+
+/* state shared by all the threads of one run_ordered() call */
+typedef struct
+{
+  ordered_task task;
+  void *arg;
+  int n;
+  int depth;     /* items claimed but not yet finished in order */
+  int next;      /* next item to claim */
+  int finished;  /* items finished in order */
+  int finishing; /* is a thread finishing items? */
+  int *ready;    /* has item i (in slot i % depth) done its first call? */
+  int failed_at; /* first item that failed (n if none) */
+  int status;    /* status of that item */
+  parallel_mutex mutex;
+  parallel_cond cond;
+} ordered_state;
+
+typedef struct
+{
+  ordered_state *state;
+  int thread;
+} ordered_worker;
+
+/* called with the mutex held */
+static void
+ordered_failed (ordered_state *state, int item, int status)
+{
+  if (status && item < state->failed_at)
+  {
+    state->failed_at = item;
+    state->status = status;
+  }
+}
+
+/* claim items in increasing order and work on them.  the thread that
+   completes the next item to be finished in order finishes it, and any
+   later items that are ready, while the other threads carry on; an item
+   is only claimed once the item depth before it has been finished, so at
+   most depth items are held at once. */
+static void
+ordered_work (ordered_worker *worker)
+{
+  ordered_state *state = worker->state;
+  int i, status;
+
+  parallel_lock (&state->mutex);
+  for (;;)
+  {
+    while (state->next < state->n && state->next >= state->finished + state->depth)
+    {
+      parallel_wait (&state->cond, &state->mutex);
+    }
+    if (state->next >= state->n)
+    {
+      break;
+    }
+    i = state->next++;
+    parallel_unlock (&state->mutex);
+
+    status = state->task (state->arg, worker->thread, i, 0);
+
+    parallel_lock (&state->mutex);
+    ordered_failed (state, i, status);
+    state->ready[i % state->depth] = 1;
+    if (!state->finishing)
+    {
+      state->finishing = 1;
+      while (state->finished < state->n && state->ready[state->finished % state->depth])
+      {
+        i = state->finished;
+        state->ready[i % state->depth] = 0;
+        parallel_unlock (&state->mutex);
+
+        status = state->task (state->arg, worker->thread, i, 1);
+
+        parallel_lock (&state->mutex);
+        ordered_failed (state, i, status);
+        state->finished++;
+        parallel_wake (&state->cond);
+      }
+      state->finishing = 0;
+    }
+  }
+  parallel_unlock (&state->mutex);
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+ordered_thread (LPVOID worker)
+{
+  ordered_work ((ordered_worker *)worker);
+  return 0;
+}
+#else
+static void *
+ordered_thread (void *worker)
+{
+  ordered_work ((ordered_worker *)worker);
+  return NULL;
+}
+#endif
+
+int
+run_ordered (evalresp_logger *log, int nthreads, int n, ordered_task task, void *arg, int *failed)
+{
+  ordered_state state;
+  ordered_worker *workers = NULL;
+#ifdef _WIN32
+  HANDLE *threads = NULL;
+#else
+  pthread_t *threads = NULL;
+#endif
+  int i, status, nstarted = 0;
+
+  nthreads = parallel_threads (nthreads);
+  if (nthreads > n)
+  {
+    nthreads = n;
+  }
+
+  state.task = task;
+  state.arg = arg;
+  state.n = n;
+  state.depth = 2 * nthreads;
+  state.next = 0;
+  state.finished = 0;
+  state.finishing = 0;
+  state.failed_at = n;
+  state.status = EVALRESP_OK;
+  state.ready = NULL;
+
+  if (nthreads > 1
+      && (!(state.ready = calloc (state.depth, sizeof (*state.ready)))
+          || !(workers = calloc (nthreads, sizeof (*workers)))
+          || !(threads = calloc (nthreads, sizeof (*threads)))))
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Cannot allocate threads, processing serially");
+    free (state.ready);
+    free (workers);
+    state.ready = NULL;
+    workers = NULL;
+  }
+
+  if (!threads)
+  {
+    for (i = 0; i < n; i++)
+    {
+      status = task (arg, 0, i, 0);
+      ordered_failed (&state, i, status);
+      status = task (arg, 0, i, 1);
+      ordered_failed (&state, i, status);
+    }
+    *failed = state.failed_at;
+    return state.status;
+  }
+
+#ifdef _WIN32
+  InitializeCriticalSection (&state.mutex);
+  InitializeConditionVariable (&state.cond);
+#else
+  pthread_mutex_init (&state.mutex, NULL);
+  pthread_cond_init (&state.cond, NULL);
+#endif
+
+  /* the calling thread is thread 0; if a thread cannot be started the
+     remaining threads simply claim more items */
+  for (i = 0; i < nthreads; i++)
+  {
+    workers[i].state = &state;
+    workers[i].thread = i;
+  }
+  for (i = 1; i < nthreads; i++, nstarted++)
+  {
+#ifdef _WIN32
+    if (!(threads[i] = CreateThread (NULL, 0, ordered_thread, &workers[i], 0, NULL)))
+#else
+    if (pthread_create (&threads[i], NULL, ordered_thread, &workers[i]))
+#endif
+    {
+      evalresp_log (log, EV_DEBUG, EV_DEBUG, "Started %d of %d threads", i, nthreads);
+      break;
+    }
+  }
+  ordered_work (&workers[0]);
+  for (i = 1; i <= nstarted; i++)
+  {
+#ifdef _WIN32
+    WaitForSingleObject (threads[i], INFINITE);
+    CloseHandle (threads[i]);
+#else
+    pthread_join (threads[i], NULL);
+#endif
+  }
+
+#ifdef _WIN32
+  DeleteCriticalSection (&state.mutex);
+#else
+  pthread_cond_destroy (&state.cond);
+  pthread_mutex_destroy (&state.mutex);
+#endif
+  free (state.ready);
+  free (workers);
+  free (threads);
+  *failed = state.failed_at;
+  return state.status;
+}
@@ -65,6 +65,24 @@
  * @brief Private evalresp string interface.
  */
 
+/**
+ * @defgroup evalresp_private_parallel evalresp Private Parallel Evaluation Interface
+ * @ingroup evalresp_private
+ * @brief Private evalresp interface for spreading work over threads.
+ */
+
+/**
+ * @defgroup evalresp_private_grid evalresp Private Frequency Grid Interface
+ * @ingroup evalresp_private
+ * @brief Private interface to the tables held by a frequency grid.
+ */
+
+/**
+ * @defgroup evalresp_private_cache evalresp Private Stage Cache Interface
+ * @ingroup evalresp_private
+ * @brief Private interface to the cache of evaluated stages.
+ */
+
 /**
  * @defgroup evalresp_private_spline evalresp Private Spline Interpolation Interface
  * @ingroup evalresp_private
@@ -82,6 +100,7 @@
 #include <ctype.h>
 #include <math.h>
 #include <stdarg.h>
+#include <stdint.h>
 #include <stdio.h>
 
 #include "evalresp/constants.h"
@@ -98,6 +117,82 @@
 #define strncasecmp strnicmp
 #endif
 
+#ifndef EVALRESP_SINGLE_TOL
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Largest estimated relative error for a filter to be evaluated in
+ *        single precision when evalresp_options.single_precision is set.
+ * @details Filters that may be less accurate (long FIR filters, roots close
+ *          to the imaginary axis, IIR filters with poles) are evaluated in
+ *          double precision.
+ */
+#define EVALRESP_SINGLE_TOL 1e-5
+#endif
+
+#ifndef EVALRESP_SINGLE_CHUNK
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Number of frequencies evaluated together by the single precision
+ *        filter kernels.
+ */
+#define EVALRESP_SINGLE_CHUNK 64
+#endif
+
+#ifndef EVALRESP_POLYNOMIAL_CHUNK
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Number of inputs evaluated together by the polynomial (blockette
+ *        62 or 42) kernel.
+ */
+#define EVALRESP_POLYNOMIAL_CHUNK 64
+#endif
+
+#ifndef TEXT_BUFFER_SIZE
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Initial size of a text_buffer, and the amount written to a stream
+ *        at a time (so the memory used to write a response to a stream does
+ *        not depend on the number of frequencies).
+ */
+#define TEXT_BUFFER_SIZE 65536
+#endif
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Space needed by format_e6(), including the terminating nul.
+ */
+#define FORMAT_E6_SIZE 32
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Magic string that starts raw binary files and containers.
+ * @details It is followed by a uint32 version, a uint32 layout and two
+ *          uint64 values that depend on the layout (all little-endian).
+ */
+#define EVALRESP_BINARY_MAGIC "EVALRESP"
+#define EVALRESP_BINARY_VERSION 1     /**< Version of the binary layouts. */
+#define EVALRESP_BINARY_FAP 1         /**< Layout of rows of frequency, amplitude and phase. */
+#define EVALRESP_BINARY_COMPLEX 2     /**< Layout of rows of frequency, real and imaginary parts. */
+#define EVALRESP_BINARY_CONTAINER 3   /**< Layout of a container of many responses. */
+#define EVALRESP_BINARY_HEADER_SIZE 32 /**< Size of the header of a raw binary file or container. */
+#define EVALRESP_BINARY_ROW_SIZE 24   /**< Size of a row of three float64 values. */
+
+#ifndef EVALRESP_PARALLEL_BLOCK
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Number of frequencies evaluated at a time when a response is split
+ *        over several threads.
+ */
+#define EVALRESP_PARALLEL_BLOCK 4096
+#endif
+
 /**
  * @private
  * @ingroup evalresp_private
@@ -114,6 +209,17 @@
  */
 #define FIR_NORM_TOL 0.02
 
+#ifndef EVALRESP_HORNER_COMPENSATED_MIN
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Number of coefficients from which FIR and IIR coefficient filters
+ *        are evaluated with compensated (double-double) Horner summation.
+ * @details Set to 0 to always use the compensated evaluation.
+ */
+#define EVALRESP_HORNER_COMPENSATED_MIN 512
+#endif
+
 /**
  * @private
  * @ingroup evalresp_private
@@ -167,7 +273,8 @@ enum filt_types
   REFERENCE,  /**< Response Reference B60 to replace B53-58,61 with the dictionary counterparts. */
   FIR_COEFFS, /**< FIR response: coefficients representation B61. */
   IIR_COEFFS, /**< Infinite Impulse response represented in B54. */
-  POLYNOMIAL  /**< Polynomial filter via B62. */
+  POLYNOMIAL, /**< Polynomial filter via B62. */
+  CONSTANT    /**< Frequency independent factor of a simplified plan (no blockette). */
 };
 
 /**
@@ -258,6 +365,79 @@ struct matched_files
   struct matched_files *ptr_next; /**< Pointer to next matches files object. */
 };
 
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief A single operation in a compiled response plan.
+ * @details The operation type is the filter type of the blockette it was
+ *          compiled from; DECIMATION operations apply the FIR delay
+ *          correction of their stage as a time shift, and CONSTANT
+ *          operations, made by simplification, have no blockette.
+ */
+typedef struct
+{
+  int type;                   /**< Filter type (one of filt_types). */
+  const evalresp_blkt *blkt;  /**< Blockette holding the coefficients, poles and zeros or list. */
+  double gain;                /**< Normalization (a0 or h0) applied to the filter. */
+  double sint;                /**< Sample interval of digital filters. */
+  double delay;               /**< Time shift applied by DECIMATION operations. */
+  evalresp_complex value;     /**< Frequency independent response (POLYNOMIAL or CONSTANT). */
+  int stage;                  /**< Index of the channel stage the operation belongs to. */
+  float *single;              /**< Coefficients (or zeros then poles) in single precision, if the operation is evaluated in single precision. */
+} evalresp_plan_op;
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief A stage gain as normalized to the sensitivity frequency.
+ */
+typedef struct
+{
+  int sequence_no;           /**< Sequence number of the stage. */
+  const evalresp_blkt *blkt; /**< Gain blockette (NULL if the reported sensitivity was used). */
+  double gain;               /**< Normalized gain. */
+  double gain_freq;          /**< Frequency of the normalized gain. */
+  const evalresp_blkt *filt; /**< Filter normalized with the gain (NULL if none). */
+  double filt_gain;          /**< Normalization (a0 or h0) of the filter. */
+} evalresp_plan_gain;
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief A channel resolved for a set of options into a flat sequence of
+ *        operations that can be evaluated at any frequencies.
+ * @details Stage selection, FIR/decimation pairing, sample intervals,
+ *          delays and gains are resolved when the plan is compiled.  The
+ *          operations point into the blockettes of the channel, which must
+ *          outlive the plan (or, after simplification or list
+ *          interpolation, into blockettes owned by the plan).  When the
+ *          plan is normalized, the normalized filter gains, stage gains and
+ *          sensitivities are held by the plan
+ *          and the channel itself is left unchanged.
+ */
+struct evalresp_plan_s
+{
+  int nops;                  /**< Number of operations. */
+  evalresp_plan_op *ops;     /**< Array of operations. */
+  int ngains;                /**< Number of stage gains. */
+  evalresp_plan_gain *gains; /**< Array of (normalized) stage gains. */
+  int units_code;            /**< Input units of the first stage. */
+  evalresp_unit unit;        /**< Output unit. */
+  double sensit;             /**< Reported sensitivity. */
+  double sensfreq;           /**< Frequency at sensitivity. */
+  double calc_sensit;        /**< Calculated sensitivity. */
+  double resp_sensit;        /**< Sensitivity applied to the response. */
+  double unit_scale_fact;    /**< Used to convert MKS / metric. */
+  int nthreads;              /**< Threads used for large frequency grids. */
+  int parallel_nfreq;        /**< Frequencies from which to use the threads. */
+  int nsingle;               /**< Number of operations evaluated in single precision. */
+  evalresp_stage_cache *stage_cache; /**< Cache of evaluated stages (NULL if none). */
+  int nowned;                /**< Number of pole-zero blockettes made by simplification. */
+  evalresp_blkt *owned;      /**< Pole-zero blockettes made by simplification (merged or reduced). */
+  int nlists;                /**< Number of interpolated list blockettes. */
+  evalresp_blkt *lists;      /**< List blockettes interpolated by interpolate_plan_lists(). */
+};
+
 /**
  * @private
  * @ingroup evalresp_private_string
@@ -329,12 +509,15 @@ int is_real (const char *test, evalresp_logger *log);
  * @param[in] file File name.
  * @param[in] scn_lst List of network-station-locid-channel objects.
  * @param[out] mode 1 for directory search or 0 if file was specified.
+ * @param[in] catalog Catalog used to find the files (if NULL, one is used
+ *            for this call only, so each directory is still read once).
  * @param[in] log Logging structure.
  * @returns Pointer to the head of the linked list of matches files.
  * @returns @c NULL if no files were found that match request.
  */
 struct matched_files *find_files (char *file, evalresp_sncls *scn_lst,
-                                  int *mode, evalresp_logger *log);
+                                  int *mode, evalresp_catalog *catalog,
+                                  evalresp_logger *log);
 
 /**
  * @private
@@ -347,6 +530,32 @@ struct matched_files *find_files (char *file, evalresp_sncls *scn_lst,
  */
 int get_names (char *in_file, struct matched_files *file, evalresp_logger *log);
 
+/**
+ * @private
+ * @ingroup evalresp_private_file
+ * @brief Get filenames matching the expression in @p in_file, as
+ *        get_names(), from a catalog.
+ * @details Patterns other than DIR/RESP.* with a literal DIR are passed to
+ *          get_names(), as are all patterns when @p catalog is NULL.
+ * @param[in] log Logging structure.
+ * @param[in] catalog Catalog of the directories searched.
+ * @param[in,out] in_file File name matching expression (one or two,
+ *                separated by a space); the first is left terminated.
+ * @param[out] files Pointer to the head of the linked list of matches files.
+ * @returns Number of files found matching the expression.
+ */
+int catalog_names (evalresp_logger *log, evalresp_catalog *catalog,
+                   char *in_file, struct matched_files *files);
+
+/**
+ * @private
+ * @ingroup evalresp_private_file
+ * @brief Start a new search with a catalog, so that the directories are
+ *        checked for changes when they are next used.
+ * @param[in] catalog Catalog (may be NULL).
+ */
+void catalog_check (evalresp_catalog *catalog);
+
 /* routines used to allocate vectors of the basic data types used in the
  filter stages */
 
@@ -719,6 +928,17 @@ f * @brief A routine that frees up the space associated with a channel's filter
  */
 void free_channel (evalresp_channel *chan_ptr);
 
+/**
+ * @private
+ * @ingroup evalresp_private_alloc
+ * @brief Copy a channel, with all its stages and blockettes.
+ * @param[in] log Logging structure.
+ * @param[in] in Channel to copy.
+ * @param[out] out The copy, to be freed with evalresp_free_channel().
+ * @retval EVALRESP_OK on success
+ */
+int copy_channel (evalresp_logger *log, const evalresp_channel *in, evalresp_channel **out);
+
 /* simple error handling routines to standardize the output error values and
  allow for control to return to 'evresp' if a recoverable error occurs */
 
@@ -841,16 +1061,562 @@ void check_sym (evalresp_blkt *f, evalresp_channel *chan, evalresp_logger *log);
  */
 int calculate_response (evalresp_logger *log, evalresp_options *options, evalresp_channel *chan, double *freq, int nfreqs, evalresp_complex *output);
 
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Compile a channel into a response plan.
+ * @details If @p normalize is set then the filters and stage gains are
+ *          normalized to the sensitivity frequency (as normalize_response()
+ *          would do) in the plan only, otherwise the gains and
+ *          normalizations are taken from the channel as they are.  In both
+ *          cases the channel is not modified.
+ * @param[in] log Logging structure.
+ * @param[in] options Options selecting stages, delay, sensitivity and units.
+ * @param[in] chan Channel structure.
+ * @param[in] normalize Normalize the response.
+ * @param[out] plan The allocated plan.
+ * @retval EVALRESP_OK on success
+ */
+int compile_plan (evalresp_logger *log, evalresp_options const *const options,
+                  evalresp_channel const *chan, int normalize, evalresp_plan **plan);
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Evaluate a response plan.
+ * @param[in] log Logging structure.
+ * @param[in] plan Compiled plan.
+ * @param[in] freq Frequency array.
+ * @param[in] nfreqs Number if numbers in @p freq.
+ * @param[out] output Output.
+ * @retval EVALRESP_OK on success
+ */
+int evaluate_plan (evalresp_logger *log, evalresp_plan const *plan,
+                   double const *freq, int nfreqs, evalresp_complex *output);
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Evaluate a response plan, writing the real and imaginary parts
+ *        to separate arrays.
+ * @param[in] log Logging structure.
+ * @param[in] plan Compiled plan.
+ * @param[in] freq Frequency array.
+ * @param[in] nfreqs Number if numbers in @p freq.
+ * @param[out] real Real parts, one per frequency.
+ * @param[out] imag Imaginary parts, one per frequency.
+ * @retval EVALRESP_OK on success
+ */
+int evaluate_plan_split (evalresp_logger *log, evalresp_plan const *plan,
+                         double const *freq, int nfreqs, double *real, double *imag);
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Evaluate a response plan at the frequencies of a grid, using its
+ *        angular frequencies and phasor tables.
+ * @param[in] log Logging structure.
+ * @param[in] plan Compiled plan.
+ * @param[in] grid Frequency grid (tables are added as needed).
+ * @param[out] output Output, one value per frequency of the grid.
+ * @retval EVALRESP_OK on success
+ */
+int evaluate_plan_grid (evalresp_logger *log, evalresp_plan const *plan,
+                        evalresp_freq_grid *grid, evalresp_complex *output);
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Largest number of times an interval is halved by
+ *        evaluate_plan_adaptive().
+ */
+#define ADAPTIVE_MAX_DEPTH 30
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Evaluate a response plan at frequencies chosen so that the
+ *        response between them can be interpolated.
+ * @details Starting from @p freq, the middle of each interval is evaluated
+ *          and kept (and both halves tested again) where interpolating from
+ *          the ends, the amplitude logarithmically and the phase linearly,
+ *          would be in error by more than @p tol (relative amplitude, or
+ *          phase in radians).
+ * @param[in] log Logging structure.
+ * @param[in] plan Compiled plan.
+ * @param[in] freq Initial frequencies, increasing.
+ * @param[in] nfreqs Number of initial frequencies.
+ * @param[in] lin Halve intervals linearly (geometrically by default)?
+ * @param[in] tol Tolerance.
+ * @param[in] max_nfreqs Refinement stops (with a warning) rather than
+ *            exceed this number of frequencies.
+ * @param[out] nout Number of frequencies chosen.
+ * @param[out] freq_out Allocated array of the frequencies chosen.
+ * @param[out] output Allocated array of the response at each.
+ * @retval EVALRESP_OK on success
+ */
+int evaluate_plan_adaptive (evalresp_logger *log, evalresp_plan const *plan,
+                            double const *freq, int nfreqs, int lin, double tol, int max_nfreqs,
+                            int *nout, double **freq_out, evalresp_complex **output);
+
+/**
+ * @private
+ * @ingroup evalresp_private_print
+ * @brief Display information on the channel being processed, with the
+ *        normalization held by a plan.
+ * @param[in] log Logging structure.
+ * @param[in] options units, start and stop stages are used; some other
+ *            options are logged
+ * @param[in] channel the channel to print into the log
+ * @param[in] plan normalized plan compiled from the channel (if NULL the
+ *            values in the channel are logged)
+ * @retval EVALRESP_OK on success
+ * @see evalresp_channel_to_log()
+ */
+int log_channel_plan (evalresp_logger *log, evalresp_options const *const options,
+                      evalresp_channel const *channel, evalresp_plan const *plan);
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Evaluate the MacLaurin polynomial of a blockette 62 (or 42), and
+ *        its first derivative, at many inputs.
+ * @param[in] log Logging structure.
+ * @param[in] blkt Polynomial blockette.
+ * @param[in] x Inputs.
+ * @param[in] n Number of inputs.
+ * @param[out] value Array of @p n polynomial values (or NULL).
+ * @param[out] derivative Array of @p n derivatives (or NULL).
+ * @retval EVALRESP_OK on success
+ */
+int evaluate_polynomial (evalresp_logger *log, const evalresp_blkt *blkt,
+                         double const *x, int n, double *value, double *derivative);
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Evaluate a plan with a polynomial stage at many inputs.
+ * @details The other operations of the plan are evaluated once, at
+ *          @p freq, and the real part of their product scales the
+ *          polynomial and its derivative.  The derivative is then the
+ *          response that evaluate_plan() gives with evalresp_options.b62_x
+ *          set to the input.
+ * @param[in] log Logging structure.
+ * @param[in] plan Compiled plan with exactly one polynomial operation.
+ * @param[in] freq Frequency at which to evaluate the other operations.
+ * @param[in] x Inputs.
+ * @param[in] n Number of inputs.
+ * @param[out] value Array of @p n scaled polynomial values (or NULL).
+ * @param[out] derivative Array of @p n scaled derivatives (or NULL).
+ * @retval EVALRESP_OK on success
+ */
+int evaluate_plan_polynomial (evalresp_logger *log, evalresp_plan const *plan, double freq,
+                              double const *x, int n, double *value, double *derivative);
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Interpolate the response list operations of a plan to a set of
+ *        frequencies.
+ * @details Each list operation is pointed at an interpolated copy of its
+ *          blockette, held by the plan, so the channel is not changed and
+ *          may be evaluated elsewhere at the same time.  The plan can then
+ *          only be evaluated at the frequencies given here, and should not
+ *          be interpolated again.
+ * @param[in] log Logging structure.
+ * @param[in,out] plan Compiled plan.
+ * @param[in] freqs Frequencies, within the range of the lists.
+ * @param[in] nfreqs Number of frequencies.
+ * @retval EVALRESP_OK on success
+ */
+int interpolate_plan_lists (evalresp_logger *log, evalresp_plan *plan,
+                            double *freqs, int nfreqs);
+
+/**
+ * @private
+ * @ingroup evalresp_private_calc
+ * @brief Free a response plan.
+ * @param[in,out] plan Plan to free (set to NULL).
+ */
+void free_plan (evalresp_plan **plan);
+
 /**
  * @private
  * @ingroup evalresp_private_calc
  * @brief Normalize response.
+ * @details Writes the normalization computed by compile_plan() back into
+ *          the channel (for the legacy interface).
  * @param[in] log Logging structure.
  * @param[in] options object to control the flow of the conversion to responses
  * @param[in,out] chan Channel structure.
  */
 int normalize_response (evalresp_logger *log, evalresp_options const *const options, evalresp_channel *chan);
 
+/* routines used to share frequencies between channels */
+/**
+ * @private
+ * @ingroup evalresp_private_grid
+ * @brief The frequencies given by the min_freq, max_freq, nfreq and
+ *        lin_freq options.
+ * @param[in] log Logging structure.
+ * @param[in,out] options Options (the limits are ordered and defaulted).
+ * @param[out] nfreqs Number of frequencies.
+ * @param[out] freqs Allocated frequencies.
+ * @retval EVALRESP_OK on success
+ */
+int calculate_freqs (evalresp_logger *log, evalresp_options *options, int *nfreqs, double **freqs);
+
+/**
+ * @private
+ * @ingroup evalresp_private_grid
+ * @brief The angular frequency, 2 pi f, at each frequency of a grid.
+ * @param[in] grid The grid.
+ * @returns the angular frequencies.
+ */
+double const *freq_grid_omega (evalresp_freq_grid const *grid);
+
+/**
+ * @private
+ * @ingroup evalresp_private_grid
+ * @brief stage_cache_hash() of the frequencies of a grid.
+ * @param[in] grid The grid.
+ * @returns the hash.
+ */
+uint64_t freq_grid_hash (evalresp_freq_grid const *grid);
+
+/**
+ * @private
+ * @ingroup evalresp_private_grid
+ * @brief The table of e^{-i omega dt} over a grid, made the first time
+ *        @p dt is requested and kept with the grid.
+ * @param[in] grid The grid.
+ * @param[in] dt Time (a sample interval or delay, in seconds).
+ * @returns the table (real part cos(omega dt), imaginary part
+ *          -sin(omega dt)), NULL if it could not be allocated.
+ */
+evalresp_complex const *freq_grid_phasors (evalresp_freq_grid *grid, double dt);
+
+/* routines used to cache evaluated stages */
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief An evaluated stage held by a evalresp_stage_cache.
+ */
+typedef struct stage_cache_entry_s stage_cache_entry;
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief FNV-1a hash of @p len bytes, continuing from @p hash.
+ * @param[in] data Bytes to hash.
+ * @param[in] len Number of bytes.
+ * @param[in] hash Hash so far (EVALRESP_HASH_INIT to start).
+ * @returns the updated hash.
+ */
+uint64_t stage_cache_hash (const void *data, size_t len, uint64_t hash);
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Initial value for stage_cache_hash().
+ */
+#define EVALRESP_HASH_INIT 0xcbf29ce484222325ULL
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Look up an evaluated stage.
+ * @details The key is the canonical description of the stage and of the
+ *          frequencies it was evaluated at; @p hash is its
+ *          stage_cache_hash().  A found entry is marked as most recently
+ *          used and cannot be evicted until it is released.
+ * @param[in] cache The cache.
+ * @param[in] key Key bytes.
+ * @param[in] key_len Number of key bytes.
+ * @param[in] hash Hash of the key.
+ * @param[in] nfreqs Number of frequencies.
+ * @param[out] entry The entry to release with stage_cache_release() (NULL
+ *             if not found).
+ * @returns the response of the stage at each frequency, NULL if not cached.
+ */
+const evalresp_complex *stage_cache_acquire (evalresp_stage_cache *cache, const unsigned char *key,
+                                             size_t key_len, uint64_t hash, int nfreqs,
+                                             stage_cache_entry **entry);
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Add an evaluated stage, evicting the least recently used entries
+ *        not in use if the cache would exceed its size.
+ * @details If the stage was added meanwhile by another thread, @p values is
+ *          freed and the existing entry is used.
+ * @param[in] cache The cache.
+ * @param[in] key Key bytes.
+ * @param[in] key_len Number of key bytes.
+ * @param[in] hash Hash of the key.
+ * @param[in] nfreqs Number of frequencies.
+ * @param[in] values Malloc'ed response of the stage; the cache takes
+ *            ownership unless NULL is returned.
+ * @param[out] entry The entry to release with stage_cache_release() (NULL
+ *             if not cached).
+ * @returns the cached response, NULL if the stage could not be cached (and
+ *          @p values is still owned by the caller).
+ */
+const evalresp_complex *stage_cache_insert (evalresp_stage_cache *cache, const unsigned char *key,
+                                            size_t key_len, uint64_t hash, int nfreqs,
+                                            evalresp_complex *values, stage_cache_entry **entry);
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Release an entry returned by stage_cache_acquire() or
+ *        stage_cache_insert().
+ * @param[in] cache The cache.
+ * @param[in] entry The entry (may be NULL).
+ */
+void stage_cache_release (evalresp_stage_cache *cache, stage_cache_entry *entry);
+
+/* routines used to keep evaluated responses on disk between runs */
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Key of the responses evaluated from one input file.
+ */
+typedef struct
+{
+  uint64_t hash;  /**< Hash of the file contents, options and filter (names the entry). */
+  uint64_t check; /**< A second hash of the same, checked when the entry is read. */
+  size_t len;     /**< Length of the file. */
+} response_cache_key;
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Calculate the key for a file, from its contents, the filter, and
+ *        the options that change the evaluated responses.
+ * @param[in] filename The input file.
+ * @param[in] options The options used to evaluate the responses.
+ * @param[in] filter The filter used to select channels (may be NULL).
+ * @param[out] key The key.
+ * @retval EVALRESP_OK on success (nothing is logged on failure, so that the
+ *         file can then be processed as usual).
+ */
+int response_cache_key_file (const char *filename, evalresp_options const *options,
+                             evalresp_filter const *filter, response_cache_key *key);
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Add the cached responses for a key to a collection.
+ * @details A missing or damaged entry is a miss, not an error.  A found
+ *          entry is marked as most recently used.
+ * @param[in] log Logging structure.
+ * @param[in] dir The cache directory.
+ * @param[in] key The key.
+ * @param[in,out] responses The collection (allocated if NULL).
+ * @param[out] hit Non-zero if the responses were found.
+ * @retval EVALRESP_OK on success
+ */
+int response_cache_load (evalresp_logger *log, const char *dir, const response_cache_key *key,
+                         evalresp_responses **responses, int *hit);
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Save the responses from @p first onwards under a key.
+ * @details The entry is written to a temporary file that is renamed into
+ *          place, so concurrent readers and writers never see a partial
+ *          entry.  Failures are logged as warnings only.  The cache is not
+ *          trimmed to its size here (see response_cache_evict()).
+ * @param[in] log Logging structure.
+ * @param[in] dir The cache directory.
+ * @param[in] key The key.
+ * @param[in] responses The collection.
+ * @param[in] first Index of the first response to save.
+ */
+void response_cache_save (evalresp_logger *log, const char *dir,
+                          const response_cache_key *key, const evalresp_responses *responses,
+                          int first);
+
+/**
+ * @private
+ * @ingroup evalresp_private_cache
+ * @brief Remove the least recently used entries until the cache directory
+ *        holds at most @p max_bytes.
+ * @details This reads the whole directory, so is called once per run rather
+ *          than after each save.  Other processes may be doing the same, so
+ *          failures are ignored.
+ * @param[in] log Logging structure.
+ * @param[in] dir The cache directory.
+ * @param[in] max_bytes Size of the cache.
+ */
+void response_cache_evict (evalresp_logger *log, const char *dir, size_t max_bytes);
+
+/* routines used to spread work over several threads */
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Work done by run_parallel() on the items [@p begin, @p end).
+ * @param[in,out] arg Data passed to run_parallel().
+ * @param[in] thread Index of the thread doing the work (0 to the number of
+ *            threads - 1), so that each thread can use its own scratch space.
+ * @param[in] begin First item.
+ * @param[in] end One past the last item.
+ * @retval EVALRESP_OK on success
+ */
+typedef int (*parallel_task) (void *arg, int thread, int begin, int end);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief A mutex (pthreads or Win32 critical section).
+ */
+typedef struct evalresp_mutex_s evalresp_mutex;
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Allocate and initialize a mutex.
+ * @param[in] log Logging structure.
+ * @param[out] mutex The new mutex.
+ * @retval EVALRESP_OK on success
+ */
+int mutex_new (evalresp_logger *log, evalresp_mutex **mutex);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Lock a mutex.
+ * @param[in] mutex Mutex to lock.
+ */
+void mutex_lock (evalresp_mutex *mutex);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Unlock a mutex.
+ * @param[in] mutex Mutex to unlock.
+ */
+void mutex_unlock (evalresp_mutex *mutex);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Free a mutex.
+ * @param[in,out] mutex Mutex to free (set to NULL).
+ */
+void mutex_free (evalresp_mutex **mutex);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief The number of threads to use for a thread count option.
+ * @param[in] nthreads Requested number of threads, EVALRESP_THREADS_AUTO
+ *            for one per processor.
+ * @returns the number of threads (at least 1).
+ */
+int parallel_threads (int nthreads);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Call @p task on blocks of @p block items out of @p n, using up to
+ *        @p nthreads threads.
+ * @details The calling thread takes part as thread 0 and the blocks are
+ *          claimed in order as threads become free.  When a task fails no
+ *          further blocks are started and the status of the first failing
+ *          block (in item order) is returned, so the result does not depend
+ *          on how the blocks were scheduled.  With a single thread the
+ *          blocks are simply run in order.
+ * @param[in] log Logging structure (only used from the calling thread).
+ * @param[in] nthreads Number of threads (see parallel_threads()).
+ * @param[in] n Number of items.
+ * @param[in] block Number of items per call to @p task.
+ * @param[in] task Work to do.
+ * @param[in,out] arg Data passed to @p task.
+ * @retval EVALRESP_OK on success
+ */
+int run_parallel (evalresp_logger *log, int nthreads, int n, int block,
+                  parallel_task task, void *arg);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Work done by run_pipeline() for one stage of one item.
+ * @param[in,out] arg Data passed to run_pipeline().
+ * @param[in] stage The stage (0 to the number of stages - 1).
+ * @param[in] item The item; its data can be kept in slot @p item % depth,
+ *            which is not used by any other item until this one has left
+ *            the last stage.
+ * @retval EVALRESP_OK on success
+ */
+typedef int (*pipeline_task) (void *arg, int stage, int item);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Pass @p n items, in order, through @p nstages stages that run
+ *        concurrently, with at most @p depth items between the first and
+ *        the last stage.
+ * @details Each stage but the last has its own thread and the calling
+ *          thread runs the last stage, so that stage alone may use @p log.
+ *          A stage takes the items in order, so the last stage sees them in
+ *          order too.  When a stage fails for an item, no later item is
+ *          started by any stage, but the items before it complete the
+ *          pipeline; the status of the first failing item is returned, as
+ *          it would be processing the items serially.  With a depth below
+ *          2 (or a single stage) each item is taken through all the stages
+ *          in turn on the calling thread.
+ * @param[in] log Logging structure (only used from the calling thread).
+ * @param[in] nstages Number of stages.
+ * @param[in] n Number of items.
+ * @param[in] depth Number of items that may be between the stages.
+ * @param[in] task Work to do.
+ * @param[in,out] arg Data passed to @p task.
+ * @param[out] failed The first item that failed (@p n if none), whose data
+ *             may still be held when it failed before the last stage.
+ * @retval EVALRESP_OK on success
+ */
+int run_pipeline (evalresp_logger *log, int nstages, int n, int depth,
+                  pipeline_task task, void *arg, int *failed);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Work done by run_ordered() for one item.
+ * @param[in,out] arg Data passed to run_ordered().
+ * @param[in] thread The thread (0 to the number of threads - 1).
+ * @param[in] item The item.
+ * @param[in] in_order Zero for the first call, made for several items at
+ *            once; non-zero for the second, made for one item at a time in
+ *            increasing order.
+ * @retval EVALRESP_OK on success
+ */
+typedef int (*ordered_task) (void *arg, int thread, int item, int in_order);
+
+/**
+ * @private
+ * @ingroup evalresp_private_parallel
+ * @brief Work on @p n independent items with a pool of threads, finishing
+ *        each in order.
+ * @details Each item is given to @p task twice: first on any thread, at
+ *          the same time as other items, then in item order, never two at
+ *          once (though not always on the same thread), so results can be
+ *          written or logged as they would be serially.  At most twice
+ *          @p nthreads items are between the two calls.  Unlike
+ *          run_parallel(), every item is processed even when some fail,
+ *          and the status of the first failing item is returned.
+ * @param[in] log Logging structure (only used from the calling thread).
+ * @param[in] nthreads Number of threads (see parallel_threads()).
+ * @param[in] n Number of items.
+ * @param[in] task Work to do.
+ * @param[in,out] arg Data passed to @p task.
+ * @param[out] failed The first item that failed (@p n if none).
+ * @retval EVALRESP_OK on success
+ */
+int run_ordered (evalresp_logger *log, int nthreads, int n,
+                 ordered_task task, void *arg, int *failed);
+
 /**
  * @private
  * @ingroup evalresp_private_string
@@ -878,6 +1644,93 @@ int is_time (const char *test, evalresp_logger *log);
  */
 int timecmp (evalresp_datetime *dt1, evalresp_datetime *dt2);
 
+/**
+ * @private
+ * @ingroup evalresp_private_response
+ * @brief The splines through the amplitudes and (unwrapped) phases of a
+ *        response list, so that interpolating the list again only costs
+ *        the evaluation.
+ * @details Made when the channel is read and not changed afterwards, so it
+ *          can be used from several threads.  It is only used while the list
+ *          has the arrays it was made from.
+ */
+typedef struct evalresp_list_spline_s
+{
+  int nresp;           /**< Number of points. */
+  const double *freq;  /**< Frequencies the splines were made from. */
+  const double *amp;   /**< Amplitudes the splines were made from. */
+  const double *phase; /**< Phases the splines were made from. */
+  double min_amp;      /**< Smallest amplitude. */
+  double *amp_ypp;     /**< Second derivatives of the amplitude spline. */
+  double *unwrapped;   /**< Unwrapped phases. */
+  double *phase_ypp;   /**< Second derivatives of the phase spline. */
+  int unwrapped_flag;  /**< Were any phases unwrapped? */
+} evalresp_list_spline;
+
+/**
+ * @private
+ * @ingroup evalresp_private_response
+ * @brief Make the splines through a response list.
+ * @param[in] log Logging structure.
+ * @param[in] number_points Number of values (at least 2).
+ * @param[in] frequency Array of frequency values, strictly increasing.
+ * @param[in] amplitude Array of amplitude values.
+ * @param[in] phase Array of phase values.
+ * @param[out] spline The splines, to be freed with free_list_spline().
+ * @retval EVALRESP_OK on success
+ */
+int list_spline_new (evalresp_logger *log, int number_points, double *frequency,
+                     double *amplitude, double *phase, evalresp_list_spline **spline);
+
+/**
+ * @private
+ * @ingroup evalresp_private_response
+ * @brief Make the splines of a response list blockette, if it can be
+ *        interpolated.
+ * @param[in] log Logging structure.
+ * @param[in,out] blkt List blockette.
+ * @retval EVALRESP_OK on success (including lists that are not increasing
+ *         in frequency, which are left without)
+ */
+int list_blkt_spline (evalresp_logger *log, evalresp_blkt *blkt);
+
+/**
+ * @private
+ * @ingroup evalresp_private_response
+ * @brief Free the splines of a response list.
+ * @param[in,out] spline The splines (set to NULL).
+ */
+void free_list_spline (evalresp_list_spline **spline);
+
+/**
+ * @private
+ * @ingroup evalresp_private_response
+ * @brief Interpolates amplitude and phase values from the set of frequencies
+ *        in the List blockette to the requested set of frequencies, into
+ *        new arrays.
+ * @details The given arrays are not changed.  Requested frequencies outside
+ *          the list are dropped, so @p nout may be less than
+ *          @p req_num_freqs.  The splines are made here unless @p spline
+ *          was made from the given arrays.
+ * @param[in] frequency Array of frequency values.
+ * @param[in] amplitude Array of amplitude values.
+ * @param[in] phase Array of phase values.
+ * @param[in] number_points Number of values in the arrays.
+ * @param[in] spline Splines through the arrays (or NULL).
+ * @param[in] req_freq_arr Array of requested frequency values.
+ * @param[in] req_num_freqs Number values in @p req_freq_arr array.
+ * @param[out] freq_out Allocated array of the frequencies used.
+ * @param[out] amp_out Allocated array of the interpolated amplitudes.
+ * @param[out] phase_out Allocated array of the interpolated phases.
+ * @param[out] nout Number of values in the output arrays.
+ * @param[in] log Logging structure.
+ * @retval EVALRESP_OK on success
+ */
+int interpolate_list (double *frequency, double *amplitude, double *phase,
+                      int number_points, evalresp_list_spline const *spline, double *req_freq_arr, int req_num_freqs,
+                      double **freq_out, double **amp_out, double **phase_out,
+                      int *nout, evalresp_logger *log);
+
 /**
  * @private
  * @ingroup evalresp_private_response
@@ -966,6 +1819,65 @@ parse_double (evalresp_logger *log, const char *name, const char *str, double *v
 int
 calloc_doubles (evalresp_logger *log, const char *name, int n, double **array);
 
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in] filename the file to read
+ * @param[in] options options that select (or autodetect) StationXML
+ * @param[out] seed the contents of the file, converted to RESP from
+ * StationXML if necessary, to be free'd by the caller
+ * @brief Read a file, ready for evalresp_char_to_channels().
+ * @retval EVALRESP_OK on success
+ */
+int filename_to_char (evalresp_logger *log, const char *filename, evalresp_options const *const options,
+                      char **seed);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in] seed_or_xml the contents of a file, as from filename_to_char()
+ * @param[in] options options used while parsing (the output unit)
+ * @param[out] channels every channel in the file, unchecked and unfiltered
+ * @brief Parse all the channels in a file, ready for select_channels().
+ * @retval EVALRESP_OK on success
+ */
+int collect_channels (evalresp_logger *log, const char *seed_or_xml,
+                      evalresp_options const *const options, evalresp_channels **channels);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in] all_channels channels from collect_channels(), which are not
+ * changed
+ * @param[in] filter selects the channels (may be NULL)
+ * @param[out] channels checked copies of the selected channels
+ * @brief Select channels as evalresp_char_to_channels() does, leaving the
+ * parsed channels to be used again.
+ * @retval EVALRESP_OK on success
+ */
+int select_channels (evalresp_logger *log, const evalresp_channels *all_channels,
+                     const evalresp_filter *filter, evalresp_channels **channels);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in] cache the parsed files
+ * @param[in] filename the file to read
+ * @param[in] options options used while reading and parsing
+ * @param[in] filter selects the channels
+ * @param[out] channels the selected channels
+ * @brief As evalresp_filename_to_channels(), but parsing the file only if it
+ * is not in the cache (when it is added).
+ * @retval EVALRESP_OK on success
+ */
+int inventory_cache_channels (evalresp_logger *log, evalresp_inventory_cache *cache,
+                              const char *filename, evalresp_options const *options,
+                              const evalresp_filter *filter, evalresp_channels **channels);
+
 /**
  * @private
  * @ingroup evalresp_private
@@ -973,11 +1885,14 @@ calloc_doubles (evalresp_logger *log, const char *name, int n, double **array);
  * @param[in] options object to control the flow of the conversion to responses
  * @param[in] filter object on how to filter the inputed files
  * @param[out] responses object pointer containing responses
+ * @param[out] sensitivities object pointer containing sensitivities, used
+ * instead of responses if options->sensitivity_only is set (may be NULL)
  * @brief take information from file and converthem into responses
  * @retval EVALRESP_OK on success
  */
 int process_cwd (evalresp_logger *log, evalresp_options *options,
-                 evalresp_filter *filter, evalresp_responses **responses);
+                 evalresp_filter *filter, evalresp_responses **responses,
+                 evalresp_sensitivities **sensitivities);
 
 /**
  * @private
@@ -986,11 +1901,81 @@ int process_cwd (evalresp_logger *log, evalresp_options *options,
  * @param[in] options object to control the flow of the conversion to responses
  * @param[in] filter object on how to filter the inputed files
  * @param[out] responses object pointer containing responses
+ * @param[out] sensitivities object pointer containing sensitivities, used
+ * instead of responses if options->sensitivity_only is set (may be NULL)
  * @brief take information form stdin and convert them to responses
  * @retval EVALRESP_OK on success
  */
 int process_stdio (evalresp_logger *log, evalresp_options *options,
-                   evalresp_filter *filter, evalresp_responses **responses);
+                   evalresp_filter *filter, evalresp_responses **responses,
+                   evalresp_sensitivities **sensitivities);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] format File format.
+ * @brief Is the file format binary (raw or NumPy)?
+ * @retval 1 for binary formats, 0 for text
+ */
+int is_binary_file_format (evalresp_file_format format);
+
+#ifndef EVALRESP_MAX_OUTPUT_FILES
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Largest number of files written for each response by an output
+ *        format.
+ */
+#define EVALRESP_MAX_OUTPUT_FILES 2
+#endif
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] format output format
+ * @param[out] file_formats array of EVALRESP_MAX_OUTPUT_FILES formats of the
+ * files written for each response
+ * @brief The formats of the files that make up an output format.
+ * @returns The number of files (0 for an unknown format).
+ */
+int output_file_formats (evalresp_output_format format, evalresp_file_format *file_formats);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] options options that select the output format
+ * @brief Should the phase be unwrapped for the output format (FAP is always
+ * unwrapped)?
+ * @retval 1 if the phase should be unwrapped
+ */
+int output_unwrap (evalresp_options const *options);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in] response the response to be written
+ * @param[in] format the file format
+ * @param[in] use_stdio flag to give the name used as a title on stdout
+ * @param[out] filename the name of the file, to be free'd by the caller
+ * @brief The name of the file for a response (eg FAP.IU.ANMO.00.BHZ).
+ * @retval EVALRESP_OK on success
+ */
+int response_filename (evalresp_logger *log, const evalresp_response *response,
+                       evalresp_file_format format, int use_stdio, char **filename);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in] options options that select where (container, ZIP archive, or
+ * files in the cwd or stdout) and how the responses are written
+ * @param[in] responses the responses to write
+ * @brief Write responses as selected by the options.
+ * @retval EVALRESP_OK on success
+ */
+int responses_to_output (evalresp_logger *log, evalresp_options const *options,
+                         const evalresp_responses *responses);
 
 /**
  * @private
@@ -1006,6 +1991,189 @@ int process_stdio (evalresp_logger *log, evalresp_options *options,
 int responses_to_cwd (evalresp_logger *log, const evalresp_responses *responses,
                       int unwrap, evalresp_output_format format, int use_stdio);
 
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Text that is collected in memory or, when @p file is set, written
+ *        to a stream as it fills.
+ */
+typedef struct
+{
+  char *text;  /**< The text (not nul terminated). */
+  size_t len;  /**< Bytes used. */
+  size_t size; /**< Bytes allocated. */
+  FILE *file;  /**< Stream that receives the text, or NULL. */
+} text_buffer;
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Store the low @p nbytes bytes of a value, least significant first.
+ * @param[out] out Destination.
+ * @param[in] value Value to store.
+ * @param[in] nbytes Number of bytes to store.
+ */
+void put_le (unsigned char *out, uint64_t value, int nbytes);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Store a double as 8 little-endian bytes.
+ * @param[out] out Destination.
+ * @param[in] value Value to store.
+ */
+void put_le_double (unsigned char *out, double value);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Read a value stored by put_le().
+ * @param[in] bytes Source.
+ * @param[in] nbytes Number of bytes to read.
+ * @returns The value.
+ */
+uint64_t get_le (const unsigned char *bytes, int nbytes);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Read a double stored by put_le_double().
+ * @param[in] bytes Source.
+ * @returns The value.
+ */
+double get_le_double (const unsigned char *bytes);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Format a value as printf's "%.6E" does.
+ * @details The seven significant digits come from a single scaling by an
+ *          exact power of ten, which decides the rounding correctly unless
+ *          the scaled value is within 1e-6 of a tie.  Those values, values
+ *          outside the range of the exact powers, and non-finite values are
+ *          passed to snprintf, so the text is always identical.
+ * @param[in] value Value to format.
+ * @param[out] out Buffer of at least FORMAT_E6_SIZE bytes.
+ * @returns The length of the (nul terminated) text.
+ */
+int format_e6 (double value, char *out);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Make room for @p n more bytes in a text buffer, writing out what
+ *        is held first if the buffer has a stream.
+ * @param[in] log Logging structure.
+ * @param[in,out] buffer Text buffer.
+ * @param[in] n Number of bytes needed.
+ * @retval EVALRESP_OK on success
+ */
+int text_buffer_reserve (evalresp_logger *log, text_buffer *buffer, size_t n);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Add @p n bytes of text to a text buffer.
+ * @param[in] log Logging structure.
+ * @param[in,out] buffer Text buffer.
+ * @param[in] text Text to add.
+ * @param[in] n Number of bytes to add.
+ * @retval EVALRESP_OK on success
+ */
+int text_buffer_append (evalresp_logger *log, text_buffer *buffer, const char *text, size_t n);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Add a value, formatted by format_e6(), to a text buffer.
+ * @param[in] log Logging structure.
+ * @param[in,out] buffer Text buffer.
+ * @param[in] value Value to add.
+ * @retval EVALRESP_OK on success
+ */
+int text_buffer_append_e6 (evalresp_logger *log, text_buffer *buffer, double value);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Write any text held by a text buffer to its stream (if any), and
+ *        flush the stream.
+ * @param[in] log Logging structure.
+ * @param[in,out] buffer Text buffer.
+ * @retval EVALRESP_OK on success
+ */
+int text_buffer_flush (evalresp_logger *log, text_buffer *buffer);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in] response the response to write
+ * @param[in] unwrap whether to unwrap phase
+ * @param[in] format the file format (text or binary)
+ * @param[in,out] buffer buffer that receives the contents of the file
+ * @brief Add the contents of a file for a response to a buffer.
+ * @retval EVALRESP_OK on success
+ */
+int response_to_buffer (evalresp_logger *log, const evalresp_response *response,
+                        int unwrap, evalresp_file_format format, text_buffer *buffer);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @brief Destination for responses that arrive in batches (see
+ *        response_writer_open()).
+ */
+typedef struct
+{
+  evalresp_options const *options; /**< Options that select the output. */
+  evalresp_responses *kept;        /**< Responses kept until the container is written, or NULL. */
+  struct _zipc_s *zip;             /**< ZIP archive being written, or NULL. */
+  text_buffer buffer;              /**< Contents of each file added to the ZIP archive. */
+  int nzipped;                     /**< Number of files in the ZIP archive. */
+} response_writer;
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in] options options that select where (container, ZIP archive, or
+ * files in the cwd or stdout) and how the responses are written; these must
+ * remain until the writer is closed
+ * @param[out] writer the writer
+ * @brief Start writing responses, as responses_to_output() would, in
+ * batches.
+ * @details Files in the cwd (or stdout) and ZIP archive entries are written
+ * with each batch, but a container starts with its index, so the responses
+ * for a container are kept until the writer is closed.
+ * @retval EVALRESP_OK on success
+ */
+int response_writer_open (evalresp_logger *log, evalresp_options const *options, response_writer *writer);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in,out] writer the writer
+ * @param[in,out] responses the next batch of responses; any kept for a
+ * container are removed
+ * @brief Write a batch of responses.
+ * @retval EVALRESP_OK on success
+ */
+int response_writer_write (evalresp_logger *log, response_writer *writer, evalresp_responses *responses);
+
+/**
+ * @private
+ * @ingroup evalresp_private
+ * @param[in] log logging structure
+ * @param[in,out] writer the writer
+ * @param[in] status the status so far; a container is only written if this
+ * is EVALRESP_OK
+ * @brief Finish writing and free the resources held by the writer.
+ * @retval EVALRESP_OK on success
+ */
+int response_writer_close (evalresp_logger *log, response_writer *writer, int status);
+
 int                                     /* O - Number of bytes formatted */
 _evalresp_snprintf (char *buffer,       /* I - Output buffer */
                     size_t bufsize,     /* I - Size of output buffer */
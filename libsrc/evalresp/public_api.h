@@ -408,9 +408,13 @@ void evalresp_free_filter (evalresp_filter **filter);
  * @brief Enumeration of output formats (FAP, complex, etc - can require multiple files).
  */
 typedef enum {
-  evalresp_ap_output_format,     /**< Two files, AMP and PHASE. */
-  evalresp_fap_output_format,    /**< One file, FAP. */
-  evalresp_complex_output_format /**< One file, COMPLEX. */
+  evalresp_ap_output_format,          /**< Two files, AMP and PHASE. */
+  evalresp_fap_output_format,         /**< One file, FAP. */
+  evalresp_complex_output_format,     /**< One file, COMPLEX. */
+  evalresp_raw_fap_output_format,     /**< One binary file, FAP...raw (see evalresp_raw_fap_file_format). */
+  evalresp_raw_complex_output_format, /**< One binary file, SPECTRA...raw (see evalresp_raw_complex_file_format). */
+  evalresp_npy_fap_output_format,     /**< One NumPy file, FAP...npy (see evalresp_npy_fap_file_format). */
+  evalresp_npy_complex_output_format  /**< One NumPy file, SPECTRA...npy (see evalresp_npy_complex_file_format). */
 } evalresp_output_format;
 
 /**
@@ -425,8 +429,47 @@ typedef enum {
   evalresp_acceleration_unit  /**< Acceleration units. */
 } evalresp_unit;
 
-#define EVALRESP_ALL_STAGES -1 /**< Default for start and stop stage. */
-#define EVALRESP_NO_FREQ -1    /**< Default for frequency limits. */
+#define EVALRESP_ALL_STAGES -1        /**< Default for start and stop stage. */
+#define EVALRESP_NO_FREQ -1           /**< Default for frequency limits. */
+#define EVALRESP_THREADS_AUTO 0       /**< Use one thread per processor. */
+#define EVALRESP_PARALLEL_NFREQ 32768 /**< Default for parallel_nfreq. */
+#define EVALRESP_SIMPLIFY_TOL 1e-9    /**< Default for simplify_tol. */
+#define EVALRESP_RESPONSE_CACHE_BYTES (256 * 1024 * 1024) /**< Default for response_cache_bytes. */
+#define EVALRESP_ADAPTIVE_MAX_NFREQ 1048576 /**< Default for adaptive_max_nfreq. */
+#define EVALRESP_PIPELINE_DEPTH 4     /**< Default for pipeline_depth. */
+#define EVALRESP_INVENTORY_CACHE_BYTES (256 * 1024 * 1024) /**< Suggested size for evalresp_new_inventory_cache(). */
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @brief A cache of evaluated stages that can be shared between channels
+ * (see evalresp_new_stage_cache()).
+ */
+typedef struct evalresp_stage_cache_s evalresp_stage_cache;
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @brief Frequencies, with the tables derived from them, that can be shared
+ * between channels (see evalresp_new_freq_grid()).
+ */
+typedef struct evalresp_freq_grid_s evalresp_freq_grid;
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @brief The RESP files in the directories searched for SNCLs, read once and
+ * indexed by station (see evalresp_new_catalog()).
+ */
+typedef struct evalresp_catalog_s evalresp_catalog;
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @brief The channels parsed from input files, kept so that they can be
+ * used again (see evalresp_new_inventory_cache()).
+ */
+typedef struct evalresp_inventory_cache_s evalresp_inventory_cache;
 
 /**
  * @public
@@ -453,6 +496,24 @@ typedef struct
   evalresp_output_format format; /**< Output format (AMP and PHA by default). */
   evalresp_unit unit;            /**< Output unit (displacement by default). */
   int verbose;                   /**< Verbose output? */
+  int threads;                   /**< Number of threads used to evaluate channels (1, the default, evaluates serially; EVALRESP_THREADS_AUTO uses one per processor). */
+  int freq_threads;              /**< Number of threads used to evaluate a single response with many frequencies (one per processor, EVALRESP_THREADS_AUTO, by default). */
+  int parallel_nfreq;            /**< Number of frequencies from which a single response is split over freq_threads (EVALRESP_PARALLEL_NFREQ by default, 0 never splits). */
+  int single_precision;          /**< Evaluate well conditioned filters in single precision, to about 5 significant digits (double by default)? */
+  int simplify;                  /**< Merge pole-zero filters, cancel matching zeros and poles, and drop trivial factors before evaluating (off by default)? */
+  double simplify_tol;           /**< Largest relative change in the response allowed for each cancelled zero-pole pair (EVALRESP_SIMPLIFY_TOL by default). */
+  double adaptive_tol;           /**< If positive, refine the frequencies (starting from min_freq, max_freq, nfreq and lin_freq) until the response between them can be interpolated to this tolerance (relative amplitude, or phase in radians); not for blockette 55 (0, a fixed set of frequencies, by default). */
+  int adaptive_max_nfreq;        /**< Largest number of frequencies chosen with adaptive_tol (EVALRESP_ADAPTIVE_MAX_NFREQ by default). */
+  int sensitivity_only;          /**< Only check the sensitivity of each channel, printing a table instead of responses (evalresp_cwd_to_cwd() only; off by default)? */
+  char *response_cache;          /**< Directory in which evalresp_cwd_to_cwd() keeps the responses evaluated from each input file, reusing them (without parsing or evaluating) when the file, filter and options match (none by default). */
+  size_t response_cache_bytes;   /**< Size above which the least recently used responses are removed from response_cache at the end of each run (EVALRESP_RESPONSE_CACHE_BYTES by default). */
+  char *container;               /**< File to which evalresp_cwd_to_cwd() writes all responses, as a single container (see evalresp_responses_to_container()), instead of one file per response (none by default). */
+  char *zip;                     /**< ZIP archive to which evalresp_cwd_to_cwd() writes the files for each response, instead of the current directory (none by default). */
+  int pipeline_depth;            /**< Number of input files that evalresp_cwd_to_cwd() may hold at once while it reads, parses, evaluates and writes them, each step on its own thread (EVALRESP_PIPELINE_DEPTH by default; below 2 the files are processed one at a time). */
+  evalresp_stage_cache *stage_cache; /**< Cache of evaluated stages shared between channels (none by default; not freed with the options). */
+  evalresp_freq_grid *freq_grid;     /**< Frequencies to evaluate, replacing min_freq, max_freq, nfreq and lin_freq (none by default; not freed with the options). */
+  evalresp_catalog *catalog;         /**< Index of the RESP files searched by evalresp_cwd_to_cwd() (none by default, when each run reads the directories again; not freed with the options). */
+  evalresp_inventory_cache *inventory_cache; /**< Channels parsed from the input files of evalresp_cwd_to_cwd(), used again while the file is unchanged (none by default, when each run parses the files again; not freed with the options). */
 } evalresp_options;
 
 /**
@@ -496,7 +557,8 @@ int evalresp_set_frequency (evalresp_logger *log, evalresp_options *options,
  * @ingroup evalresp_public_options
  * @param[in] log logging structure
  * @param[in] options evalresp_option in which the value is to be added
- * @param[in] format the format string, valid strings are "AP", "FAP", and "CS"
+ * @param[in] format the format string, valid strings are "AP", "FAP", "CS",
+ * "RAW", "RAWCS", "NPY" and "NPYCS"
  * @brief Set the output format from a string.  Alternatively the format can be set directly
  * from @ref evalresp_output_format.
  * @retval EVALRESP_OK on success
@@ -571,6 +633,85 @@ int evalresp_set_stop_stage (evalresp_logger *log, evalresp_options *options,
 int evalresp_set_b62_x (evalresp_logger *log, evalresp_options *options,
                         const char *b62_x);
 
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @param[in] log logging structure
+ * @param[in] options evalresp_option in which the value is to be added
+ * @param[in] threads number of threads as a string, "0" means one per processor
+ * @brief Set the number of threads used to evaluate channels from a string.
+ * Alternatively the numerical value can be set directly.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_set_threads (evalresp_logger *log, evalresp_options *options,
+                          const char *threads);
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @param[in] log logging structure
+ * @param[in] options evalresp_option in which the value is to be added
+ * @param[in] tol tolerance as a string, "0" to evaluate at fixed frequencies
+ * @brief Set the tolerance for adaptive frequency sampling from a string
+ * (see evalresp_options.adaptive_tol).  Alternatively the numerical value
+ * can be set directly.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_set_adaptive_tol (evalresp_logger *log, evalresp_options *options,
+                               const char *tol);
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @param[in] log logging structure
+ * @param[in] options evalresp_option in which the value is to be added
+ * @param[in] dir directory for the response cache (created if missing)
+ * @brief Set the directory in which responses are cached between runs
+ * (see evalresp_options.response_cache).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_set_response_cache (evalresp_logger *log, evalresp_options *options,
+                                 const char *dir);
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @param[in] log logging structure
+ * @param[in] options evalresp_option in which the value is to be added
+ * @param[in] filename the container file
+ * @brief Set the container to which all responses are written
+ * (see evalresp_options.container).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_set_container (evalresp_logger *log, evalresp_options *options,
+                            const char *filename);
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @param[in] log logging structure
+ * @param[in] options evalresp_option in which the value is to be added
+ * @param[in] filename the ZIP archive
+ * @brief Set the ZIP archive to which the response files are written
+ * (see evalresp_options.zip).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_set_zip (evalresp_logger *log, evalresp_options *options,
+                      const char *filename);
+
+/**
+ * @public
+ * @ingroup evalresp_public_options
+ * @param[in] log logging structure
+ * @param[in] options evalresp_option in which the value is to be added
+ * @param[in] depth number of files as a string
+ * @brief Set the number of input files held at once by evalresp_cwd_to_cwd()
+ * from a string (see evalresp_options.pipeline_depth).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_set_pipeline_depth (evalresp_logger *log, evalresp_options *options,
+                                 const char *depth);
+
 /**
  * @public
  * @ingroup evalresp_public_options
@@ -656,23 +797,456 @@ int evalresp_channel_to_response (evalresp_logger *log, evalresp_channel *channe
  * @param[in,out] responses a pointer to an @ref evalresp_responses object (a collection of responses);
  * if *responses == NULL then it will be allocated
  * @brief All the channels are evaluated and the responses added to the collection.
+ * @details If options->threads is not 1 the channels are evaluated concurrently.  The
+ * responses are still added in channel order, and the log messages for each channel
+ * are passed to @p log together, in channel order.  Evaluation stops at the first
+ * channel that fails: the responses before it are kept and its error is returned.
  * @retval EVALRESP_OK on success
  */
 int evalresp_channels_to_responses (evalresp_logger *log, evalresp_channels *channels,
                                     evalresp_options *options, evalresp_responses **responses);
 
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] channel channel object to be checked
+ * @param[in] options options control how the channel is normalized (the
+ * frequency options are not used; NULL for defaults)
+ * @param[out] sensitivity an allocated sensitivity for the channel
+ * @brief Normalize a channel and report its sensitivity, the sensitivity
+ * calculated from its stages, and the gain of each stage, without
+ * evaluating the response at any other frequency.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_channel_to_sensitivity (evalresp_logger *log, evalresp_channel const *channel,
+                                     evalresp_options const *options, evalresp_sensitivity **sensitivity);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] channels channels to be checked
+ * @param[in] options options control how the channels are normalized
+ * @param[in,out] sensitivities a pointer to an @ref evalresp_sensitivities object;
+ * if *sensitivities == NULL then it will be allocated
+ * @brief All the channels are checked and their sensitivities added to the collection.
+ * @details Channels are processed concurrently and stop at the first failure
+ * exactly as for evalresp_channels_to_responses().
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_channels_to_sensitivities (evalresp_logger *log, evalresp_channels *channels,
+                                        evalresp_options *options, evalresp_sensitivities **sensitivities);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @brief A channel compiled for evaluation (see evalresp_channel_to_plan()).
+ */
+typedef struct evalresp_plan_s evalresp_plan;
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] channel channel object to be compiled
+ * @param[in] options options control how responses are evaluated (the
+ * frequency options are not used)
+ * @param[out] plan an allocated plan that can be evaluated at any frequencies
+ * @brief Normalize a channel (@ref evalresp_public_low_level_channel) and resolve its stages
+ * into a flat sequence of operations, so that repeated evaluation does not
+ * walk the channel again.
+ * @retval EVALRESP_OK on success
+ * @note The normalization is held by the plan and the channel is not
+ * modified, so one channel can be compiled and evaluated concurrently (with
+ * different options) from several threads.  The plan refers to the
+ * coefficients of the channel, which must not be freed before the plan.
+ */
+int evalresp_channel_to_plan (evalresp_logger *log, evalresp_channel const *channel,
+                              evalresp_options const *const options, evalresp_plan **plan);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] plan plan created by evalresp_channel_to_plan()
+ * @param[in] freqs frequencies (Hz) at which to evaluate the response
+ * @param[in] nfreqs number of frequencies
+ * @param[out] output caller allocated array of nfreqs values
+ * @brief Evaluate a compiled plan at the given frequencies.
+ * @details Nothing is allocated unless the frequencies are split over
+ * threads (see the freq_threads and parallel_nfreq options) or a stage cache
+ * is used, so a plan can be evaluated repeatedly (in a deconvolution loop,
+ * say) into the same buffer without touching the heap.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_plan_evaluate (evalresp_logger *log, evalresp_plan const *plan,
+                            double const *freqs, int nfreqs, evalresp_complex *output);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] plan plan created by evalresp_channel_to_plan()
+ * @param[in] freqs frequencies (Hz) at which to evaluate the response
+ * @param[in] nfreqs number of frequencies
+ * @param[out] real caller allocated array of nfreqs real parts
+ * @param[out] imag caller allocated array of nfreqs imaginary parts
+ * @brief Evaluate a compiled plan at the given frequencies, as
+ * evalresp_plan_evaluate(), but writing the real and imaginary parts to
+ * separate arrays (as used by many FFT libraries).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_plan_evaluate_split (evalresp_logger *log, evalresp_plan const *plan,
+                                  double const *freqs, int nfreqs, double *real, double *imag);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] plan a compiled plan
+ * @param[in] freqs initial frequencies, increasing (eg a coarse logarithmic grid)
+ * @param[in] nfreqs the number of initial frequencies
+ * @param[in] lin halve intervals linearly (geometrically by default)?
+ * @param[in] tol tolerance: relative amplitude, or phase in radians
+ * @param[in] max_nfreqs refinement stops, with a warning, rather than exceed this
+ * @param[out] nout the number of frequencies chosen
+ * @param[out] freqs_out the frequencies chosen (allocated; free with free())
+ * @param[out] output the response at each frequency chosen (allocated; free with free())
+ * @brief Evaluate a plan at frequencies refined, from the initial ones, until
+ * interpolating the response between them (amplitude logarithmically,
+ * phase linearly) is within @p tol.
+ * @details Each interval is tested at its middle, so features narrower than
+ * the initial spacing can be missed if the middle happens to agree.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_plan_evaluate_adaptive (evalresp_logger *log, evalresp_plan const *plan,
+                                     double const *freqs, int nfreqs, int lin, double tol,
+                                     int max_nfreqs, int *nout, double **freqs_out,
+                                     evalresp_complex **output);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] blkt a polynomial (blockette 62 or 42) blockette
+ * @param[in] x input values (eg temperatures or pressures)
+ * @param[in] nx number of input values
+ * @param[out] value caller allocated array of nx polynomial values (or NULL)
+ * @param[out] derivative caller allocated array of nx derivatives, ie
+ * sensitivities (or NULL)
+ * @brief Evaluate the MacLaurin polynomial of a blockette, and its
+ * derivative, over an array of inputs.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_polynomial_evaluate (evalresp_logger *log, evalresp_blkt const *blkt,
+                                  double const *x, int nx, double *value, double *derivative);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] plan plan created by evalresp_channel_to_plan() for a channel
+ * with one polynomial stage
+ * @param[in] freq frequency (Hz) at which the other stages are evaluated
+ * @param[in] x input values (eg temperatures or pressures)
+ * @param[in] nx number of input values
+ * @param[out] value caller allocated array of nx output values (or NULL)
+ * @param[out] derivative caller allocated array of nx sensitivities (or NULL)
+ * @brief Evaluate the sensitivity curve of a polynomial channel over an
+ * array of inputs.
+ * @details The other stages are evaluated once and the real part of their
+ * response scales the polynomial and its derivative, so each sensitivity is
+ * the response evalresp_channel_to_response() gives with the b62_x option
+ * set to that input (the plan itself still needs a valid b62_x to compile).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_plan_evaluate_polynomial (evalresp_logger *log, evalresp_plan const *plan,
+                                       double freq, double const *x, int nx,
+                                       double *value, double *derivative);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in,out] plan the plan to free
+ * @brief Free a plan created by evalresp_channel_to_plan().
+ */
+void evalresp_free_plan (evalresp_plan **plan);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @brief Counters describing the use of a evalresp_stage_cache.
+ */
+typedef struct
+{
+  unsigned long hits;      /**< Stages found in the cache. */
+  unsigned long misses;    /**< Stages that had to be evaluated. */
+  unsigned long evictions; /**< Stages removed to keep within the size limit. */
+  int entries;             /**< Stages currently held. */
+  size_t bytes;            /**< Memory currently used. */
+} evalresp_stage_cache_stats;
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] max_bytes the most memory the cache may use
+ * @param[out] cache the allocated cache
+ * @brief Allocate a cache of evaluated stages.
+ * @details When options->stage_cache is set, the response of each stage is
+ * looked up by a canonical description of its filters (type, coefficients or
+ * poles and zeros, normalization, sample interval and delay) and of the
+ * frequencies evaluated.  A stage repeated across channels evaluated at the
+ * same frequencies (the same digitizer FIR cascade on every channel of a
+ * deployment, say) is then evaluated once.  The least recently used stages
+ * are evicted to stay within @p max_bytes.  The cache can be shared by
+ * channels evaluated on several threads.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_new_stage_cache (evalresp_logger *log, size_t max_bytes,
+                              evalresp_stage_cache **cache);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] cache the cache
+ * @param[out] stats the current counters
+ * @brief Read the hit, miss and eviction counters of a cache.
+ */
+void evalresp_stage_cache_get_stats (evalresp_stage_cache *cache,
+                                     evalresp_stage_cache_stats *stats);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in,out] cache the cache to free (set to NULL)
+ * @brief Free a cache of evaluated stages (no plan using it may be evaluated
+ * afterwards).
+ */
+void evalresp_free_stage_cache (evalresp_stage_cache **cache);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] max_bytes the most input (in bytes of the files parsed) whose
+ * channels are kept
+ * @param[out] cache the allocated cache
+ * @brief Allocate a cache of parsed input files.
+ * @details When options->inventory_cache is set, evalresp_cwd_to_cwd() parses
+ * each input file once, keeping every channel in it, and then selects the
+ * channels for each filter from copies of those.  A file is parsed again if
+ * its size or modification time changes, or with different options for
+ * StationXML or the output unit.  The messages logged while a file is parsed
+ * are logged again each time it is used.  The least recently used files are
+ * dropped to stay within @p max_bytes.  The cache can be shared by several
+ * threads.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_new_inventory_cache (evalresp_logger *log, size_t max_bytes,
+                                  evalresp_inventory_cache **cache);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in,out] cache the cache to free (set to NULL)
+ * @brief Free a cache of parsed input files.
+ */
+void evalresp_free_inventory_cache (evalresp_inventory_cache **cache);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] options the min_freq, max_freq, nfreq and lin_freq options
+ * give the frequencies
+ * @param[out] grid the allocated grid
+ * @brief Allocate a frequency grid from the frequency options.
+ * @details A grid holds its frequencies, their angular frequencies and, made
+ * the first time each is needed, tables of e^{-i omega dt} for the sample
+ * intervals and delays of the filters evaluated on it.  Setting
+ * options->freq_grid evaluates every channel on the grid, so that this work
+ * is done once rather than for each channel.  A grid can be used from
+ * several threads at once.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_new_freq_grid (evalresp_logger *log, evalresp_options *options,
+                            evalresp_freq_grid **grid);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] freqs frequencies (Hz), copied into the grid
+ * @param[in] nfreqs number of frequencies
+ * @param[out] grid the allocated grid
+ * @brief Allocate a frequency grid from explicit frequencies (see
+ * evalresp_new_freq_grid()).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_new_freq_grid_from_array (evalresp_logger *log, double const *freqs, int nfreqs,
+                                       evalresp_freq_grid **grid);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] grid the grid
+ * @brief The number of frequencies in a grid.
+ */
+int evalresp_freq_grid_nfreqs (evalresp_freq_grid const *grid);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] grid the grid
+ * @brief The frequencies (Hz) of a grid.
+ */
+double const *evalresp_freq_grid_freqs (evalresp_freq_grid const *grid);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] plan plan created by evalresp_channel_to_plan()
+ * @param[in] grid frequencies at which to evaluate the response
+ * @param[out] output caller allocated array of one value per frequency
+ * @brief Evaluate a compiled plan on a frequency grid (the same values as
+ * evalresp_plan_evaluate() at the grid's frequencies).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_plan_evaluate_grid (evalresp_logger *log, evalresp_plan const *plan,
+                                 evalresp_freq_grid *grid, evalresp_complex *output);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in,out] grid the grid to free (set to NULL)
+ * @brief Free a frequency grid.
+ */
+void evalresp_free_freq_grid (evalresp_freq_grid **grid);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @brief Removes the response of a channel from time series (see
+ * evalresp_new_deconvolver()).
+ */
+typedef struct evalresp_deconvolver_s evalresp_deconvolver;
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] plan the compiled channel (epoch) whose response is removed; it
+ * must not be freed before the deconvolver
+ * @param[in] sample_rate sample rate of the time series (Hz)
+ * @param[in] water_level the smallest amplitude inverted, in dB below the
+ * largest amplitude of the response (eg 60); negative for none
+ * @param[in] pre_filt NULL, or four increasing frequencies (Hz): the result
+ * is tapered (cosine) to zero below the first two and above the last two
+ * @param[in] block samples per block for evalresp_deconvolve_stream() (0 if
+ * not streaming)
+ * @param[in] overlap samples shared by successive blocks when streaming
+ * (less than @p block); half of it at each end of a block is discarded, so
+ * it should span the ringing of the inverse filter (several periods of the
+ * lowest pre-filter frequency)
+ * @param[out] deconvolver the allocated deconvolver
+ * @brief Allocate a deconvolver that divides the spectrum of a time series
+ * by the response of a channel.
+ * @details Each block is zero padded to a power of two at least twice its
+ * length and transformed; the response is evaluated on those frequency
+ * bins, inverted (with the water level and pre-filter) and kept, so blocks
+ * of the same length reuse it.  A deconvolver should be used by one thread
+ * at a time.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_new_deconvolver (evalresp_logger *log, evalresp_plan const *plan, double sample_rate,
+                              double water_level, double const *pre_filt, int block, int overlap,
+                              evalresp_deconvolver **deconvolver);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] deconvolver the deconvolver
+ * @param[in] input the samples of a block (any length; demeaned and
+ * tapered as needed by the caller)
+ * @param[in] n number of samples
+ * @param[out] output @p n deconvolved samples (may be @p input)
+ * @brief Remove the response from a single block of samples.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_deconvolve (evalresp_logger *log, evalresp_deconvolver *deconvolver,
+                         double const *input, int n, double *output);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] deconvolver a deconvolver with a block size
+ * @param[in] input the next samples of the stream (any number)
+ * @param[in] n number of samples
+ * @param[out] output deconvolved samples, in order (room for @p n plus the
+ * block size)
+ * @param[out] nout number of samples written to @p output
+ * @brief Remove the response from a continuous stream of samples.
+ * @details The stream is cut into overlapping blocks; each is deconvolved
+ * and only its middle (the block less the overlap) is output, so the edge
+ * effects of the transform are discarded.  Output lags input by about one
+ * block; evalresp_deconvolve_flush() outputs the rest.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_deconvolve_stream (evalresp_logger *log, evalresp_deconvolver *deconvolver,
+                                double const *input, int n, double *output, int *nout);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in] log logging structure
+ * @param[in] deconvolver a deconvolver with a block size
+ * @param[out] output the remaining deconvolved samples (room for the block size)
+ * @param[out] nout number of samples written to @p output
+ * @brief End a stream (padding with zeros), so that every sample given to
+ * evalresp_deconvolve_stream() has been output, and start a new one.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_deconvolve_flush (evalresp_logger *log, evalresp_deconvolver *deconvolver,
+                               double *output, int *nout);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_evaluation
+ * @param[in,out] deconvolver the deconvolver to free (set to NULL)
+ * @brief Free a deconvolver (but not its plan).
+ */
+void evalresp_free_deconvolver (evalresp_deconvolver **deconvolver);
+
 // --- low level output
 
 /**
  * @public
  * @ingroup evalresp_public_low_level_output
  * @brief Enumeration of output file formats (for a single file).
+ * @details The binary formats hold one row of three little-endian float64
+ *          values per frequency, in the same order as the columns of the
+ *          FAP and COMPLEX text files, and can be mapped into memory as a
+ *          (nfreqs, 3) array after the header.  The raw header is 32 bytes:
+ *          "EVALRESP", a uint32 version (1), a uint32 layout (1 for
+ *          frequency, amplitude and phase; 2 for frequency, real and
+ *          imaginary), a uint64 number of rows and a uint64 number of
+ *          columns (3).  The NumPy files are version 1.0 .npy files with
+ *          the data aligned to 64 bytes.
  */
 typedef enum {
-  evalresp_fap_file_format,       /**< A file containing frequency, amplitude and phase columns. */
-  evalresp_amplitude_file_format, /**< A file containing frequency and amplitude columns. */
-  evalresp_phase_file_format,     /**< A file containing frequency and phase columns. */
-  evalresp_complex_file_format    /**< A file containing frequency and complex response columns. */
+  evalresp_fap_file_format,         /**< A file containing frequency, amplitude and phase columns. */
+  evalresp_amplitude_file_format,   /**< A file containing frequency and amplitude columns. */
+  evalresp_phase_file_format,       /**< A file containing frequency and phase columns. */
+  evalresp_complex_file_format,     /**< A file containing frequency and complex response columns. */
+  evalresp_raw_fap_file_format,     /**< A raw binary file of frequency, amplitude and phase rows. */
+  evalresp_raw_complex_file_format, /**< A raw binary file of frequency, real and imaginary rows. */
+  evalresp_npy_fap_file_format,     /**< A NumPy file of frequency, amplitude and phase rows. */
+  evalresp_npy_complex_file_format  /**< A NumPy file of frequency, real and imaginary rows. */
 } evalresp_file_format;
 
 /**
@@ -683,7 +1257,7 @@ typedef enum {
  * @param[in] unwrap whether to unwrap phase
  * @param[in] format the output format to generate
  * @param[out] output pointer to the char * that the response will be printed into
- * @brief Format an @ref evalresp_response to a string.
+ * @brief Format an @ref evalresp_response to a string (text formats only).
  * @retval EVALRESP_OK on success
  * @post output will be allocated on success and must be free'd by other functions
  */
@@ -699,6 +1273,9 @@ int evalresp_response_to_char (evalresp_logger *log, const evalresp_response *re
  * @param[in] format the output format to generate
  * @param[out] file stream that the response will be printed into
  * @brief Format an @ref evalresp_response to a file stream.
+ * @details The output is formatted into a fixed size buffer that is written
+ * to the stream each time it fills, and the stream is flushed at the end,
+ * so memory use does not grow with the number of frequencies.
  * @retval EVALRESP_OK on success
  */
 int evalresp_response_to_stream (evalresp_logger *log, const evalresp_response *response,
@@ -718,6 +1295,75 @@ int evalresp_response_to_stream (evalresp_logger *log, const evalresp_response *
 int evalresp_response_to_file (evalresp_logger *log, const evalresp_response *response,
                                int unwrap, evalresp_file_format format, const char *filename);
 
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_output
+ * @param[in] log logging structure
+ * @param[in] responses the responses to write
+ * @param[in] options the options used to evaluate the responses, saved with
+ * them (may be NULL)
+ * @param[in] filename the container to create
+ * @brief Write all responses to a single container file.
+ * @details The container starts with a 32 byte header: "EVALRESP", a uint32
+ * version (1), a uint32 layout (3), a uint64 number of responses and a
+ * uint64 length of the options text.  Then, for each response, a 320 byte
+ * index entry holds the network, station, location and channel (64 bytes
+ * each) and the start and end of the epoch (24 bytes each), as nul padded
+ * text, followed by the uint64 offset of the response in the file and its
+ * uint64 number of frequencies.  The options follow the index, as lines of
+ * key=value padded to a multiple of 8 bytes, and then the responses as
+ * rows of frequency, real and imaginary parts.  All numbers are
+ * little-endian and the rows are float64.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_responses_to_container (evalresp_logger *log, const evalresp_responses *responses,
+                                     evalresp_options const *options, const char *filename);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_output
+ * @param[in] log logging structure
+ * @param[in] filename the container to read
+ * @param[out] responses the responses in the container (must be NULL on entry)
+ * @param[out] metadata the options saved with the responses, as lines of
+ * key=value, to be free'd by the caller (may be NULL)
+ * @brief Read the responses written by evalresp_responses_to_container().
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_container_to_responses (evalresp_logger *log, const char *filename,
+                                     evalresp_responses **responses, char **metadata);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_output
+ * @param[in] log logging structure
+ * @param[in] responses the responses to write
+ * @param[in] unwrap whether to unwrap phase
+ * @param[in] format the output format, which selects the files for each
+ * response
+ * @param[in] filename the ZIP archive to create
+ * @brief Write the files for each response (AMP, PHASE, FAP, etc) to a ZIP
+ * archive, instead of the current directory.
+ * @details The archive is limited to 65535 files and 4GB.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_responses_to_zip (evalresp_logger *log, const evalresp_responses *responses,
+                               int unwrap, evalresp_output_format format, const char *filename);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_output
+ * @param[in] log logging structure
+ * @param[in] sensitivities the sensitivities created by evalresp
+ * @param[out] file stream that the table will be printed into
+ * @brief Print a table with one line per channel: the reported and calculated
+ * sensitivities, the frequency, their percentage difference, and the gain of
+ * each stage (as stage:gain).
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_sensitivities_to_stream (evalresp_logger *log, const evalresp_sensitivities *sensitivities,
+                                      FILE *const file);
+
 /**
  * @public
  * @ingroup evalresp_public_low_level_output
@@ -742,9 +1388,82 @@ int evalresp_channel_to_log (evalresp_logger *log, evalresp_options const *const
  * in the options); extracts the channels and evaluates the responses; writes the responses to files
  * in the current directory using names inferred from the output options (although stdout can also
  * be used if specified in the options).
+ * @details Files are read, parsed, evaluated and written in turn, with up to options->pipeline_depth
+ * files held at once, each step on its own thread, so the responses for a file are written (in the
+ * same order and with the same names) while later files are still being read and evaluated.  If a
+ * file fails, the files before it have already been written.
  * @retval EVALRESP_OK on success
  */
 int evalresp_cwd_to_cwd (evalresp_logger *log,
                          evalresp_options *options, evalresp_filter *filter);
 
+/**
+ * @public
+ * @ingroup evalresp_public_high_level
+ * @param[in] log logging structure
+ * @param[in] n number of requests
+ * @param[in] options the options for each request, as for evalresp_cwd_to_cwd()
+ * @param[in] filter the filter for each request, as for evalresp_cwd_to_cwd()
+ * @param[in] threads number of requests evaluated at once (EVALRESP_THREADS_AUTO
+ * uses one per processor)
+ * @param[out] statuses the status of each request (may be NULL)
+ * @brief Run many evalresp_cwd_to_cwd() requests in one call, several at a time.
+ * @details Requests are evaluated on a pool of threads, but their messages and
+ * output are written in request order, so the files written are those of
+ * calling evalresp_cwd_to_cwd() for each request in turn.  Requests can share
+ * a catalog, stage cache and inventory cache through their options, so that
+ * each directory is read, and each file parsed, once for the whole batch.
+ * Every request is run, even when an earlier one fails.  Requests cannot use
+ * stdio.  With more than one thread each response is evaluated on a single
+ * thread (options->freq_threads is not used).
+ * @retval EVALRESP_OK if all the requests succeed, else the status of the
+ * first that failed
+ */
+int evalresp_batch_to_cwd (evalresp_logger *log, int n,
+                           evalresp_options **options, evalresp_filter **filter,
+                           int threads, int *statuses);
+
+/**
+ * @public
+ * @ingroup evalresp_public_high_level
+ * @param[in] log logging structure
+ * @param[in] options the output options (format, unwrap_phase, use_stdio and
+ * zip are used)
+ * @param[in] filename the container written by evalresp_cwd_to_cwd() or
+ * evalresp_responses_to_container()
+ * @brief Extract the responses in a container to the files that
+ * evalresp_cwd_to_cwd() would have written.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_container_to_cwd (evalresp_logger *log, evalresp_options *options,
+                               const char *filename);
+
+/**
+ * @public
+ * @ingroup evalresp_public_high_level
+ * @param[in] log logging structure
+ * @param[in] filename file in which the catalog is kept between runs (may be
+ * NULL)
+ * @param[out] catalog the allocated catalog
+ * @brief Allocate a catalog of RESP files, to be used as options->catalog.
+ * @details The RESP.* names in a directory are read the first time that the
+ * directory is searched, and each SNCL is then looked up (with the same
+ * wildcards and order as glob()) among the names for its station.  A
+ * directory is read again when its modification time changes; this is checked
+ * once per call of evalresp_cwd_to_cwd().  With @p filename the catalog is
+ * loaded from that file, if it exists, and saved to it whenever a directory is
+ * read.  The catalog can be shared by several threads.
+ * @retval EVALRESP_OK on success
+ */
+int evalresp_new_catalog (evalresp_logger *log, const char *filename,
+                          evalresp_catalog **catalog);
+
+/**
+ * @public
+ * @ingroup evalresp_public_high_level
+ * @param[in,out] catalog the catalog to free (set to NULL)
+ * @brief Free a catalog of RESP files.
+ */
+void evalresp_free_catalog (evalresp_catalog **catalog);
+
 #endif
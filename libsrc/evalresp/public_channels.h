@@ -89,6 +89,7 @@ typedef struct evalresp_list_s
   double *freq;  /**< Array of freqencies. */
   double *amp;   /**< Array of amplitudes. */
   double *phase; /**< Array of phases. */
+  struct evalresp_list_spline_s *spline; /**< Interpolating splines, made when the channel is read (private, NULL if none). */
 } evalresp_list;
 
 /**
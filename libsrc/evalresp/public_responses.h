@@ -20,6 +20,8 @@ typedef struct evalresp_response_s
   int nfreqs;                       /**< Number of frequencies. */
   double *freqs;                    /**< Array of frequencies. */
   struct evalresp_response_s *next; /**< Pointer to next response object (unused in new API, required for compatibility layer). */
+  char beg_t[DATIMLEN];             /**< Start of the channel epoch. */
+  char end_t[DATIMLEN];             /**< End of the channel epoch. */
 } evalresp_response;
 
 /**
@@ -51,4 +53,54 @@ void evalresp_free_response (evalresp_response **response);
  */
 void evalresp_free_responses (evalresp_responses **responses);
 
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_response
+ * @brief The reported and calculated sensitivity of a channel (see
+ *        evalresp_channel_to_sensitivity()).
+ */
+typedef struct
+{
+  char station[STALEN];  /**< Station name. */
+  char network[NETLEN];  /**< Network name. */
+  char locid[LOCIDLEN];  /**< Location ID. */
+  char channel[CHALEN];  /**< Channel name. */
+  char beg_t[DATIMLEN];  /**< Start of the channel epoch. */
+  char end_t[DATIMLEN];  /**< End of the channel epoch. */
+  double sensit;         /**< Reported sensitivity (stage 0 gain). */
+  double sensfreq;       /**< Frequency of the sensitivity. */
+  double calc_sensit;    /**< Product of the stage gains, normalized to sensfreq. */
+  double percent_diff;   /**< Difference between sensit and calc_sensit, as a percentage of sensit (0 if sensit is 0). */
+  int ngains;            /**< Number of stage gains. */
+  int *stages;           /**< Stage sequence number of each gain. */
+  double *gains;         /**< Stage gains, normalized to sensfreq. */
+} evalresp_sensitivity;
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_response
+ * @brief A collection of sensitivities.
+ */
+typedef struct
+{
+  int nsensitivities;
+  evalresp_sensitivity **sensitivities;
+} evalresp_sensitivities;
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_response
+ * @brief Free a sensitivity.
+ * @param[in,out] sensitivity Sensitivity (set to NULL).
+ */
+void evalresp_free_sensitivity (evalresp_sensitivity **sensitivity);
+
+/**
+ * @public
+ * @ingroup evalresp_public_low_level_response
+ * @brief Free a collection of sensitivities.
+ * @param[in,out] sensitivities Sensitivities (set to NULL).
+ */
+void evalresp_free_sensitivities (evalresp_sensitivities **sensitivities);
+
 #endif
@@ -28,6 +28,9 @@
  *
  *   1/18/2006 -- [ET]  Renamed functions to prevent name clashes with
  *                      other libraries.
+ *
+ * The work variables are kept per thread, so that files can be parsed on
+ * several threads at once.
  */
 #include <stdio.h>
 #include <string.h>
@@ -41,6 +44,14 @@
 
 #include <evalresp_log/log.h>
 
+#if defined(_MSC_VER)
+#define THREAD_LOCAL __declspec(thread)
+#elif defined(__GNUC__)
+#define THREAD_LOCAL __thread
+#else
+#define THREAD_LOCAL _Thread_local
+#endif
+
 /*
  * The "internal use only" fields in regexp.h are present to pass info from
  * compile to execute that permits the execute phase to run lots faster on
@@ -162,11 +173,11 @@
 /*
  * Global work variables for evr_regcomp().
  */
-static char *regparse; /* Input-scan pointer. */
-static int regnpar;    /* () count. */
-static char regdummy;
-static char *regcode; /* Code-emit pointer; &regdummy = don't. */
-static int regsize;   /* Code size. */
+static THREAD_LOCAL char *regparse; /* Input-scan pointer. */
+static THREAD_LOCAL int regnpar;    /* () count. */
+static THREAD_LOCAL char regdummy;
+static THREAD_LOCAL char *regcode; /* Code-emit pointer; &regdummy = don't. */
+static THREAD_LOCAL int regsize;   /* Code size. */
 
 /*
  * Forward declarations for evr_regcomp()'s friends.
@@ -713,10 +724,10 @@ evalresp_logger *log;
 /*
  * Global work variables for evr_regexec().
  */
-static char *reginput;   /* String-input pointer. */
-static char *regbol;     /* Beginning of input, for ^ check. */
-static char **regstartp; /* Pointer to startp array. */
-static char **regendp;   /* Ditto for endp. */
+static THREAD_LOCAL char *reginput;   /* String-input pointer. */
+static THREAD_LOCAL char *regbol;     /* Beginning of input, for ^ check. */
+static THREAD_LOCAL char **regstartp; /* Pointer to startp array. */
+static THREAD_LOCAL char **regendp;   /* Ditto for endp. */
 
 /*
  * Forwards.
@@ -358,6 +358,14 @@ check_channel (evalresp_logger *log, evalresp_channel *chan)
             }
           }
         }
+        /* the splines to interpolate the list are made once, here */
+        {
+          int status = list_blkt_spline (log, blkt_ptr);
+          if (status)
+          {
+            return status;
+          }
+        }
         stage_type = LIST_TYPE;
         filt_blkt = blkt_ptr;
         break;
@@ -639,24 +647,25 @@ check_channel (evalresp_logger *log, evalresp_channel *chan)
 }
 
 int
-interpolate_list_blockette (double **frequency_ptr,
-                            double **amplitude_ptr, double **phase_ptr,
-                            int *p_number_points, double *req_freq_arr,
-                            int req_num_freqs, evalresp_logger *log)
+interpolate_list (double *frequency, double *amplitude, double *phase,
+                  int number_points, evalresp_list_spline const *spline,
+                  double *req_freq_arr, int req_num_freqs,
+                  double **freq_out, double **amp_out, double **phase_out,
+                  int *nout, evalresp_logger *log)
 {
   int i, num, status = EVALRESP_OK;
   double first_freq, last_freq, val, min_ampval;
-  int fix_first_flag, fix_last_flag, unwrapped_flag;
+  int fix_first_flag, fix_last_flag;
   double *used_req_freq_arr;
   int used_req_num_freqs;
   double *retvals_arr, *retamps_arr;
   int num_retvals;
-  double old_pha, new_pha, added_value, prev_phase;
-  double *local_pha_arr;
+  double new_pha, added_value;
+  evalresp_list_spline *local_spline = NULL;
 
   /* get first and last values in freq array from list blockette */
-  first_freq = (*frequency_ptr)[0];
-  last_freq = (*frequency_ptr)[(*p_number_points) - 1];
+  first_freq = frequency[0];
+  last_freq = frequency[number_points - 1];
   if (first_freq > last_freq)
   { /* first is larger than last; swap values */
     val = first_freq;
@@ -738,30 +747,38 @@ interpolate_list_blockette (double **frequency_ptr,
   if (fix_last_flag)
     req_freq_arr[req_num_freqs - 1] = last_freq;
 
-  /* interpolate amplitude values */
-  if ((status = spline_interpolate (*p_number_points, *frequency_ptr, *amplitude_ptr,
-                                    req_freq_arr, req_num_freqs,
-                                    &retvals_arr, &num_retvals, log)))
+  /* the splines made with the list are used while it is unchanged */
+  if (!spline || spline->nresp != number_points || spline->freq != frequency ||
+      spline->amp != amplitude || spline->phase != phase)
   {
-    return status;
+    if ((status = list_spline_new (log, number_points, frequency, amplitude, phase,
+                                   &local_spline)))
+    {
+      free (req_freq_arr);
+      return status;
+    }
+    spline = local_spline;
   }
-  if (num_retvals != req_num_freqs)
-  { /* # of generated values != # requested (shouldn't happen) */
-    evalresp_log (log, EV_ERROR, 0, "Error interpolating amplitudes:  %s",
-                  "Bad # of values");
-    return EVALRESP_VAL;
+
+  retamps_arr = (double *)calloc (req_num_freqs, sizeof (double));
+  retvals_arr = (double *)calloc (req_num_freqs, sizeof (double));
+  if (!retamps_arr || !retvals_arr)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Failed to allocate interpolated amp/phase values");
+    free (req_freq_arr);
+    free (retamps_arr);
+    free (retvals_arr);
+    free_list_spline (&local_spline);
+    return EVALRESP_MEM;
   }
-  retamps_arr = retvals_arr; /* save ptr to interpolated amplitudes */
+  num_retvals = req_num_freqs;
+
+  /* interpolate amplitude values */
+  spline_cubic_vals (number_points, frequency, amplitude, spline->amp_ypp,
+                     req_freq_arr, req_num_freqs, retamps_arr);
 
   /* make sure all interpolated amplitude values are positive */
-  /* first find minimum value in "source" amplitudes */
-  min_ampval = (*amplitude_ptr)[0];
-  for (i = 1; i < *p_number_points; ++i)
-  { /* for each remaining "source" amplitude value */
-    if ((val = (*amplitude_ptr)[i]) < min_ampval)
-      min_ampval = val; /* if new mininum then save value */
-  }
-  if (min_ampval > 0.0)
+  if ((min_ampval = spline->min_amp) > 0.0)
   {                     /* all "source" amplitude values are positive */
     min_ampval /= 10.0; /* bring minimum a bit closer to zero */
     /* substitude minimum for any non-positive values */
@@ -772,42 +789,11 @@ interpolate_list_blockette (double **frequency_ptr,
     }
   }
 
-  /* unwrap phase values into local array */
-  local_pha_arr = (double *)(calloc ((*p_number_points), sizeof (double)));
-  added_value = prev_phase = 0.0;
-  unwrapped_flag = 0;
-  for (i = 0; i < (*p_number_points); i++)
-  { /* for each phase value; unwrap if necessary */
-    old_pha = (*phase_ptr)[i];
-    new_pha = unwrap_phase (old_pha, prev_phase, 360.0, &added_value);
-    if (added_value == 0.0)       /* if phase value not unwrapped */
-      local_pha_arr[i] = old_pha; /* then copy original value */
-    else
-    {                             /* phase value was unwrapped */
-      local_pha_arr[i] = new_pha; /* enter new phase value */
-      unwrapped_flag = 1;         /* indicate unwrapping */
-    }
-    prev_phase = new_pha;
-  }
-
-  /* interpolate phase values */
-  status = spline_interpolate (*p_number_points, *frequency_ptr, local_pha_arr,
-                               req_freq_arr, req_num_freqs,
-                               &retvals_arr, &num_retvals, log);
-  free (local_pha_arr);
-  if (status)
-  {
-    return status;
-  }
-  else if (num_retvals != req_num_freqs)
-  { /* # of generated values != # requested (shouldn't happen) */
-    evalresp_log (log, EV_ERROR, 0, "Error interpolating phases:  %s",
-                  "Bad # of values");
-    status = EVALRESP_ERR;
-    return status;
-  }
+  /* interpolate (unwrapped) phase values */
+  spline_cubic_vals (number_points, frequency, spline->unwrapped, spline->phase_ypp,
+                     req_freq_arr, req_num_freqs, retvals_arr);
 
-  if (unwrapped_flag)
+  if (spline->unwrapped_flag)
   { /* phase values were previously unwrapped; wrap interpolated values */
     added_value = 0.0;
     new_pha = retvals_arr[0]; /* check first phase value */
@@ -830,17 +816,137 @@ interpolate_list_blockette (double **frequency_ptr,
         retvals_arr[i] = new_pha; /* enter new phase value */
     }
   }
-
-  /* free arrays passed into function */
-  free (*frequency_ptr);
-  free (*amplitude_ptr);
-  free (*phase_ptr);
+  free_list_spline (&local_spline);
 
   /* enter generated arrays and # of points */
-  *frequency_ptr = req_freq_arr;
-  *amplitude_ptr = retamps_arr;
-  *phase_ptr = retvals_arr;
-  *p_number_points = num_retvals;
+  *freq_out = req_freq_arr;
+  *amp_out = retamps_arr;
+  *phase_out = retvals_arr;
+  *nout = num_retvals;
+
+  return status;
+}
+
+int
+list_spline_new (evalresp_logger *log, int number_points, double *frequency,
+                 double *amplitude, double *phase, evalresp_list_spline **spline)
+{
+  int i, status = EVALRESP_OK;
+  double old_pha, new_pha, added_value, prev_phase;
+
+  if (!(*spline = calloc (1, sizeof (**spline))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate list splines");
+    return EVALRESP_MEM;
+  }
+  (*spline)->nresp = number_points;
+  (*spline)->freq = frequency;
+  (*spline)->amp = amplitude;
+  (*spline)->phase = phase;
+
+  /* find minimum value in "source" amplitudes */
+  (*spline)->min_amp = amplitude[0];
+  for (i = 1; i < number_points; ++i)
+  {
+    if (amplitude[i] < (*spline)->min_amp)
+      (*spline)->min_amp = amplitude[i];
+  }
 
+  /* unwrap phase values */
+  if (!((*spline)->unwrapped = (double *)calloc (number_points, sizeof (double))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate unwrapped phases");
+    status = EVALRESP_MEM;
+  }
+  else
+  {
+    added_value = prev_phase = 0.0;
+    for (i = 0; i < number_points; i++)
+    { /* for each phase value; unwrap if necessary */
+      old_pha = phase[i];
+      new_pha = unwrap_phase (old_pha, prev_phase, 360.0, &added_value);
+      if (added_value == 0.0)              /* if phase value not unwrapped */
+        (*spline)->unwrapped[i] = old_pha; /* then copy original value */
+      else
+      {                                    /* phase value was unwrapped */
+        (*spline)->unwrapped[i] = new_pha; /* enter new phase value */
+        (*spline)->unwrapped_flag = 1;     /* indicate unwrapping */
+      }
+      prev_phase = new_pha;
+    }
+    if (!((*spline)->amp_ypp = spline_coefficients (number_points, frequency, amplitude, log)) ||
+        !((*spline)->phase_ypp = spline_coefficients (number_points, frequency,
+                                                      (*spline)->unwrapped, log)))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Call to spline_cubic_set failed");
+      status = EVALRESP_ERR;
+    }
+  }
+  if (status)
+  {
+    free_list_spline (spline);
+  }
+  return status;
+}
+
+int
+list_blkt_spline (evalresp_logger *log, evalresp_blkt *blkt)
+{
+  evalresp_list *list = &blkt->blkt_info.list;
+  int i;
+
+  free_list_spline (&list->spline);
+  /* spline_cubic_set() would exit for other lists */
+  if (list->nresp < 2)
+  {
+    return EVALRESP_OK;
+  }
+  for (i = 1; i < list->nresp; i++)
+  {
+    if (!(list->freq[i] > list->freq[i - 1]))
+    {
+      return EVALRESP_OK;
+    }
+  }
+  return list_spline_new (log, list->nresp, list->freq, list->amp, list->phase, &list->spline);
+}
+
+void
+free_list_spline (evalresp_list_spline **spline)
+{
+  if (*spline)
+  {
+    free ((*spline)->amp_ypp);
+    free ((*spline)->unwrapped);
+    free ((*spline)->phase_ypp);
+    free (*spline);
+    *spline = NULL;
+  }
+}
+
+int
+interpolate_list_blockette (double **frequency_ptr,
+                            double **amplitude_ptr, double **phase_ptr,
+                            int *p_number_points, double *req_freq_arr,
+                            int req_num_freqs, evalresp_logger *log)
+{
+  int status, num_retvals;
+  double *freq_arr, *amp_arr, *pha_arr;
+
+  if (!(status = interpolate_list (*frequency_ptr, *amplitude_ptr, *phase_ptr,
+                                   *p_number_points, NULL, req_freq_arr, req_num_freqs,
+                                   &freq_arr, &amp_arr, &pha_arr, &num_retvals, log)))
+  {
+    /* free arrays passed into function */
+    free (*frequency_ptr);
+    free (*amplitude_ptr);
+    free (*phase_ptr);
+
+    /* enter generated arrays and # of points */
+    *frequency_ptr = freq_arr;
+    *amplitude_ptr = amp_arr;
+    *phase_ptr = pha_arr;
+    *p_number_points = num_retvals;
+  }
   return status;
 }
@@ -0,0 +1,424 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <process.h>
+#include <sys/utime.h>
+#define getpid _getpid
+#else
+#include <dirent.h>
+#include <unistd.h>
+#include <utime.h>
+#endif
+
+#include "evalresp/private.h"
+
+/* responses evaluated from one input file are saved in a single entry,
+   named after the hash of the key, in the cache directory.  entries are
+   written to a temporary file and renamed into place, so a reader only
+   ever sees complete entries, and the modification time of an entry is
+   the time it was last used. */
+
+#define RESPONSE_CACHE_MAGIC "EVRESP2"
+#define RESPONSE_CACHE_SUFFIX ".evr"
+#define RESPONSE_CACHE_TMP ".tmp"
+/* temporary files older than this (seconds) were left by a failed writer */
+#define RESPONSE_CACHE_STALE 3600
+/* a second hash, independent of the file name, that must also match */
+#define RESPONSE_CACHE_CHECK_INIT 0x84222325cbf29ce4ULL
+
+static void
+key_add (response_cache_key *key, const void *data, size_t len)
+{
+  key->hash = stage_cache_hash (data, len, key->hash);
+  key->check = stage_cache_hash (data, len, key->check);
+}
+
+static void
+key_add_string (response_cache_key *key, const char *string)
+{
+  /* include the terminator so that adjacent strings cannot run together */
+  key_add (key, string ? string : "", string ? strlen (string) + 1 : 1);
+}
+
+#define KEY_ADD(key, value) key_add (key, &(value), sizeof (value))
+
+int
+response_cache_key_file (const char *filename, evalresp_options const *options,
+                         evalresp_filter const *filter, response_cache_key *key)
+{
+  unsigned char buffer[65536];
+  FILE *file;
+  size_t len;
+  int i, nfreqs;
+
+  key->hash = EVALRESP_HASH_INIT;
+  key->check = RESPONSE_CACHE_CHECK_INIT;
+  key->len = 0;
+  if (!(file = fopen (filename, "rb")))
+  {
+    return EVALRESP_IO;
+  }
+  key_add_string (key, RESPONSE_CACHE_MAGIC);
+  while ((len = fread (buffer, 1, sizeof (buffer), file)) > 0)
+  {
+    key_add (key, buffer, len);
+    key->len += len;
+  }
+  if (ferror (file))
+  {
+    fclose (file);
+    return EVALRESP_IO;
+  }
+  fclose (file);
+  KEY_ADD (key, key->len);
+
+  /* everything that changes the evaluated responses (but not the output
+     format or phase unwrapping, which are applied when writing) */
+  KEY_ADD (key, options->b62_x);
+  KEY_ADD (key, options->min_freq);
+  KEY_ADD (key, options->max_freq);
+  KEY_ADD (key, options->nfreq);
+  KEY_ADD (key, options->lin_freq);
+  KEY_ADD (key, options->start_stage);
+  KEY_ADD (key, options->stop_stage);
+  KEY_ADD (key, options->use_estimated_delay);
+  KEY_ADD (key, options->b55_interpolate);
+  KEY_ADD (key, options->use_total_sensitivity);
+  KEY_ADD (key, options->station_xml);
+  KEY_ADD (key, options->unit);
+  KEY_ADD (key, options->single_precision);
+  KEY_ADD (key, options->simplify);
+  KEY_ADD (key, options->simplify_tol);
+  KEY_ADD (key, options->adaptive_tol);
+  KEY_ADD (key, options->adaptive_max_nfreq);
+  nfreqs = options->freq_grid ? evalresp_freq_grid_nfreqs (options->freq_grid) : -1;
+  KEY_ADD (key, nfreqs);
+  if (nfreqs > 0)
+  {
+    key_add (key, evalresp_freq_grid_freqs (options->freq_grid), nfreqs * sizeof (double));
+  }
+
+  for (i = 0; filter && filter->sncls && i < filter->sncls->nscn; i++)
+  {
+    key_add_string (key, filter->sncls->scn_vec[i]->network);
+    key_add_string (key, filter->sncls->scn_vec[i]->station);
+    key_add_string (key, filter->sncls->scn_vec[i]->locid);
+    key_add_string (key, filter->sncls->scn_vec[i]->channel);
+  }
+  KEY_ADD (key, i);
+  if (filter && filter->datetime)
+  {
+    KEY_ADD (key, filter->datetime->year);
+    KEY_ADD (key, filter->datetime->jday);
+    KEY_ADD (key, filter->datetime->hour);
+    KEY_ADD (key, filter->datetime->min);
+    KEY_ADD (key, filter->datetime->sec);
+  }
+  return EVALRESP_OK;
+}
+
+static void
+entry_name (const char *dir, const response_cache_key *key, const char *suffix,
+            char *name, size_t len)
+{
+  snprintf (name, len, "%s/%08lx%08lx%s", dir,
+            (unsigned long)(key->hash >> 32), (unsigned long)(key->hash & 0xffffffffUL),
+            suffix);
+}
+
+static int
+read_response (FILE *file, evalresp_response **response)
+{
+  int nfreqs;
+
+  if (!(*response = calloc (1, sizeof (**response))))
+  {
+    return EVALRESP_MEM;
+  }
+  if (fread ((*response)->station, STALEN, 1, file) != 1
+      || fread ((*response)->network, NETLEN, 1, file) != 1
+      || fread ((*response)->locid, LOCIDLEN, 1, file) != 1
+      || fread ((*response)->channel, CHALEN, 1, file) != 1
+      || fread ((*response)->beg_t, DATIMLEN, 1, file) != 1
+      || fread ((*response)->end_t, DATIMLEN, 1, file) != 1
+      || fread (&nfreqs, sizeof (nfreqs), 1, file) != 1 || nfreqs < 0)
+  {
+    return EVALRESP_IO;
+  }
+  (*response)->nfreqs = nfreqs;
+  if (!((*response)->freqs = calloc (nfreqs ? nfreqs : 1, sizeof (*(*response)->freqs)))
+      || !((*response)->rvec = calloc (nfreqs ? nfreqs : 1, sizeof (*(*response)->rvec))))
+  {
+    return EVALRESP_MEM;
+  }
+  if (fread ((*response)->freqs, sizeof (*(*response)->freqs), nfreqs, file) != (size_t)nfreqs
+      || fread ((*response)->rvec, sizeof (*(*response)->rvec), nfreqs, file) != (size_t)nfreqs)
+  {
+    return EVALRESP_IO;
+  }
+  return EVALRESP_OK;
+}
+
+int
+response_cache_load (evalresp_logger *log, const char *dir, const response_cache_key *key,
+                     evalresp_responses **responses, int *hit)
+{
+  char name[MAXLINELEN], magic[sizeof (RESPONSE_CACHE_MAGIC)];
+  response_cache_key stored;
+  evalresp_response **array;
+  FILE *file;
+  int status = EVALRESP_OK, i, n, first;
+
+  *hit = 0;
+  entry_name (dir, key, RESPONSE_CACHE_SUFFIX, name, sizeof (name));
+  if (!(file = fopen (name, "rb")))
+  {
+    return EVALRESP_OK;
+  }
+  if (fread (magic, sizeof (magic), 1, file) != 1 || memcmp (magic, RESPONSE_CACHE_MAGIC, sizeof (magic))
+      || fread (&stored, sizeof (stored), 1, file) != 1
+      || stored.hash != key->hash || stored.check != key->check || stored.len != key->len
+      || fread (&n, sizeof (n), 1, file) != 1 || n < 0)
+  {
+    evalresp_log (log, EV_DEBUG, EV_DEBUG, "Ignoring unusable cache entry %s", name);
+    fclose (file);
+    return EVALRESP_OK;
+  }
+
+  if (!*responses && !(*responses = calloc (1, sizeof (**responses))))
+  {
+    status = EVALRESP_MEM;
+  }
+  else if (n > 0)
+  {
+    if (!(array = realloc ((*responses)->responses, ((*responses)->nresponses + n) * sizeof (*array))))
+    {
+      status = EVALRESP_MEM;
+    }
+    else
+    {
+      (*responses)->responses = array;
+      first = (*responses)->nresponses;
+      for (i = 0; !status && i < n; i++)
+      {
+        if (!(status = read_response (file, &array[first + i])))
+        {
+          (*responses)->nresponses++;
+        }
+        else
+        {
+          evalresp_free_response (&array[first + i]);
+        }
+      }
+      if (status)
+      {
+        /* a damaged entry is a miss, not an error */
+        while ((*responses)->nresponses > first)
+        {
+          evalresp_free_response (&array[--(*responses)->nresponses]);
+        }
+      }
+    }
+  }
+  fclose (file);
+
+  if (status == EVALRESP_MEM)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate cached responses");
+    return status;
+  }
+  else if (status)
+  {
+    evalresp_log (log, EV_DEBUG, EV_DEBUG, "Ignoring damaged cache entry %s", name);
+    return EVALRESP_OK;
+  }
+  /* mark as recently used */
+  (void)utime (name, NULL);
+  *hit = 1;
+  return EVALRESP_OK;
+}
+
+typedef struct
+{
+  char *name;
+  time_t mtime;
+  long size;
+} cache_file;
+
+static int
+compare_mtime (const void *a, const void *b)
+{
+  const cache_file *x = a, *y = b;
+  return x->mtime < y->mtime ? -1 : (x->mtime > y->mtime ? 1 : 0);
+}
+
+static int
+has_suffix (const char *name, const char *suffix)
+{
+  size_t n = strlen (name), m = strlen (suffix);
+  return n > m && !strcmp (name + n - m, suffix);
+}
+
+/* add a file of the cache directory to the list (growing it as needed),
+   removing stale temporary files */
+static void
+add_cache_file (const char *dir, const char *leaf, cache_file **files, int *nfiles, int *space,
+                time_t now)
+{
+  char name[MAXLINELEN];
+  cache_file *grown;
+  struct stat buf;
+
+  snprintf (name, sizeof (name), "%s/%s", dir, leaf);
+  if (has_suffix (leaf, RESPONSE_CACHE_TMP))
+  {
+    if (!stat (name, &buf) && now - buf.st_mtime > RESPONSE_CACHE_STALE)
+    {
+      (void)remove (name);
+    }
+    return;
+  }
+  if (!has_suffix (leaf, RESPONSE_CACHE_SUFFIX) || stat (name, &buf))
+  {
+    return;
+  }
+  if (*nfiles == *space)
+  {
+    if (!(grown = realloc (*files, (*space ? 2 * *space : 64) * sizeof (*grown))))
+    {
+      return;
+    }
+    *files = grown;
+    *space = *space ? 2 * *space : 64;
+  }
+  if (((*files)[*nfiles].name = strdup (name)))
+  {
+    (*files)[*nfiles].mtime = buf.st_mtime;
+    (*files)[*nfiles].size = (long)buf.st_size;
+    (*nfiles)++;
+  }
+}
+
+/* remove the least recently used entries until the directory is within
+   its size.  other processes may be doing the same, so a failure to
+   remove (or stat) a file is not an error. */
+void
+response_cache_evict (evalresp_logger *log, const char *dir, size_t max_bytes)
+{
+  cache_file *files = NULL;
+  int nfiles = 0, space = 0, i;
+  double total = 0;
+  time_t now = time (NULL);
+#ifdef _WIN32
+  char pattern[MAXLINELEN];
+  struct _finddata_t found;
+  intptr_t handle;
+
+  snprintf (pattern, sizeof (pattern), "%s/*", dir);
+  if ((handle = _findfirst (pattern, &found)) != -1)
+  {
+    do
+    {
+      add_cache_file (dir, found.name, &files, &nfiles, &space, now);
+    } while (_findnext (handle, &found) == 0);
+    _findclose (handle);
+  }
+#else
+  DIR *directory;
+  struct dirent *found;
+
+  if ((directory = opendir (dir)))
+  {
+    while ((found = readdir (directory)))
+    {
+      add_cache_file (dir, found->d_name, &files, &nfiles, &space, now);
+    }
+    closedir (directory);
+  }
+#endif
+
+  for (i = 0; i < nfiles; i++)
+  {
+    total += files[i].size;
+  }
+  if (total > max_bytes)
+  {
+    qsort (files, nfiles, sizeof (*files), compare_mtime);
+    for (i = 0; i < nfiles && total > max_bytes; i++)
+    {
+      if (!remove (files[i].name))
+      {
+        evalresp_log (log, EV_DEBUG, EV_DEBUG, "Evicted cache entry %s", files[i].name);
+      }
+      total -= files[i].size;
+    }
+  }
+  for (i = 0; i < nfiles; i++)
+  {
+    free (files[i].name);
+  }
+  free (files);
+}
+
+static int
+write_response (FILE *file, const evalresp_response *response)
+{
+  return fwrite (response->station, STALEN, 1, file) != 1
+         || fwrite (response->network, NETLEN, 1, file) != 1
+         || fwrite (response->locid, LOCIDLEN, 1, file) != 1
+         || fwrite (response->channel, CHALEN, 1, file) != 1
+         || fwrite (response->beg_t, DATIMLEN, 1, file) != 1
+         || fwrite (response->end_t, DATIMLEN, 1, file) != 1
+         || fwrite (&response->nfreqs, sizeof (response->nfreqs), 1, file) != 1
+         || fwrite (response->freqs, sizeof (*response->freqs), response->nfreqs, file) != (size_t)response->nfreqs
+         || fwrite (response->rvec, sizeof (*response->rvec), response->nfreqs, file) != (size_t)response->nfreqs;
+}
+
+void
+response_cache_save (evalresp_logger *log, const char *dir,
+                     const response_cache_key *key, const evalresp_responses *responses, int first)
+{
+  char name[MAXLINELEN], tmp[MAXLINELEN], suffix[64];
+  FILE *file;
+  int failed, i, n = responses ? responses->nresponses - first : 0;
+
+  /* unique among processes (pid) and among concurrent calls in this
+     process (address of the key); a later call from the same thread may
+     reuse the name, but this call has renamed or removed the file by then */
+  snprintf (suffix, sizeof (suffix), ".%ld.%lx%s", (long)getpid (),
+            (unsigned long)(size_t)key, RESPONSE_CACHE_TMP);
+  entry_name (dir, key, suffix, tmp, sizeof (tmp));
+  entry_name (dir, key, RESPONSE_CACHE_SUFFIX, name, sizeof (name));
+  if (!(file = fopen (tmp, "wb")))
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Cannot write to response cache %s", dir);
+    return;
+  }
+  failed = fwrite (RESPONSE_CACHE_MAGIC, sizeof (RESPONSE_CACHE_MAGIC), 1, file) != 1
+           || fwrite (key, sizeof (*key), 1, file) != 1
+           || fwrite (&n, sizeof (n), 1, file) != 1;
+  for (i = 0; !failed && i < n; i++)
+  {
+    failed = write_response (file, responses->responses[first + i]);
+  }
+  failed = fclose (file) || failed;
+  if (!failed)
+  {
+#ifdef _WIN32
+    /* rename does not replace an existing entry; either is correct */
+    (void)remove (name);
+#endif
+    failed = rename (tmp, name);
+  }
+  if (failed)
+  {
+    evalresp_log (log, EV_WARN, EV_WARN, "Cannot write to response cache %s", dir);
+    (void)remove (tmp);
+  }
+}
@@ -11,26 +11,51 @@
 #include "public_api.h"
 #include "spline.h"
 
-int
-spline_interpolate (int num_points, double *t, double *y,
-                    double *xvals_arr, int num_xvals,
-                    double **p_retvals_arr, int *p_num_retvals, evalresp_logger *log)
+double *
+spline_coefficients (int num_points, double *t, double *y, evalresp_logger *log)
 {
-  int i, status = EVALRESP_OK;
   const int ibcbeg = 2;
   const int ybcbeg = 0.0;
   const int ibcend = 2;
   const int ybcend = 0.0;
+
+  return spline_cubic_set (num_points, t, y, ibcbeg, ybcbeg, ibcend, ybcend, log);
+}
+
+void
+spline_cubic_vals (int num_points, double const *t, double const *y, double const *ypp,
+                   double const *xvals_arr, int num_xvals, double *retvals_arr)
+{
+  int i, ival = 0;
+  double tval, dt, h;
+
+  for (i = 0; i < num_xvals; ++i)
+  {
+    tval = xvals_arr[i];
+    if (i && !(tval >= xvals_arr[i - 1]))
+      ival = 0;
+    /* same interval as spline_cubic_val(): the first with tval < t[ival+1],
+       or the last */
+    while (ival < num_points - 2 && !(tval < t[ival + 1]))
+      ival++;
+    dt = tval - t[ival];
+    h = t[ival + 1] - t[ival];
+    retvals_arr[i] = y[ival] + dt * ((y[ival + 1] - y[ival]) / h - (ypp[ival + 1] / 6.0 + ypp[ival] / 3.0) * h + dt * (0.5 * ypp[ival] + dt * ((ypp[ival + 1] - ypp[ival]) / (6.0 * h))));
+  }
+}
+
+int
+spline_interpolate (int num_points, double *t, double *y,
+                    double *xvals_arr, int num_xvals,
+                    double **p_retvals_arr, int *p_num_retvals, evalresp_logger *log)
+{
+  int status = EVALRESP_OK;
   double *ypp = NULL;
-  double tval;
-  double yval;
-  double ypval;
-  double yppval;
 
   *p_retvals_arr = NULL;
   *p_num_retvals = 0;
 
-  if (!(ypp = spline_cubic_set (num_points, t, y, ibcbeg, ybcbeg, ibcend, ybcend, log)))
+  if (!(ypp = spline_coefficients (num_points, t, y, log)))
   {
     evalresp_log (log, EV_ERROR, EV_ERROR, "Call to spline_cubic_set failed");
     status = EVALRESP_ERR;
@@ -45,12 +70,7 @@ spline_interpolate (int num_points, double *t, double *y,
     }
     else
     {
-      for (i = 0; i < num_xvals; ++i)
-      {
-        tval = xvals_arr[i];
-        yval = spline_cubic_val (num_points, t, y, ypp, tval, &ypval, &yppval);
-        (*p_retvals_arr)[i] = yval;
-      }
+      spline_cubic_vals (num_points, t, y, ypp, xvals_arr, num_xvals, *p_retvals_arr);
       *p_num_retvals = num_xvals;
     }
   }
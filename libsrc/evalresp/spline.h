@@ -50,4 +50,39 @@
 int spline_interpolate (int num_points, double *t, double *y,
                         double *xvals_arr, int num_xvals,
                         double **p_retvals_arr, int *p_num_retvals, evalresp_logger *log);
+
+/**
+ * @private
+ * @ingroup evalresp_private_spline
+ * @brief Second derivatives of the natural cubic spline through a set of
+ *        points, as used by spline_interpolate().
+ * @param[in] num_points Number of points (at least 2).
+ * @param[in] t Abscissa array, strictly increasing.
+ * @param[in] y Ordinate array.
+ * @param[in] log Logging structure.
+ * @returns allocated array of @p num_points second derivatives, or NULL.
+ */
+double *spline_coefficients (int num_points, double *t, double *y, evalresp_logger *log);
+
+/**
+ * @private
+ * @ingroup evalresp_private_spline
+ * @brief Evaluate a cubic spline at many abscissa values.
+ * @details The interval holding each value is found by walking on from the
+ *          interval of the value before, so increasing values cost
+ *          O(@p num_points + @p num_xvals) in all (the walk starts again
+ *          from the first knot where the values decrease).  The results are
+ *          those of spline_cubic_val().
+ * @param[in] num_points Number of knots (at least 2).
+ * @param[in] t Knots, strictly increasing.
+ * @param[in] y Values at the knots.
+ * @param[in] ypp Second derivatives at the knots, from
+ *            spline_coefficients().
+ * @param[in] xvals_arr Abscissa values.
+ * @param[in] num_xvals Number of entries in @p xvals_arr.
+ * @param[out] retvals_arr Array of @p num_xvals values of the spline.
+ */
+void spline_cubic_vals (int num_points, double const *t, double const *y, double const *ypp,
+                        double const *xvals_arr, int num_xvals, double *retvals_arr);
+
 #endif /* __EVALRESP_EVR_SPLINE_H__ */
@@ -0,0 +1,294 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "evalresp/private.h"
+
+/* an evaluated stage.  entries are chained in their hash bucket and in a
+   list ordered by last use (most recent first); entries in use (refs > 0)
+   are never evicted */
+struct stage_cache_entry_s
+{
+  uint64_t hash;
+  unsigned char *key;
+  size_t key_len;
+  int nfreqs;
+  evalresp_complex *values;
+  size_t bytes;
+  int refs;
+  stage_cache_entry *next;
+  stage_cache_entry *newer;
+  stage_cache_entry *older;
+};
+
+struct evalresp_stage_cache_s
+{
+  evalresp_mutex *mutex;
+  size_t max_bytes;
+  size_t bytes;
+  int nentries;
+  int nbuckets;
+  stage_cache_entry **buckets;
+  stage_cache_entry *newest;
+  stage_cache_entry *oldest;
+  unsigned long hits;
+  unsigned long misses;
+  unsigned long evictions;
+};
+
+#define STAGE_CACHE_MIN_BUCKETS 64
+
+uint64_t
+stage_cache_hash (const void *data, size_t len, uint64_t hash)
+{
+  const unsigned char *bytes = data;
+  size_t i;
+
+  /* FNV-1a */
+  for (i = 0; i < len; i++)
+  {
+    hash ^= bytes[i];
+    hash *= 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+int
+evalresp_new_stage_cache (evalresp_logger *log, size_t max_bytes,
+                          evalresp_stage_cache **cache)
+{
+  int status = EVALRESP_OK;
+
+  if (!(*cache = calloc (1, sizeof (**cache)))
+      || !((*cache)->buckets = calloc (STAGE_CACHE_MIN_BUCKETS, sizeof (*(*cache)->buckets))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate stage cache");
+    status = EVALRESP_MEM;
+  }
+  else
+  {
+    (*cache)->nbuckets = STAGE_CACHE_MIN_BUCKETS;
+    (*cache)->max_bytes = max_bytes;
+    status = mutex_new (log, &(*cache)->mutex);
+  }
+  if (status)
+  {
+    evalresp_free_stage_cache (cache);
+  }
+  return status;
+}
+
+static void
+free_entry (stage_cache_entry *entry)
+{
+  free (entry->key);
+  free (entry->values);
+  free (entry);
+}
+
+void
+evalresp_free_stage_cache (evalresp_stage_cache **cache)
+{
+  stage_cache_entry *entry, *older;
+
+  if (*cache)
+  {
+    for (entry = (*cache)->newest; entry; entry = older)
+    {
+      older = entry->older;
+      free_entry (entry);
+    }
+    free ((*cache)->buckets);
+    mutex_free (&(*cache)->mutex);
+    free (*cache);
+    *cache = NULL;
+  }
+}
+
+void
+evalresp_stage_cache_get_stats (evalresp_stage_cache *cache, evalresp_stage_cache_stats *stats)
+{
+  mutex_lock (cache->mutex);
+  stats->hits = cache->hits;
+  stats->misses = cache->misses;
+  stats->evictions = cache->evictions;
+  stats->entries = cache->nentries;
+  stats->bytes = cache->bytes;
+  mutex_unlock (cache->mutex);
+}
+
+/* the following are called with the mutex held */
+
+static void
+unlink_lru (evalresp_stage_cache *cache, stage_cache_entry *entry)
+{
+  if (entry->newer)
+    entry->newer->older = entry->older;
+  else
+    cache->newest = entry->older;
+  if (entry->older)
+    entry->older->newer = entry->newer;
+  else
+    cache->oldest = entry->newer;
+  entry->newer = entry->older = NULL;
+}
+
+static void
+link_newest (evalresp_stage_cache *cache, stage_cache_entry *entry)
+{
+  entry->older = cache->newest;
+  entry->newer = NULL;
+  if (cache->newest)
+    cache->newest->newer = entry;
+  else
+    cache->oldest = entry;
+  cache->newest = entry;
+}
+
+static stage_cache_entry *
+find_entry (evalresp_stage_cache *cache, const unsigned char *key, size_t key_len,
+            uint64_t hash, int nfreqs)
+{
+  stage_cache_entry *entry;
+
+  for (entry = cache->buckets[hash & (cache->nbuckets - 1)]; entry; entry = entry->next)
+  {
+    if (entry->hash == hash && entry->nfreqs == nfreqs && entry->key_len == key_len && !memcmp (entry->key, key, key_len))
+    {
+      return entry;
+    }
+  }
+  return NULL;
+}
+
+static void
+remove_entry (evalresp_stage_cache *cache, stage_cache_entry *entry)
+{
+  stage_cache_entry **link;
+
+  for (link = &cache->buckets[entry->hash & (cache->nbuckets - 1)]; *link != entry; link = &(*link)->next)
+    ;
+  *link = entry->next;
+  unlink_lru (cache, entry);
+  cache->bytes -= entry->bytes;
+  cache->nentries--;
+  free_entry (entry);
+}
+
+/* double the number of buckets (if memory allows) */
+static void
+grow_buckets (evalresp_stage_cache *cache)
+{
+  stage_cache_entry **buckets, *entry, *next;
+  int i, nbuckets = 2 * cache->nbuckets;
+
+  if (!(buckets = calloc (nbuckets, sizeof (*buckets))))
+  {
+    return;
+  }
+  for (i = 0; i < cache->nbuckets; i++)
+  {
+    for (entry = cache->buckets[i]; entry; entry = next)
+    {
+      next = entry->next;
+      entry->next = buckets[entry->hash & (nbuckets - 1)];
+      buckets[entry->hash & (nbuckets - 1)] = entry;
+    }
+  }
+  free (cache->buckets);
+  cache->buckets = buckets;
+  cache->nbuckets = nbuckets;
+}
+
+const evalresp_complex *
+stage_cache_acquire (evalresp_stage_cache *cache, const unsigned char *key, size_t key_len,
+                     uint64_t hash, int nfreqs, stage_cache_entry **entry)
+{
+  mutex_lock (cache->mutex);
+  if ((*entry = find_entry (cache, key, key_len, hash, nfreqs)))
+  {
+    (*entry)->refs++;
+    unlink_lru (cache, *entry);
+    link_newest (cache, *entry);
+    cache->hits++;
+  }
+  else
+  {
+    cache->misses++;
+  }
+  mutex_unlock (cache->mutex);
+  return *entry ? (*entry)->values : NULL;
+}
+
+const evalresp_complex *
+stage_cache_insert (evalresp_stage_cache *cache, const unsigned char *key, size_t key_len,
+                    uint64_t hash, int nfreqs, evalresp_complex *values,
+                    stage_cache_entry **entry)
+{
+  stage_cache_entry *newer, *victim;
+  size_t bytes = sizeof (**entry) + key_len + nfreqs * sizeof (*values);
+
+  *entry = NULL;
+  mutex_lock (cache->mutex);
+  if (bytes <= cache->max_bytes)
+  {
+    if ((*entry = find_entry (cache, key, key_len, hash, nfreqs)))
+    {
+      /* another thread evaluated the same stage meanwhile */
+      (*entry)->refs++;
+      free (values);
+    }
+    else
+    {
+      /* make room, oldest first, skipping entries in use */
+      for (victim = cache->oldest; victim && cache->bytes + bytes > cache->max_bytes; victim = newer)
+      {
+        newer = victim->newer;
+        if (!victim->refs)
+        {
+          remove_entry (cache, victim);
+          cache->evictions++;
+        }
+      }
+      if (cache->bytes + bytes <= cache->max_bytes
+          && (*entry = calloc (1, sizeof (**entry))))
+      {
+        if (!((*entry)->key = malloc (key_len ? key_len : 1)))
+        {
+          free (*entry);
+          *entry = NULL;
+        }
+        else
+        {
+          memcpy ((*entry)->key, key, key_len);
+          (*entry)->key_len = key_len;
+          (*entry)->hash = hash;
+          (*entry)->nfreqs = nfreqs;
+          (*entry)->values = values;
+          (*entry)->bytes = bytes;
+          (*entry)->refs = 1;
+          (*entry)->next = cache->buckets[hash & (cache->nbuckets - 1)];
+          cache->buckets[hash & (cache->nbuckets - 1)] = *entry;
+          link_newest (cache, *entry);
+          cache->bytes += bytes;
+          if (++cache->nentries > cache->nbuckets)
+          {
+            grow_buckets (cache);
+          }
+        }
+      }
+    }
+  }
+  mutex_unlock (cache->mutex);
+  return *entry ? (*entry)->values : NULL;
+}
+
+void
+stage_cache_release (evalresp_stage_cache *cache, stage_cache_entry *entry)
+{
+  if (entry)
+  {
+    mutex_lock (cache->mutex);
+    entry->refs--;
+    mutex_unlock (cache->mutex);
+  }
+}
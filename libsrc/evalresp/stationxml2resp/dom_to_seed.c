@@ -12,6 +12,12 @@
 // This file generates response formatted data from the in-memory model of
 // the station.xml document (created in x2r_xml.c).
 
+// gmtime() shares its result between threads, and documents can be
+// converted on several at once.
+#ifdef _WIN32
+#define gmtime_r(epoch, result) (gmtime_s((result), (epoch)) ? NULL : (result))
+#endif
+
 
 /* printf-style output with linefeed. */
 static int line(evalresp_logger *log, FILE *out, const char *template, ...) {
@@ -64,10 +70,10 @@ static int lines(evalresp_logger *log, FILE *out, ...) {
 static int format_date(evalresp_logger *log, const time_t epoch, int n, char *template, char **date) {
 
     int status = X2R_OK;
-    struct tm *tm;
+    struct tm *tm, result;
 
     if (epoch != unset_time_t) {
-		if (!(tm = gmtime(&epoch))) {
+		if (!(tm = gmtime_r(&epoch, &result))) {
 			evalresp_log(log, EV_ERROR, 0, "Cannot convert epoch to time");
 			status = X2R_ERR_DATE;
 		} else {
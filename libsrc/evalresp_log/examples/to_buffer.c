@@ -0,0 +1,73 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include <evalresp_log/examples/to_buffer.h>
+#include <evalresp_log/log.h>
+
+int
+evalresp_log_intialize_log_for_buffer (evalresp_logger *log, evalresp_log_buffer *buffer)
+{
+  if (!buffer || !log)
+  {
+    return EXIT_FAILURE;
+  }
+  memset (buffer, 0, sizeof (*buffer));
+  log->log_func = evalresp_log_to_buffer;
+  log->func_data = (void *)buffer;
+  return EXIT_SUCCESS;
+}
+
+int
+evalresp_log_to_buffer (evalresp_log_msg *msg, void *data)
+{
+  evalresp_log_buffer *buffer = data;
+  evalresp_log_msg *msgs;
+  int size;
+
+  if (!buffer)
+  {
+    return EXIT_FAILURE;
+  }
+  if (buffer->nmsgs == buffer->size)
+  {
+    size = buffer->size ? 2 * buffer->size : 8;
+    if (!(msgs = realloc (buffer->msgs, size * sizeof (*msgs))))
+    {
+      return EXIT_FAILURE;
+    }
+    buffer->msgs = msgs;
+    buffer->size = size;
+  }
+  buffer->msgs[buffer->nmsgs++] = *msg;
+  return EXIT_SUCCESS;
+}
+
+int
+evalresp_log_buffer_replay (evalresp_logger *log, evalresp_log_buffer const *buffer)
+{
+  int i, status = EXIT_SUCCESS;
+
+  if (!buffer)
+  {
+    return EXIT_FAILURE;
+  }
+  for (i = 0; i < buffer->nmsgs; i++)
+  {
+    if (evalresp_log_send (log ? log->log_func : NULL, log ? log->func_data : NULL,
+                           &buffer->msgs[i]) != EXIT_SUCCESS)
+    {
+      status = EXIT_FAILURE;
+    }
+  }
+  return status;
+}
+
+void
+evalresp_log_buffer_clear (evalresp_log_buffer *buffer)
+{
+  if (buffer)
+  {
+    free (buffer->msgs);
+    memset (buffer, 0, sizeof (*buffer));
+  }
+}
@@ -0,0 +1,98 @@
+/**
+ * @mainpage Introduction
+ *
+ * @section purpose Purpose
+ *
+ * Implements a private in-memory logging interface for evalresp.
+ *
+ * @section history History
+ *
+ * Written by <a href="http://www.isti.com/">Instrumental Software
+ * Technologies, Inc.</a> (ISTI) in 2017.
+ */
+
+/**
+ * @defgroup evalresp_private_log_buffer evalresp Private Buffer Logging Interface
+ * @ingroup evalresp_private_log
+ * @brief Private in-memory logging interface for evalresp.
+ *
+ * Messages are collected in a buffer and can later be sent, in the order
+ * they were logged, to another logger.  This lets work that runs in several
+ * threads keep its messages apart and have them appear as if the work had
+ * been done serially.
+ */
+
+/**
+ * @file
+ * @brief This file contains declarations and global structures for evalresp
+ *        buffer logging.
+ */
+
+#ifndef __evalresp_log_to_buffer_h__
+#define __evalresp_log_to_buffer_h__
+#include <evalresp_log/log.h>
+
+/**
+ * @private
+ * @ingroup evalresp_private_log_buffer
+ * @brief Messages collected by evalresp_log_to_buffer.
+ */
+typedef struct evalresp_log_buffer_s
+{
+  int nmsgs;              /**< Number of messages held. */
+  int size;               /**< Number of messages allocated. */
+  evalresp_log_msg *msgs; /**< The messages, oldest first. */
+} evalresp_log_buffer;
+
+/**
+ * @private
+ * @ingroup evalresp_private_log_buffer
+ * @brief a logging function for use with evalresp log that will append a
+ *        copy of the message to a buffer
+ *
+ * this function has the type that staisfies evalresp_log_func
+ * @param[in] msg object containing msg information
+ * @param[in] data this should be a evalresp_log_buffer casted to a void *
+ * @retval EXIT_SUCCESS when stored succesfully
+ * @retval EXIT_FAILURE when data is NULL or memory cannot be allocated
+ * @sa evalresp_log
+ */
+extern int evalresp_log_to_buffer (evalresp_log_msg *msg, void *data);
+
+/**
+ * @private
+ * @ingroup evalresp_private_log_buffer
+ * @brief initialize a evalresp_logger object to log to a buffer
+ *
+ * The buffer is emptied.
+ *
+ * @param[in,out] log logger object to initialize
+ * @param[in,out] buffer buffer that will receive the messages
+ * @retval EXIT_SUCCESS on success
+ * @retval EXIT_FAILURE if log or buffer are NULL
+ */
+extern int evalresp_log_intialize_log_for_buffer (evalresp_logger *log, evalresp_log_buffer *buffer);
+
+/**
+ * @private
+ * @ingroup evalresp_private_log_buffer
+ * @brief send the buffered messages, oldest first, to a logger
+ *
+ * @param[in] log logger that receives the messages, if NULL they are printed
+ *                to stderr as evalresp_log would
+ * @param[in] buffer buffer holding the messages
+ * @retval EXIT_SUCCESS when all messages were sent
+ * @retval EXIT_FAILURE if sending any message failed
+ */
+extern int evalresp_log_buffer_replay (evalresp_logger *log, evalresp_log_buffer const *buffer);
+
+/**
+ * @private
+ * @ingroup evalresp_private_log_buffer
+ * @brief free the messages held by a buffer and leave it empty
+ *
+ * @param[in,out] buffer buffer to clear (the structure itself is not freed)
+ */
+extern void evalresp_log_buffer_clear (evalresp_log_buffer *buffer);
+
+#endif /* __evalresp_log_to_buffer_h__ */
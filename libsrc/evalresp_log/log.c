@@ -39,7 +39,6 @@ int
 evalresp_log_v (evalresp_log_func log_func, void *log_func_data, int level, int verbosity, char *fmt, va_list args)
 {
   evalresp_log_msg msg[1];
-  char date_str[256]; /*TODO this is tomany bytes*/
 
   /* create message string */
   vsnprintf (msg->msg, MAX_LOG_MSG_LEN, fmt, args);
@@ -47,6 +46,14 @@ evalresp_log_v (evalresp_log_func log_func, void *log_func_data, int level, int
   msg->log_level = level;
   msg->verbosity_level = verbosity;
   msg->timestamp = time (NULL);
+  return evalresp_log_send (log_func, log_func_data, msg);
+}
+
+int
+evalresp_log_send (evalresp_log_func log_func, void *log_func_data, evalresp_log_msg *msg)
+{
+  char date_str[256]; /*TODO this is tomany bytes*/
+
   /* if using a api function then return that */
   if (log_func)
   {
@@ -57,7 +64,7 @@ evalresp_log_v (evalresp_log_func log_func, void *log_func_data, int level, int
   strftime (date_str, 256, "%c", localtime (&(msg->timestamp)));
   /* just log the msg to stderr*/
   fprintf (stderr, "%s [%s] %s\n", date_str,
-           (level < 4 && level >= 0) ? log_level_strs[level] : "unknown",
+           (msg->log_level < 4 && msg->log_level >= 0) ? log_level_strs[msg->log_level] : "unknown",
            msg->msg);
   return EXIT_SUCCESS;
 }
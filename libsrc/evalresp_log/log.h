@@ -270,6 +270,24 @@ extern int evalresp_log_basic (evalresp_log_func log_func, void *log_func_data,
  */
 extern int evalresp_log_v (evalresp_log_func log_func, void *log_func_data, int level, int verbosity, char *fmt, va_list args);
 
+/**
+ * @private
+ * @ingroup evalresp_private_log
+ * @brief Send an already formatted message to a logging function.
+ *
+ * This is the final step of evalresp_log_v, exposed so that messages which
+ * were collected earlier (see evalresp_log_to_buffer) can be delivered
+ * unchanged, with their original level and timestamp.
+ *
+ * @param[in] log_func the logging function used for controlled output of log,
+ *                     if NULL the message is printed to stderr
+ * @param[in] log_func_data data needed by the logging function to better control the logging function
+ * @param[in] msg the message to send
+ * @retval EXIT_SUCCESS when succesfully called
+ * @retval EXIT_FAILURE if something went wrong
+ */
+extern int evalresp_log_send (evalresp_log_func log_func, void *log_func_data, evalresp_log_msg *msg);
+
 /* log/helpers.c */
 /**
  * @private
@@ -1052,6 +1052,9 @@ zipcOpen(const char *filename,		/* I - Filename of container */
             cfile_len         = zipc_read_u16(zc);
             extra_field_len   = zipc_read_u16(zc);
 
+            (void)version;                      /* Read but not needed */
+            (void)modtime;
+
             if (cfile_len > (sizeof(cfile) - 1))
             {
               zc->error = "Filename too long.";
@@ -3,6 +3,7 @@
 #include <config.h>
 #endif
 
+#include <ctype.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -23,7 +24,8 @@ usage (char *program)
 {
   printf ("\nEVALRESP V%s\n", REVNUM);
   printf ("\nUSAGE: %s STALST CHALST YYYY DAY MINFREQ", program);
-  printf (" MAXFREQ NFREQ [options]\n\n");
+  printf (" MAXFREQ NFREQ [options]\n");
+  printf ("       %s -batch file [-jobs n] [-stage-cache mb] [options]\n\n", program);
   printf ("  OPTIONS:\n\n");
   printf ("    -f file              (directory-name|filename)\n");
   printf ("    -u units             ('dis'|'vel'|'acc'|'def')\n");
@@ -32,7 +34,9 @@ usage (char *program)
   printf ("    -n netid             ('II'|'IU'|'G'|'*'...)\n");
   printf ("    -l locid             ('01'|'AA,AB,AC'|'A?'|'*'...)\n");
   printf ("    -r resp_type         ('ap'=amp/pha | 'cs'=complex spectra |\n");
-  printf ("                          'fap'=freq/amp/pha)\n");
+  printf ("                          'fap'=freq/amp/pha | 'raw'|'npy'=binary\n");
+  printf ("                          freq/amp/pha | 'rawcs'|'npycs'=binary\n");
+  printf ("                          complex spectra)\n");
   printf ("    -stage start [stop]  (start and stop are integer stage numbers)\n");
   printf ("    -stdio               (take input from stdin, output to stdout)\n");
   printf ("    -use-estimated-delay (use estimated delay instead of correction applied\n");
@@ -44,6 +48,22 @@ usage (char *program)
   printf ("                          computed)\n");
   printf ("    -b62_x value         (sample value/volts where we compute response for\n");
   printf ("                          B62)\n");
+  printf ("    -threads n           (evaluate channels on n threads, 0 for one per\n");
+  printf ("                          processor; default 1)\n");
+  printf ("    -adaptive tol        (add frequencies between NFREQ until the response\n");
+  printf ("                          interpolates to within tol, eg 0.001)\n");
+  printf ("    -cache dir           (keep evaluated responses in dir, reusing them\n");
+  printf ("                          when run again with the same file and options)\n");
+  printf ("    -container file      (write all responses to a single indexed file,\n");
+  printf ("                          read with evalresp_extract)\n");
+  printf ("    -zip file            (write the response files to a ZIP archive)\n");
+  printf ("    -pipeline n          (read, parse, evaluate and write up to n input\n");
+  printf ("                          files at once; default 4)\n");
+  printf ("    -catalog file        (keep the names of the RESP files found in each\n");
+  printf ("                          directory in file, reading a directory again only\n");
+  printf ("                          when it has changed)\n");
+  printf ("    -sensitivity         (only check sensitivities, printing a table of\n");
+  printf ("                          sensitivities and stage gains to stdout)\n");
   printf ("    -v                   (verbose; list parameters on stdout)\n");
   printf ("    -x                   (expect FDSN StationXML format, default autodetect)\n\n");
   printf ("  NOTES:\n\n");
@@ -69,7 +89,13 @@ usage (char *program)
   printf ("        any stage between (and including) the start and stop stages\n");
   printf ("        will be included in the calculation.\n");
   printf ("    (7) -b62_x defines a value in counts or volts where response is\n");
-  printf ("        computed. This flag only is applied to responses with B62.\n\n");
+  printf ("        computed. This flag only is applied to responses with B62.\n");
+  printf ("    (8) With -batch each line of the file (or stdin for '-') is a\n");
+  printf ("        request, STALST CHALST YYYY DAY MINFREQ MAXFREQ NFREQ [options].\n");
+  printf ("        The options after the file apply to every line (unless the\n");
+  printf ("        line overrides them); -jobs n runs n requests at once (default\n");
+  printf ("        one per processor), -stage-cache mb shares evaluated stages\n");
+  printf ("        between requests and -catalog is shared by all of them.\n\n");
   printf ("  EXAMPLES:\n\n");
   printf ("    evalresp AAK,ARU,TLY VHZ 1992 21 0.001 10 100 -f /EVRESP/NEW/rdseed.out\n");
   printf ("    evalresp KONO BHN,BHE 1992 1 0.001 10 100 -f /EVRESP/NEW -t 12:31:04 -v\n");
@@ -101,6 +127,14 @@ parse_args (int argc, char *argv[], evalresp_options *options, evalresp_filter *
       {"unwrap", no_argument, &options->unwrap_phase, 1},
       {"ts", no_argument, &options->use_total_sensitivity, 1},
       {"b62_x", required_argument, 0, 'b'},
+      {"threads", required_argument, 0, 'T'},
+      {"adaptive", required_argument, 0, 'A'},
+      {"cache", required_argument, 0, 'C'},
+      {"container", required_argument, 0, 'K'},
+      {"zip", required_argument, 0, 'Z'},
+      {"pipeline", required_argument, 0, 'P'},
+      {"catalog", required_argument, 0, 'G'},
+      {"sensitivity", no_argument, &options->sensitivity_only, 1},
       {"verbose", no_argument, 0, 'v'},
       {"xml", no_argument, &options->station_xml, 1},
       {0, 0, 0, 0}};
@@ -146,7 +180,7 @@ parse_args (int argc, char *argv[], evalresp_options *options, evalresp_filter *
     flags_argc = argc - first_switch + 1;
     flags_argv = argv + first_switch - 1;
 
-    while (!status && -1 != (option = getopt_long_only (flags_argc, flags_argv, ":f:u:t:s:n:l:r:S:Ub:vx", cmdline_flags, &index)))
+    while (!status && -1 != (option = getopt_long_only (flags_argc, flags_argv, ":f:u:t:s:n:l:r:S:Ub:T:A:C:K:Z:P:G:vx", cmdline_flags, &index)))
     {
       switch (option)
       {
@@ -199,6 +233,35 @@ parse_args (int argc, char *argv[], evalresp_options *options, evalresp_filter *
         status = evalresp_set_b62_x (*log, options, optarg);
         break;
 
+      case 'T':
+        status = evalresp_set_threads (*log, options, optarg);
+        break;
+
+      case 'A':
+        status = evalresp_set_adaptive_tol (*log, options, optarg);
+        break;
+
+      case 'C':
+        status = evalresp_set_response_cache (*log, options, optarg);
+        break;
+
+      case 'K':
+        status = evalresp_set_container (*log, options, optarg);
+        break;
+
+      case 'Z':
+        status = evalresp_set_zip (*log, options, optarg);
+        break;
+
+      case 'P':
+        status = evalresp_set_pipeline_depth (*log, options, optarg);
+        break;
+
+      case 'G':
+        evalresp_free_catalog (&options->catalog);
+        status = evalresp_new_catalog (*log, optarg, &options->catalog);
+        break;
+
       case 'v':
         options->verbose++;
         break;
@@ -249,13 +312,354 @@ parse_args (int argc, char *argv[], evalresp_options *options, evalresp_filter *
 
   // TODO - construct log to stderr that uses verbose as the verbosity level
 
+  free (network);
+  free (location);
+  return status;
+}
+
+/* a line of a batch, split into words (in place) after the program name */
+static int
+split_line (evalresp_logger *log, char *program, char *line, int *argc, char ***argv)
+{
+  char **words, quote;
+  int size = 8;
+
+  *argc = 0;
+  if (!(*argv = calloc (size, sizeof (**argv))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate batch arguments");
+    return EVALRESP_MEM;
+  }
+  (*argv)[(*argc)++] = program;
+  for (;;)
+  {
+    while (*line && isspace ((unsigned char)*line))
+    {
+      line++;
+    }
+    if (!*line || (*argc == 1 && *line == '#'))
+    {
+      return EVALRESP_OK;
+    }
+    if (*argc + 1 >= size)
+    {
+      if (!(words = realloc (*argv, 2 * size * sizeof (**argv))))
+      {
+        evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate batch arguments");
+        return EVALRESP_MEM;
+      }
+      *argv = words;
+      size *= 2;
+    }
+    /* quotes (as in a shell, but without escapes) protect spaces and
+       wildcards */
+    if (*line == '\'' || *line == '"')
+    {
+      quote = *line++;
+      (*argv)[(*argc)++] = line;
+      while (*line && *line != quote)
+      {
+        line++;
+      }
+    }
+    else
+    {
+      (*argv)[(*argc)++] = line;
+      while (*line && !isspace ((unsigned char)*line))
+      {
+        line++;
+      }
+    }
+    if (*line)
+    {
+      *line++ = '\0';
+    }
+  }
+}
+
+/* read a whole line, however long (NULL at the end of the file) */
+static char *
+read_line (FILE *file, char **buffer, size_t *size)
+{
+  size_t len = 0;
+  char *bigger;
+
+  if (!*buffer && !(*buffer = malloc (*size = MAXLINELEN)))
+  {
+    return NULL;
+  }
+  while (fgets (*buffer + len, (int)(*size - len), file))
+  {
+    len += strlen (*buffer + len);
+    if (len && (*buffer)[len - 1] == '\n')
+    {
+      return *buffer;
+    }
+    if (len + 1 < *size)
+    {
+      break;
+    }
+    if (!(bigger = realloc (*buffer, 2 * *size)))
+    {
+      return NULL;
+    }
+    *buffer = bigger;
+    *size *= 2;
+  }
+  return len ? *buffer : NULL;
+}
+
+/* grow the arrays of requests to hold n + 1 */
+static int
+grow_batch (evalresp_logger *log, int n, int *size, evalresp_options ***options,
+            evalresp_filter ***filters, int **lines)
+{
+  evalresp_options **more_options;
+  evalresp_filter **more_filters;
+  int *more_lines;
+
+  if (n < *size)
+  {
+    return EVALRESP_OK;
+  }
+  *size = *size ? 2 * *size : 16;
+  if ((more_options = realloc (*options, *size * sizeof (**options))))
+  {
+    *options = more_options;
+  }
+  if ((more_filters = realloc (*filters, *size * sizeof (**filters))))
+  {
+    *filters = more_filters;
+  }
+  if ((more_lines = realloc (*lines, *size * sizeof (**lines))))
+  {
+    *lines = more_lines;
+  }
+  if (!more_options || !more_filters || !more_lines)
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate batch");
+    return EVALRESP_MEM;
+  }
+  return EVALRESP_OK;
+}
+
+/* parse a line of a batch, putting the defaults after the positional
+   arguments, so that options on the line override them */
+static int
+parse_line (evalresp_logger *log, int nwords, char **words, int ndefaults, char **defaults,
+            evalresp_options **options, evalresp_filter **filter)
+{
+  int status = EVALRESP_OK, argc = 0, first_switch, i;
+  char **argv;
+
+  *options = NULL;
+  *filter = NULL;
+  if (!(argv = calloc (nwords + ndefaults + 1, sizeof (*argv))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate batch arguments");
+    return EVALRESP_MEM;
+  }
+  first_switch = 0;
+  while (++first_switch < nwords && (words[first_switch][0] != '-' || is_real (words[first_switch], log)))
+    ;
+  for (i = 0; i < first_switch; i++)
+  {
+    argv[argc++] = words[i];
+  }
+  for (i = 0; i < ndefaults; i++)
+  {
+    argv[argc++] = defaults[i];
+  }
+  for (i = first_switch; i < nwords; i++)
+  {
+    argv[argc++] = words[i];
+  }
+
+  /* restart getopt for each line: BSD getopt needs optreset, glibc has
+     none and restarts when optind is 0 (optind = 1 would keep pointers
+     into the previous line's arguments) */
+#if !defined(HAVE_GETOPT_H) || HAVE_DECL_OPTRESET
+  optind = 1;
+  optreset = 1;
+#else
+  optind = 0;
+#endif
+  if (!(status = evalresp_new_options (log, options)))
+  {
+    if (!(status = evalresp_new_filter (log, filter)))
+    {
+      status = parse_args (argc, argv, *options, *filter, &log);
+    }
+  }
   if (status)
   {
-    usage (program);
+    if (*options)
+    {
+      evalresp_free_catalog (&(*options)->catalog);
+    }
+    evalresp_free_options (options);
+    evalresp_free_filter (filter);
   }
+  free (argv);
+  return status;
+}
 
-  free (network);
-  free (location);
+/* a request on each line of the batch file, with the positional arguments
+   first, as on the command line.  the options given after the batch file
+   are used for every request, except for -jobs, the number of requests run
+   at once, -catalog, which is shared by all the requests, and -stage-cache,
+   the megabytes of evaluated stages shared by the requests (none by
+   default, as the results may then differ in the last bit) */
+static int
+run_batch (evalresp_logger *log, char *program, const char *batch_file, int argc, char *argv[])
+{
+  int status = EVALRESP_OK, line_status, bad_status = EVALRESP_OK, i, n = 0, size = 0, lineno = 0;
+  int ndefaults = 0, jobs = EVALRESP_THREADS_AUTO, stage_mb = 0, nwords;
+  char *catalog_file = NULL, **defaults = NULL, **words = NULL, *buffer = NULL, *line;
+  size_t buffer_size = 0;
+  FILE *file = NULL;
+  evalresp_options **options = NULL;
+  evalresp_filter **filters = NULL;
+  int *lines = NULL, *statuses = NULL;
+  evalresp_catalog *catalog = NULL;
+  evalresp_stage_cache *stage_cache = NULL;
+  evalresp_inventory_cache *inventory_cache = NULL;
+
+  if (!(defaults = calloc (argc + 1, sizeof (*defaults))))
+  {
+    evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate batch arguments");
+    return EVALRESP_MEM;
+  }
+  for (i = 0; !status && i < argc; i++)
+  {
+    if (strcmp (argv[i], "-jobs") && strcmp (argv[i], "--jobs")
+        && strcmp (argv[i], "-catalog") && strcmp (argv[i], "--catalog")
+        && strcmp (argv[i], "-stage-cache") && strcmp (argv[i], "--stage-cache"))
+    {
+      defaults[ndefaults++] = argv[i];
+    }
+    else if (i + 1 >= argc)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Missing argument for option '%s'", argv[i]);
+      status = EVALRESP_INP;
+    }
+    else if (strstr (argv[i], "catalog"))
+    {
+      catalog_file = argv[++i];
+    }
+    else if (strstr (argv[i], "stage-cache"))
+    {
+      if (!is_int (argv[++i], log) || (stage_mb = atoi (argv[i])) < 0)
+      {
+        evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot parse stage cache size '%s'", argv[i]);
+        status = EVALRESP_INP;
+      }
+    }
+    else if (!is_int (argv[++i], log) || (jobs = atoi (argv[i])) < 0)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot parse number of jobs '%s'", argv[i]);
+      status = EVALRESP_INP;
+    }
+  }
+
+  if (!status)
+  {
+    if (!strcmp (batch_file, "-"))
+    {
+      file = stdin;
+    }
+    else if (!(file = fopen (batch_file, "r")))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot open batch file '%s'", batch_file);
+      status = EVALRESP_IO;
+    }
+  }
+
+  /* every line is parsed (and every bad line reported) before any request
+     is run */
+  while (!status && (line = read_line (file, &buffer, &buffer_size)))
+  {
+    lineno++;
+    free (words);
+    words = NULL;
+    if (!(status = split_line (log, program, line, &nwords, &words)) && nwords > 1
+        && !(status = grow_batch (log, n, &size, &options, &filters, &lines)))
+    {
+      if ((line_status = parse_line (log, nwords, words, ndefaults, defaults, &options[n], &filters[n])))
+      {
+        evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot parse line %d of batch file '%s'", lineno, batch_file);
+        if (!bad_status)
+        {
+          bad_status = line_status;
+        }
+      }
+      else
+      {
+        lines[n++] = lineno;
+      }
+    }
+  }
+  if (file && file != stdin)
+  {
+    fclose (file);
+  }
+  free (buffer);
+  free (words);
+  if (!status)
+  {
+    status = bad_status;
+  }
+
+  /* the directories, parsed files and evaluated stages are shared */
+  if (!status && !(status = evalresp_new_catalog (log, catalog_file, &catalog))
+      && !(stage_mb && (status = evalresp_new_stage_cache (log, (size_t)stage_mb * 1024 * 1024, &stage_cache)))
+      && !(status = evalresp_new_inventory_cache (log, EVALRESP_INVENTORY_CACHE_BYTES, &inventory_cache)))
+  {
+    for (i = 0; i < n; i++)
+    {
+      if (!options[i]->catalog)
+      {
+        options[i]->catalog = catalog;
+      }
+      options[i]->stage_cache = stage_cache;
+      options[i]->inventory_cache = inventory_cache;
+    }
+    if (n && !(statuses = calloc (n, sizeof (*statuses))))
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Cannot allocate batch");
+      status = EVALRESP_MEM;
+    }
+    else
+    {
+      status = evalresp_batch_to_cwd (log, n, options, filters, jobs, statuses);
+      for (i = 0; i < n; i++)
+      {
+        if (statuses[i])
+        {
+          evalresp_log (log, EV_ERROR, EV_ERROR, "Request on line %d of batch file '%s' failed",
+                        lines[i], batch_file);
+        }
+      }
+    }
+  }
+
+  for (i = 0; i < n; i++)
+  {
+    if (options[i]->catalog != catalog)
+    {
+      evalresp_free_catalog (&options[i]->catalog);
+    }
+    evalresp_free_options (&options[i]);
+    evalresp_free_filter (&filters[i]);
+  }
+  evalresp_free_inventory_cache (&inventory_cache);
+  evalresp_free_stage_cache (&stage_cache);
+  evalresp_free_catalog (&catalog);
+  free (statuses);
+  free (options);
+  free (filters);
+  free (lines);
+  free (defaults);
   return status;
 }
 
@@ -267,6 +671,17 @@ main (int argc, char *argv[])
   evalresp_options *options = NULL;
   evalresp_filter *filter = NULL;
 
+  if (argc > 1 && (!strcmp (argv[1], "-batch") || !strcmp (argv[1], "--batch")))
+  {
+    if (argc < 3)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Missing argument for option '%s'", argv[1]);
+      usage (argv[0]);
+      return EVALRESP_INP;
+    }
+    return run_batch (log, argv[0], argv[2], argc - 3, argv + 3);
+  }
+
   if (!(status = evalresp_new_options (log, &options)))
   {
     if (!(status = evalresp_new_filter (log, &filter)))
@@ -275,10 +690,18 @@ main (int argc, char *argv[])
       {
         status = evalresp_cwd_to_cwd (log, options, filter);
       }
+      else
+      {
+        usage (argv[0]);
+      }
     }
   }
 
   // TODO - free the log allocated in parse_args
+  if (options)
+  {
+    evalresp_free_catalog (&options->catalog);
+  }
   evalresp_free_options (&options);
   evalresp_free_filter (&filter);
   return status;
@@ -0,0 +1,121 @@
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef HAVE_GETOPT_H
+#include <getopt.h>
+#else
+#include "vcs_getopt.h"
+#endif
+
+#include "evalresp/public.h"
+#include "evalresp/public_api.h"
+#include "evalresp_log/log.h"
+
+void
+usage (char *program)
+{
+  printf ("\nEVALRESP_EXTRACT V%s\n", REVNUM);
+  printf ("\nUSAGE: %s [options] CONTAINER\n\n", program);
+  printf ("  Write the responses in a container (from evalresp -container) to\n");
+  printf ("  the files that evalresp would have written.\n\n");
+  printf ("  OPTIONS:\n\n");
+  printf ("    -r resp_type         ('ap'=amp/pha | 'cs'=complex spectra |\n");
+  printf ("                          'fap'=freq/amp/pha | 'raw'|'npy'=binary\n");
+  printf ("                          freq/amp/pha | 'rawcs'|'npycs'=binary\n");
+  printf ("                          complex spectra)\n");
+  printf ("    -unwrap              (unwrap phase if the output is AP)\n");
+  printf ("    -stdio               (output to stdout)\n");
+  printf ("    -zip file            (write the files to a ZIP archive)\n");
+  printf ("    -list                (list the options and responses in the\n");
+  printf ("                          container instead)\n\n");
+}
+
+static int
+list_container (evalresp_logger *log, const char *filename)
+{
+  int status, i;
+  char *metadata = NULL;
+  evalresp_responses *responses = NULL;
+  evalresp_response *response;
+
+  if (!(status = evalresp_container_to_responses (log, filename, &responses, &metadata)))
+  {
+    printf ("%s", metadata);
+    for (i = 0; i < responses->nresponses; i++)
+    {
+      response = responses->responses[i];
+      printf ("%s.%s.%s.%s %s %s %d\n", response->network, response->station, response->locid,
+              response->channel, response->beg_t, response->end_t, response->nfreqs);
+    }
+  }
+  free (metadata);
+  evalresp_free_responses (&responses);
+  return status;
+}
+
+int
+main (int argc, char *argv[])
+{
+  int status = EVALRESP_OK, option, index, list = 0;
+  evalresp_logger *log = NULL;
+  evalresp_options *options = NULL;
+
+  if (!(status = evalresp_new_options (log, &options)))
+  {
+    struct option cmdline_flags[] = {
+        {"response", required_argument, 0, 'r'},
+        {"unwrap", no_argument, &options->unwrap_phase, 1},
+        {"stdio", no_argument, &options->use_stdio, 1},
+        {"zip", required_argument, 0, 'Z'},
+        {"list", no_argument, &list, 1},
+        {0, 0, 0, 0}};
+
+    while (!status && -1 != (option = getopt_long_only (argc, argv, ":r:Z:", cmdline_flags, &index)))
+    {
+      switch (option)
+      {
+      case 0: /* This is to handle ones that get set automatically */
+        break;
+
+      case 'r':
+        status = evalresp_set_format (log, options, optarg);
+        break;
+
+      case 'Z':
+        status = evalresp_set_zip (log, options, optarg);
+        break;
+
+      default:
+        evalresp_log (log, EV_ERROR, EV_ERROR, "Bad option: %s", argv[optind - 1]);
+        status = EVALRESP_INP;
+      }
+    }
+
+    if (!status && optind != argc - 1)
+    {
+      evalresp_log (log, EV_ERROR, EV_ERROR, "Expected a single container");
+      status = EVALRESP_INP;
+    }
+
+    if (status)
+    {
+      usage (argv[0]);
+    }
+    else if (list)
+    {
+      status = list_container (log, argv[optind]);
+    }
+    else
+    {
+      status = evalresp_container_to_cwd (log, options, argv[optind]);
+    }
+  }
+
+  evalresp_free_options (&options);
+  return status;
+}
@@ -0,0 +1,735 @@
+#include <check.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "evalresp/private.h"
+#include "evalresp/public_api.h"
+#include "evalresp/spline.h"
+#include "spline/spline.h"
+
+#define NFREQS 200
+
+/* deterministic pseudo-random coefficients in [-1, 1) */
+static double
+next_coeff (unsigned long *seed)
+{
+  *seed = (*seed * 1103515245UL + 12345UL) & 0x7fffffffUL;
+  return (double)*seed / 0x40000000UL - 1.0;
+}
+
+/* a single stage channel holding the given filter followed by a
+   decimation blockette (so the filters see a sample interval) */
+static evalresp_channel *
+filter_channel (evalresp_blkt *filter, double sint)
+{
+  evalresp_channel *chan;
+  evalresp_stage *stage;
+  evalresp_blkt *deci;
+
+  fail_if (!(chan = calloc (1, sizeof (*chan))));
+  fail_if (!(stage = alloc_stage (NULL)));
+  fail_if (!(deci = alloc_deci (NULL)));
+  deci->blkt_info.decimation.sample_int = sint;
+  deci->blkt_info.decimation.deci_fact = 1;
+  deci->blkt_info.decimation.deci_offset = 0;
+  deci->blkt_info.decimation.estim_delay = 0;
+  deci->blkt_info.decimation.applied_corr = 0;
+  filter->next_blkt = deci;
+  stage->sequence_no = 1;
+  stage->input_units = COUNTS;
+  stage->output_units = COUNTS;
+  stage->first_blkt = filter;
+  chan->first_stage = stage;
+  chan->nstages = 1;
+  chan->calc_sensit = 1.0;
+  chan->unit_scale_fact = 1.0;
+  return chan;
+}
+
+static evalresp_blkt *
+fir_filter (int type, int n, unsigned long seed)
+{
+  evalresp_blkt *fir;
+  int i;
+
+  fail_if (!(fir = alloc_fir (NULL)));
+  fir->type = type;
+  fir->blkt_info.fir.ncoeffs = n;
+  fail_if (calloc_doubles (NULL, "coeffs", n, &fir->blkt_info.fir.coeffs));
+  for (i = 0; i < n; i++)
+    fir->blkt_info.fir.coeffs[i] = next_coeff (&seed);
+  return fir;
+}
+
+static void
+evaluate (evalresp_channel *chan, double *freqs, evalresp_complex *output)
+{
+  evalresp_options *options = NULL;
+  int i;
+
+  for (i = 0; i < NFREQS; i++)
+    freqs[i] = 0.5 * (i + 1) / NFREQS * 0.999 / chan->first_stage->first_blkt->next_blkt->blkt_info.decimation.sample_int;
+  fail_if (evalresp_new_options (NULL, &options));
+  options->unit = evalresp_file_unit;
+  fail_if (calculate_response (NULL, options, chan, freqs, NFREQS, output));
+  evalresp_free_options (&options);
+}
+
+static double
+abs_sum (double *a, int n)
+{
+  double sum = 0;
+  int i;
+  for (i = 0; i < n; i++)
+    sum += fabs (a[i]);
+  return sum;
+}
+
+/* the direct cos/sin summation (with atan2 re-phasing) that was used
+   before the filters were evaluated with Horner's rule */
+static void
+direct_fir_asym (double *a, int na, double sint, double w, long double *re, long double *im)
+{
+  long double r = 0, i = 0, mod, pha;
+  double wsint = w * sint;
+  int k;
+  for (k = 0; k < na; k++)
+  {
+    r += a[k] * cosl ((long double)wsint * k);
+    i -= a[k] * sinl ((long double)wsint * k);
+  }
+  mod = sqrtl (r * r + i * i);
+  pha = atan2l (i, r) + (w * (double)((na - 1) / 2.0) * sint);
+  *re = mod * cosl (pha);
+  *im = mod * sinl (pha);
+}
+
+static void
+check_fir_asym (int na, double tol)
+{
+  evalresp_channel *chan;
+  evalresp_blkt *fir;
+  double freqs[NFREQS], sint = 0.01, w, bound;
+  evalresp_complex output[NFREQS];
+  long double re, im;
+  int i;
+
+  fir = fir_filter (FIR_ASYM, na, 42);
+  chan = filter_channel (fir, sint);
+  /* cancel the delay correction so that only the filter is measured */
+  fir->next_blkt->blkt_info.decimation.applied_corr = ((na - 1) / 2.0) * sint;
+  evaluate (chan, freqs, output);
+  bound = tol * abs_sum (fir->blkt_info.fir.coeffs, na);
+  for (i = 0; i < NFREQS; i++)
+  {
+    w = 2 * M_PI * freqs[i];
+    direct_fir_asym (fir->blkt_info.fir.coeffs, na, sint, w, &re, &im);
+    fail_if (fabsl (output[i].real - re) > bound, "Real %d: %g", i,
+             (double)fabsl (output[i].real - re));
+    fail_if (fabsl (output[i].imag - im) > bound, "Imag %d: %g", i,
+             (double)fabsl (output[i].imag - im));
+  }
+  evalresp_free_channel (&chan);
+}
+
+START_TEST (test_fir_asym)
+{
+  check_fir_asym (101, 1e-13);
+}
+END_TEST
+
+START_TEST (test_fir_asym_compensated)
+{
+  /* above EVALRESP_HORNER_COMPENSATED_MIN the deviation from the
+     extended precision sum must not grow with the filter length */
+  check_fir_asym (8192, 1e-15);
+}
+END_TEST
+
+START_TEST (test_fir_sym)
+{
+  evalresp_channel *chan;
+  evalresp_blkt *fir;
+  double freqs[NFREQS], sint = 0.025, w, *a, bound;
+  evalresp_complex output[NFREQS];
+  long double sum;
+  int i, k, na = 64, type;
+
+  for (type = FIR_SYM_1; type <= FIR_SYM_2; type++)
+  {
+    fir = fir_filter (type, na, 7);
+    a = fir->blkt_info.fir.coeffs;
+    chan = filter_channel (fir, sint);
+    evaluate (chan, freqs, output);
+    bound = 1e-13 * abs_sum (a, na);
+    for (i = 0; i < NFREQS; i++)
+    {
+      w = 2 * M_PI * freqs[i] * sint;
+      sum = 0;
+      if (type == FIR_SYM_1)
+      {
+        for (k = 0; k < na - 1; k++)
+          sum += a[k] * cosl ((long double)w * (na - 1 - k));
+        sum = a[na - 1] + 2 * sum;
+      }
+      else
+      {
+        for (k = 0; k < na; k++)
+          sum += a[k] * cosl ((long double)w * (na - 1 - k + 0.5));
+        sum = 2 * sum;
+      }
+      fail_if (fabsl (output[i].real - sum) > bound, "Real %d: %g", i,
+               (double)fabsl (output[i].real - sum));
+      fail_if (output[i].imag != 0.0);
+    }
+    evalresp_free_channel (&chan);
+  }
+}
+END_TEST
+
+START_TEST (test_iir_coeffs)
+{
+  evalresp_channel *chan;
+  evalresp_blkt *iir;
+  double freqs[NFREQS], sint = 0.001, w;
+  evalresp_complex output[NFREQS];
+  /* second order butterworth low pass at a tenth of the sample rate */
+  double numer[] = {0.0674552738890719, 0.1349105477781438, 0.0674552738890719};
+  double denom[] = {1.0, -1.1429805025399011, 0.4128015980961886};
+  long double nr, ni, dr, di, amp, pha;
+  int i, k;
+
+  fail_if (!(iir = alloc_coeff (NULL)));
+  iir->type = IIR_COEFFS;
+  iir->blkt_info.coeff.nnumer = 3;
+  iir->blkt_info.coeff.ndenom = 3;
+  iir->blkt_info.coeff.h0 = 2.0;
+  fail_if (calloc_doubles (NULL, "numer", 3, &iir->blkt_info.coeff.numer));
+  fail_if (calloc_doubles (NULL, "denom", 3, &iir->blkt_info.coeff.denom));
+  for (k = 0; k < 3; k++)
+  {
+    iir->blkt_info.coeff.numer[k] = numer[k];
+    iir->blkt_info.coeff.denom[k] = denom[k];
+  }
+  chan = filter_channel (iir, sint);
+  evaluate (chan, freqs, output);
+  for (i = 0; i < NFREQS; i++)
+  {
+    w = 2 * M_PI * freqs[i] * sint;
+    nr = ni = dr = di = 0;
+    for (k = 0; k < 3; k++)
+    {
+      nr += numer[k] * cosl ((long double)w * k);
+      ni -= numer[k] * sinl ((long double)w * k);
+      dr += denom[k] * cosl ((long double)w * k);
+      di -= denom[k] * sinl ((long double)w * k);
+    }
+    amp = 2.0 * sqrtl ((nr * nr + ni * ni) / (dr * dr + di * di));
+    pha = atan2l (ni, nr) - atan2l (di, dr);
+    fail_if (fabsl (output[i].real - amp * cosl (pha)) > 1e-13 * (1 + amp), "Real %d", i);
+    fail_if (fabsl (output[i].imag - amp * sinl (pha)) > 1e-13 * (1 + amp), "Imag %d", i);
+  }
+  /* pass band gain well below the corner */
+  fail_if (fabs (hypot (output[0].real, output[0].imag) - 2.0) > 1e-3, "Gain: %f",
+           hypot (output[0].real, output[0].imag));
+  evalresp_free_channel (&chan);
+}
+END_TEST
+
+/* response of a channel, in double or single precision; returns the
+   number of operations evaluated in single precision */
+static int
+evaluate_plan_precision (evalresp_channel *chan, int normalize, int single,
+                         double *freqs, int nfreqs, evalresp_complex *output)
+{
+  evalresp_options *options = NULL;
+  evalresp_plan *plan = NULL;
+  int nsingle;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  options->single_precision = single;
+  options->unit = evalresp_file_unit;
+  fail_if (compile_plan (NULL, options, chan, normalize, &plan));
+  fail_if (evaluate_plan (NULL, plan, freqs, nfreqs, output));
+  nsingle = plan->nsingle;
+  evalresp_free_plan (&plan);
+  evalresp_free_options (&options);
+  return nsingle;
+}
+
+START_TEST (test_single_precision)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_complex expected[NFREQS], output[NFREQS];
+  double freqs[NFREQS], err, mod;
+  int i;
+
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", NULL, NULL,
+                                          &channels));
+  for (i = 0; i < NFREQS; i++)
+    freqs[i] = 0.001 * pow (10.0, 4.0 * i / NFREQS);
+  fail_if (evaluate_plan_precision (channels->channels[0], 1, 0, freqs, NFREQS, expected));
+  fail_if (!evaluate_plan_precision (channels->channels[0], 1, 1, freqs, NFREQS, output));
+  for (i = 0; i < NFREQS; i++)
+  {
+    mod = hypot (expected[i].real, expected[i].imag);
+    err = hypot (output[i].real - expected[i].real, output[i].imag - expected[i].imag);
+    fail_if (err > 1e-5 * mod, "Relative error %d: %g", i, err / mod);
+  }
+  evalresp_free_channels (&channels);
+}
+END_TEST
+
+START_TEST (test_single_precision_guard)
+{
+  evalresp_channel *chan;
+  evalresp_blkt *fir;
+  evalresp_complex expected[NFREQS], output[NFREQS];
+  double freqs[NFREQS], sint = 0.01, dc = 0, err;
+  int i, n = 16;
+
+  /* a short low pass filter is evaluated in single precision... */
+  fir = fir_filter (FIR_ASYM, n, 1);
+  for (i = 0; i < n; i++)
+    dc += (fir->blkt_info.fir.coeffs[i] = 0.5 - 0.5 * cos (2 * M_PI * (i + 1) / (n + 1)));
+  chan = filter_channel (fir, sint);
+  for (i = 0; i < NFREQS; i++)
+    freqs[i] = 0.5 * (i + 1) / NFREQS * 0.999 / sint;
+  fail_if (evaluate_plan_precision (chan, 0, 0, freqs, NFREQS, expected));
+  fail_if (!evaluate_plan_precision (chan, 0, 1, freqs, NFREQS, output));
+  for (i = 0; i < NFREQS; i++)
+  {
+    err = hypot (output[i].real - expected[i].real, output[i].imag - expected[i].imag);
+    fail_if (err > 1e-5 * dc, "Error %d: %g", i, err / dc);
+  }
+  evalresp_free_channel (&chan);
+
+  /* ...but a long one with random coefficients stays in double */
+  chan = filter_channel (fir_filter (FIR_ASYM, 1000, 3), sint);
+  fail_if (evaluate_plan_precision (chan, 0, 0, freqs, NFREQS, expected));
+  fail_if (evaluate_plan_precision (chan, 0, 1, freqs, NFREQS, output));
+  for (i = 0; i < NFREQS; i++)
+  {
+    fail_if (output[i].real != expected[i].real || output[i].imag != expected[i].imag);
+  }
+  evalresp_free_channel (&chan);
+}
+END_TEST
+
+/* response of a channel with or without simplification; returns the
+   number of operations evaluated */
+static int
+evaluate_plan_simplified (evalresp_channel *chan, int normalize, int simplify,
+                          double *freqs, int nfreqs, evalresp_complex *output)
+{
+  evalresp_options *options = NULL;
+  evalresp_plan *plan = NULL;
+  int nops;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  options->simplify = simplify;
+  options->unit = evalresp_file_unit;
+  fail_if (compile_plan (NULL, options, chan, normalize, &plan));
+  fail_if (evaluate_plan (NULL, plan, freqs, nfreqs, output));
+  nops = plan->nops;
+  evalresp_free_plan (&plan);
+  evalresp_free_options (&options);
+  return nops;
+}
+
+static evalresp_blkt *
+laplace_filter (double a0, int nzeros, const double *zeros, int npoles, const double *poles)
+{
+  evalresp_blkt *pz;
+  int i;
+
+  fail_if (!(pz = alloc_pz (NULL)));
+  pz->type = LAPLACE_PZ;
+  pz->blkt_info.pole_zero.a0 = a0;
+  pz->blkt_info.pole_zero.nzeros = nzeros;
+  pz->blkt_info.pole_zero.npoles = npoles;
+  fail_if (!(pz->blkt_info.pole_zero.zeros = alloc_complex (nzeros ? nzeros : 1, NULL)));
+  fail_if (!(pz->blkt_info.pole_zero.poles = alloc_complex (npoles ? npoles : 1, NULL)));
+  for (i = 0; i < nzeros; i++)
+  {
+    pz->blkt_info.pole_zero.zeros[i].real = zeros[2 * i];
+    pz->blkt_info.pole_zero.zeros[i].imag = zeros[2 * i + 1];
+  }
+  for (i = 0; i < npoles; i++)
+  {
+    pz->blkt_info.pole_zero.poles[i].real = poles[2 * i];
+    pz->blkt_info.pole_zero.poles[i].imag = poles[2 * i + 1];
+  }
+  return pz;
+}
+
+static void
+check_simplified (evalresp_complex *expected, evalresp_complex *output, double tol)
+{
+  double err, mod;
+  int i;
+
+  for (i = 0; i < NFREQS; i++)
+  {
+    mod = hypot (expected[i].real, expected[i].imag);
+    err = hypot (output[i].real - expected[i].real, output[i].imag - expected[i].imag);
+    fail_if (err > tol * mod, "Relative error %d: %g", i, err / mod);
+  }
+}
+
+START_TEST (test_simplify)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_channel *chan;
+  evalresp_stage *stage, *prev = NULL;
+  evalresp_complex expected[NFREQS], output[NFREQS];
+  double freqs[NFREQS];
+  /* a seismometer with a zero at the origin and a zero-pole pair a
+     relative 1e-10 apart, then a stage with a pole at the origin, then a
+     stage that is only a gain */
+  double zeros1[] = {0, 0, -1, 1}, poles1[] = {-0.037, 0.037, -0.037, -0.037, -1.0000000001, 1};
+  double poles2[] = {0, 0, -200, 0};
+  evalresp_blkt *filters[3];
+  int i;
+
+  for (i = 0; i < NFREQS; i++)
+    freqs[i] = 0.001 * pow (10.0, 4.0 * i / NFREQS);
+
+  /* a real channel with nothing to simplify is unchanged */
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", NULL, NULL,
+                                          &channels));
+  fail_if (evaluate_plan_simplified (channels->channels[0], 1, 0, freqs, NFREQS, expected)
+           != evaluate_plan_simplified (channels->channels[0], 1, 1, freqs, NFREQS, output));
+  check_simplified (expected, output, 1e-12);
+  evalresp_free_channels (&channels);
+
+  /* the stages merge, both pairs cancel and the gain stage is absorbed:
+     each cancelled pair changes the response by at most the tolerance */
+  filters[0] = laplace_filter (1.0, 2, zeros1, 3, poles1);
+  filters[1] = laplace_filter (200.0, 0, NULL, 2, poles2);
+  filters[2] = laplace_filter (5.0, 0, NULL, 0, NULL);
+  fail_if (!(chan = calloc (1, sizeof (*chan))));
+  for (i = 0; i < 3; i++)
+  {
+    fail_if (!(stage = alloc_stage (NULL)));
+    stage->sequence_no = i + 1;
+    stage->input_units = i ? VOLTS : VEL;
+    stage->output_units = VOLTS;
+    stage->first_blkt = filters[i];
+    if (prev)
+      prev->next_stage = stage;
+    else
+      chan->first_stage = stage;
+    prev = stage;
+  }
+  chan->nstages = 3;
+  chan->calc_sensit = 1.0;
+  chan->unit_scale_fact = 1.0;
+  fail_if (evaluate_plan_simplified (chan, 0, 0, freqs, NFREQS, expected) != 3);
+  fail_if (evaluate_plan_simplified (chan, 0, 1, freqs, NFREQS, output) != 1);
+  check_simplified (expected, output, 2 * EVALRESP_SIMPLIFY_TOL);
+  /* the channel itself is unchanged */
+  fail_if (filters[0]->blkt_info.pole_zero.nzeros != 2 || filters[1]->blkt_info.pole_zero.npoles != 2);
+  evalresp_free_channel (&chan);
+}
+END_TEST
+
+/* the larger of the relative amplitude and phase (radians) errors of
+   interpolating the response at f from the adaptive response around it */
+static double
+adaptive_error (int n, double const *freqs, evalresp_complex const *values,
+                double f, evalresp_complex expected)
+{
+  double t, amp, phase, turn;
+  int i = 0;
+
+  while (i < n - 2 && freqs[i + 1] < f)
+    i++;
+  t = log (f / freqs[i]) / log (freqs[i + 1] / freqs[i]);
+  amp = exp ((1 - t) * log (hypot (values[i].real, values[i].imag))
+             + t * log (hypot (values[i + 1].real, values[i + 1].imag)));
+  turn = atan2 (values[i + 1].imag, values[i + 1].real) - atan2 (values[i].imag, values[i].real);
+  turn = atan2 (sin (turn), cos (turn));
+  phase = atan2 (values[i].imag, values[i].real) + t * turn - atan2 (expected.imag, expected.real);
+  phase = fabs (atan2 (sin (phase), cos (phase)));
+  amp = fabs (amp / hypot (expected.real, expected.imag) - 1);
+  return amp > phase ? amp : phase;
+}
+
+START_TEST (test_adaptive)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_options *options = NULL;
+  evalresp_plan *plan = NULL;
+  evalresp_complex *expected, *values = NULL;
+  double coarse[20], *freqs, *adaptive = NULL, tol = 1e-3, error, worst = 0;
+  int i, n, ndense = 5000;
+
+  fail_if (!(freqs = calloc (ndense, sizeof (*freqs))));
+  fail_if (!(expected = calloc (ndense, sizeof (*expected))));
+  for (i = 0; i < 20; i++)
+    coarse[i] = 0.001 * pow (10.0, 4.0 * i / 19);
+  for (i = 0; i < ndense; i++)
+    freqs[i] = 0.001 * pow (10.0, 4.0 * i / (ndense - 1));
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", options, NULL,
+                                          &channels));
+  fail_if (evalresp_channel_to_plan (NULL, channels->channels[0], options, &plan));
+  fail_if (evalresp_plan_evaluate (NULL, plan, freqs, ndense, expected));
+  fail_if (evalresp_plan_evaluate_adaptive (NULL, plan, coarse, 20, 0, tol, 100000,
+                                            &n, &adaptive, &values));
+  /* far fewer frequencies; the ends are kept, and the rest are increasing */
+  fail_if (n <= 20 || n >= ndense / 10, "Frequencies: %d", n);
+  fail_if (adaptive[0] != coarse[0] || adaptive[n - 1] != coarse[19]);
+  for (i = 1; i < n; i++)
+    fail_if (adaptive[i] <= adaptive[i - 1]);
+  /* interpolation reproduces the response everywhere (the tolerance is
+     checked at midpoints only, so allow a little more in between) */
+  for (i = 0; i < ndense; i++)
+  {
+    error = adaptive_error (n, adaptive, values, freqs[i], expected[i]);
+    worst = error > worst ? error : worst;
+  }
+  fail_if (worst > 2 * tol, "Worst error %g", worst);
+  free (adaptive);
+  free (values);
+
+  /* the number of frequencies is limited */
+  fail_if (evalresp_plan_evaluate_adaptive (NULL, plan, coarse, 20, 0, tol, 30,
+                                            &n, &adaptive, &values));
+  fail_if (n > 30, "Frequencies: %d", n);
+  free (adaptive);
+  free (values);
+
+  free (freqs);
+  free (expected);
+  evalresp_free_plan (&plan);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+START_TEST (test_list_spline)
+{
+  double freq[50], amp[50], phase[50], query[300], walked[300], ypp_val, yppp_val;
+  double *ypp, *f1, *a1, *p1, *f2, *a2, *p2;
+  evalresp_list_spline *spline = NULL;
+  unsigned long seed = 7;
+  int i, n1, n2;
+
+  for (i = 0; i < 50; i++)
+  {
+    freq[i] = 0.01 * pow (10.0, 3.0 * i / 49);
+    amp[i] = 2.0 + next_coeff (&seed);
+    /* phases that need unwrapping */
+    phase[i] = fmod (-40.0 * i + 540.0, 360.0) - 180.0;
+  }
+  /* increasing queries, then some out of order (and outside the knots) */
+  for (i = 0; i < 300; i++)
+    query[i] = i < 250 ? 0.01 * pow (10.0, 3.0 * i / 249) : 20.0 * (next_coeff (&seed) + 1.0);
+  fail_if (!(ypp = spline_coefficients (50, freq, amp, NULL)));
+  spline_cubic_vals (50, freq, amp, ypp, query, 300, walked);
+  for (i = 0; i < 300; i++)
+    fail_if (walked[i] != spline_cubic_val (50, freq, amp, ypp, query[i], &ypp_val, &yppp_val),
+             "Value %d", i);
+  free (ypp);
+
+  /* the same values with the splines made beforehand */
+  fail_if (list_spline_new (NULL, 50, freq, amp, phase, &spline));
+  fail_if (!spline->unwrapped_flag);
+  fail_if (interpolate_list (freq, amp, phase, 50, NULL, query, 250, &f1, &a1, &p1, &n1, NULL));
+  fail_if (interpolate_list (freq, amp, phase, 50, spline, query, 250, &f2, &a2, &p2, &n2, NULL));
+  fail_if (n1 != 250 || n2 != 250);
+  for (i = 0; i < n1; i++)
+  {
+    fail_if (f1[i] != f2[i] || a1[i] != a2[i] || p1[i] != p2[i], "Value %d", i);
+    fail_if (p1[i] < -180.0 || p1[i] > 180.0, "Phase %d: %f", i, p1[i]);
+  }
+  free (f1);
+  free (a1);
+  free (p1);
+  free (f2);
+  free (a2);
+  free (p2);
+  free_list_spline (&spline);
+}
+END_TEST
+
+START_TEST (test_polynomial)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_channel *chan = NULL;
+  evalresp_options *options = NULL;
+  evalresp_plan *plan = NULL;
+  evalresp_polynomial *poly;
+  evalresp_complex response;
+  double x[NFREQS], value[NFREQS], derivative[NFREQS], expected, freq = 0.01;
+  double coeffs[4] = {0.5, 0.1, -0.02, 0.003};
+  int i, j;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_filename_to_channels (NULL, "./data/response-1", options, NULL, &channels));
+  for (i = 0; i < channels->nchannels; i++)
+  {
+    if (!strcmp (channels->channels[i]->chaname, "VMZ"))
+      chan = channels->channels[i];
+  }
+  fail_if (!chan);
+  /* a cubic instead of the linear response in the file */
+  poly = &chan->first_stage->first_blkt->blkt_info.polynomial;
+  fail_if (!(poly->coeffs = realloc (poly->coeffs, 4 * sizeof (double))));
+  memcpy (poly->coeffs, coeffs, sizeof (coeffs));
+  poly->ncoeffs = 4;
+  for (i = 0; i < NFREQS; i++)
+    x[i] = 0.05 * (i + 1);
+
+  fail_if (evalresp_polynomial_evaluate (NULL, chan->first_stage->first_blkt,
+                                         x, NFREQS, value, derivative));
+  for (i = 0; i < NFREQS; i++)
+  {
+    expected = 0;
+    for (j = 0; j < 4; j++)
+      expected += coeffs[j] * pow (x[i], j);
+    fail_if (fabs (value[i] - expected) > 1e-12 * fabs (expected), "Value %d", i);
+    expected = 0;
+    for (j = 1; j < 4; j++)
+      expected += coeffs[j] * j * pow (x[i], j - 1);
+    fail_if (fabs (derivative[i] - expected) > 1e-12 * fabs (expected), "Derivative %d", i);
+  }
+
+  /* the channel's sensitivity curve matches a response for each level */
+  options->b62_x = 1.0;
+  fail_if (evalresp_channel_to_plan (NULL, chan, options, &plan));
+  fail_if (evalresp_plan_evaluate_polynomial (NULL, plan, freq, x, NFREQS, NULL, derivative));
+  evalresp_free_plan (&plan);
+  for (i = 0; i < NFREQS; i += 17)
+  {
+    options->b62_x = x[i];
+    fail_if (evalresp_channel_to_plan (NULL, chan, options, &plan));
+    fail_if (evalresp_plan_evaluate (NULL, plan, &freq, 1, &response));
+    fail_if (fabs (derivative[i] - response.real) > 1e-12 * fabs (response.real),
+             "Sensitivity %d: %g %g", i, derivative[i], response.real);
+    evalresp_free_plan (&plan);
+  }
+
+  /* a plan without a polynomial is refused */
+  evalresp_free_channels (&channels);
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", options, NULL, &channels));
+  fail_if (evalresp_channel_to_plan (NULL, channels->channels[0], options, &plan));
+  fail_if (evalresp_plan_evaluate_polynomial (NULL, plan, freq, x, NFREQS, value, derivative) == EVALRESP_OK);
+  evalresp_free_plan (&plan);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+/* a polynomial channel with a pole-zero stage that is only a gain (B53
+   without roots and B58), before or after the polynomial stage, evaluated
+   with or without simplification */
+START_TEST (test_simplify_polynomial)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_channel *chan;
+  evalresp_options *options = NULL;
+  evalresp_plan *plan = NULL;
+  evalresp_stage *stage;
+  evalresp_complex response[2];
+  double x[NFREQS], value[2][NFREQS], derivative[2][NFREQS], freq = 0.01;
+  int after, simplify, i;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  options->b62_x = 1.0;
+  for (i = 0; i < NFREQS; i++)
+    x[i] = 0.05 * (i + 1);
+  for (after = 0; after < 2; after++)
+  {
+    fail_if (evalresp_filename_to_channels (NULL, "./data/response-1", options, NULL, &channels));
+    for (i = 0, chan = NULL; i < channels->nchannels; i++)
+    {
+      if (!strcmp (channels->channels[i]->chaname, "VMZ"))
+        chan = channels->channels[i];
+    }
+    fail_if (!chan);
+    fail_if (!(stage = alloc_stage (NULL)));
+    stage->first_blkt = laplace_filter (1.0, 0, NULL, 0, NULL);
+    fail_if (!(stage->first_blkt->next_blkt = alloc_gain (NULL)));
+    stage->first_blkt->next_blkt->blkt_info.gain.gain = 5.0;
+    if (after)
+    {
+      stage->sequence_no = 2;
+      stage->input_units = stage->output_units = COUNTS;
+      chan->first_stage->next_stage = stage;
+    }
+    else
+    {
+      stage->sequence_no = 1;
+      stage->input_units = stage->output_units = VOLTS;
+      chan->first_stage->sequence_no = 2;
+      stage->next_stage = chan->first_stage;
+      chan->first_stage = stage;
+    }
+    chan->nstages++;
+
+    /* the pole-zero filter becomes a constant, which is never combined
+       with the polynomial */
+    for (simplify = 0; simplify < 2; simplify++)
+    {
+      options->simplify = simplify;
+      fail_if (evalresp_channel_to_plan (NULL, chan, options, &plan));
+      fail_if (evalresp_plan_evaluate (NULL, plan, &freq, 1, &response[simplify]));
+      fail_if (evalresp_plan_evaluate_polynomial (NULL, plan, freq, x, NFREQS,
+                                                  value[simplify], derivative[simplify]));
+      evalresp_free_plan (&plan);
+    }
+    fail_if (fabs (response[1].real - response[0].real) > 1e-12 * fabs (response[0].real));
+    for (i = 0; i < NFREQS; i++)
+    {
+      fail_if (fabs (value[1][i] - value[0][i]) > 1e-12 * fabs (value[0][i]), "Value %d", i);
+      fail_if (fabs (derivative[1][i] - derivative[0][i]) > 1e-12 * fabs (derivative[0][i]),
+               "Derivative %d", i);
+    }
+    /* a polynomial without its blockette is refused */
+    options->simplify = 1;
+    fail_if (evalresp_channel_to_plan (NULL, chan, options, &plan));
+    for (i = 0; i < plan->nops; i++)
+    {
+      if (plan->ops[i].type == POLYNOMIAL)
+        plan->ops[i].blkt = NULL;
+    }
+    fail_if (evalresp_plan_evaluate_polynomial (NULL, plan, freq, x, NFREQS, value[0], derivative[0])
+             != EVALRESP_INP);
+    evalresp_free_plan (&plan);
+    evalresp_free_channels (&channels);
+  }
+  evalresp_free_options (&options);
+}
+END_TEST
+
+int
+main (void)
+{
+  int number_failed;
+  Suite *s = suite_create ("suite");
+  TCase *tc = tcase_create ("case");
+  tcase_add_test (tc, test_fir_asym);
+  tcase_add_test (tc, test_fir_asym_compensated);
+  tcase_add_test (tc, test_fir_sym);
+  tcase_add_test (tc, test_iir_coeffs);
+  tcase_add_test (tc, test_single_precision);
+  tcase_add_test (tc, test_single_precision_guard);
+  tcase_add_test (tc, test_simplify);
+  tcase_add_test (tc, test_adaptive);
+  tcase_add_test (tc, test_list_spline);
+  tcase_add_test (tc, test_polynomial);
+  tcase_add_test (tc, test_simplify_polynomial);
+  suite_add_tcase (s, tc);
+  SRunner *sr = srunner_create (s);
+  srunner_set_xml (sr, "check-calc.xml");
+  srunner_run_all (sr, CK_NORMAL);
+  number_failed = srunner_ntests_failed (sr);
+  srunner_free (sr);
+  return number_failed;
+}
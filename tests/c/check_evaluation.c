@@ -3,9 +3,13 @@
 #include <math.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 
 #include "evalresp/constants.h"
+#include "evalresp/private.h"
 #include "evalresp/public_api.h"
+#include "evalresp_log/examples/to_buffer.h"
 
 START_TEST (test_no_options)
 {
@@ -80,6 +84,821 @@ START_TEST (test_freqs)
 }
 END_TEST
 
+START_TEST (test_plan)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_response *response = NULL;
+  evalresp_options *options = NULL;
+  evalresp_plan *plan = NULL;
+  evalresp_complex output[3];
+  double freq = 1;
+  int i;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_set_frequency (NULL, options, "0.5", "4", "3"));
+  options->lin_freq = 1;
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", options, NULL,
+                                          &channels));
+  fail_if (evalresp_channel_to_response (NULL, channels->channels[0], options, &response));
+  fail_if (evalresp_channel_to_plan (NULL, channels->channels[0], options, &plan));
+  /* a plan can be evaluated repeatedly, at any frequencies */
+  fail_if (evalresp_plan_evaluate (NULL, plan, response->freqs, response->nfreqs, output));
+  for (i = 0; i < response->nfreqs; i++)
+  {
+    fail_if (output[i].real != response->rvec[i].real, "Real %d: %f", i, output[i].real);
+    fail_if (output[i].imag != response->rvec[i].imag, "Imag %d: %f", i, output[i].imag);
+  }
+  fail_if (evalresp_plan_evaluate (NULL, plan, &freq, 1, output));
+  fail_if (fabs (output[0].real - 918243620.549808) > 1e-3, "Real: %f", output[0].real);
+  fail_if (fabs (output[0].imag - -392298381.164822) > 1e-3, "Imag: %f", output[0].imag);
+  evalresp_free_plan (&plan);
+  fail_if (plan);
+  evalresp_free_response (&response);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+/* sum of the gains and normalizations held by a channel */
+static double
+channel_gains (evalresp_channel *channel)
+{
+  evalresp_stage *stage;
+  evalresp_blkt *blkt;
+  double sum = channel->sensit + channel->sensfreq + channel->calc_sensit;
+  int nblkts = 0;
+
+  for (stage = channel->first_stage; stage; stage = stage->next_stage)
+  {
+    for (blkt = stage->first_blkt; blkt; blkt = blkt->next_blkt, nblkts++)
+    {
+      switch (blkt->type)
+      {
+      case LAPLACE_PZ:
+      case ANALOG_PZ:
+      case IIR_PZ:
+        sum += blkt->blkt_info.pole_zero.a0 + blkt->blkt_info.pole_zero.a0_freq;
+        break;
+      case FIR_SYM_1:
+      case FIR_SYM_2:
+      case FIR_ASYM:
+        sum += blkt->blkt_info.fir.h0;
+        break;
+      case GAIN:
+        sum += blkt->blkt_info.gain.gain + blkt->blkt_info.gain.gain_freq;
+        break;
+      }
+    }
+  }
+  return sum + nblkts;
+}
+
+START_TEST (test_immutable)
+{
+  evalresp_channels *channels = NULL, *fresh = NULL;
+  evalresp_response *response = NULL, *stages = NULL;
+  evalresp_options *options = NULL;
+  double before;
+  int i;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_set_frequency (NULL, options, "0.01", "10", "20"));
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", options, NULL,
+                                          &channels));
+  before = channel_gains (channels->channels[0]);
+  /* evaluating a subset of the stages must not change the channel... */
+  fail_if (evalresp_set_start_stage (NULL, options, "1"));
+  fail_if (evalresp_set_stop_stage (NULL, options, "3"));
+  fail_if (evalresp_channel_to_response (NULL, channels->channels[0], options, &stages));
+  fail_if (channel_gains (channels->channels[0]) != before);
+  /* ...so a later evaluation of the whole channel is not affected */
+  options->start_stage = EVALRESP_ALL_STAGES;
+  options->stop_stage = 0;
+  fail_if (evalresp_channel_to_response (NULL, channels->channels[0], options, &response));
+  fail_if (channel_gains (channels->channels[0]) != before);
+  evalresp_free_response (&stages);
+  /* same response as from a freshly read channel */
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", options, NULL,
+                                          &fresh));
+  fail_if (evalresp_channel_to_response (NULL, fresh->channels[0], options, &stages));
+  for (i = 0; i < response->nfreqs; i++)
+  {
+    fail_if (response->rvec[i].real != stages->rvec[i].real, "Real %d: %f", i, response->rvec[i].real);
+    fail_if (response->rvec[i].imag != stages->rvec[i].imag, "Imag %d: %f", i, response->rvec[i].imag);
+  }
+  evalresp_free_channels (&fresh);
+  evalresp_free_response (&response);
+  evalresp_free_response (&stages);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+START_TEST (test_b55_immutable)
+{
+  evalresp_channels *channels = NULL, shared;
+  evalresp_channel *copies[8];
+  evalresp_responses *responses = NULL;
+  evalresp_response *response = NULL;
+  evalresp_options *options = NULL;
+  evalresp_list *list;
+  double *freq, *amp, amp0;
+  int nresp, i, j;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_set_frequency (NULL, options, "0.001", "5", "37"));
+  options->b55_interpolate = 1;
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IM.ATTU..BHE", options, NULL,
+                                          &channels));
+  list = &channels->channels[0]->first_stage->first_blkt->blkt_info.list;
+  nresp = list->nresp;
+  freq = list->freq;
+  amp = list->amp;
+  amp0 = amp[0];
+  /* interpolation is at the requested frequencies within the list... */
+  fail_if (evalresp_channel_to_response (NULL, channels->channels[0], options, &response));
+  fail_if (response->nfreqs >= 37 || response->nfreqs == nresp, "Frequencies: %d", response->nfreqs);
+  /* ...but leaves the list of the channel as it was */
+  fail_if (list->nresp != nresp || list->freq != freq || list->amp != amp || amp[0] != amp0);
+  /* so the same channel can be evaluated from several threads at once */
+  for (i = 0; i < 8; i++)
+  {
+    copies[i] = channels->channels[0];
+  }
+  shared.nchannels = 8;
+  shared.channels = copies;
+  fail_if (evalresp_set_threads (NULL, options, "4"));
+  fail_if (evalresp_channels_to_responses (NULL, &shared, options, &responses));
+  fail_if (responses->nresponses != 8);
+  for (i = 0; i < 8; i++)
+  {
+    fail_if (responses->responses[i]->nfreqs != response->nfreqs);
+    for (j = 0; j < response->nfreqs; j++)
+    {
+      fail_if (responses->responses[i]->rvec[j].real != response->rvec[j].real);
+      fail_if (responses->responses[i]->rvec[j].imag != response->rvec[j].imag);
+    }
+  }
+  fail_if (list->nresp != nresp || list->freq != freq || list->amp != amp || amp[0] != amp0);
+  evalresp_free_responses (&responses);
+  evalresp_free_response (&response);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+/* all the channels in the test RESP files, several times over */
+static evalresp_channels *
+many_channels (evalresp_options *options)
+{
+  char *files[] = {"./data/RESP.IU.ANMO..BHZ", "./data/RESP.IU.ANMO.00.BHZ",
+                   "./data/RESP.IU.ANMO.10.BHZ"};
+  evalresp_channels *all, *channels = NULL;
+  int i, j;
+
+  fail_if (!(all = calloc (1, sizeof (*all))));
+  for (i = 0; i < 12; i++)
+  {
+    fail_if (evalresp_filename_to_channels (NULL, files[i % 3], options, NULL, &channels));
+    fail_if (!(all->channels = realloc (all->channels, (all->nchannels + channels->nchannels) * sizeof (*all->channels))));
+    for (j = 0; j < channels->nchannels; j++)
+    {
+      all->channels[all->nchannels++] = channels->channels[j];
+    }
+    channels->nchannels = 0;
+    evalresp_free_channels (&channels);
+  }
+  return all;
+}
+
+static void
+check_threads (evalresp_options *options, evalresp_channels *channels,
+               int expected_status, int expected_nresponses)
+{
+  evalresp_responses *serial = NULL, *parallel = NULL;
+  evalresp_log_buffer serial_log, parallel_log;
+  evalresp_logger log[1];
+  int i, j;
+
+  evalresp_log_intialize_log_for_buffer (log, &serial_log);
+  options->threads = 1;
+  fail_if (evalresp_channels_to_responses (log, channels, options, &serial) != expected_status);
+  evalresp_log_intialize_log_for_buffer (log, &parallel_log);
+  options->threads = 4;
+  fail_if (evalresp_channels_to_responses (log, channels, options, &parallel) != expected_status);
+
+  fail_if (serial->nresponses != expected_nresponses, "Serial responses: %d", serial->nresponses);
+  fail_if (parallel->nresponses != expected_nresponses, "Parallel responses: %d", parallel->nresponses);
+  for (i = 0; i < serial->nresponses; i++)
+  {
+    fail_if (strcmp (serial->responses[i]->locid, parallel->responses[i]->locid));
+    fail_if (serial->responses[i]->nfreqs != parallel->responses[i]->nfreqs);
+    for (j = 0; j < serial->responses[i]->nfreqs; j++)
+    {
+      fail_if (serial->responses[i]->rvec[j].real != parallel->responses[i]->rvec[j].real);
+      fail_if (serial->responses[i]->rvec[j].imag != parallel->responses[i]->rvec[j].imag);
+    }
+  }
+  /* the log messages arrive grouped by channel, in channel order */
+  fail_if (serial_log.nmsgs != parallel_log.nmsgs, "Messages: %d %d", serial_log.nmsgs, parallel_log.nmsgs);
+  for (i = 0; i < serial_log.nmsgs; i++)
+  {
+    fail_if (strcmp (serial_log.msgs[i].msg, parallel_log.msgs[i].msg), "Message %d", i);
+  }
+  evalresp_log_buffer_clear (&serial_log);
+  evalresp_log_buffer_clear (&parallel_log);
+  evalresp_free_responses (&serial);
+  evalresp_free_responses (&parallel);
+}
+
+START_TEST (test_threads)
+{
+  evalresp_channels *channels;
+  evalresp_options *options = NULL;
+  evalresp_blkt *blkt;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_set_frequency (NULL, options, "0.01", "10", "50"));
+  options->verbose = 1;
+  channels = many_channels (options);
+  fail_if (channels->nchannels != 16, "Channels: %d", channels->nchannels);
+  check_threads (options, channels, EVALRESP_OK, 16);
+
+  /* a zero gain is an error: the channels before it are kept */
+  for (blkt = channels->channels[9]->first_stage->first_blkt; blkt->type != GAIN; blkt = blkt->next_blkt)
+    ;
+  blkt->blkt_info.gain.gain = 0;
+  check_threads (options, channels, EVALRESP_VAL, 9);
+
+  fail_if (evalresp_set_threads (NULL, options, "-1") == EVALRESP_OK);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+START_TEST (test_freq_threads)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_options *options = NULL;
+  evalresp_plan *serial = NULL, *parallel = NULL;
+  evalresp_complex *expected, *output;
+  double *freqs;
+  int i, n = 100000;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", options, NULL,
+                                          &channels));
+  fail_if (!(freqs = calloc (n, sizeof (*freqs))));
+  fail_if (!(expected = calloc (n, sizeof (*expected))));
+  fail_if (!(output = calloc (n, sizeof (*output))));
+  for (i = 0; i < n; i++)
+  {
+    freqs[i] = 0.001 + 10.0 * i / n;
+  }
+  options->freq_threads = 1;
+  fail_if (evalresp_channel_to_plan (NULL, channels->channels[0], options, &serial));
+  options->freq_threads = 4;
+  options->parallel_nfreq = 1000;
+  fail_if (evalresp_channel_to_plan (NULL, channels->channels[0], options, &parallel));
+  fail_if (evalresp_plan_evaluate (NULL, serial, freqs, n, expected));
+  fail_if (evalresp_plan_evaluate (NULL, parallel, freqs, n, output));
+  for (i = 0; i < n; i++)
+  {
+    fail_if (output[i].real != expected[i].real, "Real %d: %f", i, output[i].real);
+    fail_if (output[i].imag != expected[i].imag, "Imag %d: %f", i, output[i].imag);
+  }
+  evalresp_free_plan (&serial);
+  evalresp_free_plan (&parallel);
+  free (freqs);
+  free (expected);
+  free (output);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+typedef struct
+{
+  evalresp_mutex *mutex;
+  int depth;
+  int fail_stage;
+  int fail_item;
+  int next[3];    /* next item expected by each stage */
+  int written;    /* items through the last stage */
+  int misordered; /* items taken out of order */
+  int too_deep;   /* items started with depth items not yet written */
+} pipeline_test;
+
+static int
+pipeline_test_task (void *arg, int stage, int item)
+{
+  pipeline_test *test = arg;
+
+  mutex_lock (test->mutex);
+  test->misordered += item != test->next[stage]++;
+  if (stage == 0)
+  {
+    test->too_deep += test->depth > 1 && item >= test->written + test->depth;
+  }
+  mutex_unlock (test->mutex);
+  if (stage == test->fail_stage && item == test->fail_item)
+  {
+    return EVALRESP_VAL;
+  }
+  if (stage == 2)
+  {
+    mutex_lock (test->mutex);
+    test->written++;
+    mutex_unlock (test->mutex);
+  }
+  return EVALRESP_OK;
+}
+
+static void
+check_pipeline (int depth, int fail_stage, int fail_item, int n)
+{
+  pipeline_test test;
+  int failed, status;
+
+  memset (&test, 0, sizeof (test));
+  fail_if (mutex_new (NULL, &test.mutex));
+  test.depth = depth;
+  test.fail_stage = fail_stage;
+  test.fail_item = fail_item;
+  status = run_pipeline (NULL, 3, n, depth, pipeline_test_task, &test, &failed);
+  fail_if (status != (fail_item < n ? EVALRESP_VAL : EVALRESP_OK), "Status: %d", status);
+  /* the items before the failure, and only those, are written */
+  fail_if (failed != (fail_item < n ? fail_item : n), "Failed: %d", failed);
+  fail_if (test.written != failed, "Written: %d", test.written);
+  fail_if (test.misordered, "Misordered: %d", test.misordered);
+  fail_if (test.too_deep, "Too deep: %d", test.too_deep);
+  mutex_free (&test.mutex);
+}
+
+START_TEST (test_pipeline)
+{
+  int depth;
+
+  for (depth = 0; depth <= 4; depth += 2)
+  {
+    check_pipeline (depth, -1, 1000, 1000);
+    check_pipeline (depth, 1, 37, 1000);
+    check_pipeline (depth, 2, 37, 1000);
+    check_pipeline (depth, 0, 0, 1000);
+    check_pipeline (depth, -1, 0, 0);
+  }
+}
+END_TEST
+
+typedef struct
+{
+  evalresp_mutex *mutex;
+  int fail_item;  /* fails its first call */
+  int fail_later; /* fails its call in order */
+  int *started;   /* first call made for each item */
+  int finished;   /* items through the call in order */
+  int finishing;  /* calls in order running now */
+  int held;       /* items between the two calls */
+  int most_held;
+  int misordered; /* items finished out of order, or before they started */
+  int overlapped; /* calls in order made at the same time */
+} ordered_test;
+
+static int
+ordered_test_task (void *arg, int thread, int item, int in_order)
+{
+  ordered_test *test = arg;
+
+  (void)thread;
+  mutex_lock (test->mutex);
+  if (!in_order)
+  {
+    test->started[item] = 1;
+    if (++test->held > test->most_held)
+    {
+      test->most_held = test->held;
+    }
+  }
+  else
+  {
+    test->misordered += item != test->finished || !test->started[item];
+    test->overlapped += test->finishing++;
+  }
+  mutex_unlock (test->mutex);
+  if (in_order)
+  {
+    mutex_lock (test->mutex);
+    test->finished++;
+    test->finishing--;
+    test->held--;
+    mutex_unlock (test->mutex);
+  }
+  return (!in_order && item == test->fail_item) || (in_order && item == test->fail_later) ? EVALRESP_VAL : EVALRESP_OK;
+}
+
+static void
+check_ordered (int nthreads, int fail_item, int fail_later, int n)
+{
+  ordered_test test;
+  int failed, status, first = fail_item < fail_later ? fail_item : fail_later;
+
+  memset (&test, 0, sizeof (test));
+  fail_if (mutex_new (NULL, &test.mutex));
+  fail_if (!(test.started = calloc (n + 1, sizeof (*test.started))));
+  test.fail_item = fail_item;
+  test.fail_later = fail_later;
+  status = run_ordered (NULL, nthreads, n, ordered_test_task, &test, &failed);
+  fail_if (status != (first < n ? EVALRESP_VAL : EVALRESP_OK), "Status: %d", status);
+  /* every item is processed, whatever fails */
+  fail_if (failed != (first < n ? first : n), "Failed: %d", failed);
+  fail_if (test.finished != n, "Finished: %d", test.finished);
+  fail_if (test.misordered, "Misordered: %d", test.misordered);
+  fail_if (test.overlapped, "Overlapped: %d", test.overlapped);
+  fail_if (test.most_held > (nthreads > 1 ? 2 * nthreads : 1), "Held: %d", test.most_held);
+  free (test.started);
+  mutex_free (&test.mutex);
+}
+
+START_TEST (test_ordered)
+{
+  int nthreads;
+
+  for (nthreads = 1; nthreads <= 4; nthreads += 3)
+  {
+    check_ordered (nthreads, 1000, 1000, 1000);
+    check_ordered (nthreads, 37, 1000, 1000);
+    check_ordered (nthreads, 500, 37, 1000);
+    check_ordered (nthreads, 0, 0, 1000);
+    check_ordered (nthreads, 0, 0, 0);
+  }
+}
+END_TEST
+
+START_TEST (test_stage_cache)
+{
+  evalresp_channels *channels;
+  evalresp_options *options = NULL;
+  evalresp_responses *expected = NULL, *cached = NULL;
+  evalresp_stage_cache *cache = NULL;
+  evalresp_stage_cache_stats first, stats;
+  evalresp_complex *a, *b;
+  int i, j;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_set_frequency (NULL, options, "0.01", "10", "500"));
+  channels = many_channels (options);
+  fail_if (evalresp_channels_to_responses (NULL, channels, options, &expected));
+
+  /* the files repeat, so most stages are found in the cache */
+  fail_if (evalresp_new_stage_cache (NULL, 1 << 24, &cache));
+  options->stage_cache = cache;
+  fail_if (evalresp_channels_to_responses (NULL, channels, options, &cached));
+  fail_if (cached->nresponses != expected->nresponses);
+  for (i = 0; i < cached->nresponses; i++)
+  {
+    for (j = 0; j < cached->responses[i]->nfreqs; j++)
+    {
+      a = &cached->responses[i]->rvec[j];
+      b = &expected->responses[i]->rvec[j];
+      fail_if (hypot (a->real - b->real, a->imag - b->imag) > 1e-12 * hypot (b->real, b->imag),
+               "Response %d, freq %d", i, j);
+    }
+  }
+  evalresp_stage_cache_get_stats (cache, &first);
+  fail_if (!first.hits || !first.misses || first.evictions, "%lu %lu %lu", first.hits, first.misses, first.evictions);
+  fail_if (first.misses >= first.hits, "%lu %lu", first.hits, first.misses);
+
+  /* a second pass, on several threads, only hits */
+  evalresp_free_responses (&cached);
+  options->threads = 4;
+  fail_if (evalresp_channels_to_responses (NULL, channels, options, &cached));
+  evalresp_stage_cache_get_stats (cache, &stats);
+  fail_if (stats.misses != first.misses);
+  fail_if (stats.hits != 2 * first.hits + first.misses);
+  evalresp_free_responses (&cached);
+  evalresp_free_stage_cache (&cache);
+
+  /* a small cache evicts but stays within its size */
+  fail_if (evalresp_new_stage_cache (NULL, 20000, &cache));
+  options->stage_cache = cache;
+  options->threads = 1;
+  fail_if (evalresp_channels_to_responses (NULL, channels, options, &cached));
+  evalresp_stage_cache_get_stats (cache, &stats);
+  fail_if (!stats.evictions);
+  fail_if (stats.bytes > 20000 || !stats.entries, "%d entries, %lu bytes", stats.entries, (unsigned long)stats.bytes);
+  fail_if (cached->nresponses != expected->nresponses);
+
+  evalresp_free_responses (&cached);
+  evalresp_free_responses (&expected);
+  evalresp_free_stage_cache (&cache);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+START_TEST (test_freq_grid)
+{
+  evalresp_channels *channels;
+  evalresp_options *options = NULL;
+  evalresp_responses *responses = NULL;
+  evalresp_freq_grid *grid = NULL, *copy = NULL, *bad = NULL;
+  evalresp_plan *plan = NULL;
+  evalresp_complex *expected, *output;
+  double const *freqs;
+  int i, j, k, n;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_set_frequency (NULL, options, "0.001", "20", "1000"));
+  channels = many_channels (options);
+  fail_if (evalresp_new_freq_grid (NULL, options, &grid));
+  n = evalresp_freq_grid_nfreqs (grid);
+  freqs = evalresp_freq_grid_freqs (grid);
+  fail_if (n != 1000);
+  fail_if (fabs (freqs[0] - 0.001) > 1e-15 || fabs (freqs[n - 1] - 20) > 1e-12);
+  fail_if (evalresp_new_freq_grid_from_array (NULL, freqs, n, &copy));
+  fail_if (evalresp_new_freq_grid_from_array (NULL, freqs, -1, &bad) == EVALRESP_OK);
+  fail_if (!(expected = calloc (n, sizeof (*expected))));
+  fail_if (!(output = calloc (n, sizeof (*output))));
+
+  /* the tables give the same values as plain frequencies, whether just
+     made or reused */
+  for (i = 0; i < 3; i++)
+  {
+    fail_if (evalresp_channel_to_plan (NULL, channels->channels[i], options, &plan));
+    fail_if (evalresp_plan_evaluate (NULL, plan, freqs, n, expected));
+    for (k = 0; k < 2; k++)
+    {
+      fail_if (evalresp_plan_evaluate_grid (NULL, plan, k ? grid : copy, output));
+      for (j = 0; j < n; j++)
+      {
+        fail_if (output[j].real != expected[j].real, "Real %d: %g %g", j, output[j].real, expected[j].real);
+        fail_if (output[j].imag != expected[j].imag, "Imag %d: %g %g", j, output[j].imag, expected[j].imag);
+      }
+    }
+    evalresp_free_plan (&plan);
+  }
+
+  /* channels sharing a grid, on several threads */
+  options->freq_grid = grid;
+  options->threads = 4;
+  fail_if (evalresp_channels_to_responses (NULL, channels, options, &responses));
+  fail_if (responses->nresponses != 16);
+  fail_if (evalresp_channel_to_plan (NULL, channels->channels[15], options, &plan));
+  fail_if (evalresp_plan_evaluate (NULL, plan, freqs, n, expected));
+  fail_if (responses->responses[15]->nfreqs != n);
+  for (j = 0; j < n; j++)
+  {
+    fail_if (responses->responses[15]->freqs[j] != freqs[j]);
+    fail_if (responses->responses[15]->rvec[j].real != expected[j].real);
+    fail_if (responses->responses[15]->rvec[j].imag != expected[j].imag);
+  }
+
+  free (expected);
+  free (output);
+  evalresp_free_plan (&plan);
+  evalresp_free_responses (&responses);
+  evalresp_free_freq_grid (&grid);
+  evalresp_free_freq_grid (&copy);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+START_TEST (test_split)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_options *options = NULL;
+  evalresp_plan *plan = NULL;
+  evalresp_stage_cache *cache = NULL;
+  evalresp_complex output[200];
+  double freqs[200], real[200], imag[200];
+  int i, k, n = 200;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", options, NULL,
+                                          &channels));
+  fail_if (evalresp_new_stage_cache (NULL, 1 << 20, &cache));
+  for (i = 0; i < n; i++)
+  {
+    freqs[i] = 0.001 * pow (1.05, i);
+  }
+  /* plain, then with the stages cached (evaluated, then found) */
+  for (k = 0; k < 3; k++)
+  {
+    options->stage_cache = k ? cache : NULL;
+    fail_if (evalresp_channel_to_plan (NULL, channels->channels[0], options, &plan));
+    fail_if (evalresp_plan_evaluate (NULL, plan, freqs, n, output));
+    fail_if (evalresp_plan_evaluate_split (NULL, plan, freqs, n, real, imag));
+    for (i = 0; i < n; i++)
+    {
+      fail_if (real[i] != output[i].real, "Real %d: %g %g", i, real[i], output[i].real);
+      fail_if (imag[i] != output[i].imag, "Imag %d: %g %g", i, imag[i], output[i].imag);
+    }
+    evalresp_free_plan (&plan);
+  }
+  evalresp_free_stage_cache (&cache);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+static void
+check_sensitivities (evalresp_options *options, evalresp_channels *channels,
+                     int expected_status, int expected_nsensitivities)
+{
+  evalresp_sensitivities *serial = NULL, *parallel = NULL;
+  evalresp_sensitivity *sensitivity;
+  double product;
+  int i, j;
+
+  options->threads = 1;
+  fail_if (evalresp_channels_to_sensitivities (NULL, channels, options, &serial) != expected_status);
+  options->threads = 4;
+  fail_if (evalresp_channels_to_sensitivities (NULL, channels, options, &parallel) != expected_status);
+  fail_if (serial->nsensitivities != expected_nsensitivities, "Serial: %d", serial->nsensitivities);
+  fail_if (parallel->nsensitivities != expected_nsensitivities, "Parallel: %d", parallel->nsensitivities);
+  for (i = 0; i < serial->nsensitivities; i++)
+  {
+    sensitivity = serial->sensitivities[i];
+    fail_if (strcmp (sensitivity->locid, channels->channels[i]->locid));
+    fail_if (sensitivity->sensit != channels->channels[i]->sensit);
+    fail_if (sensitivity->percent_diff > 0.1, "Difference %d: %g%%", i, sensitivity->percent_diff);
+    /* the stage gains multiply to the calculated sensitivity */
+    fail_if (sensitivity->ngains < 2, "Gains %d: %d", i, sensitivity->ngains);
+    for (j = 0, product = 1.0; j < sensitivity->ngains; j++)
+    {
+      fail_if (sensitivity->stages[j] != j + 1, "Stage %d: %d", j, sensitivity->stages[j]);
+      product *= sensitivity->gains[j];
+    }
+    fail_if (fabs (product - sensitivity->calc_sensit) > 1e-9 * sensitivity->calc_sensit,
+             "Product %d: %g %g", i, product, sensitivity->calc_sensit);
+    fail_if (sensitivity->calc_sensit != parallel->sensitivities[i]->calc_sensit);
+    fail_if (sensitivity->ngains != parallel->sensitivities[i]->ngains);
+  }
+  evalresp_free_sensitivities (&serial);
+  evalresp_free_sensitivities (&parallel);
+}
+
+START_TEST (test_sensitivity)
+{
+  evalresp_channels *channels;
+  evalresp_options *options = NULL;
+  evalresp_blkt *blkt;
+
+  fail_if (evalresp_new_options (NULL, &options));
+  channels = many_channels (options);
+  check_sensitivities (options, channels, EVALRESP_OK, 16);
+
+  /* a zero gain is an error: the channels before it are kept */
+  for (blkt = channels->channels[9]->first_stage->first_blkt; blkt->type != GAIN; blkt = blkt->next_blkt)
+    ;
+  blkt->blkt_info.gain.gain = 0;
+  check_sensitivities (options, channels, EVALRESP_VAL, 9);
+
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+START_TEST (test_response_cache)
+{
+  char *file = "./data/RESP.IU.ANMO.00.BHZ", *dir = "./response_cache";
+  evalresp_channels *channels = NULL;
+  evalresp_options *options = NULL;
+  evalresp_responses *responses = NULL, *cached = NULL;
+  response_cache_key key, other;
+  int i, j, hit;
+
+  /* setting the cache creates its directory */
+  (void)rmdir (dir);
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_set_response_cache (NULL, options, dir));
+  fail_if (strcmp (options->response_cache, dir));
+  fail_if (evalresp_set_frequency (NULL, options, "0.01", "10", "100"));
+  fail_if (response_cache_key_file (file, options, NULL, &key));
+  fail_if (response_cache_load (NULL, dir, &key, &cached, &hit));
+  fail_if (hit);
+
+  fail_if (evalresp_filename_to_channels (NULL, file, options, NULL, &channels));
+  fail_if (evalresp_channels_to_responses (NULL, channels, options, &responses));
+  response_cache_save (NULL, dir, &key, responses, 0);
+  response_cache_evict (NULL, dir, 1 << 20);
+  fail_if (response_cache_load (NULL, dir, &key, &cached, &hit));
+  fail_if (!hit);
+  fail_if (cached->nresponses != responses->nresponses);
+  for (i = 0; i < responses->nresponses; i++)
+  {
+    fail_if (strcmp (cached->responses[i]->channel, responses->responses[i]->channel));
+    fail_if (cached->responses[i]->nfreqs != responses->responses[i]->nfreqs);
+    for (j = 0; j < responses->responses[i]->nfreqs; j++)
+    {
+      fail_if (cached->responses[i]->freqs[j] != responses->responses[i]->freqs[j]);
+      fail_if (cached->responses[i]->rvec[j].real != responses->responses[i]->rvec[j].real);
+      fail_if (cached->responses[i]->rvec[j].imag != responses->responses[i]->rvec[j].imag);
+    }
+  }
+
+  /* any option that changes the response changes the key */
+  options->unit = evalresp_acceleration_unit;
+  fail_if (response_cache_key_file (file, options, NULL, &other));
+  fail_if (other.hash == key.hash);
+  /* saving does not evict, but trimming beyond the size does */
+  response_cache_save (NULL, dir, &other, responses, 0);
+  fail_if (response_cache_load (NULL, dir, &key, &cached, &hit));
+  fail_if (!hit);
+  evalresp_free_responses (&cached);
+  response_cache_evict (NULL, dir, 1);
+  evalresp_free_responses (&cached);
+  fail_if (response_cache_load (NULL, dir, &key, &cached, &hit));
+  fail_if (hit);
+  fail_if (response_cache_load (NULL, dir, &other, &cached, &hit));
+  fail_if (hit);
+
+  evalresp_free_responses (&cached);
+  evalresp_free_responses (&responses);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+  (void)rmdir (dir);
+}
+END_TEST
+
+/* the largest error of a deconvolved unit sine, delayed by phase, over
+   samples [begin, end) */
+static double
+sine_error (double const *output, int begin, int end, double rate, double f, double phase)
+{
+  double error, worst = 0;
+  int i;
+
+  for (i = begin; i < end; i++)
+  {
+    error = fabs (output[i] - sin (2 * M_PI * f * i / rate - phase));
+    worst = error > worst ? error : worst;
+  }
+  return worst;
+}
+
+START_TEST (test_deconvolve)
+{
+  evalresp_channels *channels = NULL;
+  evalresp_options *options = NULL;
+  evalresp_plan *plan = NULL;
+  evalresp_deconvolver *deconvolver = NULL;
+  evalresp_complex h;
+  double pre_filt[] = {0.1, 0.2, 8, 9}, rate = 20, f = 0.5, phase;
+  double *input, *output, *chunked;
+  int i, n = 10000, nout, total, chunk;
+
+  fail_if (!(input = calloc (n, sizeof (*input))));
+  fail_if (!(output = calloc (n + 2048, sizeof (*output))));
+  fail_if (!(chunked = calloc (n + 2048, sizeof (*chunked))));
+  fail_if (evalresp_new_options (NULL, &options));
+  fail_if (evalresp_filename_to_channels (NULL, "./data/RESP.IU.ANMO..BHZ", options, NULL,
+                                          &channels));
+  fail_if (evalresp_channel_to_plan (NULL, channels->channels[0], options, &plan));
+  fail_if (evalresp_plan_evaluate (NULL, plan, &f, 1, &h));
+  /* counts for a unit sine */
+  for (i = 0; i < n; i++)
+  {
+    input[i] = hypot (h.real, h.imag) * sin (2 * M_PI * f * i / rate);
+  }
+  phase = atan2 (h.imag, h.real);
+
+  /* a single block is good away from its ends */
+  fail_if (evalresp_new_deconvolver (NULL, plan, rate, 60, pre_filt, 2048, 1024, &deconvolver));
+  fail_if (evalresp_deconvolve (NULL, deconvolver, input, 4096, output));
+  fail_if (sine_error (output, 1024, 3072, rate, f, phase) > 1e-3, "Block error");
+
+  /* streamed, the output does not depend on how the input is split */
+  for (chunk = 1; chunk <= 4096; chunk *= 8)
+  {
+    for (i = 0, total = 0; i < n; i += chunk)
+    {
+      fail_if (evalresp_deconvolve_stream (NULL, deconvolver, input + i, i + chunk < n ? chunk : n - i,
+                                           (chunk == 1 ? output : chunked) + total, &nout));
+      total += nout;
+    }
+    fail_if (evalresp_deconvolve_flush (NULL, deconvolver, (chunk == 1 ? output : chunked) + total, &nout));
+    total += nout;
+    fail_if (total != n, "Streamed %d of %d", total, n);
+    for (i = 0; chunk > 1 && i < n; i++)
+    {
+      fail_if (chunked[i] != output[i], "Sample %d", i);
+    }
+  }
+  fail_if (sine_error (output, 2048, n - 2048, rate, f, phase) > 1e-3, "Stream error");
+  evalresp_free_deconvolver (&deconvolver);
+
+  fail_if (evalresp_new_deconvolver (NULL, plan, rate, 60, NULL, 100, 100, &deconvolver) == EVALRESP_OK);
+  evalresp_free_plan (&plan);
+  evalresp_free_channels (&channels);
+  evalresp_free_options (&options);
+  free (input);
+  free (output);
+  free (chunked);
+}
+END_TEST
+
 int
 main (void)
 {
@@ -89,6 +908,19 @@ main (void)
   tcase_add_test (tc, test_no_options);
   tcase_add_test (tc, test_start);
   tcase_add_test (tc, test_freqs);
+  tcase_add_test (tc, test_plan);
+  tcase_add_test (tc, test_immutable);
+  tcase_add_test (tc, test_b55_immutable);
+  tcase_add_test (tc, test_threads);
+  tcase_add_test (tc, test_freq_threads);
+  tcase_add_test (tc, test_pipeline);
+  tcase_add_test (tc, test_ordered);
+  tcase_add_test (tc, test_stage_cache);
+  tcase_add_test (tc, test_freq_grid);
+  tcase_add_test (tc, test_split);
+  tcase_add_test (tc, test_sensitivity);
+  tcase_add_test (tc, test_response_cache);
+  tcase_add_test (tc, test_deconvolve);
   suite_add_tcase (s, tc);
   SRunner *sr = srunner_create (s);
   srunner_set_xml (sr, "check-evaluation.xml");
@@ -380,7 +380,7 @@ old_evresp_itp (char *stalst, char *chalst, char *net_code,
   }
   else
   {
-    flst_head = find_files (file, scns, &mode, log);
+    flst_head = find_files (file, scns, &mode, NULL, log);
     flst_ptr = flst_head;
   }
 
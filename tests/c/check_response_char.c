@@ -2,8 +2,11 @@
 #include <check.h>
 #include <fcntl.h>
 #include <math.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "evalresp/private.h"
@@ -11,6 +14,7 @@
 #include "evalresp/public_compat.h"
 #include "evalresp/stationxml2resp.h"
 #include "evalresp/stationxml2resp/dom_to_seed.h"
+#include "mxml/zipc.h"
 
 FILE *
 open_path (const char *dir, const char *file)
@@ -120,6 +124,531 @@ START_TEST (test_response_char_phase)
 }
 END_TEST
 
+START_TEST (test_format_e6)
+{
+  double special[] = {0.0, -0.0, 1.0, -1.0, 9.9999995, 9.9999994999, 1234567.5, 1234568.5,
+                      0.5, 1e-7, 1e22, 1e23, 1e-22, 1e-23, 1e300, -1e-300, 4.9e-324,
+                      2.2250738585072014e-308, 1.7976931348623157e308, 0.1, 0.3, 123456.65,
+                      INFINITY, -INFINITY, NAN};
+  char expected[FORMAT_E6_SIZE], actual[FORMAT_E6_SIZE];
+  double value;
+  uint64_t bits;
+  int i, n;
+
+  for (i = 0; i < sizeof (special) / sizeof (special[0]); i++)
+  {
+    n = format_e6 (special[i], actual);
+    snprintf (expected, sizeof (expected), "%.6E", special[i]);
+    ck_assert_msg (!strcmp (expected, actual), expected);
+    ck_assert (n == strlen (expected));
+  }
+
+  /* random magnitudes, and values that are (nearly) exact in 7 digits */
+  srand (43);
+  for (i = 0; i < 200000; i++)
+  {
+    if (i % 2)
+    {
+      bits = ((uint64_t)rand () << 62) ^ ((uint64_t)rand () << 31) ^ (uint64_t)rand ();
+      memcpy (&value, &bits, sizeof (value));
+    }
+    else
+    {
+      value = (rand () % 20000000 - 10000000) * pow (10, rand () % 60 - 30) / 2;
+    }
+    n = format_e6 (value, actual);
+    snprintf (expected, sizeof (expected), "%.6E", value);
+    ck_assert_msg (!strcmp (expected, actual), expected);
+    ck_assert (n == strlen (expected));
+  }
+}
+END_TEST
+
+START_TEST (test_response_stream)
+{
+  char cwd[1000];
+  char *test_string = NULL, *stream_string = NULL;
+  evalresp_response *response = NULL;
+  evalresp_file_format format;
+  FILE *file;
+  long len;
+
+  ck_assert (NULL != getcwd (cwd, 1000));
+
+  response = get_response (cwd, "data/station-1.xml", "ANMO", "BH1", "IU", "00", "2015,1,00:00:00");
+
+  /* the same text, whether collected in memory or written directly */
+  for (format = evalresp_fap_file_format; format <= evalresp_complex_file_format; format++)
+  {
+    test_string = NULL;
+    ck_assert (EVALRESP_OK == evalresp_response_to_char (NULL, response, 1, format, &test_string));
+    ck_assert (NULL != (file = tmpfile ()));
+    ck_assert (EVALRESP_OK == evalresp_response_to_stream (NULL, response, 1, format, file));
+    len = ftell (file);
+    ck_assert (len == strlen (test_string));
+    ck_assert (NULL != (stream_string = calloc (len + 1, 1)));
+    rewind (file);
+    ck_assert (len == fread (stream_string, 1, len, file));
+    ck_assert (!strcmp (test_string, stream_string));
+    fclose (file);
+    free (stream_string);
+    free (test_string);
+  }
+}
+END_TEST
+
+START_TEST (test_response_binary)
+{
+  char cwd[1000];
+  char *test_string = NULL;
+  evalresp_response *response = NULL;
+  evalresp_file_format format;
+  unsigned char *bytes;
+  const unsigned char *data;
+  double text[3];
+  FILE *file;
+  long len;
+  int i, j, offset, n, header_len;
+
+  ck_assert (NULL != getcwd (cwd, 1000));
+
+  response = get_response (cwd, "data/station-1.xml", "ANMO", "BH1", "IU", "00", "2015,1,00:00:00");
+
+  for (format = evalresp_raw_fap_file_format; format <= evalresp_npy_complex_file_format; format++)
+  {
+    ck_assert (NULL != (file = tmpfile ()));
+    ck_assert (EVALRESP_OK == evalresp_response_to_stream (NULL, response, 1, format, file));
+    len = ftell (file);
+    ck_assert (NULL != (bytes = calloc (len, 1)));
+    rewind (file);
+    ck_assert (len == fread (bytes, 1, len, file));
+    fclose (file);
+
+    if (format == evalresp_raw_fap_file_format || format == evalresp_raw_complex_file_format)
+    {
+      ck_assert (!memcmp (bytes, "EVALRESP", 8));
+      ck_assert (1 == get_le (bytes + 8, 4));
+      ck_assert ((format == evalresp_raw_fap_file_format ? 1 : 2) == get_le (bytes + 12, 4));
+      ck_assert (response->nfreqs == get_le (bytes + 16, 8));
+      ck_assert (3 == get_le (bytes + 24, 8));
+      header_len = 32;
+    }
+    else
+    {
+      ck_assert (!memcmp (bytes, "\x93NUMPY\x01\x00", 8));
+      header_len = 10 + get_le (bytes + 8, 2);
+      ck_assert (0 == header_len % 64);
+      ck_assert ('\n' == bytes[header_len - 1]);
+      ck_assert (NULL != strstr ((char *)bytes + 10, "'descr': '<f8'"));
+      ck_assert (NULL != strstr ((char *)bytes + 10, "'shape': (19, 3)"));
+    }
+    ck_assert (len == header_len + 24 * response->nfreqs);
+
+    /* the same values as the text files, to the precision of the text */
+    test_string = NULL;
+    ck_assert (EVALRESP_OK == evalresp_response_to_char (NULL, response, 1,
+                                                         (format == evalresp_raw_fap_file_format || format == evalresp_npy_fap_file_format) ? evalresp_fap_file_format : evalresp_complex_file_format,
+                                                         &test_string));
+    data = bytes + header_len;
+    for (i = 0, offset = 0; i < response->nfreqs; i++)
+    {
+      ck_assert (3 == sscanf (test_string + offset, "%lf %lf %lf%n", &text[0], &text[1], &text[2], &n));
+      offset += n;
+      for (j = 0; j < 3; j++)
+      {
+        ck_assert (fabs (get_le_double (data + 8 * (3 * i + j)) - text[j]) <= 1e-6 * fabs (text[j]));
+      }
+    }
+    free (test_string);
+    free (bytes);
+
+    /* binary cannot be returned as a string */
+    test_string = NULL;
+    ck_assert (EVALRESP_OK != evalresp_response_to_char (NULL, response, 1, format, &test_string));
+    ck_assert (NULL == test_string);
+  }
+}
+END_TEST
+
+START_TEST (test_response_container)
+{
+  char cwd[1000], line[100];
+  char *metadata = NULL, *text = NULL;
+  evalresp_response *response = NULL, *copy;
+  evalresp_responses responses, *read = NULL;
+  evalresp_options *options = NULL;
+  zipc_t *zc;
+  zipc_file_t *zf;
+  int i, n;
+
+  ck_assert (NULL != getcwd (cwd, 1000));
+
+  response = get_response (cwd, "data/station-1.xml", "ANMO", "BH1", "IU", "00", "2015,1,00:00:00");
+  strcpy (response->beg_t, "2014,351,18:40:00");
+  responses.nresponses = 1;
+  responses.responses = &response;
+  ck_assert (EVALRESP_OK == evalresp_new_options (NULL, &options));
+
+  /* the responses (and options) come back unchanged */
+  ck_assert (EVALRESP_OK == evalresp_responses_to_container (NULL, &responses, options, "check_container.evc"));
+  ck_assert (EVALRESP_OK == evalresp_container_to_responses (NULL, "check_container.evc", &read, &metadata));
+  ck_assert (NULL != strstr (metadata, "unit=VEL\n"));
+  ck_assert (1 == read->nresponses);
+  copy = read->responses[0];
+  ck_assert (!strcmp (copy->network, "IU") && !strcmp (copy->station, "ANMO"));
+  ck_assert (!strcmp (copy->locid, "00") && !strcmp (copy->channel, "BH1"));
+  ck_assert (!strcmp (copy->beg_t, "2014,351,18:40:00"));
+  ck_assert (copy->nfreqs == response->nfreqs);
+  for (i = 0; i < copy->nfreqs; i++)
+  {
+    ck_assert (copy->freqs[i] == response->freqs[i]);
+    ck_assert (copy->rvec[i].real == response->rvec[i].real);
+    ck_assert (copy->rvec[i].imag == response->rvec[i].imag);
+  }
+  evalresp_free_responses (&read);
+  free (metadata);
+  ck_assert (EVALRESP_OK != evalresp_container_to_responses (NULL, "data/station-1.xml", &read, NULL));
+  evalresp_free_responses (&read);
+  remove ("check_container.evc");
+
+  /* the zip archive holds the files that would be written to the cwd */
+  ck_assert (EVALRESP_OK == evalresp_responses_to_zip (NULL, &responses, 0, evalresp_ap_output_format, "check_container.zip"));
+  ck_assert (NULL != (zc = zipcOpen ("check_container.zip", "r")));
+  ck_assert (NULL != (zf = zipcOpenFile (zc, "PHASE.IU.ANMO.00.BH1")));
+  ck_assert (EVALRESP_OK == evalresp_response_to_char (NULL, response, 0, evalresp_phase_file_format, &text));
+  for (i = 0, n = 0; zipcFileGets (zf, line, sizeof (line)) == 0; i++)
+  {
+    ck_assert (!strncmp (line, text + n, strlen (line)));
+    n += strlen (line) + 1;
+  }
+  ck_assert (i == response->nfreqs);
+  ck_assert (NULL != zipcOpenFile (zc, "AMP.IU.ANMO.00.BH1"));
+  zipcClose (zc);
+  free (text);
+  remove ("check_container.zip");
+  evalresp_free_options (&options);
+}
+END_TEST
+
+START_TEST (test_cwd_files)
+{
+  evalresp_options *options = NULL;
+  evalresp_filter *filter = NULL;
+  evalresp_responses *read = NULL;
+  evalresp_response *a, *b;
+  int i, j, anmo = 0;
+
+  ck_assert (EVALRESP_OK == evalresp_new_options (NULL, &options));
+  ck_assert (EVALRESP_OK == evalresp_set_filename (NULL, options, "data"));
+  ck_assert (EVALRESP_OK == evalresp_set_frequency (NULL, options, "0.01", "10", "10"));
+  ck_assert (EVALRESP_OK == evalresp_set_container (NULL, options, "check_cwd.evc"));
+  ck_assert (EVALRESP_OK == evalresp_new_filter (NULL, &filter));
+  ck_assert (EVALRESP_OK == evalresp_set_year (NULL, filter, "2015"));
+  ck_assert (EVALRESP_OK == evalresp_set_julian_day (NULL, filter, "1"));
+  /* the first two both find RESP.IU.ANMO.00.BHZ */
+  ck_assert (EVALRESP_OK == evalresp_add_sncl_text (NULL, filter, "IU", "ANMO", "*", "BHZ"));
+  ck_assert (EVALRESP_OK == evalresp_add_sncl_text (NULL, filter, "*", "ANMO", "00", "BHZ"));
+  ck_assert (EVALRESP_OK == evalresp_add_sncl_text (NULL, filter, "IM", "ATTU", "*", "BHE"));
+  ck_assert (EVALRESP_OK == evalresp_cwd_to_cwd (NULL, options, filter));
+
+  /* each channel is evaluated once, whichever sncls found its file */
+  ck_assert (EVALRESP_OK == evalresp_container_to_responses (NULL, "check_cwd.evc", &read, NULL));
+  for (i = 0; i < read->nresponses; i++)
+  {
+    a = read->responses[i];
+    anmo += !strcmp (a->station, "ANMO") && !strcmp (a->locid, "00");
+    for (j = i + 1; j < read->nresponses; j++)
+    {
+      b = read->responses[j];
+      ck_assert (strcmp (a->network, b->network) || strcmp (a->station, b->station)
+                 || strcmp (a->locid, b->locid) || strcmp (a->channel, b->channel));
+    }
+  }
+  ck_assert (anmo == 1);
+  evalresp_free_responses (&read);
+  remove ("check_cwd.evc");
+  evalresp_free_filter (&filter);
+  evalresp_free_options (&options);
+}
+END_TEST
+
+/* the files found with a catalog, as a string */
+static void
+catalog_files (evalresp_catalog *catalog, const char *pattern, char *found)
+{
+  char copy[MAXLINELEN];
+  struct matched_files *files = alloc_matched_files (NULL);
+  struct file_list *file;
+
+  strcpy (copy, pattern);
+  if (catalog)
+  {
+    catalog_names (NULL, catalog, copy, files);
+  }
+  else
+  {
+    get_names (copy, files, NULL);
+  }
+  found[0] = '\0';
+  for (file = files->first_list; file; file = file->next_file)
+  {
+    if (file->name)
+    {
+      strcat (found, file->name);
+      strcat (found, " ");
+    }
+  }
+  free_matched_files (files);
+}
+
+START_TEST (test_catalog)
+{
+  const char *patterns[] = {"data/RESP.IU.ANMO.*.BHZ", "data/RESP.*.ANMO.??.BH?",
+                            "data/RESP.IU.ANMO.[!1]*.BHZ", "data/RESP.HAW.CO.00.HHZ.*",
+                            "data/RESP.XX.*.BHZ data/RESP.IM.ATTU.*.BHE", "data/RESP.XX.*"};
+  char expected[1024], found[1024];
+  evalresp_catalog *catalog = NULL;
+  FILE *file;
+  int i, pass;
+
+  /* the catalog finds the same files as glob(), whether read from the
+     directory or loaded from the saved catalog */
+  remove ("check_catalog.txt");
+  for (pass = 0; pass < 2; pass++)
+  {
+    ck_assert (EVALRESP_OK == evalresp_new_catalog (NULL, "check_catalog.txt", &catalog));
+    catalog_check (catalog);
+    for (i = 0; i < sizeof (patterns) / sizeof (patterns[0]); i++)
+    {
+      catalog_files (NULL, patterns[i], expected);
+      catalog_files (catalog, patterns[i], found);
+      ck_assert_str_eq (expected, found);
+    }
+    evalresp_free_catalog (&catalog);
+    ck_assert (NULL != (file = fopen ("check_catalog.txt", "r")));
+    fclose (file);
+  }
+  remove ("check_catalog.txt");
+
+  /* a file added to a directory is seen on the next search */
+  mkdir ("check_catalog", 0777);
+  ck_assert (NULL != (file = fopen ("check_catalog/RESP.XX.YY..ZZZ", "w")));
+  fclose (file);
+  ck_assert (EVALRESP_OK == evalresp_new_catalog (NULL, NULL, &catalog));
+  catalog_check (catalog);
+  catalog_files (catalog, "check_catalog/RESP.XX.YY.*.ZZZ", found);
+  ck_assert_str_eq ("check_catalog/RESP.XX.YY..ZZZ ", found);
+  ck_assert (NULL != (file = fopen ("check_catalog/RESP.XX.YY.00.ZZZ", "w")));
+  fclose (file);
+  catalog_check (catalog);
+  catalog_files (catalog, "check_catalog/RESP.XX.YY.*.ZZZ", found);
+  ck_assert_str_eq ("check_catalog/RESP.XX.YY.00.ZZZ check_catalog/RESP.XX.YY..ZZZ ", found);
+  evalresp_free_catalog (&catalog);
+  remove ("check_catalog/RESP.XX.YY..ZZZ");
+  remove ("check_catalog/RESP.XX.YY.00.ZZZ");
+  rmdir ("check_catalog");
+}
+END_TEST
+
+/* do two files hold the same bytes? */
+static int
+same_file (const char *a, const char *b)
+{
+  FILE *fa, *fb;
+  int ca, cb;
+
+  ck_assert (NULL != (fa = fopen (a, "rb")));
+  ck_assert (NULL != (fb = fopen (b, "rb")));
+  do
+  {
+    ca = fgetc (fa);
+    cb = fgetc (fb);
+  } while (ca == cb && ca != EOF);
+  fclose (fa);
+  fclose (fb);
+  return ca == cb;
+}
+
+START_TEST (test_batch)
+{
+  const char *freqs[][3] = {{"0.01", "10", "10"}, {"0.1", "20", "50"}, {"0.01", "10", "10"}, {"0.01", "10", "10"}};
+  const char *stations[] = {"ANMO", "ANMO", "ATTU", "ANMO"};
+  const char *channels[] = {"BHZ", "BH?", "BHE", "BHZ"};
+  evalresp_options *options[4];
+  evalresp_filter *filters[4];
+  evalresp_catalog *catalog = NULL;
+  evalresp_inventory_cache *inventory_cache = NULL;
+  char single[64], batch[64];
+  int i, statuses[4];
+
+  ck_assert (EVALRESP_OK == evalresp_new_catalog (NULL, NULL, &catalog));
+  ck_assert (EVALRESP_OK == evalresp_new_inventory_cache (NULL, EVALRESP_INVENTORY_CACHE_BYTES, &inventory_cache));
+  for (i = 0; i < 4; i++)
+  {
+    ck_assert (EVALRESP_OK == evalresp_new_options (NULL, &options[i]));
+    ck_assert (EVALRESP_OK == evalresp_set_filename (NULL, options[i], "data"));
+    ck_assert (EVALRESP_OK == evalresp_set_frequency (NULL, options[i], freqs[i][0], freqs[i][1], freqs[i][2]));
+    ck_assert (EVALRESP_OK == evalresp_new_filter (NULL, &filters[i]));
+    ck_assert (EVALRESP_OK == evalresp_set_year (NULL, filters[i], "2015"));
+    ck_assert (EVALRESP_OK == evalresp_set_julian_day (NULL, filters[i], "1"));
+    ck_assert (EVALRESP_OK == evalresp_add_sncl_text (NULL, filters[i], "*", stations[i], "*", channels[i]));
+    /* each request run alone */
+    sprintf (single, "check_single%d.evc", i);
+    ck_assert (EVALRESP_OK == evalresp_set_container (NULL, options[i], single));
+    ck_assert (EVALRESP_OK == evalresp_cwd_to_cwd (NULL, options[i], filters[i]));
+    sprintf (batch, "check_batch%d.evc", i);
+    ck_assert (EVALRESP_OK == evalresp_set_container (NULL, options[i], batch));
+    options[i]->catalog = catalog;
+    options[i]->inventory_cache = inventory_cache;
+  }
+  /* the last cannot be run in a batch */
+  options[3]->use_stdio = 1;
+
+  /* the batch, with shared caches, writes the same files */
+  ck_assert (EVALRESP_INP == evalresp_batch_to_cwd (NULL, 4, options, filters, 3, statuses));
+  for (i = 0; i < 4; i++)
+  {
+    sprintf (single, "check_single%d.evc", i);
+    sprintf (batch, "check_batch%d.evc", i);
+    if (i < 3)
+    {
+      ck_assert (EVALRESP_OK == statuses[i]);
+      ck_assert (same_file (single, batch));
+      remove (batch);
+    }
+    remove (single);
+    evalresp_free_options (&options[i]);
+    evalresp_free_filter (&filters[i]);
+  }
+  ck_assert (EVALRESP_INP == statuses[3]);
+  evalresp_free_inventory_cache (&inventory_cache);
+  evalresp_free_catalog (&catalog);
+}
+END_TEST
+
+START_TEST (test_batch_large)
+{
+  evalresp_options *options[3];
+  evalresp_filter *filters[3];
+  char single[64], batch[64];
+  int i, statuses[3];
+
+  for (i = 0; i < 3; i++)
+  {
+    ck_assert (EVALRESP_OK == evalresp_new_options (NULL, &options[i]));
+    ck_assert (EVALRESP_OK == evalresp_set_filename (NULL, options[i], "data"));
+    ck_assert (EVALRESP_OK == evalresp_set_frequency (NULL, options[i], "0.001", "10", "5000"));
+    /* alone, each response is split over several threads */
+    options[i]->freq_threads = 4;
+    options[i]->parallel_nfreq = 1000;
+    ck_assert (EVALRESP_OK == evalresp_new_filter (NULL, &filters[i]));
+    ck_assert (EVALRESP_OK == evalresp_set_year (NULL, filters[i], "2015"));
+    ck_assert (EVALRESP_OK == evalresp_set_julian_day (NULL, filters[i], "1"));
+    ck_assert (EVALRESP_OK == evalresp_add_sncl_text (NULL, filters[i], "*", i == 1 ? "ATTU" : "ANMO", "*", "BH?"));
+    sprintf (single, "check_single%d.evc", i);
+    ck_assert (EVALRESP_OK == evalresp_set_container (NULL, options[i], single));
+    ck_assert (EVALRESP_OK == evalresp_cwd_to_cwd (NULL, options[i], filters[i]));
+    sprintf (batch, "check_batch%d.evc", i);
+    ck_assert (EVALRESP_OK == evalresp_set_container (NULL, options[i], batch));
+  }
+
+  /* in a batch on several threads each response is evaluated on one, with
+     the same results, and the options are left unchanged */
+  ck_assert (EVALRESP_OK == evalresp_batch_to_cwd (NULL, 3, options, filters, 3, statuses));
+  for (i = 0; i < 3; i++)
+  {
+    sprintf (single, "check_single%d.evc", i);
+    sprintf (batch, "check_batch%d.evc", i);
+    ck_assert (EVALRESP_OK == statuses[i]);
+    ck_assert (same_file (single, batch));
+    ck_assert (4 == options[i]->freq_threads);
+    remove (single);
+    remove (batch);
+    evalresp_free_options (&options[i]);
+    evalresp_free_filter (&filters[i]);
+  }
+}
+END_TEST
+
+START_TEST (test_batch_no_match)
+{
+  evalresp_options *options[2];
+  evalresp_filter *filters[2];
+  int i, statuses[2];
+
+  for (i = 0; i < 2; i++)
+  {
+    ck_assert (EVALRESP_OK == evalresp_new_options (NULL, &options[i]));
+    ck_assert (EVALRESP_OK == evalresp_set_filename (NULL, options[i], "data"));
+    ck_assert (EVALRESP_OK == evalresp_set_frequency (NULL, options[i], "0.01", "10", "10"));
+    ck_assert (EVALRESP_OK == evalresp_new_filter (NULL, &filters[i]));
+    ck_assert (EVALRESP_OK == evalresp_set_year (NULL, filters[i], "2015"));
+    ck_assert (EVALRESP_OK == evalresp_set_julian_day (NULL, filters[i], "1"));
+    ck_assert (EVALRESP_OK == evalresp_add_sncl_text (NULL, filters[i], "*", "NONE", "*", "BHZ"));
+  }
+
+  /* requests that match no channel write nothing, as when run alone */
+  ck_assert (EVALRESP_OK == evalresp_batch_to_cwd (NULL, 2, options, filters, 2, statuses));
+  for (i = 0; i < 2; i++)
+  {
+    ck_assert (EVALRESP_OK == statuses[i]);
+    evalresp_free_options (&options[i]);
+    evalresp_free_filter (&filters[i]);
+  }
+}
+END_TEST
+
+START_TEST (test_response_chunks)
+{
+  int nfreqs = 100000, i;
+  char *test_string = NULL, *stream_string;
+  evalresp_response response;
+  evalresp_file_format format;
+  text_buffer buffer = {NULL, 0, 0, NULL};
+  long len;
+
+  memset (&response, 0, sizeof (response));
+  response.nfreqs = nfreqs;
+  ck_assert (NULL != (response.freqs = calloc (nfreqs, sizeof (*response.freqs))));
+  ck_assert (NULL != (response.rvec = calloc (nfreqs, sizeof (*response.rvec))));
+  for (i = 0; i < nfreqs; i++)
+  {
+    response.freqs[i] = 0.001 * (i + 1);
+    response.rvec[i].real = cos (i * 0.01) * (i + 1);
+    response.rvec[i].imag = sin (i * 0.01) / (i + 1);
+  }
+
+  /* a stream receives the output in chunks, so the buffer does not grow */
+  for (format = evalresp_fap_file_format; format <= evalresp_npy_complex_file_format; format++)
+  {
+    ck_assert (NULL != (buffer.file = tmpfile ()));
+    buffer.len = 0;
+    ck_assert (EVALRESP_OK == response_to_buffer (NULL, &response, 1, format, &buffer));
+    ck_assert (EVALRESP_OK == text_buffer_flush (NULL, &buffer));
+    ck_assert (TEXT_BUFFER_SIZE == buffer.size);
+    len = ftell (buffer.file);
+    ck_assert (len > TEXT_BUFFER_SIZE);
+    if (!is_binary_file_format (format))
+    {
+      test_string = NULL;
+      ck_assert (EVALRESP_OK == evalresp_response_to_char (NULL, &response, 1, format, &test_string));
+      ck_assert (len == strlen (test_string));
+      ck_assert (NULL != (stream_string = calloc (len + 1, 1)));
+      rewind (buffer.file);
+      ck_assert (len == fread (stream_string, 1, len, buffer.file));
+      ck_assert (!strcmp (test_string, stream_string));
+      free (stream_string);
+      free (test_string);
+    }
+    fclose (buffer.file);
+  }
+
+  free (buffer.text);
+  free (response.freqs);
+  free (response.rvec);
+}
+END_TEST
+
 int
 main (void)
 {
@@ -128,6 +657,16 @@ main (void)
   TCase *tc = tcase_create ("case");
   tcase_add_test (tc, test_response_char_amp);
   tcase_add_test (tc, test_response_char_phase);
+  tcase_add_test (tc, test_format_e6);
+  tcase_add_test (tc, test_response_stream);
+  tcase_add_test (tc, test_response_binary);
+  tcase_add_test (tc, test_response_container);
+  tcase_add_test (tc, test_cwd_files);
+  tcase_add_test (tc, test_catalog);
+  tcase_add_test (tc, test_batch);
+  tcase_add_test (tc, test_batch_large);
+  tcase_add_test (tc, test_batch_no_match);
+  tcase_add_test (tc, test_response_chunks);
   suite_add_tcase (s, tc);
   SRunner *sr = srunner_create (s);
   srunner_set_xml (sr, "check-response-char.xml");